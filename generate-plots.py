@@ -1,9 +1,11 @@
 ''' Plot results from the experiments.
     usage: python generate-plots.py <rank_csv> <select_csv> <sparsearray_csv>
+           python generate-plots.py --bench <bench_json>
     author: Daniel Nichols
     date: February 2022
 '''
 # std lib
+import json
 import sys
 from os import makedirs
 from os.path import join as path_join
@@ -97,9 +99,115 @@ def make_sparsearray_plots(df):
     fig.savefig(path_join('figs', 'sparsearray-overhead-experiment-plots.png'))
 
 
+INSTRUMENT_COUNTERS = ['rank_calls', 'select_calls', 'select_search_steps', 'select_scan_words', 'build_bits_scanned',
+                       'cycles', 'llc_misses', 'dtlb_misses']
+
+
+def read_bench(fname):
+    ''' Reads the JSON written by `bin/bench --benchmark_out=<fname> --benchmark_out_format=json` into one row per
+        benchmark and statistic.
+        df columns: family,run_name,statistic,size,density,alphabet,pattern,pages,label,ns_per_op,p99_ns_per_op,
+                    items_per_second,bytes_per_second,bytes_per_elem,huge_page_fraction, and INSTRUMENT_COUNTERS
+    '''
+    with open(fname, 'r') as fp:
+        benchmarks = json.load(fp)['benchmarks']
+
+    rows = []
+    for bench in benchmarks:
+        if bench.get('run_type') != 'aggregate' or bench.get('error_occurred', False):
+            continue
+        rows.append({
+            'family': bench['run_name'].split('/')[0],
+            'run_name': bench['run_name'],
+            'statistic': bench['aggregate_name'],
+            'size': bench.get('size'),
+            'density': bench.get('density'),
+            'alphabet': bench.get('alphabet'),
+            'pattern': bench.get('pattern'),
+            'pages': bench.get('pages'),
+            'label': bench.get('label', ''),
+            'ns_per_op': bench.get('ns_per_op'),
+            'p99_ns_per_op': bench.get('p99_ns_per_op'),
+            'items_per_second': bench.get('items_per_second'),
+            'bytes_per_second': bench.get('bytes_per_second'),
+            'bytes_per_elem': bench.get('bytes_per_elem'),
+            'huge_page_fraction': bench.get('huge_page_fraction'),
+        })
+        # per operation counters of an INSTRUMENT=1 build; hardware events only where the kernel allowed them
+        for counter in INSTRUMENT_COUNTERS:
+            rows[-1][counter] = bench.get(counter)
+    return pd.DataFrame(rows)
+
+
+def make_bench_plots(df):
+    ''' Generates plots for the benchmark suite. Per query benchmark: N vs ns/op, one panel per density (alphabet size
+        for WaveletMatrix) and one line per query pattern (median, with the min to max range over the
+        repetitions shaded, and the median p99 over the query batches dashed). Per page size comparison: the same, one
+        line per page size. Per build and serialization benchmark: N vs throughput, one
+        line per density (or alphabet size).
+        df columns: see read_bench
+    '''
+
+    def stat(name):
+        return df[df['statistic'] == name].set_index('run_name')
+
+    median, low, high = stat('median'), stat('min'), stat('max')
+
+    for family, group in median.groupby('family'):
+        fname = family.replace('<', '-').replace('>', '').replace('::', '-')
+        panel = 'density' if group['density'].notna().all() else 'alphabet'
+        if group['pattern'].notna().all():
+            values = sorted(group[panel].unique())
+            fig, axes = plt.subplots(1, len(values), figsize=(4*len(values), 5), sharey=True, squeeze=False)
+            for ax, value in zip(axes[0], values):
+                for label, line in group[group[panel] == value].groupby('label'):
+                    line = line.sort_values('size')
+                    color = ax.plot(line['size'], line['ns_per_op'], label=label)[0].get_color()
+                    ax.plot(line['size'], line['p99_ns_per_op'], '--', color=color)
+                    ax.fill_between(line['size'], low.loc[line.index, 'ns_per_op'],
+                        high.loc[line.index, 'ns_per_op'], alpha=0.2)
+                ax.set_xscale('log')
+                ax.set_title('{} {}'.format(panel, value))
+            axes[0][0].set_ylabel('ns/op')
+            axes[0][-1].legend()
+            fig.text(0.5, 0.01, 'Size (N)', ha='center')
+        elif group['pages'].notna().all():
+            fig, ax = plt.subplots(1, figsize=(8,5))
+            for label, line in group.groupby('label'):
+                line = line.sort_values('size')
+                color = ax.plot(line['size'], line['ns_per_op'], label=label)[0].get_color()
+                ax.plot(line['size'], line['p99_ns_per_op'], '--', color=color)
+                ax.fill_between(line['size'], low.loc[line.index, 'ns_per_op'], high.loc[line.index, 'ns_per_op'],
+                    alpha=0.2)
+            ax.set_xscale('log')
+            ax.set_xlabel('Size (N)')
+            ax.set_ylabel('ns/op')
+            ax.legend()
+        else:
+            fig, ax = plt.subplots(1, figsize=(8,5))
+            for value, line in group.groupby(panel):
+                line = line.sort_values('size')
+                ax.plot(line['size'], line['items_per_second'], label='{} {}'.format(panel, value))
+            ax.set_xscale('log')
+            ax.set_yscale('log')
+            ax.set_xlabel('Size (N)')
+            ax.set_ylabel('Elements per Second')
+            ax.legend()
+        fig.suptitle(family)
+        fig.tight_layout()
+        fig.savefig(path_join('figs', 'bench-{}.png'.format(fname)))
+        plt.close(fig)
+
+
 def main():
+    if len(sys.argv) == 3 and sys.argv[1] == '--bench':
+        makedirs('figs', exist_ok=True)
+        make_bench_plots(read_bench(sys.argv[2]))
+        return
+
     if len(sys.argv) != 4:
         print('usage: {} <rank_csv> <select_csv> <sparsearray_csv>'.format(sys.argv[0]), sys.stderr)
+        print('       {} --bench <bench_json>'.format(sys.argv[0]), sys.stderr)
         exit(1)
 
     # mkdir -p figs
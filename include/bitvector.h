@@ -5,53 +5,256 @@
 #pragma once
 
 // stl includes
+#include <algorithm>
+#include <array>
 #include <bit>
-#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <exception>
 #include <fstream>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <random>
+#include <ranges>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 // local includes
+#include "instrument.h"
 #include "utilities.h"
 
 /* forward declarations */
-namespace sparse { template<typename T> class SparseArray; }    /* so RankSupport and SelectSupport can friend it */
+namespace sparse { class BitVectorPositions; }    /* so RankSupport can friend it */
 
 namespace bitvector {
 
+/**
+ * @brief Forward iterator over the positions of the set bits in a sequence of words. Each word is scanned with
+ * countr_zero (tzcnt) and cleared one bit at a time with `word & (word - 1)` (blsr), so a scan costs O(1) per word
+ * plus O(1) per set bit instead of a probe per bit. Ends at std::default_sentinel.
+ *
+ * @tparam Cursor hands out the words in order: `bool done()`, `uint64_t position()` (index of bit 0 of the next
+ * word), and `uint64_t next()` (the next word). Words may hold fewer than 64 bits.
+ */
+template <typename Cursor>
+class OnesIterator {
+    public:
+        using value_type = uint64_t;
+        using difference_type = std::ptrdiff_t;
+
+        OnesIterator() = default;
+
+        explicit OnesIterator(Cursor cursor) : cursor_(std::move(cursor)) {
+            this->skipEmpty();
+        }
+
+        /**
+         * @return uint64_t position of the current set bit
+         */
+        uint64_t operator*() const noexcept {
+            return base_ + std::countr_zero(word_);
+        }
+
+        OnesIterator& operator++() noexcept {
+            word_ &= word_ - 1;
+            this->skipEmpty();
+            return *this;
+        }
+
+        OnesIterator operator++(int) noexcept {
+            OnesIterator previous = *this;
+            ++(*this);
+            return previous;
+        }
+
+        bool operator==(OnesIterator const& other) const noexcept {
+            return base_ == other.base_ && word_ == other.word_;
+        }
+
+        bool operator==(std::default_sentinel_t) const noexcept {
+            return word_ == 0;
+        }
+
+    private:
+        Cursor cursor_ {};
+        uint64_t base_ = 0, word_ = 0;
+
+        void skipEmpty() noexcept {
+            while (word_ == 0 && !cursor_.done()) {
+                base_ = cursor_.position();
+                word_ = cursor_.next();
+            }
+            if (word_ == 0) {
+                base_ = 0;   /* every exhausted iterator compares equal */
+            }
+        }
+};
+
+/**
+ * @brief Cursor over a plain word array for OnesIterator.
+ */
+struct WordCursor {
+    uint64_t const* words = nullptr;
+    uint64_t index = 0, end = 0;
+
+    bool done() const noexcept {
+        return index == end;
+    }
+
+    uint64_t position() const noexcept {
+        return index * 64;
+    }
+
+    uint64_t next() noexcept {
+        return words[index++];
+    }
+};
+
+/**
+ * @brief Range of the set bit positions in a word array, in increasing order.
+ */
+using OnesRange = std::ranges::subrange<OnesIterator<WordCursor>, std::default_sentinel_t>;
+
 /**
  * @brief BitVector class for storing bit arrays in a compact format.
+ * 
+ * Bits are stored little-endian in 64-bit words. The word array is aligned to a cache line and padded to a whole
+ * number of cache lines, so word loads never straddle a line and never read past the allocation.
  */
 class BitVector {
     public:
+        /**
+         * @brief number of bits in each storage word
+         */
+        constexpr static uint64_t WORD_BITS = 64;
+
+        /**
+         * @brief alignment (in bytes) of the word array. Also the padding granularity.
+         */
+        constexpr static std::size_t ALIGNMENT = 64;
+
         /**
          * @brief Construct a new BitVector object. Creates room for `size` bits.
          * 
          * @param size number of bits.
          */
-        BitVector(uint64_t size) noexcept : size_(size), 
-            data_(std::make_unique<uint8_t[]>(utility::roundDivisionUp(size_, 8))) {}
+        BitVector(uint64_t size) : BitVector(size, utility::AllocationPolicy()) {}
+
+        /**
+         * @brief Construct a new BitVector object of `size` bits whose words are allocated by `policy`, e.g. on huge
+         * pages or interleaved over NUMA nodes. Reallocations (by `deserialize`) use the same policy.
+         * 
+         * @param size number of bits
+         * @param policy how to allocate the words. If it skips the zero fill, the bits are unspecified until written
+         *        (e.g. through `words()`), except for the last word holding bits and the padding words, which are
+         *        still zeroed.
+         */
+        BitVector(uint64_t size, utility::AllocationPolicy const& policy) : size_(size), 
+            numWords_(paddedNumWords(size)), data_(utility::allocateAligned<uint64_t, ALIGNMENT>(numWords_, policy)),
+            policy_(policy) {
+            if (!policy.zeroFill) {
+                const uint64_t lastWord = utility::roundDivisionUp(size_, WORD_BITS);
+                std::fill(data_.get() + ((lastWord == 0) ? 0 : lastWord - 1), data_.get() + numWords_, 0);
+            }
+        }
 
         /**
          * @brief Construct a new BitVector object from an input binary string. Assumes the string
-         * holds binary in big-endian format.
+         * holds binary in big-endian format, i.e. character i is bit i.
+         * 
+         * @throws std::invalid_argument If a character is not '0' or '1'.
          * 
          * @param value binary string
          */
-        BitVector(std::string const& value) noexcept : BitVector(value.size()) {
-            for (size_t i = 0; i < value.size(); i += 8) {
-                std::string byteStr = value.substr(i, 8);
-                std::reverse(std::begin(byteStr), std::end(byteStr));   // handle endianness
-                data_[i >> 3] = static_cast<uint8_t>( std::stoul(byteStr, nullptr, 2) );
+        BitVector(std::string const& value) : BitVector(value.size()) {
+            uint64_t *words = data_.get();
+            for (uint64_t w = 0; w * WORD_BITS < size_; w += 1) {
+                const uint64_t end = std::min(size_, (w + 1) * WORD_BITS);
+                uint64_t word = 0;
+                for (uint64_t i = w * WORD_BITS; i < end; i += 1) {
+                    const uint64_t bit = static_cast<uint64_t>(value[i] - '0');
+                    if (bit > 1) {
+                        throw std::invalid_argument("BitVector -- invalid character '" + std::string(1, value[i]) +
+                            "' at index " + std::to_string(i) + " of binary string.");
+                    }
+                    word |= bit << (i % WORD_BITS);
+                }
+                words[w] = word;
+            }
+        }
+
+        /**
+         * @brief Construct a new BitVector object by copying `size` bits from a word buffer laid out like `words()`.
+         * Bits of the last word past `size` are ignored.
+         * 
+         * @param size number of bits
+         * @param words at least ceil(size/64) words, bit i in bit (i % 64) of word (i / 64)
+         */
+        BitVector(uint64_t size, uint64_t const* words) : BitVector(size) {
+            std::copy(words, words + utility::roundDivisionUp(size, WORD_BITS), data_.get());
+            this->clearTail();
+        }
+
+        /**
+         * @brief Construct a new BitVector object that takes ownership of `words` instead of copying them. Bits past
+         * `size` are cleared.
+         * 
+         * @throws std::invalid_argument If words is null.
+         * 
+         * @param size number of bits
+         * @param words an array of at least `numWordsFor(size)` words, e.g. from 
+         *        `utility::allocateAligned<uint64_t, BitVector::ALIGNMENT>(numWordsFor(size))`
+         */
+        BitVector(uint64_t size, utility::AlignedArray<uint64_t, ALIGNMENT>&& words) : size_(size), 
+            numWords_(paddedNumWords(size)), data_(std::move(words)) {
+            if (!data_) {
+                throw std::invalid_argument("BitVector -- cannot adopt a null word array.");
+            }
+            this->clearTail();
+            std::fill(data_.get() + utility::roundDivisionUp(size_, WORD_BITS), data_.get() + numWords_, 0);
+        }
+
+        /**
+         * @brief Construct a new BitVector object with the bits at `positions` set. The positions may come in any
+         * order and repeat.
+         * 
+         * @throws std::out_of_range If a position is >= size.
+         * 
+         * @tparam It input iterator over positions
+         * @tparam End sentinel for It
+         * @param size number of bits
+         * @param first first position
+         * @param last end of positions
+         */
+        template <std::input_iterator It, std::sentinel_for<It> End>
+        BitVector(uint64_t size, It first, End last) : BitVector(size) {
+            uint64_t *words = data_.get();
+            for (; first != last; ++first) {
+                const uint64_t pos = *first;
+                checkIndexBounds(pos);
+                words[pos >> 6] |= 1ull << (pos & 63);
             }
         }
 
+        /**
+         * @brief The number of words a bitvector of `size` bits allocates, i.e. `numWords()` once constructed. Word
+         * arrays adopted by the constructor must be at least this long.
+         * 
+         * @param size number of bits
+         * @return uint64_t number of words
+         */
+        static uint64_t numWordsFor(uint64_t size) noexcept {
+            return paddedNumWords(size);
+        }
+
         /**
          * @brief Gets the `index`-th element of the bitvector. No bounds checking is done, so an invalid `index`
          * may raise segfault or return junk value.
@@ -61,9 +264,7 @@ class BitVector {
          * @return false bit `index` is not set 
          */
         bool operator[](uint64_t index) const noexcept {
-            const uint64_t arrayIndex = index >> 3;
-            const uint8_t bitIndex = index & 7;
-            return data_[arrayIndex] & (1 << bitIndex);
+            return (data_[index >> 6] >> (index & 63)) & 1;
         }
 
         /**
@@ -80,6 +281,15 @@ class BitVector {
             return operator[](index);
         }
 
+        /**
+         * @brief Hints that bit `index` will be read soon. Never faults, even if index is out of range.
+         * 
+         * @param index index that will be read
+         */
+        void prefetch(uint64_t index) const noexcept {
+            utility::prefetch(data_.get() + (index >> 6));
+        }
+
         /**
          * @brief Sets the `index`-th bit of the bitvector. 
          * 
@@ -91,18 +301,169 @@ class BitVector {
         void set(uint64_t index, bool bit) {
             checkIndexBounds(index);
             
-            const uint64_t arrayIndex = index >> 3;
-            const uint8_t bitIndex = index & 7;
-            data_[arrayIndex] = (data_[arrayIndex] & ~(1 << bitIndex)) | (bit << bitIndex);
+            const uint64_t wordIndex = index >> 6;
+            const uint64_t bitIndex = index & 63;
+            data_[wordIndex] = (data_[wordIndex] & ~(1ull << bitIndex)) | (static_cast<uint64_t>(bit) << bitIndex);
+            version_ += 1;
+        }
+
+        /**
+         * @brief Sets or clears the bits [start, start+len) a word at a time.
+         * 
+         * @throws std::out_of_range If the range is out of bounds.
+         * 
+         * @param start first bit to set
+         * @param len number of bits to set
+         * @param bit set the range to 0 or 1
+         */
+        void setRange(uint64_t start, uint64_t len, bool bit) {
+            checkRangeBounds(start, len, "setRange");
+            if (len == 0) {
+                return;
+            }
+            version_ += 1;
+
+            const uint64_t fill = bit ? ~0ull : 0;
+            const uint64_t firstWord = start >> 6, lastWord = (start + len - 1) >> 6;
+            const uint64_t firstMask = ~0ull << (start & 63);
+            const uint64_t lastMask = ~0ull >> (63 - ((start + len - 1) & 63));
+            uint64_t *words = data_.get();
+            if (firstWord == lastWord) {
+                const uint64_t mask = firstMask & lastMask;
+                words[firstWord] = (words[firstWord] & ~mask) | (fill & mask);
+                return;
+            }
+            words[firstWord] = (words[firstWord] & ~firstMask) | (fill & firstMask);
+            std::fill(words + firstWord + 1, words + lastWord, fill);
+            words[lastWord] = (words[lastWord] & ~lastMask) | (fill & lastMask);
+        }
+
+        /**
+         * @brief Copies `len` bits of `source` starting at `sourceStart` over the bits starting at `start`. Writes
+         * whole destination words, each assembled from at most 2 source words. The ranges may overlap, including when
+         * `source` is this bitvector.
+         * 
+         * @throws std::out_of_range If either range is out of bounds.
+         * 
+         * @param source bitvector to copy from
+         * @param sourceStart first bit of `source` to copy
+         * @param start first bit to overwrite
+         * @param len number of bits to copy
+         */
+        void copyRange(BitVector const& source, uint64_t sourceStart, uint64_t start, uint64_t len) {
+            source.checkRangeBounds(sourceStart, len, "copyRange");
+            checkRangeBounds(start, len, "copyRange");
+            if (len == 0) {
+                return;
+            }
+            version_ += 1;
+
+            /* chunks end on destination word boundaries: a leading partial word, whole words, a trailing partial */
+            const uint64_t headLen = std::min<uint64_t>(len, WORD_BITS - (start & 63));
+            const uint64_t numChunks = 1 + utility::roundDivisionUp(len - headLen, WORD_BITS);
+            auto copyChunk = [&](uint64_t chunk) {
+                const uint64_t offset = (chunk == 0) ? 0 : headLen + (chunk - 1) * WORD_BITS;
+                const uint32_t chunkLen = std::min<uint64_t>(len - offset, (chunk == 0) ? headLen : WORD_BITS);
+                const uint64_t bits = utility::readBits(source.words(), sourceStart + offset, chunkLen);
+                utility::writeBits(data_.get(), start + offset, chunkLen, bits);
+            };
+
+            /* copy away from the overlap, so no chunk reads bits an earlier chunk already overwrote */
+            if (&source == this && start > sourceStart) {
+                for (uint64_t chunk = numChunks; chunk > 0; chunk -= 1) {
+                    copyChunk(chunk - 1);
+                }
+            } else {
+                for (uint64_t chunk = 0; chunk < numChunks; chunk += 1) {
+                    copyChunk(chunk);
+                }
+            }
+        }
+
+        /**
+         * @brief Bitwise AND with `other`, a word at a time. The loop has no dependencies between words, so the
+         * compiler vectorizes it (AVX2/AVX-512 with `make NATIVE=1`).
+         * 
+         * @throws std::invalid_argument If the sizes differ.
+         * 
+         * @param other bitvector of the same size
+         * @return BitVector& this bitvector
+         */
+        BitVector& operator&=(BitVector const& other) {
+            return this->combine(other, "&=", [](uint64_t a, uint64_t b) { return a & b; });
+        }
+
+        /**
+         * @brief Bitwise OR with `other`, a word at a time.
+         * @see operator&=
+         * 
+         * @throws std::invalid_argument If the sizes differ.
+         * 
+         * @param other bitvector of the same size
+         * @return BitVector& this bitvector
+         */
+        BitVector& operator|=(BitVector const& other) {
+            return this->combine(other, "|=", [](uint64_t a, uint64_t b) { return a | b; });
+        }
+
+        /**
+         * @brief Bitwise XOR with `other`, a word at a time.
+         * @see operator&=
+         * 
+         * @throws std::invalid_argument If the sizes differ.
+         * 
+         * @param other bitvector of the same size
+         * @return BitVector& this bitvector
+         */
+        BitVector& operator^=(BitVector const& other) {
+            return this->combine(other, "^=", [](uint64_t a, uint64_t b) { return a ^ b; });
+        }
+
+        /**
+         * @brief Inverts every bit, a word at a time. Bits past `size()` stay zero.
+         * 
+         * @return BitVector& this bitvector
+         */
+        BitVector& flip() noexcept {
+            version_ += 1;
+            const uint64_t usedWords = utility::roundDivisionUp(size_, WORD_BITS);
+            uint64_t *words = data_.get();
+            for (uint64_t w = 0; w < usedWords; w += 1) {
+                words[w] = ~words[w];
+            }
+            this->clearTail();
+            return *this;
+        }
+
+        /**
+         * @brief Counts the writes made through this class (set, setRange, copyRange, the bitwise operators, flip,
+         * deserialize, and map). Rank and select structures record it when they build, so they can tell they are
+         * stale. Writes through `words()` or `data()` are not counted.
+         * 
+         * @return uint64_t number of writes so far
+         */
+        uint64_t version() const noexcept {
+            return version_;
+        }
+
+        /**
+         * @brief The positions of the set bits, in increasing order, found a word at a time.
+         * @see OnesIterator
+         * 
+         * @return OnesRange range over the set positions
+         */
+        OnesRange ones() const noexcept {
+            const uint64_t usedWords = utility::roundDivisionUp(size_, WORD_BITS);
+            return {OnesIterator<WordCursor>(WordCursor{data_.get(), 0, usedWords}), std::default_sentinel};
         }
 
         /**
          * @brief Popcount of the entire bitvector i.e. the total number of 1s.
          * 
-         * @return uint32_t Total number of 1s in bitvector
+         * @return uint64_t Total number of 1s in bitvector
          */
         uint64_t popcount() const noexcept {
-            return std::transform_reduce(data_.get(), data_.get() + utility::roundDivisionUp(size_, 8), 0, 
+            return std::transform_reduce(data_.get(), data_.get() + numWords_, 0ull, 
                     std::plus<uint64_t>(), [](auto const& a) -> uint64_t { return std::popcount(a); });
         }
 
@@ -115,21 +476,22 @@ class BitVector {
          */
         uint8_t popcount(uint64_t index) const {
             checkIndexBounds(index);
-            return std::popcount(data_[index >> 3]);
+            return std::popcount(this->data()[index >> 3]);
         }
 
         /**
-         * @brief Returns the popcount of a range in bitvector. Range must be <= 32 bits.
+         * @brief Returns the popcount of a range in bitvector. Range must be <= 64 bits.
          * 
-         * Computed by loading bit range into 32 bit integer, clearing unnecessary bits with shifts, and calling
-         * machine popcount. This should be 1 load and approximately 3 bit operations and, thus, is O(1) in `len`.
+         * Computed by loading the word `start` lies in (and the next word if the range crosses a word boundary), 
+         * shifting the range down to bit 0, masking off the bits past `len`, and calling machine popcount. This is
+         * at most 2 aligned loads and a handful of bit operations and, thus, is O(1) in `len`.
          * 
          * Note: uses std::popcount to compute popcount. The STL standard doesn't require this to use popcnt 
          * instruction, but gcc, clang, and msvc all implement it using the `__builtin_popcount()` intrinsic 
          * plus some other optimizations.
          * 
          * @throws std::out_of_range If start is out of bounds.
-         * @throws std::invalid_argument If len is greater than 32 or start+len overflows a 32 bit int
+         * @throws std::invalid_argument If len is greater than 64 or start+len overflows a 64 bit int
          * 
          * @param start first bit to include in popcount
          * @param len number of bits in total to use
@@ -138,31 +500,49 @@ class BitVector {
         uint32_t popcount(uint64_t start, uint32_t len) const {
             checkIndexBounds(start);
             if constexpr (utility::CHECK_BOUNDS) {
-                if ((len > 32) || (start+len < start)) {
+                if ((len > WORD_BITS) || (start+len < start)) {
                     /* last condition checks for overflow */
                     throw std::invalid_argument("Cannot do machine popcount.");
                 }
             }
 
-            uint32_t val = *reinterpret_cast<uint32_t*>(&data_[start >> 3]);
-            val >>= start & 7;
-            val <<= 32-len;
-
-            return std::popcount(val);
+            return utility::popcountBits(data_.get(), start, len);
         }
 
         uint8_t *data() noexcept {
-            return data_.get();
+            return reinterpret_cast<uint8_t*>(data_.get());
         }
 
         uint8_t const* data() const noexcept {
+            return reinterpret_cast<uint8_t const*>(data_.get());
+        }
+
+        /**
+         * @brief The underlying word array. Bit i is bit (i % 64) of word (i / 64).
+         * 
+         * @return uint64_t* pointer to the first, cache line aligned, word
+         */
+        uint64_t *words() noexcept {
+            return data_.get();
+        }
+
+        uint64_t const* words() const noexcept {
             return data_.get();
         }
 
+        /**
+         * @brief The number of allocated words, including padding. Padding words are always zero.
+         * 
+         * @return uint64_t number of words in `words()`
+         */
+        uint64_t numWords() const noexcept {
+            return numWords_;
+        }
+
         /**
          * @brief The number of bits in this bitvector.
          * 
-         * @return constexpr uint32_t number of bits.
+         * @return uint64_t number of bits.
          */
         uint64_t size() const noexcept {
             return size_;
@@ -183,38 +563,117 @@ class BitVector {
         }
 
         /**
-         * @brief Serialize bitvector into output stream. Pads data to nearest byte.
+         * @brief Whether the words are a view into a mapped file (see `map`) rather than owned memory.
+         * 
+         * @return true if the bitvector was mapped
+         */
+        bool isMapped() const noexcept {
+            return static_cast<bool>(data_.get_deleter().owner);
+        }
+
+        /**
+         * @brief Serialize bitvector into output stream. Writes the size, pads to a cache line, and writes all of the
+         * (padded) words so `map` can use them in place.
          * 
          * @param out destination of data
          */
-        void serialize(std::ofstream& out) const {
+        void serialize(std::ostream& out) const {
             serial::serialize(size_, out);
-            const uint32_t numBytes = utility::roundDivisionUp(size_, 8);
-            out.write(reinterpret_cast<char const*>(data_.get()), numBytes);
+            serial::pad(out);
+            out.write(reinterpret_cast<char const*>(data_.get()), numWords_ * sizeof(uint64_t));
         }
 
         /**
-         * @brief Deserialize data into array. Reallocates if incoming size is different.
+         * @brief Deserialize data into array. Reallocates if incoming size is different or the bitvector is mapped.
          * Current data will be overwritten.
          * 
          * @param in source of data
          */
-        void deserialize(std::ifstream& in) {
+        void deserialize(std::istream& in) {
             uint64_t tmpSize;
             serial::deserialize(tmpSize, in);
 
-            if (tmpSize != size_) {
+            if (tmpSize != size_ || this->isMapped()) {
+                /* every word is read below, so there is nothing to zero */
+                utility::AllocationPolicy policy = policy_;
+                policy.zeroFill = false;
                 size_ = tmpSize;
-                data_ = std::make_unique<uint8_t[]>(size_);
+                numWords_ = paddedNumWords(size_);
+                data_ = utility::allocateAligned<uint64_t, ALIGNMENT>(numWords_, policy);
             }
 
-            const uint32_t numBytes = utility::roundDivisionUp(size_, 8);
-            in.read(reinterpret_cast<char*>(data_.get()), numBytes);
+            serial::skipPadding(in);
+            in.read(reinterpret_cast<char*>(data_.get()), numWords_ * sizeof(uint64_t));
+            version_ += 1;
+        }
+
+        /**
+         * @brief Points the bitvector at words written by `serialize` inside a mapped file instead of copying them.
+         * Pages stay shared with the page cache until written (see utility::MappedFile).
+         * 
+         * @throws std::ios_base::failure If the file is truncated.
+         * 
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader) {
+            const uint64_t tmpSize = reader.read<uint64_t>();
+            reader.skipPadding();
+            uint64_t *words = reader.view<uint64_t>(paddedNumWords(tmpSize));
+
+            size_ = tmpSize;
+            numWords_ = paddedNumWords(size_);
+            data_ = utility::viewAligned<uint64_t, ALIGNMENT>(words, reader.keepAlive());
+            version_ += 1;
         }
 
     private:
         uint64_t size_;
-        std::unique_ptr<uint8_t[]> data_;
+        uint64_t numWords_;
+        utility::AlignedArray<uint64_t, ALIGNMENT> data_;
+        utility::AllocationPolicy policy_;
+        uint64_t version_ = 0;
+
+        /**
+         * @brief Zeroes the bits of the last word past `size()`, which popcount and the bulk operations assume are 0.
+         */
+        void clearTail() noexcept {
+            if (size_ % WORD_BITS != 0) {
+                data_[size_ / WORD_BITS] &= ~0ull >> (WORD_BITS - size_ % WORD_BITS);
+            }
+        }
+
+        /**
+         * @brief Applies `op` to each pair of words. Padding words are zero in both, so they stay zero for
+         * and/or/xor.
+         */
+        template <typename Op>
+        BitVector& combine(BitVector const& other, std::string const& name, Op op) {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (other.size_ != size_) {
+                    throw std::invalid_argument("BitVector::operator" + name + " -- sizes " + std::to_string(size_) +
+                        " and " + std::to_string(other.size_) + " differ.");
+                }
+            }
+            version_ += 1;
+            uint64_t *words = data_.get();
+            uint64_t const* otherWords = other.data_.get();
+            for (uint64_t w = 0; w < numWords_; w += 1) {
+                words[w] = op(words[w], otherWords[w]);
+            }
+            return *this;
+        }
+
+        /**
+         * @brief number of words needed to store `size` bits, rounded up to a whole number of cache lines.
+         * 
+         * @param size number of bits
+         * @return uint64_t number of words to allocate
+         */
+        static uint64_t paddedNumWords(uint64_t size) noexcept {
+            constexpr uint64_t WORDS_PER_LINE = ALIGNMENT / sizeof(uint64_t);
+            return utility::roundDivisionUp(utility::roundDivisionUp(size, WORD_BITS), WORDS_PER_LINE) 
+                    * WORDS_PER_LINE;
+        }
 
         /**
          * @brief Checks to see if `index` is in-bounds for bitvector.
@@ -230,6 +689,16 @@ class BitVector {
                 }
             }
         }
+
+        inline void checkRangeBounds(uint64_t start, uint64_t len, std::string const& name) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (start > size_ || len > size_ - start) {
+                    throw std::out_of_range("BitVector::" + name + " -- range [" + std::to_string(start) + ", " +
+                        std::to_string(start) + "+" + std::to_string(len) + ") is out of bounds for bitvector with " +
+                        "size " + std::to_string(size_) + ".");
+                }
+            }
+        }
 };
 
 /**
@@ -251,13 +720,19 @@ std::string getRandomBinaryString(size_t bits) noexcept {
 }
 
 /**
- * @brief Return a random bitvector with size `bits`.
+ * @brief Return a random bitvector with size `bits`. Fills whole words straight from a 64 bit generator, so it needs no
+ * memory beyond the bitvector.
  * 
  * @param bits number of bits in bitvector
+ * @param seed generator seed. Defaults to one from std::random_device.
  * @return BitVector the random bitvector object
  */
-BitVector getRandomBitVector(size_t bits) noexcept {
-    return BitVector(getRandomBinaryString(bits));
+BitVector getRandomBitVector(size_t bits, std::optional<uint64_t> seed = std::nullopt) noexcept {
+    std::mt19937_64 rng(seed.value_or(std::random_device{}()));
+    auto words = utility::allocateAligned<uint64_t, BitVector::ALIGNMENT>(BitVector::numWordsFor(bits), 
+        utility::AllocationPolicy{.zeroFill = false});
+    std::generate(words.get(), words.get() + utility::roundDivisionUp(bits, BitVector::WORD_BITS), std::ref(rng));
+    return BitVector(bits, std::move(words));
 }
 
 
@@ -266,12 +741,20 @@ BitVector getRandomBitVector(size_t bits) noexcept {
  */
 class PackedVector {
     public:
-        PackedVector(uint64_t length, uint32_t bitsPerElement) : size_(length), bitsPerElement_(bitsPerElement),
-            bitvector_(length*bitsPerElement + 64) {
-            if (bitsPerElement > 56) {
-                /*  []/at return uint64_t and the data is copied into the return value at byte alignment, so
-                    each element has to be less than 64-8=56 bits. */
-                throw std::invalid_argument("PackedVector -- Bits/Element larger than 56 not yet supported.");
+        /**
+         * @brief Construct `length` zeroed elements of `bitsPerElement` bits each.
+         * @throws std::invalid_argument if bitsPerElement is not in [1, 64].
+         * 
+         * @param length number of elements
+         * @param bitsPerElement bits per element
+         * @param policy how to allocate the packed words (see BitVector)
+         */
+        PackedVector(uint64_t length, uint32_t bitsPerElement, 
+            utility::AllocationPolicy const& policy = utility::AllocationPolicy()) : size_(length), 
+            bitsPerElement_(bitsPerElement), bitvector_(length*bitsPerElement, policy) {
+            if (bitsPerElement == 0 || bitsPerElement > 64) {
+                throw std::invalid_argument("PackedVector -- Bits/Element must be in [1, 64], got " + 
+                    std::to_string(bitsPerElement) + ".");
             } 
         }
 
@@ -289,9 +772,33 @@ class PackedVector {
          * @return uint64_t the idx-th value
          */
         uint64_t operator[](uint64_t idx) const noexcept {
-            const uint64_t start = idx * bitsPerElement_;
-            const uint64_t val = *reinterpret_cast<uint64_t const*>(&bitvector_.data()[start >> 3]);
-            return utility::getBitRange(val, start & 7, bitsPerElement_);
+            /* reads the second word only when the element straddles it, so no padding is needed past the end */
+            return utility::readBits(bitvector_.words(), idx * bitsPerElement_, bitsPerElement_);
+        }
+
+        /**
+         * @return uint32_t the number of bits per element
+         */
+        uint32_t bitsPerElement() const noexcept {
+            return bitsPerElement_;
+        }
+
+        /**
+         * @brief The packed words, e.g. for FixedPackedVector::get.
+         * 
+         * @return uint64_t const* packed data
+         */
+        uint64_t const* words() const noexcept {
+            return bitvector_.words();
+        }
+
+        /**
+         * @brief Hints that element `idx` will be read soon. Never faults, even if idx is out of range.
+         * 
+         * @param idx index that will be read
+         */
+        void prefetch(uint64_t idx) const noexcept {
+            bitvector_.prefetch(idx * bitsPerElement_);
         }
 
         /**
@@ -315,14 +822,38 @@ class PackedVector {
          */
         void set(uint64_t idx, uint64_t value) {
             checkBounds(idx);
+            /* only the (at most 2) words holding the element are written */
+            utility::writeBits(bitvector_.words(), idx * bitsPerElement_, bitsPerElement_, value);
+        }
 
-            value &= (1ull << (bitsPerElement_+1)) - 1;
-            const uint64_t start = idx * bitsPerElement_;
+        /**
+         * @brief Copies elements [begin, begin+count) into `out`. Unpacks 4 elements at a time with AVX2 when
+         * compiled for it.
+         * @see utility::unpackBits
+         * @throws std::out_of_range when the range is out of bounds.
+         * 
+         * @param begin first element to read
+         * @param count number of elements to read
+         * @param out receives the `count` elements
+         */
+        void unpack(uint64_t begin, uint64_t count, uint64_t *out) const {
+            checkRange(begin, count);
+            utility::unpackBits(bitvector_.words(), bitvector_.numWords(), begin * bitsPerElement_, bitsPerElement_,
+                count, out);
+        }
 
-            // TODO -- this is dangerous because writing 8 bytes might write past end of data
-            // right now it's ok because PackedVector is padded by 8 bytes, but there might be a better solution.
-            uint64_t *bits = reinterpret_cast<uint64_t*>(&bitvector_.data()[start >> 3]);
-            *bits = utility::setBitRange(*bits, start & 7, bitsPerElement_, value);
+        /**
+         * @brief Sets elements [begin, begin+count) to the values in `in`, writing each word once.
+         * @see utility::packBits
+         * @throws std::out_of_range when the range is out of bounds.
+         * 
+         * @param begin first element to write
+         * @param count number of elements to write
+         * @param in the `count` values. Bits above the element width are ignored.
+         */
+        void pack(uint64_t begin, uint64_t count, uint64_t const* in) {
+            checkRange(begin, count);
+            utility::packBits(bitvector_.words(), begin * bitsPerElement_, bitsPerElement_, count, in);
         }
 
         /**
@@ -337,7 +868,7 @@ class PackedVector {
          * 
          * @param out destination of data
          */
-        void serialize(std::ofstream& out) const {
+        void serialize(std::ostream& out) const {
             serial::serialize(size_, out);
             serial::serialize(bitsPerElement_, out);
             serial::serialize(bitvector_, out);
@@ -348,11 +879,23 @@ class PackedVector {
          * 
          * @param in source of data
          */
-        void deserialize(std::ifstream& in) {
+        void deserialize(std::istream& in) {
             serial::deserialize(size_, in);
             serial::deserialize(bitsPerElement_, in);
             serial::deserialize(bitvector_, in);
         }
+
+        /**
+         * @brief Views packed data written by `serialize` in a mapped file instead of copying it.
+         * @see BitVector::map
+         * 
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader) {
+            size_ = reader.read<uint64_t>();
+            bitsPerElement_ = reader.read<uint32_t>();
+            bitvector_.map(reader);
+        }
     
     private:
         uint64_t size_;
@@ -367,69 +910,391 @@ class PackedVector {
                 }
             }
         }
-};
 
+        inline void checkRange(uint64_t begin, uint64_t count) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (begin > size_ || count > size_ - begin) {
+                    throw std::out_of_range("Invalid range [" + std::to_string(begin) + ", " + 
+                        std::to_string(begin) + "+" + std::to_string(count) + ") for PackedVector of size " + 
+                        std::to_string(size_) + ".");
+                }
+            }
+        }
+};
 
 /**
- * @brief RankSupport class. Implements ability to compute rank of bitvector in constant time.
+ * @brief FixedPackedVector. PackedVector with the element width fixed at compile time, so index math and masks are
+ * constants. 8, 16, 32, and 64 bit elements never straddle words and are read and written as plain aligned integers.
+ * Uses the same bit layout and file format as PackedVector, so `get` can also read a PackedVector's words when its
+ * width is known to be `Bits`.
+ *
+ * @tparam Bits bits per element, in [1, 64]
  */
-class RankSupport {
+template <uint32_t Bits>
+class FixedPackedVector {
+    static_assert(Bits >= 1 && Bits <= 64, "FixedPackedVector -- Bits/Element must be in [1, 64].");
+
     /**
-     * @brief All RankSupport files should start with these 4 bytes.
+     * @brief whether elements are whole, naturally aligned integers
      */
-    constexpr static uint32_t FILE_MAGIC = 0xfeedbeef;
+    constexpr static bool ALIGNED = (Bits == 8 || Bits == 16 || Bits == 32 || Bits == 64) &&
+        std::endian::native == std::endian::little;
+
+    constexpr static uint64_t MASK = (Bits == 64) ? ~0ull : ((1ull << Bits) - 1);
 
     public:
         /**
-         * @brief Construct a new RankSupport object around `bitvector`. Builds ancillary data tables on construction.
-         * 
-         * @param bitvector input BitVector
+         * @brief unsigned type of Bits bits, for aligned widths
          */
-        RankSupport(BitVector const& bitvector) : bitvector_(bitvector), 
-            superblockSize_(std::pow(std::log2(utility::roundUpToPowerOf2(bitvector.size())), 2) / 2), 
-            superblockWordSize_(std::ceil(std::log2(bitvector.size()))),
-            blockSize_(std::log2(utility::roundUpToPowerOf2(bitvector.size())) / 2),
-            blockWordSize_(std::ceil(std::log2(superblockSize_))),
-            superblocks_(utility::roundDivisionUp(bitvector.size(), superblockSize_), superblockWordSize_),
-            blocks_(utility::roundDivisionUp(bitvector.size(), blockSize_), blockWordSize_) {
-            /* construct tables here */
+        using Element = std::conditional_t<Bits <= 8, uint8_t, std::conditional_t<Bits <= 16, uint16_t,
+            std::conditional_t<Bits <= 32, uint32_t, uint64_t>>>;
 
-            this->buildTables();
-        }
+        FixedPackedVector(uint64_t length = 0, utility::AllocationPolicy const& policy = utility::AllocationPolicy()) :
+            size_(length), bitvector_(length*Bits, policy) {}
 
         /**
-         * @brief Builds superblock and block level tables based on underlying bitvector's data.
-         * @throws std::out_of_range if startingIndex is larger than the bitvector size.
-         * 
-         * @param startingIndex index to start building table from
+         * @brief Reads the idx-th element of packed `words`. No bounds checking.
+         *
+         * @param words words of a FixedPackedVector<Bits>, or of a PackedVector with Bits bits per element
+         * @param idx index to retrieve
+         * @return uint64_t the idx-th value
          */
-        void buildTables(uint64_t startingIndex = 0) {
-            if constexpr (utility::CHECK_BOUNDS) {
-                if (startingIndex > this->size()) {
-                    throw std::out_of_range("RankSupport::buildTables -- startingIndex " + 
-                            std::to_string(startingIndex) + " is out of range for bitvector.");
+        static uint64_t get(uint64_t const* words, uint64_t idx) noexcept {
+            if constexpr (ALIGNED) {
+                /* memcpy instead of a cast keeps the access legal under strict aliasing; it compiles to one load */
+                Element val;
+                std::memcpy(&val, reinterpret_cast<unsigned char const*>(words) + idx * sizeof(Element), sizeof(val));
+                return val;
+            } else {
+                const uint64_t start = idx * Bits;
+                const uint32_t offset = start & 63;
+                uint64_t val = words[start >> 6] >> offset;
+                if constexpr (64 % Bits != 0) {
+                    if (offset + Bits > BitVector::WORD_BITS) {
+                        val |= words[(start >> 6) + 1] << (BitVector::WORD_BITS - offset);
+                    }
                 }
+                return val & MASK;
             }
-            auto const& bv = bitvector_.get();
-
-            /* round startingIndex down to superblock */
-            startingIndex = (startingIndex / superblockSize_) * (superblockSize_);
-
-            uint32_t superblockSum = superblocks_.at(startingIndex / superblockSize_);
-            uint32_t blockSum = blocks_.at(startingIndex / blockSize_);
+        }
 
-            for (size_t i = startingIndex; i < bv.size(); i += 1) {
-                if (i % superblockSize_ == 0) {
-                    superblocks_.set(i / superblockSize_, superblockSum);
-                    blockSum = 0;
-                }
-                if (i % blockSize_ == 0) {
-                    blocks_.set(i / blockSize_, blockSum);
-                }
-                blockSum += bv[i];
-                superblockSum += bv[i];
-            }
-            totalOnes_ = superblockSum;
+        /**
+         * @return uint64_t the number of elements
+         */
+        uint64_t size() const noexcept {
+            return size_;
+        }
+
+        /**
+         * @brief Retrieves the idx-th element of the array. No bounds checking.
+         *
+         * @param idx index to retrieve
+         * @return uint64_t the idx-th value
+         */
+        uint64_t operator[](uint64_t idx) const noexcept {
+            return get(bitvector_.words(), idx);
+        }
+
+        /**
+         * @brief Gets the idx-th value with bounds checking.
+         * @throws std::out_of_range when idx is out of range
+         *
+         * @param idx index to retrieve
+         * @return uint64_t the idx-th value
+         */
+        uint64_t at(uint64_t idx) const {
+            checkBounds(idx);
+            return this->operator[](idx);
+        }
+
+        /**
+         * @brief Hints that element `idx` will be read soon. Never faults, even if idx is out of range.
+         *
+         * @param idx index that will be read
+         */
+        void prefetch(uint64_t idx) const noexcept {
+            bitvector_.prefetch(idx * Bits);
+        }
+
+        /**
+         * @brief Sets the idx-th element to value. Does bounds checking.
+         * @throws std::out_of_range when idx is out of range.
+         *
+         * @param idx index to set
+         * @param value value to put in index
+         */
+        void set(uint64_t idx, uint64_t value) {
+            checkBounds(idx);
+
+            uint64_t *words = bitvector_.words();
+            if constexpr (ALIGNED) {
+                const Element val = static_cast<Element>(value);
+                std::memcpy(reinterpret_cast<unsigned char*>(words) + idx * sizeof(Element), &val, sizeof(val));
+            } else {
+                value &= MASK;
+                const uint64_t start = idx * Bits;
+                const uint64_t wordIndex = start >> 6;
+                const uint32_t offset = start & 63;
+                words[wordIndex] = (words[wordIndex] & ~(MASK << offset)) | (value << offset);
+                if constexpr (64 % Bits != 0) {
+                    if (offset + Bits > BitVector::WORD_BITS) {
+                        const uint32_t lowBits = BitVector::WORD_BITS - offset;
+                        words[wordIndex+1] = utility::setBitRange(words[wordIndex+1], 0, Bits - lowBits,
+                                                                    value >> lowBits);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @return uint64_t The number of bits this data structure uses.
+         */
+        uint64_t overhead() const noexcept {
+            return bitvector_.size();
+        }
+
+        /**
+         * @brief Serialize data into output stream using serial::serialize. Same format as PackedVector.
+         *
+         * @param out destination of data
+         */
+        void serialize(std::ostream& out) const {
+            serial::serialize(size_, out);
+            serial::serialize(Bits, out);
+            serial::serialize(bitvector_, out);
+        }
+
+        /**
+         * @brief Deserialize from inputstream using serial::deserialize. Will reallocate bitvector.
+         * @throws std::ios_base::failure if the data has a different element width.
+         *
+         * @param in source of data
+         */
+        void deserialize(std::istream& in) {
+            uint32_t bits;
+            serial::deserialize(size_, in);
+            serial::deserialize(bits, in);
+            checkWidth(bits);
+            serial::deserialize(bitvector_, in);
+        }
+
+        /**
+         * @brief Views packed data written by `serialize` in a mapped file instead of copying it.
+         * @see BitVector::map
+         * @throws std::ios_base::failure if the data has a different element width.
+         *
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader) {
+            size_ = reader.read<uint64_t>();
+            checkWidth(reader.read<uint32_t>());
+            bitvector_.map(reader);
+        }
+
+    private:
+        uint64_t size_;
+        BitVector bitvector_;
+
+        static void checkWidth(uint32_t bits) {
+            if (bits != Bits) {
+                throw std::ios_base::failure("FixedPackedVector -- expected " + std::to_string(Bits) +
+                    " bits per element, got " + std::to_string(bits) + ".");
+            }
+        }
+
+        inline void checkBounds(uint64_t idx) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (idx >= size_) {
+                    throw std::out_of_range("Invalid index " + std::to_string(idx) + " for FixedPackedVector of size " +
+                                            std::to_string(size_) + ".");
+                }
+            }
+        }
+};
+
+
+/**
+ * @brief Bits that can be read by index, like BitVector.
+ */
+template <typename B>
+concept BitAccess = requires(B const& bits, uint64_t i) {
+    { bits[i] } -> std::convertible_to<bool>;
+    { bits.size() } -> std::convertible_to<uint64_t>;
+};
+
+/**
+ * @brief Answers rank queries over a fixed set of bits, like RankSupport. rank1(i) and rank0(i) count the ones and 
+ * zeros in [0, i].
+ */
+template <typename R>
+concept Rankable = requires(R const& rank, uint64_t i) {
+    { rank.rank1(i) } -> std::convertible_to<uint64_t>;
+    { rank.rank0(i) } -> std::convertible_to<uint64_t>;
+    { rank.size() } -> std::convertible_to<uint64_t>;
+    { rank.totalOnes() } -> std::convertible_to<uint64_t>;
+    { rank.totalZeros() } -> std::convertible_to<uint64_t>;
+    { rank.overhead() } -> std::convertible_to<uint64_t>;
+};
+
+/**
+ * @brief Answers select queries, like SelectSupport. select1(i) and select0(i) are the positions of the i-th one and
+ * zero, 1-indexed.
+ */
+template <typename S>
+concept Selectable = requires(S const& select, uint64_t i) {
+    { select.select1(i) } -> std::convertible_to<uint64_t>;
+    { select.select0(i) } -> std::convertible_to<uint64_t>;
+    { select.overhead() } -> std::convertible_to<uint64_t>;
+};
+
+/**
+ * @brief Answers both rank and select by itself, like CompressedBitVector.
+ */
+template <typename R>
+concept RankSelectable = Rankable<R> && Selectable<R>;
+
+/**
+ * @brief Rank over a BitVector it exposes, so other indices (e.g. SelectSupport) can be built on the same bits.
+ */
+template <typename R>
+concept BitVectorRankable = Rankable<R> && requires(R const& rank) {
+    { rank.bitvector() } -> std::same_as<BitVector const&>;
+};
+
+class RankSupport;
+template <BitVectorRankable Rank = RankSupport> class SelectSupport;
+class WaveletMatrix;
+
+/**
+ * @brief RankSupport class. Implements ability to compute rank of bitvector in constant time.
+ */
+class RankSupport {
+    /**
+     * @brief All RankSupport files should start with these 4 bytes.
+     */
+    constexpr static uint32_t FILE_MAGIC = 0xfeedbeef;
+
+    /**
+     * @brief Layout version written after the magic. Bump when the file layout changes.
+     */
+    constexpr static uint32_t FILE_VERSION = 2;
+
+    public:
+        /**
+         * @brief Construct a new RankSupport object around `bitvector`. Builds ancillary data tables on construction.
+         * 
+         * @param bitvector input BitVector
+         */
+        RankSupport(BitVector const& bitvector) : RankSupport(bitvector, 1) {}
+
+        /**
+         * @brief Construct a new RankSupport object around `bitvector`. Builds ancillary data tables on construction
+         * using `numThreads` threads.
+         * @see buildTables
+         * 
+         * @param bitvector input BitVector
+         * @param numThreads number of threads to build tables with. 0 uses std::thread::hardware_concurrency().
+         * @param policy how to allocate the tables, e.g. on huge pages like a large `bitvector`. buildTables writes
+         *        every entry, so the zero fill is always skipped.
+         */
+        RankSupport(BitVector const& bitvector, uint32_t numThreads, 
+            utility::AllocationPolicy const& policy = utility::AllocationPolicy()) : bitvector_(bitvector), 
+            superblockSize_(superblockSizeFor(bitvector.size())), 
+            superblockWordSize_(ceilLog2(bitvector.size())),
+            blockSize_(blockSizeFor(bitvector.size())),
+            blockWordSize_(ceilLog2(superblockSize_)),
+            superblocks_(utility::roundDivisionUp(bitvector.size(), superblockSize_), superblockWordSize_, 
+                withoutZeroFill(policy)),
+            blocks_(utility::roundDivisionUp(bitvector.size(), blockSize_), blockWordSize_, withoutZeroFill(policy)) {
+            /* construct tables here */
+
+            this->buildTables(0, numThreads);
+        }
+
+        /**
+         * @brief Builds superblock and block level tables based on underlying bitvector's data.
+         * 
+         * With more than 1 thread the superblocks from `startingIndex` on are split into one chunk per thread. Each
+         * thread fills its chunk as if no ones came before it, the chunk totals are exclusive scanned, and then each
+         * thread adds its chunk's offset to its superblock entries. Block entries are relative to their superblock, so
+         * they are final after the first pass. The superblocks before the first multiple of 64 at or after
+         * `startingIndex` are filled serially first; the chunks after them start on multiples of 64 superblocks, so no
+         * two threads ever write the same word of either table.
+         * 
+         * @throws std::out_of_range if startingIndex is larger than the bitvector size.
+         * 
+         * @param startingIndex index to start building table from
+         * @param numThreads number of threads to build tables with. 0 uses std::thread::hardware_concurrency().
+         */
+        void buildTables(uint64_t startingIndex = 0, uint32_t numThreads = 1) {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (startingIndex > this->size()) {
+                    throw std::out_of_range("RankSupport::buildTables -- startingIndex " + 
+                            std::to_string(startingIndex) + " is out of range for bitvector.");
+                }
+            }
+
+            builtVersion_ = bitvector_.get().version();
+
+            /* round startingIndex down to superblock */
+            const uint64_t firstSuperblock = startingIndex / superblockSize_;
+            const uint64_t numSuperblocks = superblocks_.size();
+            if (firstSuperblock >= numSuperblocks) {
+                return;
+            }
+            /* the tables may not be zeroed yet (see the constructor), so superblock 0 is not read */
+            uint64_t onesBefore = (firstSuperblock == 0) ? 0 : superblocks_.at(firstSuperblock);
+
+            if (numThreads == 0) {
+                numThreads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            if (numThreads == 1) {
+                totalOnes_ = fillTables(firstSuperblock, numSuperblocks, onesBefore);
+                return;
+            }
+
+            /* (0) the unaligned head shares table words with the superblocks before it, so it is filled serially */
+            const uint64_t alignedFirst = std::min(numSuperblocks,
+                utility::roundDivisionUp(firstSuperblock, PARALLEL_CHUNK_ALIGNMENT) * PARALLEL_CHUNK_ALIGNMENT);
+            if (alignedFirst != firstSuperblock) {
+                onesBefore = fillTables(firstSuperblock, alignedFirst, onesBefore);
+            }
+            if (alignedFirst == numSuperblocks) {
+                totalOnes_ = onesBefore;
+                return;
+            }
+
+            const uint64_t chunkSize = utility::roundDivisionUp(
+                    utility::roundDivisionUp(numSuperblocks - alignedFirst, numThreads), PARALLEL_CHUNK_ALIGNMENT)
+                    * PARALLEL_CHUNK_ALIGNMENT;
+            const uint64_t numChunks = utility::roundDivisionUp(numSuperblocks - alignedFirst, chunkSize);
+
+            if (numChunks <= 1) {
+                totalOnes_ = fillTables(alignedFirst, numSuperblocks, onesBefore);
+                return;
+            }
+
+            /* (1) fill every chunk relative to its own start; the first chunk starts from the ones before it */
+            std::vector<uint64_t> chunkOffsets(numChunks + 1, 0);
+            utility::parallelFor(numChunks, numThreads, [&](uint64_t chunk) {
+                const uint64_t begin = alignedFirst + chunk * chunkSize;
+                const uint64_t end = std::min(begin + chunkSize, numSuperblocks);
+                chunkOffsets[chunk + 1] = fillTables(begin, end, (chunk == 0) ? onesBefore : 0);
+            });
+
+            /* (2) exclusive scan of chunk totals */
+            std::inclusive_scan(std::begin(chunkOffsets), std::end(chunkOffsets), std::begin(chunkOffsets));
+
+            /* (3) shift each chunk's superblock counts by the ones before it */
+            utility::parallelFor(numChunks - 1, numThreads, [&](uint64_t task) {
+                const uint64_t chunk = task + 1;
+                const uint64_t begin = alignedFirst + chunk * chunkSize;
+                const uint64_t end = std::min(begin + chunkSize, numSuperblocks);
+                for (uint64_t superblock = begin; superblock < end; superblock += 1) {
+                    superblocks_.set(superblock, superblocks_[superblock] + chunkOffsets[chunk]);
+                }
+            });
+            totalOnes_ = chunkOffsets[numChunks];
         }
 
         /**
@@ -438,54 +1303,630 @@ class RankSupport {
          * 
          * @throws std::invalid_argument If i is >= the number of bits in the bitvector.
          * 
-         * @param i 
-         * @return uint64_t 
+         * @param i 
+         * @return uint64_t 
+         */
+        uint64_t operator()(uint64_t i) const {
+            return rank1(i);
+        }
+
+        /**
+         * @brief The number of 1 bits in range 0...i.
+         * 
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         * 
+         * @param i
+         * @return uint64_t 
+         */
+        uint64_t rank1(uint64_t i) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (i >= this->size()) {
+                    throw std::out_of_range("RankSupport::rank1 - " + std::to_string(i) + 
+                        "-th bit is out of bounds for bitvector of size " + std::to_string(this->size()) + ".");
+                }
+            }
+
+            instrument::count(instrument::RANK_CALLS);
+            auto const& bv = bitvector_.get();
+            const uint64_t blockCount = bv.popcount((i/blockSize_)*blockSize_, (i % (blockSize_)) + 1);
+            return superblocks_[i/superblockSize_] + this->blockOnes(i/blockSize_) + blockCount;
+        }
+
+        /**
+         * @brief rank1(i) and bit i together. The word holding bit i is loaded once and serves both the bit and the
+         * in-block popcount, so a membership test followed by a rank costs no more than the rank.
+         * 
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         * 
+         * @param i
+         * @return std::pair<uint64_t, bool> (number of 1 bits in range 0...i, bit i)
+         */
+        std::pair<uint64_t, bool> rank1WithBit(uint64_t i) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (i >= this->size()) {
+                    throw std::out_of_range("RankSupport::rank1WithBit - " + std::to_string(i) + 
+                        "-th bit is out of bounds for bitvector of size " + std::to_string(this->size()) + ".");
+                }
+            }
+
+            instrument::count(instrument::RANK_CALLS);
+            uint64_t const* words = bitvector_.get().words();
+            const uint64_t blockStart = (i / blockSize_) * blockSize_;
+            const uint64_t word = words[i >> 6];
+            const uint64_t upToI = word & (~0ull >> (63 - (i & 63)));
+            /* blocks are at most 32 bits, so the block starts in the word of i or the one before it */
+            const uint64_t blockCount = ((blockStart >> 6) == (i >> 6)) 
+                ? std::popcount(upToI >> (blockStart & 63))
+                : std::popcount(upToI) + std::popcount(words[blockStart >> 6] >> (blockStart & 63));
+            const uint64_t rank = superblocks_[i/superblockSize_] + this->blockOnes(i/blockSize_) + blockCount;
+            return {rank, ((word >> (i & 63)) & 1) != 0};
+        }
+
+        /**
+         * @brief Computes out[j] = rank1(in[j]) for every query. The superblock, block, and bitvector words of
+         * upcoming queries are prefetched while earlier ones are answered, so independent queries overlap their
+         * cache misses instead of paying for them one at a time.
+         * 
+         * @throws std::out_of_range If any query is >= the number of bits in the bitvector.
+         * @throws std::invalid_argument If out is shorter than in.
+         * 
+         * @param in queries
+         * @param out receives the answers in the same order as `in`
+         * @param sortQueries answer the queries in increasing order. Helps when queries are many and random.
+         */
+        void rank1Batch(std::span<const uint64_t> in, std::span<uint64_t> out, bool sortQueries = false) const {
+            auto const& bv = bitvector_.get();
+            utility::batchQuery(in, out, sortQueries, 
+                [this, &bv](uint64_t i) {
+                    superblocks_.prefetch(i/superblockSize_);
+                    blocks_.prefetch(i/blockSize_);
+                    bv.prefetch(i);
+                },
+                [](uint64_t) {},
+                [this](uint64_t i) { return rank1(i); });
+        }
+
+        /**
+         * @brief The number of 0 bits in range 0...i. Uses the same tables as rank1.
+         * 
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         * 
+         * @param i
+         * @return uint64_t 
+         */
+        uint64_t rank0(uint64_t i) const {
+            return (i + 1) - rank1(i);
+        }
+
+        /**
+         * @brief Return the overhead in bits.
+         * 
+         * @return uint64_t bits overhead.
+         */
+        uint64_t overhead() const noexcept {
+            return superblocks_.overhead() + blocks_.overhead();
+        }
+
+        /**
+         * @brief Loads saved RankSupport data from file `fname`. Data must be in format written by `save` function.
+         * @see save
+         * 
+         * @param fname input filename
+         */
+        void load(std::string const& fname) {
+            serial::FileReader inputStream(fname);
+
+            /* meta data */
+            uint32_t magicTmp, versionTmp;
+            serial::deserialize(magicTmp, inputStream);
+            serial::deserialize(versionTmp, inputStream);
+            checkHeader(magicTmp, versionTmp, fname);
+
+            /* read rest of data */
+            this->deserialize(inputStream);
+
+            /* cleanup */
+            inputStream.close();
+        }
+
+        /**
+         * @brief Loads a file written by `save` without copying it. The superblock and block tables become views into
+         * a private mapping of the file, so loading is O(1) in the table size and processes that map the same file
+         * share its pages. The tables stay valid after buildTables (writes are copy-on-write) and until this
+         * RankSupport is destroyed or reloaded. The bitvector is not part of the file.
+         * @see save
+         * 
+         * @throws std::ios_base::failure If the file cannot be mapped or is truncated.
+         * @throws std::domain_error If the file is not a RankSupport file of the current version.
+         * 
+         * @param fname input filename
+         */
+        void map(std::string const& fname) {
+            serial::MappedReader reader(fname);
+
+            const uint32_t magicTmp = reader.read<uint32_t>();
+            const uint32_t versionTmp = reader.read<uint32_t>();
+            checkHeader(magicTmp, versionTmp, fname);
+
+            this->map(reader);
+        }
+
+        /**
+         * @brief Saves RankSupport data to file `fname`.
+         * @see load
+         * 
+         * @param fname output filename
+         */
+        void save(std::string const& fname) const {
+            serial::FileWriter outputStream(fname);
+
+            /* write meta data */
+            const uint32_t magicTmp = FILE_MAGIC, versionTmp = FILE_VERSION;
+            serial::serialize(magicTmp, outputStream);
+            serial::serialize(versionTmp, outputStream);
+
+            /* write parameters, superblocks, and blocks */
+            this->serialize(outputStream);
+
+            /* cleanup */
+            outputStream.close();
+        }
+
+        /**
+         * @brief Returns the size of the underlying bitvector.
+         * 
+         * @return uint64_t size of underlying bitvector
+         */
+        uint64_t size() const noexcept {
+            return bitvector_.get().size();
+        }
+
+        /**
+         * @brief Returns the total number of 1s in the bitvector in constant time.
+         * 
+         * @return uint64_t total number of 1s.
+         */
+        uint64_t totalOnes() const noexcept {
+            return totalOnes_;
+        }
+
+        /**
+         * @brief Returns the total number of 0s in the bitvector in constant time.
+         * 
+         * @return uint64_t total number of 0s.
+         */
+        uint64_t totalZeros() const noexcept {
+            return this->size() - totalOnes_;
+        }
+
+        /**
+         * @brief Whether the bitvector was written through since the tables were last built or loaded. Stale tables
+         * give wrong answers until `buildTables` is called again.
+         * @see BitVector::version
+         * 
+         * @return true if the bitvector changed after the tables were built
+         */
+        bool isStale() const noexcept {
+            return bitvector_.get().version() != builtVersion_;
+        }
+
+        /**
+         * @brief The bitvector the tables are built over.
+         * 
+         * @return BitVector const& underlying bitvector
+         */
+        BitVector const& bitvector() const noexcept {
+            return bitvector_.get();
+        }
+
+        template <BitVectorRankable> friend class SelectSupport;
+        friend class ::sparse::BitVectorPositions;
+        friend class WaveletMatrix;
+
+    private:
+        /**
+         * @brief Fills the superblock and block table entries for superblocks [firstSuperblock, endSuperblock).
+         * Block popcounts are computed a batch at a time straight from the bitvector's words (see 
+         * utility::blockPopcounts), so the cost is O(1) word operations per block rather than per bit.
+         * 
+         * @param firstSuperblock first superblock to fill
+         * @param endSuperblock one past the last superblock to fill
+         * @param onesBefore number of ones before superblock `firstSuperblock`
+         * @return uint64_t number of ones before superblock `endSuperblock` (or the end of bitvector)
+         */
+        uint64_t fillTables(uint64_t firstSuperblock, uint64_t endSuperblock, uint64_t onesBefore) {
+            auto const& bv = bitvector_.get();
+            const uint64_t blocksPerSuperblock = superblockSize_ / blockSize_;
+            const uint64_t endBlock = std::min(endSuperblock * blocksPerSuperblock, blocks_.size());
+
+            std::array<uint32_t, BUILD_BATCH_SIZE> counts;
+            uint64_t ones = onesBefore, superblockOnes = onesBefore;
+            uint64_t blockInSuperblock = 0, superblock = firstSuperblock;
+
+            /* the last block may run past the end of the bitvector (and its words), so it is counted separately */
+            const uint64_t numFullBlocks = bv.size() / blockSize_;
+            const uint64_t firstBit = firstSuperblock * blocksPerSuperblock * blockSize_;
+            instrument::count(instrument::BUILD_BITS_SCANNED, std::min(endBlock * blockSize_, bv.size()) - firstBit);
+
+            for (uint64_t block = firstSuperblock * blocksPerSuperblock; block < endBlock; block += BUILD_BATCH_SIZE) {
+                const uint64_t batchSize = std::min(BUILD_BATCH_SIZE, endBlock - block);
+                const uint64_t fullBlocks = (block < numFullBlocks) ? std::min(batchSize, numFullBlocks - block) : 0;
+                utility::blockPopcounts(bv.words(), bv.numWords(), block * blockSize_, blockSize_, fullBlocks, 
+                                        counts.data());
+                for (uint64_t k = fullBlocks; k < batchSize; k += 1) {
+                    const uint64_t start = (block + k) * blockSize_;
+                    counts[k] = utility::popcountBits(bv.words(), start, bv.size() - start);
+                }
+
+                for (uint64_t k = 0; k < batchSize; k += 1) {
+                    if (blockInSuperblock == 0) {
+                        superblocks_.set(superblock, ones);
+                        superblockOnes = ones;
+                        superblock += 1;
+                    }
+                    blocks_.set(block + k, ones - superblockOnes);
+                    ones += counts[k];
+
+                    blockInSuperblock = (blockInSuperblock + 1 == blocksPerSuperblock) ? 0 : blockInSuperblock + 1;
+                }
+            }
+            return ones;
+        }
+
+        /**
+         * @brief number of block counts computed per call to utility::blockPopcounts in `fillTables`
+         */
+        constexpr static uint64_t BUILD_BATCH_SIZE = 1024;
+
+        /**
+         * @brief parallel build chunks are a multiple of this many superblocks. 64 entries of any width end on a word
+         * boundary, so chunks never share a word of the superblock or block tables.
+         */
+        constexpr static uint64_t PARALLEL_CHUNK_ALIGNMENT = 64;
+
+        /**
+         * @brief Throws unless a file header matches FILE_MAGIC and FILE_VERSION.
+         * @throws std::domain_error on a mismatch
+         */
+        static void checkHeader(uint32_t magic, uint32_t version, std::string const& fname) {
+            if (magic != FILE_MAGIC) {
+                throw std::domain_error("Invalid file magic for file \"" + fname + "\".");
+            }
+            if (version != FILE_VERSION) {
+                throw std::domain_error("Unsupported RankSupport file version " + std::to_string(version) + 
+                    " in file \"" + fname + "\".");
+            }
+        }
+
+        /**
+         * @brief Writes the parameters and tables that follow the file header. SparseArray embeds them in its files.
+         * 
+         * @param out destination of data
+         */
+        void serialize(std::ostream& out) const {
+            serial::serialize(superblockSize_, out);
+            serial::serialize(blockSize_, out);
+            serial::serialize(totalOnes_, out);
+            serial::serialize(superblocks_, out);
+            serial::serialize(blocks_, out);
+        }
+
+        /**
+         * @brief Reads what `serialize` wrote into freshly allocated tables.
+         * 
+         * @param in source of data
+         */
+        void deserialize(std::istream& in) {
+            serial::deserialize(superblockSize_, in);
+            serial::deserialize(blockSize_, in);
+            serial::deserialize(totalOnes_, in);
+            serial::deserialize(superblocks_, in);
+            serial::deserialize(blocks_, in);
+            builtVersion_ = bitvector_.get().version();
+        }
+
+        /**
+         * @brief Views what `serialize` wrote in a mapped file.
+         * 
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader) {
+            superblockSize_ = reader.read<uint32_t>();
+            blockSize_ = reader.read<uint32_t>();
+            totalOnes_ = reader.read<uint64_t>();
+            superblocks_.map(reader);
+            blocks_.map(reader);
+            builtVersion_ = bitvector_.get().version();
+        }
+
+        /**
+         * @brief ceil(log_2(num)) in integer arithmetic, but at least 1 so it is a valid PackedVector width.
+         *
+         * @param num input integer
+         * @return uint32_t number of bits needed to store values in [0, num)
+         */
+        constexpr static uint32_t ceilLog2(uint64_t num) noexcept {
+            return std::max<uint32_t>(1, (num <= 1) ? 0 : std::bit_width(num - 1));
+        }
+
+        /**
+         * @brief Block size log_2(n)/2 with n rounded up to a power of 2. At least 1 bit.
+         *
+         * @param size number of bits in the bitvector
+         * @return uint32_t bits per block
+         */
+        constexpr static uint32_t blockSizeFor(uint64_t size) noexcept {
+            const uint64_t logSize = std::countr_zero(utility::roundUpToPowerOf2(std::max<uint64_t>(size, 1)));
+            return std::max<uint64_t>(1, logSize / 2);
+        }
+
+        /**
+         * @brief Superblock size log_2(n)^2/2 with n rounded up to a power of 2. Always a multiple of the block size,
+         * and never smaller than it.
+         *
+         * @param size number of bits in the bitvector
+         * @return uint32_t bits per superblock
+         */
+        constexpr static uint32_t superblockSizeFor(uint64_t size) noexcept {
+            const uint64_t logSize = std::countr_zero(utility::roundUpToPowerOf2(std::max<uint64_t>(size, 1)));
+            return std::max<uint64_t>(blockSizeFor(size), (logSize * logSize) / 2);
+        }
+
+        /**
+         * @brief The block table entry of `block`. Block entries are < superblockSize_ <= 2048, so their width is at
+         * most 11 bits and known once the size is; dispatching to a FixedPackedVector read turns the shifts and mask
+         * into constants.
+         *
+         * @param block block index
+         * @return uint64_t ones in the superblock before the block
+         */
+        uint64_t blockOnes(uint64_t block) const noexcept {
+            uint64_t const* words = blocks_.words();
+            switch (blocks_.bitsPerElement()) {
+                case 1: return FixedPackedVector<1>::get(words, block);
+                case 2: return FixedPackedVector<2>::get(words, block);
+                case 3: return FixedPackedVector<3>::get(words, block);
+                case 4: return FixedPackedVector<4>::get(words, block);
+                case 5: return FixedPackedVector<5>::get(words, block);
+                case 6: return FixedPackedVector<6>::get(words, block);
+                case 7: return FixedPackedVector<7>::get(words, block);
+                case 8: return FixedPackedVector<8>::get(words, block);
+                case 9: return FixedPackedVector<9>::get(words, block);
+                case 10: return FixedPackedVector<10>::get(words, block);
+                case 11: return FixedPackedVector<11>::get(words, block);
+                default: return blocks_[block];
+            }
+        }
+
+        static utility::AllocationPolicy withoutZeroFill(utility::AllocationPolicy policy) noexcept {
+            policy.zeroFill = false;
+            return policy;
+        }
+
+        std::reference_wrapper<const BitVector> bitvector_;
+        uint32_t superblockSize_, superblockWordSize_, blockSize_, blockWordSize_;
+        PackedVector superblocks_, blocks_;
+        uint64_t totalOnes_ = 0;
+        uint64_t builtVersion_ = 0;
+};
+
+
+/**
+ * @brief RankSupportInterleaved class. Rank support with the counts and the bits in the same cache line, so a rank 
+ * query costs one cache miss instead of the up to three (superblock, block, and data) of RankSupport.
+ * 
+ * Bits are copied into 64 byte lines of 8 words. Word 0 of each line is the number of ones before the line and words
+ * 1-7 hold the next 448 bits of the bitvector. Within a line, rank is the header plus a masked popcount of each of
+ * the 7 payload words, which needs no data dependent branches and no other memory. The header is a full 64 bit
+ * count, so any bitvector size is supported. The headers cost 64 bits for every 448 bits, on top of the copy.
+ */
+class RankSupportInterleaved {
+    /**
+     * @brief All RankSupportInterleaved files should start with these 4 bytes.
+     */
+    constexpr static uint32_t FILE_MAGIC = 0xbeefcafe;
+
+    public:
+        /**
+         * @brief number of words in a line
+         */
+        constexpr static uint64_t WORDS_PER_LINE = BitVector::ALIGNMENT / sizeof(uint64_t);
+
+        /**
+         * @brief number of bitvector bits in a line
+         */
+        constexpr static uint64_t PAYLOAD_BITS = (WORDS_PER_LINE - 1) * BitVector::WORD_BITS;
+
+        /**
+         * @brief Construct a new RankSupportInterleaved object around `bitvector`. Copies the bits and builds counts
+         * on construction.
+         * 
+         * @param bitvector input BitVector
+         */
+        RankSupportInterleaved(BitVector const& bitvector) : bitvector_(bitvector), size_(bitvector.size()),
+            numLines_(std::max<uint64_t>(1, utility::roundDivisionUp(size_, PAYLOAD_BITS))),
+            lines_(utility::allocateAligned<uint64_t, BitVector::ALIGNMENT>(numLines_ * WORDS_PER_LINE)) {
+            this->buildTables();
+        }
+
+        /**
+         * @brief Copies the bits of the underlying bitvector into the lines and rebuilds the line counts from the
+         * line `startingIndex` lies in onwards.
+         * @throws std::out_of_range if startingIndex is larger than the bitvector size.
+         * 
+         * @param startingIndex index to start rebuilding from
+         */
+        void buildTables(uint64_t startingIndex = 0) {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (startingIndex > size_) {
+                    throw std::out_of_range("RankSupportInterleaved::buildTables -- startingIndex " + 
+                            std::to_string(startingIndex) + " is out of range for bitvector.");
+                }
+            }
+
+            auto const& bv = bitvector_.get();
+            builtVersion_ = bv.version();
+            const uint64_t numDataWords = utility::roundDivisionUp(size_, BitVector::WORD_BITS);
+            constexpr uint64_t PAYLOAD_WORDS = WORDS_PER_LINE - 1;
+
+            uint64_t line = startingIndex / PAYLOAD_BITS;
+            if (line >= numLines_) {
+                return;
+            }
+            uint64_t ones = lines_[line * WORDS_PER_LINE];
+            for (; line < numLines_; line += 1) {
+                uint64_t *dst = lines_.get() + line * WORDS_PER_LINE;
+                dst[0] = ones;
+                for (uint64_t w = 0; w < PAYLOAD_WORDS; w += 1) {
+                    const uint64_t wordIndex = line * PAYLOAD_WORDS + w;
+                    dst[1 + w] = (wordIndex < numDataWords) ? bv.words()[wordIndex] : 0;
+                    ones += std::popcount(dst[1 + w]);
+                }
+            }
+            totalOnes_ = ones;
+        }
+
+        /**
+         * @brief The number of 1 bits in range 0...i.
+         * @see rank1
+         * 
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         * 
+         * @param i 
+         * @return uint64_t 
+         */
+        uint64_t operator()(uint64_t i) const {
+            return rank1(i);
+        }
+
+        /**
+         * @brief The number of 1 bits in range 0...i. Touches one cache line.
+         * 
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         * 
+         * @param i
+         * @return uint64_t 
+         */
+        uint64_t rank1(uint64_t i) const {
+            checkBounds(i, "rank1");
+
+            const uint64_t line = i / PAYLOAD_BITS;
+            const uint64_t offset = i - line * PAYLOAD_BITS;
+            const uint64_t lastWord = offset >> 6;
+            const uint64_t lastMask = ~0ull >> (63 - (offset & 63));
+            uint64_t const* words = lines_.get() + line * WORDS_PER_LINE;
+
+            uint64_t count = words[0];
+            for (uint64_t w = 0; w < WORDS_PER_LINE - 1; w += 1) {
+                const uint64_t mask = (w < lastWord) ? ~0ull : ((w == lastWord) ? lastMask : 0);
+                count += std::popcount(words[1 + w] & mask);
+            }
+            return count;
+        }
+
+        /**
+         * @brief rank1(i) and bit i together, both from the one cache line rank1 reads.
+         * @see RankSupport::rank1WithBit
+         * 
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         * 
+         * @param i
+         * @return std::pair<uint64_t, bool> (number of 1 bits in range 0...i, bit i)
+         */
+        std::pair<uint64_t, bool> rank1WithBit(uint64_t i) const {
+            checkBounds(i, "rank1WithBit");
+
+            const uint64_t line = i / PAYLOAD_BITS;
+            const uint64_t offset = i - line * PAYLOAD_BITS;
+            uint64_t const* words = lines_.get() + line * WORDS_PER_LINE;
+            return {this->rank1(i), ((words[1 + (offset >> 6)] >> (offset & 63)) & 1) != 0};
+        }
+
+        /**
+         * @brief Computes out[j] = rank1(in[j]) for every query, prefetching the lines of upcoming queries.
+         * @see RankSupport::rank1Batch
+         * 
+         * @throws std::out_of_range If any query is >= the number of bits in the bitvector.
+         * @throws std::invalid_argument If out is shorter than in.
+         * 
+         * @param in queries
+         * @param out receives the answers in the same order as `in`
+         * @param sortQueries answer the queries in increasing order
          */
-        uint64_t operator()(uint64_t i) const {
-            return rank1(i);
+        void rank1Batch(std::span<const uint64_t> in, std::span<uint64_t> out, bool sortQueries = false) const {
+            utility::batchQuery(in, out, sortQueries,
+                [this](uint64_t i) { utility::prefetch(lines_.get() + (i / PAYLOAD_BITS) * WORDS_PER_LINE); },
+                [](uint64_t) {},
+                [this](uint64_t i) { return rank1(i); });
         }
 
         /**
-         * @brief The number of 1 bits in range 0...i.
+         * @brief The number of 0 bits in range 0...i.
          * 
          * @throws std::out_of_range If i is >= the number of bits in the bitvector.
          * 
          * @param i
          * @return uint64_t 
          */
-        uint64_t rank1(uint64_t i) const {
-            if constexpr (utility::CHECK_BOUNDS) {
-                if (i >= this->size()) {
-                    throw std::out_of_range("RankSupport::rank1 - " + std::to_string(i) + 
-                        "-th bit is out of bounds for bitvector of size " + std::to_string(this->size()) + ".");
-                }
-            }
+        uint64_t rank0(uint64_t i) const {
+            return (i + 1) - rank1(i);
+        }
 
-            auto const& bv = bitvector_.get();
-            const uint64_t blockCount = bv.popcount((i/blockSize_)*blockSize_, (i % (blockSize_)) + 1);
-            return superblocks_.at(i/superblockSize_) + blocks_.at(i/blockSize_) + blockCount;
+        /**
+         * @brief Gets the `i`-th bit from the interleaved copy. No bounds checking.
+         * 
+         * @param i index to retrieve
+         * @return true bit `i` is set
+         * @return false bit `i` is not set 
+         */
+        bool operator[](uint64_t i) const noexcept {
+            return (this->word(i >> 6) >> (i & 63)) & 1;
         }
 
         /**
-         * @brief Return the overhead in bits.
+         * @brief The k-th 64 bit word of the bitvector, read from the interleaved copy. 448 bits is exactly 7 words,
+         * so bitvector words never straddle lines.
+         * 
+         * @param k word index
+         * @return uint64_t bits [64k, 64k+64) of the bitvector
+         */
+        uint64_t word(uint64_t k) const noexcept {
+            constexpr uint64_t PAYLOAD_WORDS = WORDS_PER_LINE - 1;
+            return lines_[(k / PAYLOAD_WORDS) * WORDS_PER_LINE + 1 + (k % PAYLOAD_WORDS)];
+        }
+
+        /**
+         * @brief Return the overhead in bits. Like RankSupport, this is everything allocated besides the bitvector,
+         * so it counts the copy of the bits in the line payloads as well as the line headers and padding.
+         * @see copyOverhead
          * 
          * @return uint64_t bits overhead.
          */
         uint64_t overhead() const noexcept {
-            return superblocks_.overhead() + blocks_.overhead();
+            return numLines_ * WORDS_PER_LINE * BitVector::WORD_BITS;
         }
 
         /**
-         * @brief Loads saved RankSupport data from file `fname`. Data must be in format written by `save` function.
+         * @brief The part of `overhead` that is the copy of the bits, i.e. the line payloads. The lines can answer
+         * bit access (see `word`), so this is what could be saved by dropping the bitvector.
+         * 
+         * @return uint64_t bits of line payload
+         */
+        uint64_t copyOverhead() const noexcept {
+            return numLines_ * PAYLOAD_BITS;
+        }
+
+        /**
+         * @brief Loads saved RankSupportInterleaved data from file `fname`. Data must be in format written by `save`.
          * @see save
+         * @throws std::ios_base::failure If the file cannot be opened or is truncated.
+         * @throws std::domain_error If the file is not a RankSupportInterleaved file.
+         * @throws std::invalid_argument If CHECK_BOUNDS and the file was saved over a bitvector of another size.
          * 
          * @param fname input filename
          */
         void load(std::string const& fname) {
-            std::ifstream inputStream(fname, std::ios::in | std::ios::binary);
-            if (!inputStream) {
-                throw std::ios_base::failure("Could not open file \"" + fname + "\" to read.");
-            }
+            serial::FileReader inputStream(fname);
 
             /* meta data */
             uint32_t magicTmp;
@@ -495,41 +1936,56 @@ class RankSupport {
                 throw std::domain_error("Invalid file magic for file \"" + fname + "\".");
             }
 
-            uint32_t superblockSize, blockSize;
-            serial::deserialize(superblockSize, inputStream);
-            serial::deserialize(blockSize, inputStream);
-            this->superblockSize_ = superblockSize;
-            this->blockSize_ = blockSize;
+            uint64_t size, numLines;
+            serial::deserialize(size, inputStream);
+            serial::deserialize(numLines, inputStream);
+            if constexpr (utility::CHECK_BOUNDS) {
+                const uint64_t expectedLines = std::max<uint64_t>(1, utility::roundDivisionUp(size, PAYLOAD_BITS));
+                if (size != bitvector_.get().size() || numLines != expectedLines) {
+                    inputStream.close();
+                    throw std::invalid_argument("RankSupportInterleaved::load -- file \"" + fname + "\" has " +
+                        std::to_string(numLines) + " lines over " + std::to_string(size) + " bits, but the " +
+                        "bitvector has " + std::to_string(bitvector_.get().size()) + " bits.");
+                }
+            }
+            size_ = size;
+            serial::deserialize(totalOnes_, inputStream);
+            if (numLines != numLines_) {
+                numLines_ = numLines;
+                lines_ = utility::allocateAligned<uint64_t, BitVector::ALIGNMENT>(numLines_ * WORDS_PER_LINE);
+            }
 
-            /* read rest of data */
-            serial::deserialize(superblocks_, inputStream);
-            serial::deserialize(blocks_, inputStream);
+            /* read lines */
+            inputStream.read(reinterpret_cast<char*>(lines_.get()), numLines_ * WORDS_PER_LINE * sizeof(uint64_t));
+            if (!inputStream) {
+                throw std::ios_base::failure("RankSupportInterleaved::load -- file \"" + fname + "\" is truncated.");
+            }
+            builtVersion_ = bitvector_.get().version();
 
             /* cleanup */
             inputStream.close();
         }
 
         /**
-         * @brief Saves RankSupport data to file `fname`.
+         * @brief Saves RankSupportInterleaved data to file `fname`.
          * @see load
+         * @throws std::ios_base::failure If the file cannot be opened.
          * 
          * @param fname output filename
          */
         void save(std::string const& fname) const {
-            std::ofstream outputStream(fname, std::ios::out | std::ios::binary);
-            if (!outputStream) {
-                throw std::ios_base::failure("Could not open file \"" + fname + "\" to write.");
-            }
+            serial::FileWriter outputStream(fname);
 
             /* write meta data */
             const uint32_t magicTmp = FILE_MAGIC;
             serial::serialize(magicTmp, outputStream);
-            serial::serialize(superblockSize_, outputStream);
-            serial::serialize(blockSize_, outputStream);
+            serial::serialize(size_, outputStream);
+            serial::serialize(numLines_, outputStream);
+            serial::serialize(totalOnes_, outputStream);
 
-            /* write superblocks and blocks */
-            serial::serialize(superblocks_, outputStream);
-            serial::serialize(blocks_, outputStream);
+            /* write lines */
+            outputStream.write(reinterpret_cast<char const*>(lines_.get()), 
+                                numLines_ * WORDS_PER_LINE * sizeof(uint64_t));
 
             /* cleanup */
             outputStream.close();
@@ -538,10 +1994,10 @@ class RankSupport {
         /**
          * @brief Returns the size of the underlying bitvector.
          * 
-         * @return uint32_t size of underlying bitvector
+         * @return uint64_t size of underlying bitvector
          */
         uint64_t size() const noexcept {
-            return bitvector_.get().size();
+            return size_;
         }
 
         /**
@@ -553,35 +2009,399 @@ class RankSupport {
             return totalOnes_;
         }
 
-        friend class SelectSupport;
-        template <typename> friend class ::sparse::SparseArray;
+        /**
+         * @brief Returns the total number of 0s in the bitvector in constant time.
+         * 
+         * @return uint64_t total number of 0s.
+         */
+        uint64_t totalZeros() const noexcept {
+            return size_ - totalOnes_;
+        }
+
+        /**
+         * @brief Whether the bitvector was written through since the lines were last built or loaded. Stale lines give
+         * wrong answers until `buildTables` is called again.
+         * @see BitVector::version
+         * 
+         * @return true if the bitvector changed after the lines were built
+         */
+        bool isStale() const noexcept {
+            return bitvector_.get().version() != builtVersion_;
+        }
+
+        /**
+         * @brief The bitvector the lines are copied from.
+         * 
+         * @return BitVector const& underlying bitvector
+         */
+        BitVector const& bitvector() const noexcept {
+            return bitvector_.get();
+        }
 
     private:
         std::reference_wrapper<const BitVector> bitvector_;
-        uint32_t superblockSize_, superblockWordSize_, blockSize_, blockWordSize_;
-        PackedVector superblocks_, blocks_;
-        uint64_t totalOnes_;
+        uint64_t size_;
+        uint64_t numLines_;
+        utility::AlignedArray<uint64_t, BitVector::ALIGNMENT> lines_;
+        uint64_t totalOnes_ = 0;
+        uint64_t builtVersion_ = 0;
+
+        inline void checkBounds(uint64_t i, char const* function) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (i >= size_) {
+                    throw std::out_of_range("RankSupportInterleaved::" + std::string(function) + " - " + 
+                        std::to_string(i) + "-th bit is out of bounds for bitvector of size " + 
+                        std::to_string(size_) + ".");
+                }
+            }
+        }
+};
+
+
+/**
+ * @brief SelectIndex. Sampled positions of the ones (or zeros) in a bitvector (darray of Okanohara and Sadakane), 
+ * used to answer select in near constant time. An index over zeros works on the complemented words, so everything
+ * below applies to either bit value.
+ * 
+ * The ones are grouped into blocks of ONES_PER_BLOCK. The inventory stores the position of the first one in every
+ * block. Blocks spanning at least SPARSE_SPAN bits are sparse and store the position of each of their ones
+ * explicitly in the overflow table. Dense blocks span less than SPARSE_SPAN bits, so they store the 16 bit offset of
+ * every ONES_PER_SUBBLOCK-th one from the block's start instead. A query on a dense block jumps to the nearest
+ * subsample and scans forward a word at a time with popcount, finishing with utility::selectInWord.
+ */
+class SelectIndex {
+    public:
+        /**
+         * @brief number of ones per inventory block
+         */
+        constexpr static uint64_t ONES_PER_BLOCK = 1024;
+
+        /**
+         * @brief number of ones between subsamples in dense blocks
+         */
+        constexpr static uint64_t ONES_PER_SUBBLOCK = 32;
+
+        /**
+         * @brief blocks spanning at least this many bits store all positions explicitly
+         */
+        constexpr static uint64_t SPARSE_SPAN = 1ull << 16;
+
+        /**
+         * @brief Construct an empty SelectIndex, e.g. to deserialize into.
+         */
+        SelectIndex() : count_(0), flip_(0), positionBits_(1), inventory_(0, positionBits_ + 1), 
+            subsamples_(0, SUBSAMPLE_BITS), overflow_(0, positionBits_) {}
+
+        /**
+         * @brief Construct a new SelectIndex over the bits equal to `bit` in `bitvector`.
+         * 
+         * @param bitvector input BitVector
+         * @param count number of bits in `bitvector` equal to `bit`
+         * @param bit index positions of ones if true, zeros if false
+         */
+        SelectIndex(BitVector const& bitvector, uint64_t count, bool bit = true) : count_(count), 
+            flip_(bit ? 0 : ~0ull), positionBits_(std::max<uint32_t>(1, std::bit_width(bitvector.size()))),
+            inventory_(utility::roundDivisionUp(count, ONES_PER_BLOCK), positionBits_ + 1),
+            subsamples_(inventory_.size() * SUBBLOCKS_PER_BLOCK, SUBSAMPLE_BITS),
+            overflow_(0, positionBits_) {
+            this->build(bitvector);
+        }
+
+        /**
+         * @brief Position of the (k+1)-th indexed bit. No bounds checking.
+         * 
+         * @param words words of the indexed bitvector
+         * @param k number of indexed bits before the one to find
+         * @return uint64_t index of the (k+1)-th indexed bit
+         */
+        uint64_t select(uint64_t const* words, uint64_t k) const noexcept {
+            const uint64_t block = k / ONES_PER_BLOCK;
+            const uint64_t rankInBlock = k % ONES_PER_BLOCK;
+
+            const uint64_t entry = inventory_[block];
+            if (entry & sparseFlag()) {
+                return overflow_[(entry & ~sparseFlag()) + rankInBlock];
+            }
+
+            const uint64_t position = entry + 
+                subsamples_[block * SUBBLOCKS_PER_BLOCK + rankInBlock / ONES_PER_SUBBLOCK];
+            const uint64_t remaining = rankInBlock % ONES_PER_SUBBLOCK;
+            if (remaining == 0) {
+                return position;
+            }
+            return scan(words, position + 1, remaining - 1, flip_);
+        }
+
+        /**
+         * @brief Hints that select(k) will be called soon by prefetching its inventory entry and subsample. Never
+         * faults, even if k is out of range.
+         * 
+         * @param k number of indexed bits before the one that will be found
+         */
+        void prefetchSample(uint64_t k) const noexcept {
+            const uint64_t block = k / ONES_PER_BLOCK;
+            inventory_.prefetch(block);
+            subsamples_.prefetch(block * SUBBLOCKS_PER_BLOCK + (k % ONES_PER_BLOCK) / ONES_PER_SUBBLOCK);
+        }
+
+        /**
+         * @brief Second prefetch stage for select(k). Reads the (ideally already cached) samples of k and prefetches
+         * the overflow entry or the first word select(k) will scan. Does nothing if k >= count().
+         * 
+         * @param words words of the indexed bitvector
+         * @param k number of indexed bits before the one that will be found
+         */
+        void prefetchScan(uint64_t const* words, uint64_t k) const noexcept {
+            if (k >= count_) {
+                return;
+            }
+            const uint64_t block = k / ONES_PER_BLOCK;
+            const uint64_t rankInBlock = k % ONES_PER_BLOCK;
+
+            const uint64_t entry = inventory_[block];
+            if (entry & sparseFlag()) {
+                overflow_.prefetch((entry & ~sparseFlag()) + rankInBlock);
+                return;
+            }
+            const uint64_t position = entry + 
+                subsamples_[block * SUBBLOCKS_PER_BLOCK + rankInBlock / ONES_PER_SUBBLOCK];
+            utility::prefetch(words + (position >> 6));
+        }
+
+        /**
+         * @brief number of indexed bits
+         * 
+         * @return uint64_t number of ones (or zeros) in the bitvector
+         */
+        uint64_t count() const noexcept {
+            return count_;
+        }
+
+        /**
+         * @brief Position of the (k+1)-th one at or after bit `from`, scanning a word at a time. Words are XORed with
+         * `flip` first, so passing ~0 finds zeros instead.
+         * 
+         * @param words words to scan
+         * @param from first bit to consider
+         * @param k number of ones to skip
+         * @param flip mask XORed into every word
+         * @return uint64_t index of the one
+         */
+        static uint64_t scan(uint64_t const* words, uint64_t from, uint64_t k, uint64_t flip = 0) noexcept {
+            uint64_t wordIndex = from >> 6;
+            uint64_t word = (words[wordIndex] ^ flip) & (~0ull << (from & 63));
+            
+            uint32_t ones = std::popcount(word);
+            while (k >= ones) {
+                k -= ones;
+                word = words[++wordIndex] ^ flip;
+                ones = std::popcount(word);
+            }
+            instrument::count(instrument::SELECT_SCAN_WORDS, wordIndex - (from >> 6) + 1);
+            return (wordIndex << 6) + utility::selectInWord(word, k);
+        }
+
+        /**
+         * @brief Return the overhead in bits.
+         * 
+         * @return uint64_t bits overhead.
+         */
+        uint64_t overhead() const noexcept {
+            return inventory_.overhead() + subsamples_.overhead() + overflow_.overhead();
+        }
+
+        /**
+         * @brief Serialize index into output stream using serial::serialize
+         * 
+         * @param out destination of data
+         */
+        void serialize(std::ostream& out) const {
+            serial::serialize(count_, out);
+            serial::serialize(flip_, out);
+            serial::serialize(positionBits_, out);
+            serial::serialize(inventory_, out);
+            serial::serialize(subsamples_, out);
+            serial::serialize(overflow_, out);
+        }
+
+        /**
+         * @brief Deserialize from inputstream using serial::deserialize. Will reallocate tables.
+         * 
+         * @param in source of data
+         */
+        void deserialize(std::istream& in) {
+            serial::deserialize(count_, in);
+            serial::deserialize(flip_, in);
+            serial::deserialize(positionBits_, in);
+            serial::deserialize(inventory_, in);
+            serial::deserialize(subsamples_, in);
+            serial::deserialize(overflow_, in);
+        }
+
+        /**
+         * @brief Views tables written by `serialize` in a mapped file instead of copying them.
+         * @see BitVector::map
+         * 
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader) {
+            count_ = reader.read<uint64_t>();
+            flip_ = reader.read<uint64_t>();
+            positionBits_ = reader.read<uint32_t>();
+            inventory_.map(reader);
+            subsamples_.map(reader);
+            overflow_.map(reader);
+        }
+
+    private:
+        constexpr static uint64_t SUBBLOCKS_PER_BLOCK = ONES_PER_BLOCK / ONES_PER_SUBBLOCK;
+        constexpr static uint32_t SUBSAMPLE_BITS = 16;
+        static_assert(SPARSE_SPAN <= (1ull << SUBSAMPLE_BITS), "dense block offsets must fit in a subsample.");
+
+        uint64_t count_;
+        uint64_t flip_;
+        uint32_t positionBits_;
+        PackedVector inventory_, subsamples_, overflow_;
+
+        /**
+         * @brief inventory entries with this bit set are sparse and hold an index into overflow_
+         */
+        uint64_t sparseFlag() const noexcept {
+            return 1ull << positionBits_;
+        }
+
+        /**
+         * @brief Calls func(position) for every indexed bit in `bitvector` in increasing order, a word at a time.
+         */
+        template <typename Func>
+        void forEachIndexed(BitVector const& bitvector, Func&& func) const {
+            uint64_t const* words = bitvector.words();
+            const uint64_t numWords = utility::roundDivisionUp(bitvector.size(), BitVector::WORD_BITS);
+            const uint32_t tailBits = bitvector.size() % BitVector::WORD_BITS;
+            for (uint64_t wordIndex = 0; wordIndex < numWords; wordIndex += 1) {
+                uint64_t word = words[wordIndex] ^ flip_;
+                if (wordIndex + 1 == numWords && tailBits != 0) {
+                    word &= (1ull << tailBits) - 1;     /* complemented padding bits aren't zeros of the bitvector */
+                }
+                for (; word != 0; word &= word - 1) {
+                    func((wordIndex << 6) + std::countr_zero(word));
+                }
+            }
+        }
+
+        /**
+         * @brief Fills the inventory, subsample, and overflow tables. The first pass finds every block's first one,
+         * which decides the sparse blocks and size of overflow_. The second pass records the samples.
+         * 
+         * @param bitvector input BitVector
+         */
+        void build(BitVector const& bitvector) {
+            const uint64_t numBlocks = inventory_.size();
+            if (numBlocks == 0) {
+                return;
+            }
+
+            /* (1) start of every block plus one past the last one */
+            std::vector<uint64_t> blockStarts;
+            blockStarts.reserve(numBlocks + 1);
+            uint64_t count = 0, lastOne = 0;
+            forEachIndexed(bitvector, [&](uint64_t position) {
+                if (count % ONES_PER_BLOCK == 0) {
+                    blockStarts.push_back(position);
+                }
+                count += 1;
+                lastOne = position;
+            });
+            blockStarts.push_back(lastOne + 1);
+
+            uint64_t numOverflow = 0;
+            for (uint64_t block = 0; block < numBlocks; block += 1) {
+                if (blockStarts[block + 1] - blockStarts[block] >= SPARSE_SPAN) {
+                    inventory_.set(block, sparseFlag() | numOverflow);
+                    numOverflow += ONES_PER_BLOCK;
+                } else {
+                    inventory_.set(block, blockStarts[block]);
+                }
+            }
+            overflow_ = PackedVector(numOverflow, positionBits_);
+
+            /* (2) subsamples for dense blocks, every position for sparse blocks */
+            count = 0;
+            forEachIndexed(bitvector, [&](uint64_t position) {
+                const uint64_t block = count / ONES_PER_BLOCK;
+                const uint64_t rankInBlock = count % ONES_PER_BLOCK;
+                const uint64_t entry = inventory_[block];
+
+                if (entry & sparseFlag()) {
+                    overflow_.set((entry & ~sparseFlag()) + rankInBlock, position);
+                } else if (rankInBlock % ONES_PER_SUBBLOCK == 0) {
+                    subsamples_.set(block * SUBBLOCKS_PER_BLOCK + rankInBlock / ONES_PER_SUBBLOCK, position - entry);
+                }
+                count += 1;
+            });
+        }
 };
 
 
 /**
  * @brief SelectSupport class. Implements routines for doing selection on a bitvector.
+ * @see SelectIndex
+ * 
+ * @tparam Rank rank structure over the bitvector, e.g. RankSupport or RankSupportInterleaved. Only its bitvector and
+ *         counts are needed, except by select0 without a zero index.
  */
+template <BitVectorRankable Rank>
 class SelectSupport {
+    /**
+     * @brief All SelectSupport files should start with these 4 bytes.
+     */
+    constexpr static uint32_t FILE_MAGIC = 0xfacebeef;
+
     public:
         /**
-         * @brief Construct a new SelectSupport object. 
+         * @brief Construct a new SelectSupport object. Builds the sampled select index on construction.
+         * 
+         * @param rank rank object
+         * @param indexZeros if true, also build a sampled index for select0. Otherwise select0 searches the rank
+         *        tables of `rank`.
+         */
+        SelectSupport(Rank const& rank, bool indexZeros = false) : rank_(rank), 
+            ones_(rank.bitvector(), rank.totalOnes()), builtVersion_(rank.bitvector().version()) {
+            if (indexZeros) {
+                zeros_.emplace(rank.bitvector(), rank.totalZeros(), false);
+            }
+        }
+
+        /**
+         * @brief Rebuilds the select indices, and the zero index if there is one, from the current bitvector. The
+         * rank structure must be rebuilt first since its counts size the indices.
+         * @see isStale
+         */
+        void rebuild() {
+            auto const& rank = rank_.get();
+            ones_ = SelectIndex(rank.bitvector(), rank.totalOnes());
+            if (zeros_) {
+                zeros_.emplace(rank.bitvector(), rank.totalZeros(), false);
+            }
+            builtVersion_ = rank.bitvector().version();
+        }
+
+        /**
+         * @brief Whether the bitvector was written through since the indices were last built or loaded. Stale
+         * indices give wrong answers until `rebuild` is called.
+         * @see BitVector::version
          * 
-         * @param rank RankSupport object
+         * @return true if the bitvector changed after the indices were built
          */
-        SelectSupport(RankSupport const& rank) noexcept : rank_(rank) {}
+        bool isStale() const noexcept {
+            return rank_.get().bitvector().version() != builtVersion_;
+        }
 
         /**
          * @brief The location of the i-th 1 in the bitvector. 
          * @see select1
          * 
-         * @throws std::invalid_argument If i is greater than the total number of ones.
-         * @throws std::domain_error If no answer is found (something is really wrong here).
+         * @throws std::invalid_argument If i is greater than the total number of ones or is zero.
          * 
          * @param i number of ones
          * @return uint64_t index of i-th 1
@@ -591,80 +2411,227 @@ class SelectSupport {
         }
 
         /**
-         * @brief The location of the i-th 1 in the bitvector. 
+         * @brief The location of the i-th 1 in the bitvector. Near constant time (see SelectIndex).
          * 
          * @throws std::invalid_argument If i is greater than the total number of ones or is zero.
-         * @throws std::runtime_error If no answer is found (something is really wrong here).
          * 
          * @param i number of ones
          * @return uint64_t index of i-th 1
          */
         uint64_t select1(uint64_t i) const {
-
-            auto const& rank = rank_.get();
-
             if constexpr (utility::CHECK_BOUNDS) {
-                if (i > rank.totalOnes()) {
+                if (i > ones_.count()) {
                     throw std::invalid_argument("SelectSupport::select1 - Cannot select " + std::to_string(i) + 
-                        "-th 1 in bitvector with " + std::to_string(rank.totalOnes()) + " 1s.");
+                        "-th 1 in bitvector with " + std::to_string(ones_.count()) + " 1s.");
                 }
                 if (i == 0) {
                     throw std::invalid_argument("SelectSupport::select1 - 0-th 1 is not defined. Use 1-indexing.");
                 }
             }
 
-            auto const& bv = rank.bitvector_.get();
+            instrument::count(instrument::SELECT_CALLS);
+            return ones_.select(rank_.get().bitvector().words(), i - 1);
+        }
 
-            /* binary search */
-            uint32_t lower = 0, upper = rank.size();
-            while (lower <= upper) {
-                const uint32_t mid = (lower + upper) / 2;
-                const auto valueAtMid = rank(mid);
+        /**
+         * @brief Computes out[j] = select1(in[j]) for every query. Lookups are pipelined in two stages: the samples
+         * of a query are prefetched first, then read a few queries later to prefetch the words its scan starts at.
+         * 
+         * @throws std::invalid_argument If any query is zero or greater than the total number of ones, or if out is
+         * shorter than in.
+         * 
+         * @param in queries (1-indexed, as in select1)
+         * @param out receives the answers in the same order as `in`
+         * @param sortQueries answer the queries in increasing order
+         */
+        void select1Batch(std::span<const uint64_t> in, std::span<uint64_t> out, bool sortQueries = false) const {
+            uint64_t const* words = rank_.get().bitvector().words();
+            utility::batchQuery(in, out, sortQueries,
+                [this](uint64_t i) { ones_.prefetchSample(i - 1); },
+                [this, words](uint64_t i) { ones_.prefetchScan(words, i - 1); },
+                [this](uint64_t i) { return select1(i); });
+        }
 
-                if (valueAtMid < i) {
-                    lower = mid + 1;
-                } else if ((valueAtMid > i) || (bv.at(mid) != 1)) {
-                    upper = mid - 1;
-                } else {
-                    return mid;
+        /**
+         * @brief The location of the i-th 0 in the bitvector. Near constant time if the zero index was built. 
+         * Otherwise it binary searches the superblock and then block counts of the RankSupport tables, and scans at
+         * most one block. With other Rank types it binary searches rank0.
+         * 
+         * @throws std::invalid_argument If i is greater than the total number of zeros or is zero.
+         * 
+         * @param i number of zeros
+         * @return uint64_t index of i-th 0
+         */
+        uint64_t select0(uint64_t i) const {
+            auto const& rank = rank_.get();
+
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (i > rank.totalZeros()) {
+                    throw std::invalid_argument("SelectSupport::select0 - Cannot select " + std::to_string(i) + 
+                        "-th 0 in bitvector with " + std::to_string(rank.totalZeros()) + " 0s.");
                 }
+                if (i == 0) {
+                    throw std::invalid_argument("SelectSupport::select0 - 0-th 0 is not defined. Use 1-indexing.");
+                }
+            }
+
+            instrument::count(instrument::SELECT_CALLS);
+            if (zeros_) {
+                return zeros_->select(rank.bitvector().words(), i - 1);
             }
+            return select0ByRank(i);
+        }
 
-            /* i < totalOnes but we couldn't find the i-th 1. Something went wrong. */
-            throw std::runtime_error("Unexpected error finding " + std::to_string(i) + "-th 1.");
+        /**
+         * @brief Whether select0 uses a sampled index.
+         * 
+         * @return true if the zero index was built or loaded
+         */
+        bool hasZeroIndex() const noexcept {
+            return zeros_.has_value();
         }
 
         /**
-         * @brief Returns the overhead in bits of RankSelect.
+         * @brief Returns the overhead in bits of SelectSupport.
          * 
          * @return uint64_t number of bits
          */
         uint64_t overhead() const noexcept {
-            return 0;
+            return ones_.overhead() + (zeros_ ? zeros_->overhead() : 0);
         }
 
         /**
-         * @brief Loads SelectSupport data to `fname`. Must be in format from `save`.
+         * @brief Loads SelectSupport data from `fname`. Must be in format from `save`.
          * @see save
+         * @throws std::ios_base::failure If the file cannot be opened.
+         * @throws std::domain_error If the file is not a SelectSupport file.
          * 
          * @param fname input filename
          */
         void load(std::string const& fname) {
-            (void)(fname);  /* suppress -Wunused-parameter */
+            serial::FileReader inputStream(fname);
+
+            /* meta data */
+            uint32_t magicTmp;
+            serial::deserialize(magicTmp, inputStream);
+            if (magicTmp != FILE_MAGIC) {
+                inputStream.close();
+                throw std::domain_error("Invalid file magic for file \"" + fname + "\".");
+            }
+
+            /* read indices */
+            serial::deserialize(ones_, inputStream);
+
+            uint8_t hasZeros;
+            serial::deserialize(hasZeros, inputStream);
+            zeros_.reset();
+            if (hasZeros) {
+                serial::deserialize(zeros_.emplace(), inputStream);
+            }
+            builtVersion_ = rank_.get().bitvector().version();
+
+            /* cleanup */
+            inputStream.close();
         }
 
         /**
          * @brief Saves SelectSupport data to `fname`.
          * @see load
+         * @throws std::ios_base::failure If the file cannot be opened.
          * 
          * @param fname output filename
          */
         void save(std::string const& fname) const {
-            (void)(fname);  /* suppress -Wunused-parameter */
+            serial::FileWriter outputStream(fname);
+
+            /* write meta data */
+            const uint32_t magicTmp = FILE_MAGIC;
+            serial::serialize(magicTmp, outputStream);
+
+            /* write indices */
+            serial::serialize(ones_, outputStream);
+
+            const uint8_t hasZeros = zeros_.has_value();
+            serial::serialize(hasZeros, outputStream);
+            if (zeros_) {
+                serial::serialize(*zeros_, outputStream);
+            }
+
+            /* cleanup */
+            outputStream.close();
         }
     
     private:
-        std::reference_wrapper<const RankSupport> rank_;
+        std::reference_wrapper<const Rank> rank_;
+        SelectIndex ones_;
+        std::optional<SelectIndex> zeros_;
+        uint64_t builtVersion_ = 0;
+
+        /**
+         * @brief select0 without a zero index. Zeros before superblock s are s*superblockSize - superblocks[s] and
+         * zeros before a block within it are similar, so both levels can be binary searched on rank's tables.
+         * Other Rank types don't expose tables, so it binary searches for the first index with i zeros up to it.
+         * 
+         * @param i number of zeros, in [1, totalZeros]
+         * @return uint64_t index of i-th 0
+         */
+        uint64_t select0ByRank(uint64_t i) const {
+            auto const& rank = rank_.get();
+            if constexpr (!std::same_as<Rank, RankSupport>) {
+                uint64_t lower = 0, upper = rank.size() - 1;
+                while (lower < upper) {
+                    instrument::count(instrument::SELECT_SEARCH_STEPS);
+                    const uint64_t mid = lower + (upper - lower) / 2;
+                    if (rank.rank0(mid) < i) {
+                        lower = mid + 1;
+                    } else {
+                        upper = mid;
+                    }
+                }
+                return lower;
+            } else {
+                const uint64_t superblockSize = rank.superblockSize_, blockSize = rank.blockSize_;
+
+                /* last superblock with fewer than i zeros before it */
+                uint64_t lower = 0, upper = rank.superblocks_.size();
+                while (upper - lower > 1) {
+                    instrument::count(instrument::SELECT_SEARCH_STEPS);
+                    const uint64_t mid = lower + (upper - lower) / 2;
+                    if (mid * superblockSize - rank.superblocks_[mid] < i) {
+                        lower = mid;
+                    } else {
+                        upper = mid;
+                    }
+                }
+                const uint64_t superblockStart = lower * superblockSize;
+                const uint64_t superblockZeros = superblockStart - rank.superblocks_[lower];
+
+                /* last block in that superblock with fewer than i zeros before it */
+                auto zerosBeforeBlock = [&](uint64_t block) {
+                    return superblockZeros + (block * blockSize - superblockStart) - rank.blockOnes(block);
+                };
+                const uint64_t blocksPerSuperblock = superblockSize / blockSize;
+                lower = superblockStart / blockSize;
+                upper = std::min(lower + blocksPerSuperblock, rank.blocks_.size());
+                while (upper - lower > 1) {
+                    instrument::count(instrument::SELECT_SEARCH_STEPS);
+                    const uint64_t mid = lower + (upper - lower) / 2;
+                    if (zerosBeforeBlock(mid) < i) {
+                        lower = mid;
+                    } else {
+                        upper = mid;
+                    }
+                }
+
+                return SelectIndex::scan(rank.bitvector().words(), lower * blockSize, 
+                                         i - 1 - zerosBeforeBlock(lower), ~0ull);
+            }
+        }
 };
 
+static_assert(BitAccess<BitVector> && std::ranges::forward_range<OnesRange>);
+static_assert(BitVectorRankable<RankSupport> && BitVectorRankable<RankSupportInterleaved>);
+static_assert(BitAccess<RankSupportInterleaved>);
+static_assert(Selectable<SelectSupport<RankSupport>> && Selectable<SelectSupport<RankSupportInterleaved>>);
+
 }   // end namespace bitvector
\ No newline at end of file
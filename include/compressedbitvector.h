@@ -0,0 +1,521 @@
+/*  Implementation of an RRR compressed bit vector with rank and select.
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// local includes
+#include "bitvector.h"
+#include "utilities.h"
+
+namespace bitvector {
+
+/**
+ * @brief CompressedBitVector. An immutable, RRR-compressed copy of a BitVector that answers access, rank, and select
+ * itself, so it can stand in for a BitVector + RankSupport + SelectSupport.
+ *
+ * The bits are cut into blocks of BLOCK_BITS. Each block is stored as its class (number of ones) in a fixed 6 bits
+ * and its offset (index among all blocks of that class, in the combinatorial number system) in the fewest bits that
+ * hold every offset of its class, ceil(log_2(BLOCK_BITS choose class)). Runs of zeros or ones thus cost 6 bits per
+ * block, and a bitvector with density p takes about n*H(p) + 6n/63 bits. Every SAMPLE_BLOCKS blocks the rank and
+ * offset position are sampled, so a query sums at most SAMPLE_BLOCKS classes and decodes one block, both bounded by
+ * constants. select1 additionally samples which rank sample every SELECT_SAMPLE-th one falls in, to narrow its
+ * binary search over the rank samples.
+ */
+class CompressedBitVector {
+    public:
+        /**
+         * @brief bits per RRR block. 63 is the largest size whose offsets fit in a 64-bit word.
+         */
+        constexpr static uint32_t BLOCK_BITS = 63;
+
+        /**
+         * @brief blocks between rank and offset samples
+         */
+        constexpr static uint64_t SAMPLE_BLOCKS = 32;
+
+        /**
+         * @brief ones between select hints
+         */
+        constexpr static uint64_t SELECT_SAMPLE = 4096;
+
+        /**
+         * @brief Construct an empty CompressedBitVector, e.g. to deserialize into.
+         */
+        CompressedBitVector() : CompressedBitVector(BitVector(0)) {}
+
+        /**
+         * @brief Compresses `bitvector`. The result does not refer to it.
+         *
+         * @param bitvector bits to compress
+         */
+        explicit CompressedBitVector(BitVector const& bitvector) : size_(bitvector.size()), totalOnes_(0),
+            classes_(utility::roundDivisionUp(bitvector.size(), BLOCK_BITS), CLASS_BITS), offsets_(0),
+            rankSamples_(0, 1), offsetSamples_(0, 1), selectHints_(0, 1) {
+            uint64_t const* words = bitvector.words();
+            const uint64_t numBlocks = classes_.size();
+
+            /* (1) classes, and how many bits the offsets need */
+            uint64_t offsetBits = 0;
+            for (uint64_t block = 0; block < numBlocks; block += 1) {
+                const uint32_t blockClass = utility::popcountBits(words, block * BLOCK_BITS, this->blockLength(block));
+                classes_.set(block, blockClass);
+                totalOnes_ += blockClass;
+                offsetBits += OFFSET_BITS[blockClass];
+            }
+
+            /* (2) offsets and samples */
+            const uint64_t numSamples = utility::roundDivisionUp(numBlocks, SAMPLE_BLOCKS);
+            offsets_ = BitVector(offsetBits);
+            rankSamples_ = PackedVector(numSamples, std::max<uint32_t>(1, std::bit_width(size_)));
+            offsetSamples_ = PackedVector(numSamples, std::max<uint32_t>(1, std::bit_width(offsetBits)));
+            selectHints_ = PackedVector(utility::roundDivisionUp(totalOnes_, SELECT_SAMPLE),
+                std::max<uint32_t>(1, std::bit_width(numSamples)));
+
+            uint64_t *offsetWords = offsets_.words();
+            uint64_t ones = 0, position = 0;
+            for (uint64_t block = 0; block < numBlocks; block += 1) {
+                const uint64_t sample = block / SAMPLE_BLOCKS;
+                if (block % SAMPLE_BLOCKS == 0) {
+                    rankSamples_.set(sample, ones);
+                    offsetSamples_.set(sample, position);
+                }
+
+                const uint32_t blockClass = classes_[block];
+                const uint64_t bits = utility::readBits(words, block * BLOCK_BITS, this->blockLength(block));
+                utility::orBits(offsetWords, position, OFFSET_BITS[blockClass], encode(bits));
+
+                /* hints for every multiple of SELECT_SAMPLE in [ones, ones + blockClass) */
+                for (uint64_t hint = utility::roundDivisionUp(ones, SELECT_SAMPLE);
+                    hint * SELECT_SAMPLE < ones + blockClass; hint += 1) {
+                    selectHints_.set(hint, sample);
+                }
+
+                ones += blockClass;
+                position += OFFSET_BITS[blockClass];
+            }
+        }
+
+        CompressedBitVector(CompressedBitVector&&) = default;
+        CompressedBitVector& operator=(CompressedBitVector&&) = default;
+
+        /**
+         * @brief Cursor for OnesIterator that decodes one block at a time, tracking where each block's offset starts.
+         */
+        struct BlockCursor {
+            CompressedBitVector const* bits;
+            uint64_t block, end, offsetPosition;
+
+            bool done() const noexcept {
+                return block == end;
+            }
+
+            uint64_t position() const noexcept {
+                return block * BLOCK_BITS;
+            }
+
+            uint64_t next() noexcept {
+                auto [blockClass, offset] = bits->readBlock(block, offsetPosition);
+                offsetPosition += OFFSET_BITS[blockClass];
+                block += 1;
+                return (blockClass == 0) ? 0 : decode(blockClass, offset);
+            }
+        };
+
+        /**
+         * @brief Get the bit at `index`. Does not do bounds checking.
+         *
+         * @param index bit index
+         * @return bool the bit at `index`
+         */
+        bool operator[](uint64_t index) const noexcept {
+            const uint64_t block = index / BLOCK_BITS;
+            const uint32_t blockClass = classes_[block];
+            if (blockClass == 0 || blockClass == BLOCK_BITS) {
+                return blockClass != 0;
+            }
+            auto [remaining, offset] = this->readBlock(block, this->walkTo(block).second);
+            return (decode(remaining, offset, index % BLOCK_BITS) >> (index % BLOCK_BITS)) & 1;
+        }
+
+        /**
+         * @brief The positions of the set bits, in increasing order. Blocks are decoded in sequence, so a full scan
+         * costs one decode per non-empty block instead of a select per one.
+         * @see OnesIterator
+         *
+         * @return range over the set positions
+         */
+        std::ranges::subrange<OnesIterator<BlockCursor>, std::default_sentinel_t> ones() const noexcept {
+            return {OnesIterator<BlockCursor>(BlockCursor{this, 0, classes_.size(), 0}), std::default_sentinel};
+        }
+
+        /**
+         * @brief Get the bit at `index`.
+         * @throws std::out_of_range If index >= size().
+         *
+         * @param index bit index
+         * @return bool the bit at `index`
+         */
+        bool at(uint64_t index) const {
+            this->checkBounds(index, "at");
+            return (*this)[index];
+        }
+
+        /**
+         * @brief The number of 1 bits in range 0...i.
+         * @see rank1
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         *
+         * @param i
+         * @return uint64_t
+         */
+        uint64_t operator()(uint64_t i) const {
+            return rank1(i);
+        }
+
+        /**
+         * @brief The number of 1 bits in range 0...i.
+         * @see RankSupport::rank1
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         *
+         * @param i
+         * @return uint64_t
+         */
+        uint64_t rank1(uint64_t i) const {
+            this->checkBounds(i, "rank1");
+
+            const uint64_t block = i / BLOCK_BITS;
+            const auto [ones, position] = this->walkTo(block);
+            /* only the bits above i are decoded; what's left of the class is the ones at or below it */
+            auto [remaining, offset] = this->readBlock(block, position);
+            decode(remaining, offset, (i % BLOCK_BITS) + 1);
+            return ones + remaining;
+        }
+
+        /**
+         * @brief rank1(i) and bit i together, from one walk and one partial decode of i's block.
+         * @see RankSupport::rank1WithBit
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         *
+         * @param i
+         * @return std::pair<uint64_t, bool> (number of 1 bits in range 0...i, bit i)
+         */
+        std::pair<uint64_t, bool> rank1WithBit(uint64_t i) const {
+            this->checkBounds(i, "rank1WithBit");
+
+            const uint64_t block = i / BLOCK_BITS;
+            const auto [ones, position] = this->walkTo(block);
+            /* decoding down to i itself leaves the ones below i, and bit i is the lowest decoded bit */
+            auto [remaining, offset] = this->readBlock(block, position);
+            const bool bit = (decode(remaining, offset, i % BLOCK_BITS) >> (i % BLOCK_BITS)) & 1;
+            return {ones + remaining + bit, bit};
+        }
+
+        /**
+         * @brief The number of 0 bits in range 0...i.
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         *
+         * @param i
+         * @return uint64_t
+         */
+        uint64_t rank0(uint64_t i) const {
+            return (i + 1) - rank1(i);
+        }
+
+        /**
+         * @brief The location of the i-th 1 in the bitvector.
+         * @see SelectSupport::select1
+         * @throws std::invalid_argument If i is greater than the total number of ones or is zero.
+         *
+         * @param i number of ones
+         * @return uint64_t index of i-th 1
+         */
+        uint64_t select1(uint64_t i) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (i > totalOnes_) {
+                    throw std::invalid_argument("CompressedBitVector::select1 - Cannot select " + std::to_string(i) +
+                        "-th 1 in bitvector with " + std::to_string(totalOnes_) + " 1s.");
+                }
+                if (i == 0) {
+                    throw std::invalid_argument("CompressedBitVector::select1 - 0-th 1 is not defined. "
+                        "Use 1-indexing.");
+                }
+            }
+
+            const uint64_t k = i - 1, hint = k / SELECT_SAMPLE;
+            const uint64_t lower = selectHints_[hint];
+            const uint64_t upper = (hint + 1 < selectHints_.size()) ? selectHints_[hint + 1] : rankSamples_.size() - 1;
+            return this->selectFrom(k, lower, upper, true);
+        }
+
+        /**
+         * @brief The location of the i-th 0 in the bitvector. Binary searches all of the rank samples.
+         * @throws std::invalid_argument If i is greater than the total number of zeros or is zero.
+         *
+         * @param i number of zeros
+         * @return uint64_t index of i-th 0
+         */
+        uint64_t select0(uint64_t i) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (i > this->totalZeros()) {
+                    throw std::invalid_argument("CompressedBitVector::select0 - Cannot select " + std::to_string(i) +
+                        "-th 0 in bitvector with " + std::to_string(this->totalZeros()) + " 0s.");
+                }
+                if (i == 0) {
+                    throw std::invalid_argument("CompressedBitVector::select0 - 0-th 0 is not defined. "
+                        "Use 1-indexing.");
+                }
+            }
+            return this->selectFrom(i - 1, 0, rankSamples_.size() - 1, false);
+        }
+
+        /**
+         * @return uint64_t The number of bits in the bitvector.
+         */
+        uint64_t size() const noexcept {
+            return size_;
+        }
+
+        /**
+         * @return uint64_t The number of 1 bits in the bitvector.
+         */
+        uint64_t totalOnes() const noexcept {
+            return totalOnes_;
+        }
+
+        /**
+         * @return uint64_t The number of 0 bits in the bitvector.
+         */
+        uint64_t totalZeros() const noexcept {
+            return size_ - totalOnes_;
+        }
+
+        /**
+         * @brief Return the total size in bits, including the rank and select samples. Unlike RankSupport this counts
+         * the bits themselves too, since there is no separate BitVector.
+         *
+         * @return uint64_t bits used
+         */
+        uint64_t overhead() const noexcept {
+            return classes_.overhead() + offsets_.size() + rankSamples_.overhead() + offsetSamples_.overhead() +
+                selectHints_.overhead();
+        }
+
+        /**
+         * @brief Serialize into output stream using serial::serialize
+         *
+         * @param out destination of data
+         */
+        void serialize(std::ostream& out) const {
+            serial::serialize(size_, out);
+            serial::serialize(totalOnes_, out);
+            serial::serialize(classes_, out);
+            serial::serialize(offsets_, out);
+            serial::serialize(rankSamples_, out);
+            serial::serialize(offsetSamples_, out);
+            serial::serialize(selectHints_, out);
+        }
+
+        /**
+         * @brief Deserialize from inputstream using serial::deserialize. Will reallocate.
+         *
+         * @param in source of data
+         */
+        void deserialize(std::istream& in) {
+            serial::deserialize(size_, in);
+            serial::deserialize(totalOnes_, in);
+            serial::deserialize(classes_, in);
+            serial::deserialize(offsets_, in);
+            serial::deserialize(rankSamples_, in);
+            serial::deserialize(offsetSamples_, in);
+            serial::deserialize(selectHints_, in);
+        }
+
+        /**
+         * @brief Views data written by `serialize` in a mapped file instead of copying it.
+         * @see BitVector::map
+         *
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader) {
+            size_ = reader.read<uint64_t>();
+            totalOnes_ = reader.read<uint64_t>();
+            classes_.map(reader);
+            offsets_.map(reader);
+            rankSamples_.map(reader);
+            offsetSamples_.map(reader);
+            selectHints_.map(reader);
+        }
+
+    private:
+        /**
+         * @brief bits to store a class in [0, BLOCK_BITS]
+         */
+        constexpr static uint32_t CLASS_BITS = std::bit_width(BLOCK_BITS);
+
+        /**
+         * @brief BINOMIALS[n][k] = n choose k, for n, k <= BLOCK_BITS. 0 when k > n.
+         */
+        constexpr static auto BINOMIALS = [] {
+            std::array<std::array<uint64_t, BLOCK_BITS + 1>, BLOCK_BITS + 1> table {};
+            for (uint32_t n = 0; n <= BLOCK_BITS; n += 1) {
+                table[n][0] = 1;
+                for (uint32_t k = 1; k <= n; k += 1) {
+                    table[n][k] = table[n - 1][k - 1] + table[n - 1][k];
+                }
+            }
+            return table;
+        }();
+
+        /**
+         * @brief OFFSET_BITS[c] = bits to store an offset of class c, i.e. of any of the (BLOCK_BITS choose c) blocks
+         */
+        constexpr static auto OFFSET_BITS = [] {
+            std::array<uint32_t, BLOCK_BITS + 1> table {};
+            for (uint32_t c = 0; c <= BLOCK_BITS; c += 1) {
+                table[c] = std::bit_width(BINOMIALS[BLOCK_BITS][c] - 1);
+            }
+            return table;
+        }();
+
+        uint64_t size_, totalOnes_;
+        PackedVector classes_;
+        BitVector offsets_;
+        PackedVector rankSamples_, offsetSamples_;  /* ones and offset bits before every SAMPLE_BLOCKS-th block */
+        PackedVector selectHints_;                  /* rank sample containing every SELECT_SAMPLE-th one */
+
+        /**
+         * @brief Length of `block`; only the last block can be shorter than BLOCK_BITS.
+         */
+        uint32_t blockLength(uint64_t block) const noexcept {
+            return std::min<uint64_t>(BLOCK_BITS, size_ - block * BLOCK_BITS);
+        }
+
+        /**
+         * @brief Offset of a block with set bits p_1 < p_2 < ... < p_c: sum of (p_j choose j). This ranks the block
+         * among all blocks of class c, from 0 for the c lowest bits set to (BLOCK_BITS choose c) - 1.
+         */
+        static uint64_t encode(uint64_t bits) noexcept {
+            uint64_t offset = 0;
+            for (uint32_t j = 1; bits != 0; j += 1, bits &= bits - 1) {
+                offset += BINOMIALS[std::countr_zero(bits)][j];
+            }
+            return offset;
+        }
+
+        /**
+         * @brief Inverse of encode, from the top bit down: the highest p with (p choose c) <= offset is the top set
+         * bit, and the rest is the offset of a class c-1 block below p. Stops without looking at bits below `low`,
+         * leaving `blockClass` as the number of ones below it and `offset` as their offset.
+         *
+         * @return uint64_t the set bits at positions >= low
+         */
+        static uint64_t decode(uint32_t &blockClass, uint64_t &offset, uint32_t low = 0) noexcept {
+            if (blockClass == BLOCK_BITS) {
+                blockClass = low;
+                return ((1ull << BLOCK_BITS) - 1) & (~0ull << low);
+            }
+            uint64_t bits = 0;
+            for (uint32_t p = BLOCK_BITS; p > low && blockClass > 0; ) {
+                p -= 1;
+                const uint64_t binomial = BINOMIALS[p][blockClass];
+                if (binomial <= offset) {
+                    bits |= 1ull << p;
+                    offset -= binomial;
+                    blockClass -= 1;
+                }
+            }
+            return bits;
+        }
+
+        /**
+         * @brief Class and offset of `block`, whose offset starts at bit `position` of offsets_.
+         */
+        std::pair<uint32_t, uint64_t> readBlock(uint64_t block, uint64_t position) const noexcept {
+            const uint32_t blockClass = classes_[block];
+            const uint32_t width = OFFSET_BITS[blockClass];
+            return {blockClass, (width == 0) ? 0 : utility::readBits(offsets_.words(), position, width)};
+        }
+
+        /**
+         * @brief Ones before `block` and where its offset starts, from the nearest sample and at most SAMPLE_BLOCKS
+         * classes.
+         *
+         * @return std::pair<uint64_t, uint64_t> (rank, offset position)
+         */
+        std::pair<uint64_t, uint64_t> walkTo(uint64_t block) const noexcept {
+            const uint64_t sample = block / SAMPLE_BLOCKS;
+            uint64_t ones = rankSamples_[sample], position = offsetSamples_[sample];
+            for (uint64_t b = sample * SAMPLE_BLOCKS; b < block; b += 1) {
+                const uint32_t blockClass = classes_[b];
+                ones += blockClass;
+                position += OFFSET_BITS[blockClass];
+            }
+            return {ones, position};
+        }
+
+        /**
+         * @brief Position of the (k+1)-th one (or zero) given that it lies in rank samples [lower, upper]: binary
+         * searches the samples, walks the classes of one sample, and selects within the decoded block.
+         */
+        uint64_t selectFrom(uint64_t k, uint64_t lower, uint64_t upper, bool bit) const noexcept {
+            auto countBefore = [this, bit](uint64_t sample) {
+                const uint64_t ones = rankSamples_[sample];
+                return bit ? ones : sample * SAMPLE_BLOCKS * BLOCK_BITS - ones;
+            };
+
+            /* last sample with at most k matching bits before it */
+            while (lower < upper) {
+                const uint64_t mid = lower + (upper - lower + 1) / 2;
+                if (countBefore(mid) <= k) {
+                    lower = mid;
+                } else {
+                    upper = mid - 1;
+                }
+            }
+
+            uint64_t block = lower * SAMPLE_BLOCKS, count = countBefore(lower), position = offsetSamples_[lower];
+            for (;; block += 1) {
+                const uint32_t blockClass = classes_[block];
+                const uint32_t matching = bit ? blockClass : this->blockLength(block) - blockClass;
+                if (count + matching > k) {
+                    break;
+                }
+                count += matching;
+                position += OFFSET_BITS[blockClass];
+            }
+
+            auto [blockClass, offset] = this->readBlock(block, position);
+            uint64_t bits = decode(blockClass, offset);
+            if (!bit) {
+                bits = ~bits & ((1ull << this->blockLength(block)) - 1);
+            }
+            return block * BLOCK_BITS + utility::selectInWord(bits, k - count);
+        }
+
+        inline void checkBounds(uint64_t index, char const* function) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (index >= size_) {
+                    throw std::out_of_range("CompressedBitVector::" + std::string(function) + " - " +
+                        std::to_string(index) + "-th bit is out of bounds for bitvector of size " +
+                        std::to_string(size_) + ".");
+                }
+            }
+        }
+};
+
+static_assert(RankSelectable<CompressedBitVector> && BitAccess<CompressedBitVector>);
+
+}   // end namespace bitvector
@@ -0,0 +1,307 @@
+/*  Implementation of a SparseArray that serves lock-free readers while it is updated
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// local includes
+#include "sparsearray.h"
+#include "utilities.h"
+
+namespace sparse {
+
+/**
+ * @brief A SparseArray that many threads can query while one or more threads append to it. Readers only ever see an
+ * immutable, published SparseArray (a snapshot), so they need no lock; writers stage appends and `publish` builds
+ * the next snapshot from the current one and swaps it in atomically.
+ *
+ * Snapshots are reference counted: one that was swapped out stays valid until the last reader holding it lets go,
+ * and is freed then (read-copy-update, with shared_ptr doing the reclamation). Appends are staged under a writer
+ * mutex that readers never touch.
+ *
+ * For the lowest query latency, give each query thread a Reader. A Reader keeps its own reference to the snapshot
+ * and only reloads it when the published version changes, so a lookup costs one atomic load that every reader
+ * shares read-only, plus the SparseArray lookup itself. `snapshot()` and the lookups on this class load the shared
+ * pointer on every call, which writes its reference count.
+ *
+ * @tparam T type to store within array
+ * @tparam Positions how each snapshot stores its set positions. See PositionsBackend.
+ */
+template <typename T, PositionsBackend Positions = BitVectorPositions>
+class ConcurrentSparseArray {
+    public:
+        using Array = SparseArray<T, Positions>;
+        using Snapshot = std::shared_ptr<const Array>;
+
+        /**
+         * @brief Lookups for one thread against the latest published snapshot. Refreshes its snapshot only when a
+         * new one was published, and keeps the one it has alive until then. Not thread safe itself; make one per
+         * thread.
+         */
+        class Reader {
+            public:
+                explicit Reader(ConcurrentSparseArray const& owner) : owner_(&owner),
+                    version_(owner.version_.load(std::memory_order_acquire)), snapshot_(owner.snapshot()) {}
+
+                /**
+                 * @brief The latest published snapshot. Reloads it if a newer one was published since the last call.
+                 *
+                 * @return Array const& snapshot, valid until the next call on this Reader
+                 */
+                Array const& current() {
+                    const uint64_t published = owner_->version_.load(std::memory_order_acquire);
+                    if (published != version_) {
+                        snapshot_ = owner_->snapshot();
+                        version_ = published;
+                    }
+                    return *snapshot_;
+                }
+
+                /**
+                 * @brief Looks up the element at `index` in the latest snapshot.
+                 * @see SparseArray::find
+                 * @throws std::out_of_range if index is out of bounds.
+                 *
+                 * @return T const* the value at `index`, or nullptr. Valid until the next call on this Reader.
+                 */
+                T const* find(uint64_t index) {
+                    return this->current().find(index);
+                }
+
+                /**
+                 * @brief Copies the element at `index` in the latest snapshot into `element`, if there is one.
+                 * @throws std::out_of_range if index is out of bounds.
+                 *
+                 * @return true if value was present
+                 */
+                bool getAtIndex(uint64_t index, T &element) {
+                    if (T const* value = this->find(index)) {
+                        element = *value;
+                        return true;
+                    }
+                    return false;
+                }
+
+                /**
+                 * @brief Number of elements up to `index` in the latest snapshot.
+                 * @throws std::out_of_range if index is out of bounds.
+                 */
+                uint64_t numElemAt(uint64_t index) {
+                    return this->current().numElemAt(index);
+                }
+
+                /**
+                 * @return uint64_t version of the snapshot the last call read
+                 */
+                uint64_t version() const noexcept {
+                    return version_;
+                }
+
+            private:
+                ConcurrentSparseArray const* owner_;
+                uint64_t version_;
+                Snapshot snapshot_;
+        };
+
+        /**
+         * @brief An empty array of size 0. Call `create` to give it a size.
+         */
+        ConcurrentSparseArray() : ConcurrentSparseArray(Array()) {}
+
+        /**
+         * @brief Publishes `initial` as the first snapshot, e.g. an array built with fromSorted or loaded from a file.
+         * Finds where appending may resume with one scan of it.
+         *
+         * @param initial first snapshot
+         */
+        explicit ConcurrentSparseArray(Array&& initial) {
+            this->replace(std::move(initial));
+        }
+
+        ConcurrentSparseArray(ConcurrentSparseArray const&) = delete;
+        ConcurrentSparseArray& operator=(ConcurrentSparseArray const&) = delete;
+
+        /**
+         * @brief Discards staged appends and publishes an empty array of `size`.
+         *
+         * @param size size of the new array
+         */
+        void create(uint64_t size) {
+            Array empty;
+            empty.create(size);
+            this->replace(std::move(empty));
+        }
+
+        /**
+         * @brief Discards staged appends and publishes `next` as is.
+         *
+         * @param next the new snapshot
+         * @return uint64_t its version
+         */
+        uint64_t replace(Array&& next) {
+            next.finalize();
+            uint64_t endPosition = 0;
+            for (auto const& [pos, value] : next) {
+                endPosition = pos + 1;
+            }
+
+            std::lock_guard<std::mutex> lock(writerMutex_);
+            staged_.clear();
+            endPosition_ = endPosition;
+            return this->publishLocked(std::make_shared<const Array>(std::move(next)));
+        }
+
+        /**
+         * @brief Stages `elem` at `pos`. Readers don't see it until the next `publish`. Positions must increase
+         * across every append since the array was created, as with SparseArray::append.
+         * @throws std::out_of_range if the position is out of bounds.
+         * @throws std::invalid_argument if the position is at or before the last appended position.
+         *
+         * @param elem element to append
+         * @param pos where to insert it
+         */
+        void append(T const& elem, uint64_t pos) {
+            std::lock_guard<std::mutex> lock(writerMutex_);
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (pos >= size_) {
+                    throw std::out_of_range("ConcurrentSparseArray::append -- position " + std::to_string(pos) +
+                        " is out of bounds.");
+                }
+                if (pos < endPosition_) {
+                    throw std::invalid_argument("ConcurrentSparseArray::append -- position " + std::to_string(pos) +
+                        " is at or before the last appended position " + std::to_string(endPosition_ - 1) + ".");
+                }
+            }
+            staged_.emplace_back(pos, elem);
+            endPosition_ = pos + 1;
+        }
+
+        /**
+         * @brief Builds the next snapshot from the current one and the staged appends, then publishes it. The build
+         * is one pass over the current pairs (SparseArray::fromSorted), O(n + staged), so batch appends between
+         * publishes. Readers keep using the old snapshot until it is swapped in. Does nothing if nothing is staged.
+         *
+         * @return uint64_t version of the published snapshot
+         */
+        uint64_t publish() {
+            std::lock_guard<std::mutex> lock(writerMutex_);
+            Snapshot current = this->snapshot();
+            if (staged_.empty()) {
+                return version_.load(std::memory_order_relaxed);
+            }
+
+            std::vector<std::pair<uint64_t, T>> pairs;
+            pairs.reserve(current->numElem() + staged_.size());
+            for (auto const& [pos, value] : *current) {
+                pairs.emplace_back(pos, value);
+            }
+            pairs.insert(pairs.end(), std::make_move_iterator(staged_.begin()), std::make_move_iterator(staged_.end()));
+            staged_.clear();
+
+            auto next = std::make_shared<Array>(Array::fromSorted(current->size(), pairs.cbegin(), pairs.cend()));
+            next->finalize();
+            return this->publishLocked(std::move(next));
+        }
+
+        /**
+         * @brief The latest published snapshot. Holding it keeps it alive and unchanged.
+         *
+         * @return Snapshot shared, immutable snapshot
+         */
+        Snapshot snapshot() const {
+            return current_.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief A Reader for the calling thread.
+         */
+        Reader reader() const {
+            return Reader(*this);
+        }
+
+        /**
+         * @brief Looks up the element at `index` in the latest snapshot and copies it into `element`.
+         * @see Reader::getAtIndex
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @return true if value was present
+         */
+        bool getAtIndex(uint64_t index, T &element) const {
+            const Snapshot current = this->snapshot();
+            if (T const* value = current->find(index)) {
+                element = *value;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Number of elements up to `index` in the latest snapshot.
+         * @throws std::out_of_range if index is out of bounds.
+         */
+        uint64_t numElemAt(uint64_t index) const {
+            return this->snapshot()->numElemAt(index);
+        }
+
+        /**
+         * @return uint64_t number of elements in the latest snapshot, not counting staged appends
+         */
+        uint64_t numElem() const {
+            return this->snapshot()->numElem();
+        }
+
+        /**
+         * @return uint64_t size of the array
+         */
+        uint64_t size() const {
+            return this->snapshot()->size();
+        }
+
+        /**
+         * @return uint64_t number of appends waiting for `publish`
+         */
+        uint64_t numStaged() const {
+            std::lock_guard<std::mutex> lock(writerMutex_);
+            return staged_.size();
+        }
+
+        /**
+         * @brief Bumped by every publish. Readers compare it to know when to reload.
+         *
+         * @return uint64_t version of the latest snapshot
+         */
+        uint64_t version() const noexcept {
+            return version_.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<Snapshot> current_;
+        /* readers poll this instead of current_, whose loads write its reference count */
+        std::atomic<uint64_t> version_ = 0;
+
+        mutable std::mutex writerMutex_;
+        std::vector<std::pair<uint64_t, T>> staged_;
+        uint64_t size_ = 0;
+        uint64_t endPosition_ = 0;
+
+        /**
+         * @brief Swaps in `next`, then bumps the version so Readers reload. Called with writerMutex_ held.
+         */
+        uint64_t publishLocked(Snapshot next) {
+            size_ = next->size();
+            current_.store(std::move(next), std::memory_order_release);
+            return version_.fetch_add(1, std::memory_order_acq_rel) + 1;
+        }
+};
+
+} // end namespace sparse
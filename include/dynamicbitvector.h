@@ -0,0 +1,721 @@
+/*  Implementation of a bitvector that supports inserts and deletes with rank and select
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// local includes
+#include "bitvector.h"
+#include "utilities.h"
+
+namespace bitvector {
+
+/**
+ * @brief A bitvector that bits can be inserted into and erased from anywhere, with rank and select kept up to date.
+ * The bits are packed into leaves of LEAF_WORDS words, and the leaves hang off a B-tree whose nodes store the number
+ * of bits and ones under each child. Access, set, insert, erase, rank and select all descend the tree once, so they
+ * are O(log n) (with a popcount or word shift of at most one leaf at the bottom), where RankSupport would need an
+ * O(n) `buildTables` after every change.
+ *
+ * Leaves split when an insert finds them full and merge with or borrow from a neighbor when they fall under a quarter
+ * full, and inner nodes do the same with their children, so every level but the root stays at least a quarter full
+ * and the height stays logarithmic. Built from a BitVector, leaves and nodes start three quarters full so both inserts
+ * and erases have room.
+ */
+class DynamicBitVector {
+    /**
+     * @brief words per leaf: 2048 bits, 4 cache lines
+     */
+    constexpr static uint32_t LEAF_WORDS = 32;
+    constexpr static uint32_t LEAF_BITS = LEAF_WORDS * 64;
+    constexpr static uint32_t MIN_LEAF_BITS = LEAF_BITS / 4;
+    constexpr static uint32_t FILL_LEAF_BITS = LEAF_BITS * 3 / 4;
+
+    /**
+     * @brief children per inner node
+     */
+    constexpr static uint32_t MAX_CHILDREN = 16;
+    constexpr static uint32_t MIN_CHILDREN = MAX_CHILDREN / 4;
+    constexpr static uint32_t FILL_CHILDREN = MAX_CHILDREN * 3 / 4;
+
+    struct Leaf {
+        /* bits at and past `size` are always zero */
+        std::array<uint64_t, LEAF_WORDS> words {};
+        uint32_t size = 0;
+    };
+
+    /**
+     * @brief An inner node. Nodes one level above the leaves use `leaves`, all others `inner`; sizes[k] and ones[k]
+     * count the bits and ones under child k.
+     */
+    struct Inner {
+        uint32_t count = 0;
+        std::array<uint64_t, MAX_CHILDREN> sizes {}, ones {};
+        std::array<std::unique_ptr<Inner>, MAX_CHILDREN> inner;
+        std::array<std::unique_ptr<Leaf>, MAX_CHILDREN> leaves;
+    };
+
+    public:
+        /**
+         * @brief An empty bitvector.
+         */
+        DynamicBitVector() : root_(std::make_unique<Inner>()) {
+            root_->leaves[0] = std::make_unique<Leaf>();
+            root_->count = 1;
+        }
+
+        /**
+         * @brief Copies `bits` into three quarter full leaves and builds the tree over them bottom up, in O(n / 64).
+         *
+         * @param bits bits to start with
+         */
+        explicit DynamicBitVector(BitVector const& bits) : size_(bits.size()) {
+            std::vector<std::unique_ptr<Leaf>> leaves;
+            for (uint64_t start = 0; start < size_ || leaves.empty(); start += FILL_LEAF_BITS) {
+                auto leaf = std::make_unique<Leaf>();
+                leaf->size = std::min<uint64_t>(FILL_LEAF_BITS, size_ - start);
+                copyBits(leaf->words.data(), 0, bits.words(), start, leaf->size);
+                ones_ += countOnes(*leaf);
+                leaves.push_back(std::move(leaf));
+            }
+
+            std::vector<std::unique_ptr<Inner>> level;
+            for (uint64_t first = 0; first < leaves.size(); first += FILL_CHILDREN) {
+                auto node = std::make_unique<Inner>();
+                for (uint64_t k = first; k < std::min<uint64_t>(first + FILL_CHILDREN, leaves.size()); k += 1) {
+                    placeChild(*node, node->count, nullptr, std::move(leaves[k]));
+                }
+                level.push_back(std::move(node));
+            }
+            height_ = 1;
+            while (level.size() > 1) {
+                std::vector<std::unique_ptr<Inner>> parents;
+                for (uint64_t first = 0; first < level.size(); first += FILL_CHILDREN) {
+                    auto node = std::make_unique<Inner>();
+                    for (uint64_t k = first; k < std::min<uint64_t>(first + FILL_CHILDREN, level.size()); k += 1) {
+                        placeChild(*node, node->count, std::move(level[k]), nullptr);
+                    }
+                    parents.push_back(std::move(node));
+                }
+                level = std::move(parents);
+                height_ += 1;
+            }
+            root_ = std::move(level.front());
+        }
+
+        DynamicBitVector(DynamicBitVector&&) noexcept = default;
+        DynamicBitVector& operator=(DynamicBitVector&&) noexcept = default;
+
+        /**
+         * @brief Get the bit at `i`. Does not do bounds checking.
+         *
+         * @param i bit index
+         * @return bool the bit at `i`
+         */
+        bool operator[](uint64_t i) const noexcept {
+            Inner const* node = root_.get();
+            for (uint32_t level = height_; ; level -= 1) {
+                const uint32_t k = childAt(*node, i);
+                if (level == 1) {
+                    return (node->leaves[k]->words[i >> 6] >> (i & 63)) & 1;
+                }
+                node = node->inner[k].get();
+            }
+        }
+
+        /**
+         * @brief Get the bit at `i`.
+         * @throws std::out_of_range If i >= size().
+         *
+         * @param i bit index
+         * @return bool the bit at `i`
+         */
+        bool at(uint64_t i) const {
+            this->checkBounds(i, size_, "at");
+            return (*this)[i];
+        }
+
+        /**
+         * @brief Sets bit `i` to `bit`, updating the counts on the path to it.
+         * @throws std::out_of_range If i >= size().
+         *
+         * @param i bit index
+         * @param bit new value
+         */
+        void set(uint64_t i, bool bit) {
+            this->checkBounds(i, size_, "set");
+            const int64_t delta = setIn(*root_, height_, i, bit);
+            ones_ += delta;
+        }
+
+        /**
+         * @brief Inserts `bit` before bit `i`, shifting bit `i` and all bits after it up by one.
+         * @throws std::out_of_range If i > size().
+         *
+         * @param i where the new bit goes, in [0, size()]
+         * @param bit value of the new bit
+         */
+        void insert(uint64_t i, bool bit) {
+            this->checkBounds(i, size_ + 1, "insert");
+            auto right = insertInto(*root_, height_, i, bit);
+            if (right) {
+                auto root = std::make_unique<Inner>();
+                placeChild(*root, 0, std::move(root_), nullptr);
+                placeChild(*root, 1, std::move(right), nullptr);
+                root_ = std::move(root);
+                height_ += 1;
+            }
+            size_ += 1;
+            ones_ += bit;
+        }
+
+        /**
+         * @brief Appends `bit` after the last bit.
+         *
+         * @param bit value of the new bit
+         */
+        void push_back(bool bit) {
+            this->insert(size_, bit);
+        }
+
+        /**
+         * @brief Removes bit `i`, shifting all bits after it down by one.
+         * @throws std::out_of_range If i >= size().
+         *
+         * @param i bit index
+         * @return bool the erased bit
+         */
+        bool erase(uint64_t i) {
+            this->checkBounds(i, size_, "erase");
+            const bool bit = eraseFrom(*root_, height_, i);
+            while (height_ > 1 && root_->count == 1) {
+                auto child = std::move(root_->inner[0]);
+                root_ = std::move(child);
+                height_ -= 1;
+            }
+            size_ -= 1;
+            ones_ -= bit;
+            return bit;
+        }
+
+        /**
+         * @brief The number of 1 bits in range 0...i.
+         * @see rank1
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         *
+         * @param i
+         * @return uint64_t
+         */
+        uint64_t operator()(uint64_t i) const {
+            return rank1(i);
+        }
+
+        /**
+         * @brief The number of 1 bits in range 0...i. Adds up the ones of the children left of the path to bit i,
+         * then popcounts the leaf up to it.
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         *
+         * @param i
+         * @return uint64_t
+         */
+        uint64_t rank1(uint64_t i) const {
+            this->checkBounds(i, size_, "rank1");
+
+            uint64_t ones = 0;
+            Inner const* node = root_.get();
+            for (uint32_t level = height_; ; level -= 1) {
+                uint32_t k = 0;
+                while (i >= node->sizes[k]) {
+                    i -= node->sizes[k];
+                    ones += node->ones[k];
+                    k += 1;
+                }
+                if (level == 1) {
+                    Leaf const& leaf = *node->leaves[k];
+                    for (uint64_t w = 0; w < (i >> 6); w += 1) {
+                        ones += std::popcount(leaf.words[w]);
+                    }
+                    return ones + std::popcount(leaf.words[i >> 6] & (~0ull >> (63 - (i & 63))));
+                }
+                node = node->inner[k].get();
+            }
+        }
+
+        /**
+         * @brief The number of 0 bits in range 0...i.
+         * @throws std::out_of_range If i is >= the number of bits in the bitvector.
+         *
+         * @param i
+         * @return uint64_t
+         */
+        uint64_t rank0(uint64_t i) const {
+            return (i + 1) - rank1(i);
+        }
+
+        /**
+         * @brief The location of the i-th 1 in the bitvector, found by descending on the ones counts.
+         * @see SelectSupport::select1
+         * @throws std::invalid_argument If i is greater than the total number of ones or is zero.
+         *
+         * @param i number of ones
+         * @return uint64_t index of i-th 1
+         */
+        uint64_t select1(uint64_t i) const {
+            this->checkSelect(i, ones_, "select1");
+            return this->selectFrom(i - 1, true);
+        }
+
+        /**
+         * @brief The location of the i-th 0 in the bitvector.
+         * @see SelectSupport::select0
+         * @throws std::invalid_argument If i is greater than the total number of zeros or is zero.
+         *
+         * @param i number of zeros
+         * @return uint64_t index of i-th 0
+         */
+        uint64_t select0(uint64_t i) const {
+            this->checkSelect(i, this->totalZeros(), "select0");
+            return this->selectFrom(i - 1, false);
+        }
+
+        /**
+         * @return uint64_t The number of bits in the bitvector.
+         */
+        uint64_t size() const noexcept {
+            return size_;
+        }
+
+        /**
+         * @return uint64_t The number of 1 bits in the bitvector.
+         */
+        uint64_t totalOnes() const noexcept {
+            return ones_;
+        }
+
+        /**
+         * @return uint64_t The number of 0 bits in the bitvector.
+         */
+        uint64_t totalZeros() const noexcept {
+            return size_ - ones_;
+        }
+
+        /**
+         * @return uint32_t levels of inner nodes above the leaves
+         */
+        uint32_t height() const noexcept {
+            return height_;
+        }
+
+        /**
+         * @brief Bits used beyond the size of the bitvector: the unused room in the leaves and the inner nodes.
+         *
+         * @return uint64_t overhead in bits
+         */
+        uint64_t overhead() const noexcept {
+            return nodeBits(*root_, height_) - size_;
+        }
+
+        /**
+         * @brief Copies the bits out into a BitVector, a leaf at a time.
+         *
+         * @return BitVector the same bits
+         */
+        BitVector toBitVector() const {
+            BitVector bits(size_);
+            uint64_t offset = 0;
+            copyOut(*root_, height_, bits.words(), offset);
+            return bits;
+        }
+
+    private:
+        std::unique_ptr<Inner> root_;
+        uint32_t height_ = 1;
+        uint64_t size_ = 0;
+        uint64_t ones_ = 0;
+
+        /**
+         * @brief Copies bits [srcStart, srcStart+len) of `src` to bits [dstStart, dstStart+len) of `dst`, 64 at a
+         * time. The ranges must not overlap.
+         */
+        static void copyBits(uint64_t *dst, uint64_t dstStart, uint64_t const* src, uint64_t srcStart,
+            uint64_t len) noexcept {
+            for (uint64_t offset = 0; offset < len; offset += 64) {
+                const uint32_t chunk = std::min<uint64_t>(64, len - offset);
+                utility::writeBits(dst, dstStart + offset, chunk, utility::readBits(src, srcStart + offset, chunk));
+            }
+        }
+
+        static uint64_t countOnes(Leaf const& leaf) noexcept {
+            uint64_t ones = 0;
+            for (uint64_t w = 0; w < utility::roundDivisionUp(leaf.size, 64); w += 1) {
+                ones += std::popcount(leaf.words[w]);
+            }
+            return ones;
+        }
+
+        /**
+         * @brief The child of `node` that bit i lies under. Subtracts the bits of the children before it from i.
+         */
+        static uint32_t childAt(Inner const& node, uint64_t &i) noexcept {
+            uint32_t k = 0;
+            while (i >= node.sizes[k]) {
+                i -= node.sizes[k];
+                k += 1;
+            }
+            return k;
+        }
+
+        /**
+         * @brief Total bits and ones under `node`.
+         */
+        static std::pair<uint64_t, uint64_t> totals(Inner const& node) noexcept {
+            uint64_t size = 0, ones = 0;
+            for (uint32_t k = 0; k < node.count; k += 1) {
+                size += node.sizes[k];
+                ones += node.ones[k];
+            }
+            return {size, ones};
+        }
+
+        /**
+         * @brief Recounts the bits and ones of child k from the child itself.
+         */
+        static void recount(Inner &node, uint32_t k) noexcept {
+            if (node.leaves[k]) {
+                node.sizes[k] = node.leaves[k]->size;
+                node.ones[k] = countOnes(*node.leaves[k]);
+            } else {
+                std::tie(node.sizes[k], node.ones[k]) = totals(*node.inner[k]);
+            }
+        }
+
+        /**
+         * @brief Moves child `from` of `source` to slot `to` of `target`, with its counts.
+         */
+        static void moveSlot(Inner &source, uint32_t from, Inner &target, uint32_t to) noexcept {
+            target.inner[to] = std::move(source.inner[from]);
+            target.leaves[to] = std::move(source.leaves[from]);
+            target.sizes[to] = std::exchange(source.sizes[from], 0);
+            target.ones[to] = std::exchange(source.ones[from], 0);
+        }
+
+        /**
+         * @brief Inserts a child (an inner node or a leaf; the other is null) into slot `pos` of a node with room
+         * for it, shifting the children after it right.
+         */
+        static void placeChild(Inner &node, uint32_t pos, std::unique_ptr<Inner> inner, std::unique_ptr<Leaf> leaf) {
+            for (uint32_t k = node.count; k > pos; k -= 1) {
+                moveSlot(node, k - 1, node, k);
+            }
+            node.inner[pos] = std::move(inner);
+            node.leaves[pos] = std::move(leaf);
+            node.count += 1;
+            recount(node, pos);
+        }
+
+        /**
+         * @brief Removes child `pos` of `node`, which must already be empty, shifting the children after it left.
+         */
+        static void removeChild(Inner &node, uint32_t pos) noexcept {
+            for (uint32_t k = pos; k + 1 < node.count; k += 1) {
+                moveSlot(node, k + 1, node, k);
+            }
+            node.count -= 1;
+            node.inner[node.count].reset();
+            node.leaves[node.count].reset();
+            node.sizes[node.count] = 0;
+            node.ones[node.count] = 0;
+        }
+
+        /**
+         * @brief placeChild, splitting `node` in half first if it is full.
+         *
+         * @return std::unique_ptr<Inner> the new right half of `node`, or null if it didn't split
+         */
+        static std::unique_ptr<Inner> addChild(Inner &node, uint32_t pos, std::unique_ptr<Inner> inner,
+            std::unique_ptr<Leaf> leaf) {
+            if (node.count < MAX_CHILDREN) {
+                placeChild(node, pos, std::move(inner), std::move(leaf));
+                return nullptr;
+            }
+            auto right = std::make_unique<Inner>();
+            for (uint32_t k = MAX_CHILDREN / 2; k < MAX_CHILDREN; k += 1) {
+                moveSlot(node, k, *right, k - MAX_CHILDREN / 2);
+            }
+            node.count = MAX_CHILDREN / 2;
+            right->count = MAX_CHILDREN / 2;
+            if (pos <= MAX_CHILDREN / 2) {
+                placeChild(node, pos, std::move(inner), std::move(leaf));
+            } else {
+                placeChild(*right, pos - MAX_CHILDREN / 2, std::move(inner), std::move(leaf));
+            }
+            return right;
+        }
+
+        /**
+         * @brief Shifts bits [i, size) of `leaf` up by one and writes `bit` at i. The leaf must have room.
+         */
+        static void insertBit(Leaf &leaf, uint32_t i, bool bit) noexcept {
+            const uint32_t first = i >> 6, offset = i & 63;
+            for (uint32_t w = leaf.size >> 6; w > first; w -= 1) {
+                leaf.words[w] = (leaf.words[w] << 1) | (leaf.words[w - 1] >> 63);
+            }
+            const uint64_t lowMask = (1ull << offset) - 1;
+            const uint64_t word = leaf.words[first];
+            leaf.words[first] = (word & lowMask) | ((word & ~lowMask) << 1) | (static_cast<uint64_t>(bit) << offset);
+            leaf.size += 1;
+        }
+
+        /**
+         * @brief Removes bit i of `leaf`, shifting bits (i, size) down by one.
+         *
+         * @return bool the removed bit
+         */
+        static bool eraseBit(Leaf &leaf, uint32_t i) noexcept {
+            const uint32_t first = i >> 6, offset = i & 63, last = (leaf.size - 1) >> 6;
+            const uint64_t lowMask = (1ull << offset) - 1;
+            const uint64_t word = leaf.words[first];
+            const bool bit = (word >> offset) & 1;
+            leaf.words[first] = (word & lowMask) | ((word >> 1) & ~lowMask);
+            for (uint32_t w = first; w < last; w += 1) {
+                leaf.words[w] |= leaf.words[w + 1] << 63;
+                leaf.words[w + 1] >>= 1;
+            }
+            leaf.size -= 1;
+            return bit;
+        }
+
+        /**
+         * @return int64_t how much the number of ones changed
+         */
+        static int64_t setIn(Inner &node, uint32_t level, uint64_t i, bool bit) noexcept {
+            const uint32_t k = childAt(node, i);
+            int64_t delta = 0;
+            if (level == 1) {
+                uint64_t &word = node.leaves[k]->words[i >> 6];
+                delta = static_cast<int64_t>(bit) - static_cast<int64_t>((word >> (i & 63)) & 1);
+                word = (word & ~(1ull << (i & 63))) | (static_cast<uint64_t>(bit) << (i & 63));
+            } else {
+                delta = setIn(*node.inner[k], level - 1, i, bit);
+            }
+            node.ones[k] += delta;
+            return delta;
+        }
+
+        /**
+         * @brief Inserts `bit` before bit i under `node`. A full leaf on the way is split in half first, and the new
+         * leaf is added to its parent, which may split in turn.
+         *
+         * @return std::unique_ptr<Inner> the new right half of `node`, or null if it didn't split
+         */
+        static std::unique_ptr<Inner> insertInto(Inner &node, uint32_t level, uint64_t i, bool bit) {
+            /* i may be one past a child's bits, so appending lands in the last child */
+            uint32_t k = 0;
+            while (k + 1 < node.count && i > node.sizes[k]) {
+                i -= node.sizes[k];
+                k += 1;
+            }
+
+            if (level > 1) {
+                auto split = insertInto(*node.inner[k], level - 1, i, bit);
+                if (!split) {
+                    node.sizes[k] += 1;
+                    node.ones[k] += bit;
+                    return nullptr;
+                }
+                recount(node, k);
+                return addChild(node, k + 1, std::move(split), nullptr);
+            }
+
+            Leaf &leaf = *node.leaves[k];
+            if (leaf.size < LEAF_BITS) {
+                insertBit(leaf, i, bit);
+                node.sizes[k] += 1;
+                node.ones[k] += bit;
+                return nullptr;
+            }
+            /* the halves are word aligned, so the upper one moves as whole words */
+            auto right = std::make_unique<Leaf>();
+            std::copy(leaf.words.begin() + LEAF_WORDS / 2, leaf.words.end(), right->words.begin());
+            std::fill(leaf.words.begin() + LEAF_WORDS / 2, leaf.words.end(), 0);
+            leaf.size = LEAF_BITS / 2;
+            right->size = LEAF_BITS / 2;
+            if (i <= leaf.size) {
+                insertBit(leaf, i, bit);
+            } else {
+                insertBit(*right, i - leaf.size, bit);
+            }
+            recount(node, k);
+            return addChild(node, k + 1, nullptr, std::move(right));
+        }
+
+        /**
+         * @brief Erases bit i under `node`, then fixes a child that fell under its minimum.
+         *
+         * @return bool the erased bit
+         */
+        static bool eraseFrom(Inner &node, uint32_t level, uint64_t i) {
+            const uint32_t k = childAt(node, i);
+            bool bit = false, underflow = false;
+            if (level == 1) {
+                bit = eraseBit(*node.leaves[k], i);
+                underflow = node.leaves[k]->size < MIN_LEAF_BITS;
+            } else {
+                bit = eraseFrom(*node.inner[k], level - 1, i);
+                underflow = node.inner[k]->count < MIN_CHILDREN;
+            }
+            node.sizes[k] -= 1;
+            node.ones[k] -= bit;
+            if (underflow && node.count > 1) {
+                rebalance(node, (k + 1 < node.count) ? k : k - 1);
+            }
+            return bit;
+        }
+
+        /**
+         * @brief Merges children a and a+1 of `node` if they fit in one, otherwise splits their contents evenly.
+         * Either way both end up at least half full, since one was under a quarter and the other at most full.
+         */
+        static void rebalance(Inner &node, uint32_t a) {
+            if (node.leaves[a]) {
+                Leaf &left = *node.leaves[a], &right = *node.leaves[a + 1];
+                const uint32_t total = left.size + right.size;
+                if (total <= LEAF_BITS) {
+                    copyBits(left.words.data(), left.size, right.words.data(), 0, right.size);
+                    left.size = total;
+                    recount(node, a);
+                    removeChild(node, a + 1);
+                    return;
+                }
+                std::array<uint64_t, 2 * LEAF_WORDS> bits {};
+                copyBits(bits.data(), 0, left.words.data(), 0, left.size);
+                copyBits(bits.data(), left.size, right.words.data(), 0, right.size);
+                left = Leaf();
+                right = Leaf();
+                left.size = total / 2;
+                right.size = total - left.size;
+                copyBits(left.words.data(), 0, bits.data(), 0, left.size);
+                copyBits(right.words.data(), 0, bits.data(), left.size, right.size);
+            } else {
+                Inner &left = *node.inner[a], &right = *node.inner[a + 1];
+                const uint32_t total = left.count + right.count;
+                if (total <= MAX_CHILDREN) {
+                    for (uint32_t k = 0; k < right.count; k += 1) {
+                        moveSlot(right, k, left, left.count + k);
+                    }
+                    left.count = total;
+                    recount(node, a);
+                    removeChild(node, a + 1);
+                    return;
+                }
+                const uint32_t half = total / 2;
+                if (left.count < half) {
+                    const uint32_t moved = half - left.count;
+                    for (uint32_t k = 0; k < moved; k += 1) {
+                        moveSlot(right, k, left, left.count + k);
+                    }
+                    for (uint32_t k = moved; k < right.count; k += 1) {
+                        moveSlot(right, k, right, k - moved);
+                    }
+                    right.count -= moved;
+                    left.count = half;
+                } else {
+                    const uint32_t moved = left.count - half;
+                    for (uint32_t k = right.count; k > 0; k -= 1) {
+                        moveSlot(right, k - 1, right, k - 1 + moved);
+                    }
+                    for (uint32_t k = 0; k < moved; k += 1) {
+                        moveSlot(left, half + k, right, k);
+                    }
+                    right.count += moved;
+                    left.count = half;
+                }
+            }
+            recount(node, a);
+            recount(node, a + 1);
+        }
+
+        /**
+         * @brief Descends to the k-th (0-indexed) one or zero, skipping children with fewer.
+         */
+        uint64_t selectFrom(uint64_t k, bool bit) const noexcept {
+            uint64_t position = 0;
+            Inner const* node = root_.get();
+            for (uint32_t level = height_; ; level -= 1) {
+                uint32_t c = 0;
+                auto matching = [&](uint32_t j) { return bit ? node->ones[j] : node->sizes[j] - node->ones[j]; };
+                while (k >= matching(c)) {
+                    k -= matching(c);
+                    position += node->sizes[c];
+                    c += 1;
+                }
+                if (level == 1) {
+                    /* the k-th match is in this leaf, so the zeros past its end are never reached */
+                    Leaf const& leaf = *node->leaves[c];
+                    for (uint32_t w = 0; ; w += 1) {
+                        const uint64_t word = bit ? leaf.words[w] : ~leaf.words[w];
+                        const uint32_t count = std::popcount(word);
+                        if (k < count) {
+                            return position + 64 * w + utility::selectInWord(word, k);
+                        }
+                        k -= count;
+                    }
+                }
+                node = node->inner[c].get();
+            }
+        }
+
+        static uint64_t nodeBits(Inner const& node, uint32_t level) noexcept {
+            uint64_t bits = 8 * sizeof(Inner);
+            for (uint32_t k = 0; k < node.count; k += 1) {
+                bits += (level == 1) ? 8 * sizeof(Leaf) : nodeBits(*node.inner[k], level - 1);
+            }
+            return bits;
+        }
+
+        static void copyOut(Inner const& node, uint32_t level, uint64_t *words, uint64_t &offset) noexcept {
+            for (uint32_t k = 0; k < node.count; k += 1) {
+                if (level == 1) {
+                    copyBits(words, offset, node.leaves[k]->words.data(), 0, node.leaves[k]->size);
+                    offset += node.leaves[k]->size;
+                } else {
+                    copyOut(*node.inner[k], level - 1, words, offset);
+                }
+            }
+        }
+
+        inline void checkBounds(uint64_t i, uint64_t limit, char const* function) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (i >= limit) {
+                    throw std::out_of_range("DynamicBitVector::" + std::string(function) + " - " +
+                        std::to_string(i) + "-th bit is out of bounds for bitvector of size " +
+                        std::to_string(size_) + ".");
+                }
+            }
+        }
+
+        inline void checkSelect(uint64_t i, uint64_t available, char const* function) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (i > available || i == 0) {
+                    throw std::invalid_argument("DynamicBitVector::" + std::string(function) + " - Cannot select " +
+                        std::to_string(i) + "-th bit of " + std::to_string(available) + ". Use 1-indexing.");
+                }
+            }
+        }
+};
+
+static_assert(RankSelectable<DynamicBitVector> && BitAccess<DynamicBitVector>);
+
+} // end namespace bitvector
@@ -0,0 +1,200 @@
+/*  Implementation of a SparseArray whose positions can be set in any order
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// local includes
+#include "bitvector.h"
+#include "dynamicbitvector.h"
+#include "sparsearray.h"
+#include "utilities.h"
+
+namespace sparse {
+
+/**
+ * @brief A sparse array that elements can be inserted into and erased from at any position, in any order. SparseArray
+ * only appends in increasing position; this marks positions in a DynamicBitVector instead, so numElemAt (rank) and
+ * getAtRank (select) stay O(log n) after every change, and keeps the values in a map ordered by position.
+ *
+ * Once the positions settle, `toSparseArray` converts to the static, more compact SparseArray in one pass.
+ *
+ * @tparam T type to store within array
+ */
+template <typename T>
+class DynamicSparseArray {
+    public:
+        using const_iterator = typename std::map<uint64_t, T>::const_iterator;
+
+        /**
+         * @brief Construct a new DynamicSparseArray object. Empty initially.
+         * @see create
+         */
+        DynamicSparseArray() = default;
+
+        DynamicSparseArray(DynamicSparseArray&&) noexcept = default;
+        DynamicSparseArray& operator=(DynamicSparseArray&&) noexcept = default;
+
+        /**
+         * @brief Resets to a sparse array of `size` empty positions.
+         *
+         * @param size size of the sparse array
+         */
+        void create(uint64_t size) {
+            positions_ = bitvector::DynamicBitVector(bitvector::BitVector(size));
+            values_.clear();
+        }
+
+        /**
+         * @brief Stores `elem` at `pos`, replacing the element already there, if any. O(log n).
+         * @throws std::out_of_range if the position is out of bounds.
+         *
+         * @param elem element to store
+         * @param pos where to store it
+         * @return true if the position was empty
+         * @return false if an element was replaced
+         */
+        bool insert(T const& elem, uint64_t pos) {
+            this->checkBounds(pos, "insert");
+            auto [it, inserted] = values_.insert_or_assign(pos, elem);
+            if (inserted) {
+                positions_.set(pos, true);
+            }
+            return inserted;
+        }
+
+        /**
+         * @brief Removes the element at `pos`, if any. O(log n).
+         * @throws std::out_of_range if the position is out of bounds.
+         *
+         * @param pos position to clear
+         * @return true if an element was removed
+         */
+        bool erase(uint64_t pos) {
+            this->checkBounds(pos, "erase");
+            if (values_.erase(pos) == 0) {
+                return false;
+            }
+            positions_.set(pos, false);
+            return true;
+        }
+
+        /**
+         * @brief Looks up the element at `index` without copying it.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index index of sparse array
+         * @return T const* the value at `index`, or nullptr if none is present. Valid until it is erased.
+         */
+        T const* find(uint64_t index) const {
+            this->checkBounds(index, "find");
+            const auto it = values_.find(index);
+            return (it == values_.end()) ? nullptr : &it->second;
+        }
+
+        /**
+         * @brief get the element of the sparse array at `index`.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index index of sparse array
+         * @param element receives value at `index`
+         * @return true if value was present
+         * @return false if value was not present
+         */
+        bool getAtIndex(uint64_t index, T &element) const {
+            if (T const* value = this->find(index)) {
+                element = *value;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief return the rank-th element of the sparse array. Selects its position in O(log n).
+         *
+         * @param rank what rank element to retrieve
+         * @param element receives the value
+         * @return true if rank < the number of elements
+         * @return false if rank >= the number of elements
+         */
+        bool getAtRank(uint64_t rank, T &element) const {
+            if (rank >= this->numElem()) {
+                return false;
+            }
+            element = values_.find(positions_.select1(rank + 1))->second;
+            return true;
+        }
+
+        /**
+         * @brief Counts the number of elements up to index. O(log n).
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
+         * @return uint64_t number of elements up to `index`
+         */
+        uint64_t numElemAt(uint64_t index) const {
+            return positions_.rank1(index);
+        }
+
+        /**
+         * @brief The size of the DynamicSparseArray. This is the total number of elements it can store.
+         *
+         * @return uint64_t size of sparsearray
+         */
+        uint64_t size() const noexcept {
+            return positions_.size();
+        }
+
+        /**
+         * @brief The number of elements stored in the sparse array.
+         *
+         * @return uint64_t number of elements
+         */
+        uint64_t numElem() const noexcept {
+            return values_.size();
+        }
+
+        /**
+         * @brief The (position, value) pairs in increasing position.
+         */
+        const_iterator begin() const noexcept {
+            return values_.cbegin();
+        }
+
+        const_iterator end() const noexcept {
+            return values_.cend();
+        }
+
+        /**
+         * @brief Builds a static SparseArray with the same elements, with SparseArray::fromSorted.
+         *
+         * @tparam Positions positions backend of the result
+         * @return SparseArray<T, Positions> the same elements
+         */
+        template <PositionsBackend Positions = BitVectorPositions>
+        SparseArray<T, Positions> toSparseArray() const {
+            return SparseArray<T, Positions>::fromSorted(this->size(), values_.cbegin(), values_.cend());
+        }
+
+    private:
+        bitvector::DynamicBitVector positions_;
+        std::map<uint64_t, T> values_;
+
+        inline void checkBounds(uint64_t index, char const* function) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (index >= this->size()) {
+                    throw std::out_of_range("DynamicSparseArray::" + std::string(function) + " -- index " +
+                        std::to_string(index) + " is out of bounds.");
+                }
+            }
+        }
+};
+
+} // end namespace sparse
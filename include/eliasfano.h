@@ -0,0 +1,348 @@
+/*  Implementation of an Elias-Fano encoded sorted integer set.
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// local includes
+#include "bitvector.h"
+#include "utilities.h"
+
+namespace bitvector {
+
+/**
+ * @brief EliasFano. Stores m sorted positions from a universe [0, n) in about m*(2 + log_2(n/m)) bits.
+ *
+ * Each position is split into its low l = floor(log_2(n/m)) bits, stored verbatim in a PackedVector, and its high
+ * bits, stored in unary: the k-th position sets bit (position >> l) + k of the `high` BitVector. A SelectIndex over
+ * the ones of `high` gives select in O(1). A SelectIndex over its zeros finds the start and end of the bucket of
+ * positions sharing a high part, so rank is two select0s plus a binary search over the (usually 1 or 2) low parts
+ * in that bucket.
+ */
+class EliasFano {
+    public:
+        /**
+         * @brief Construct an empty set, e.g. to deserialize into.
+         *
+         * @param universe one past the largest allowed position
+         */
+        explicit EliasFano(uint64_t universe = 0) : EliasFano(universe, 0, static_cast<uint64_t const*>(nullptr),
+            static_cast<uint64_t const*>(nullptr)) {}
+
+        /**
+         * @brief Encodes `count` strictly increasing positions in [0, universe).
+         * @throws std::invalid_argument If CHECK_BOUNDS and the positions are unsorted, out of the universe, or there
+         * are not `count` of them.
+         *
+         * @tparam It input iterator
+         * @tparam Proj maps *it to a uint64_t position
+         * @param universe one past the largest allowed position
+         * @param count number of positions in [first, last)
+         * @param first first position
+         * @param last end of positions
+         * @param proj projection applied to each element, e.g. to pick the position out of a (position, value) pair
+         */
+        template <std::input_iterator It, typename Proj = std::identity>
+        EliasFano(uint64_t universe, uint64_t count, It first, It last, Proj proj = {}) : universe_(universe),
+            count_(count), lowBits_(lowBitsFor(universe, count)),
+            high_(count + (universe >> lowBits_) + 1), low_(count, std::max<uint32_t>(1, lowBits_)) {
+
+            uint64_t k = 0, end = 0;
+            uint64_t *highWords = high_.words();
+            for (; first != last; ++first, k += 1) {
+                const uint64_t position = std::invoke(proj, *first);
+                if constexpr (utility::CHECK_BOUNDS) {
+                    if (k >= count || position < end || position >= universe) {
+                        throw std::invalid_argument("EliasFano -- positions must be strictly increasing, in [0, " +
+                            std::to_string(universe) + "), and exactly " + std::to_string(count) + " long.");
+                    }
+                }
+                const uint64_t bit = (position >> lowBits_) + k;
+                highWords[bit >> 6] |= 1ull << (bit & 63);
+                if (lowBits_ != 0) {
+                    low_.set(k, position & lowMask());
+                }
+                end = position + 1;
+            }
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (k != count) {
+                    throw std::invalid_argument("EliasFano -- expected " + std::to_string(count) + " positions, got " +
+                        std::to_string(k) + ".");
+                }
+            }
+
+            ones_ = SelectIndex(high_, count_, true);
+            zeros_ = SelectIndex(high_, high_.size() - count_, false);
+        }
+
+        EliasFano(EliasFano&&) = default;
+        EliasFano& operator=(EliasFano&&) = default;
+
+        /**
+         * @brief Forward iterator over the positions in increasing order. Walks the ones of `high` a word at a time
+         * and the low parts in step, so a full scan costs O(m + n/2^l/64) instead of m selects.
+         */
+        class Iterator {
+            public:
+                using value_type = uint64_t;
+                using difference_type = std::ptrdiff_t;
+
+                Iterator() = default;
+
+                explicit Iterator(EliasFano const& set) : set_(&set), ones_(set.high_.ones().begin()) {}
+
+                /**
+                 * @return uint64_t the current position
+                 */
+                uint64_t operator*() const noexcept {
+                    return ((*ones_ - k_) << set_->lowBits_) | set_->lowAt(k_);
+                }
+
+                Iterator& operator++() noexcept {
+                    ++ones_;
+                    k_ += 1;
+                    return *this;
+                }
+
+                Iterator operator++(int) noexcept {
+                    Iterator previous = *this;
+                    ++(*this);
+                    return previous;
+                }
+
+                bool operator==(Iterator const& other) const noexcept {
+                    return ones_ == other.ones_;
+                }
+
+                bool operator==(std::default_sentinel_t) const noexcept {
+                    return ones_ == std::default_sentinel;
+                }
+
+            private:
+                EliasFano const* set_ = nullptr;
+                OnesIterator<WordCursor> ones_;
+                uint64_t k_ = 0;
+        };
+
+        /**
+         * @return Iterator the smallest position
+         */
+        Iterator begin() const noexcept {
+            return Iterator(*this);
+        }
+
+        /**
+         * @return std::default_sentinel_t the end of the positions
+         */
+        std::default_sentinel_t end() const noexcept {
+            return std::default_sentinel;
+        }
+
+        /**
+         * @brief The k-th (0-indexed) position.
+         * @throws std::out_of_range If k >= count().
+         *
+         * @param k number of positions before the one to return
+         * @return uint64_t position
+         */
+        uint64_t select(uint64_t k) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (k >= count_) {
+                    throw std::out_of_range("EliasFano::select -- " + std::to_string(k) + "-th position requested " +
+                        "from a set of " + std::to_string(count_) + ".");
+                }
+            }
+            const uint64_t high = ones_.select(high_.words(), k) - k;
+            return (high << lowBits_) | this->lowAt(k);
+        }
+
+        /**
+         * @brief The number of positions <= index.
+         * @throws std::out_of_range If index >= size().
+         *
+         * @param index
+         * @return uint64_t number of positions in [0, index]
+         */
+        uint64_t rank(uint64_t index) const {
+            this->checkBounds(index, "rank");
+            return this->bucketSearch(index).first;
+        }
+
+        /**
+         * @brief Whether `index` is one of the positions.
+         * @throws std::out_of_range If index >= size().
+         *
+         * @param index
+         * @return true if index is in the set
+         */
+        bool contains(uint64_t index) const {
+            this->checkBounds(index, "contains");
+            return this->bucketSearch(index).second;
+        }
+
+        /**
+         * @brief rank(index) and contains(index) from one bucket search.
+         * @throws std::out_of_range If index >= size().
+         *
+         * @param index
+         * @return std::pair<uint64_t, bool> (number of positions in [0, index], whether index is in the set)
+         */
+        std::pair<uint64_t, bool> rankAndContains(uint64_t index) const {
+            this->checkBounds(index, "rankAndContains");
+            return this->bucketSearch(index);
+        }
+
+        /**
+         * @brief The size of the universe.
+         *
+         * @return uint64_t one past the largest representable position
+         */
+        uint64_t size() const noexcept {
+            return universe_;
+        }
+
+        /**
+         * @brief The number of positions stored.
+         *
+         * @return uint64_t number of positions
+         */
+        uint64_t count() const noexcept {
+            return count_;
+        }
+
+        /**
+         * @brief Return the overhead in bits, including both select indices.
+         *
+         * @return uint64_t bits used
+         */
+        uint64_t overhead() const noexcept {
+            return high_.size() + low_.overhead() + ones_.overhead() + zeros_.overhead();
+        }
+
+        /**
+         * @brief Serialize into output stream using serial::serialize
+         *
+         * @param out destination of data
+         */
+        void serialize(std::ostream& out) const {
+            serial::serialize(universe_, out);
+            serial::serialize(count_, out);
+            serial::serialize(lowBits_, out);
+            serial::serialize(high_, out);
+            serial::serialize(low_, out);
+            serial::serialize(ones_, out);
+            serial::serialize(zeros_, out);
+        }
+
+        /**
+         * @brief Deserialize from inputstream using serial::deserialize. Will reallocate.
+         *
+         * @param in source of data
+         */
+        void deserialize(std::istream& in) {
+            serial::deserialize(universe_, in);
+            serial::deserialize(count_, in);
+            serial::deserialize(lowBits_, in);
+            serial::deserialize(high_, in);
+            serial::deserialize(low_, in);
+            serial::deserialize(ones_, in);
+            serial::deserialize(zeros_, in);
+        }
+
+        /**
+         * @brief Views data written by `serialize` in a mapped file instead of copying it.
+         * @see BitVector::map
+         *
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader) {
+            universe_ = reader.read<uint64_t>();
+            count_ = reader.read<uint64_t>();
+            lowBits_ = reader.read<uint32_t>();
+            high_.map(reader);
+            low_.map(reader);
+            ones_.map(reader);
+            zeros_.map(reader);
+        }
+
+    private:
+        uint64_t universe_, count_;
+        uint32_t lowBits_;
+        BitVector high_;
+        PackedVector low_;
+        SelectIndex ones_, zeros_;
+
+        /**
+         * @brief floor(log_2(universe/count)), the split that minimizes the encoded size. An empty set puts the
+         * whole universe in one bucket, so `high` is O(1) bits instead of universe + 1.
+         */
+        static uint32_t lowBitsFor(uint64_t universe, uint64_t count) noexcept {
+            if (count == 0) {
+                return std::min<uint32_t>(std::bit_width(universe), BitVector::WORD_BITS - 1);
+            }
+            if (universe <= count) {
+                return 0;
+            }
+            return std::bit_width(universe / count) - 1;
+        }
+
+        uint64_t lowMask() const noexcept {
+            return (1ull << lowBits_) - 1;
+        }
+
+        uint64_t lowAt(uint64_t k) const noexcept {
+            return (lowBits_ == 0) ? 0 : low_[k];
+        }
+
+        /**
+         * @brief Counts the positions <= index and checks whether index is one of them. Positions before bucket
+         * h = index >> l number (start of bucket h) - h; within the bucket the low parts are sorted, so a binary
+         * search finds the ones <= the low part of index.
+         *
+         * @param index position to look up. Must be < universe.
+         * @return std::pair<uint64_t, bool> rank of index and whether it is set
+         */
+        std::pair<uint64_t, bool> bucketSearch(uint64_t index) const noexcept {
+            uint64_t const* words = high_.words();
+            const uint64_t bucket = index >> lowBits_;
+            const uint64_t bucketStart = (bucket == 0) ? 0 : zeros_.select(words, bucket - 1) + 1;
+            const uint64_t bucketEnd = zeros_.select(words, bucket);
+
+            uint64_t lower = bucketStart - bucket, upper = bucketEnd - bucket;
+            const uint64_t target = index & lowMask();
+            while (lower < upper) {
+                const uint64_t mid = lower + (upper - lower) / 2;
+                if (this->lowAt(mid) <= target) {
+                    lower = mid + 1;
+                } else {
+                    upper = mid;
+                }
+            }
+            const bool found = (lower > bucketStart - bucket) && (this->lowAt(lower - 1) == target);
+            return {lower, found};
+        }
+
+        inline void checkBounds(uint64_t index, std::string const& name) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (index >= universe_) {
+                    throw std::out_of_range("EliasFano::" + name + " -- index " + std::to_string(index) +
+                        " is out of bounds for universe of size " + std::to_string(universe_) + ".");
+                }
+            }
+        }
+};
+
+static_assert(std::ranges::forward_range<EliasFano const>);
+
+}   // end namespace bitvector
@@ -0,0 +1,283 @@
+/*  Implementation of optional operation counters and hardware event counters for the hot paths
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#if defined(INSTRUMENT)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace instrument {
+
+/* Enabled with `make INSTRUMENT=1`. Off, every count and event call below compiles to nothing. */
+#if defined(INSTRUMENT)
+constexpr bool ENABLED = true;
+#else
+constexpr bool ENABLED = false;
+#endif
+
+/**
+ * @brief What the hot paths count.
+ */
+enum Counter : uint32_t {
+    RANK_CALLS = 0,             /* RankSupport::rank1 and rank1WithBit */
+    SELECT_CALLS,               /* SelectSupport::select1 and select0 */
+    SELECT_SEARCH_STEPS,        /* binary search iterations of select0 without a zero index */
+    SELECT_SCAN_WORDS,          /* words read by SelectIndex::scan, i.e. the search of select past a sample */
+    BUILD_BITS_SCANNED,         /* bits popcounted by RankSupport::buildTables */
+    NUM_COUNTERS
+};
+
+/**
+ * @brief Names of the counters, e.g. for benchmark output.
+ */
+constexpr std::array<char const*, NUM_COUNTERS> COUNTER_NAMES = {
+    "rank_calls", "select_calls", "select_search_steps", "select_scan_words", "build_bits_scanned"
+};
+
+using Counts = std::array<uint64_t, NUM_COUNTERS>;
+
+namespace detail {
+
+struct ThreadCounts;
+
+/**
+ * @brief Every thread's counts, plus the totals of threads that have exited.
+ */
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadCounts const*> live;
+    Counts retired{};
+};
+
+inline Registry& registry() {
+    static Registry registry;
+    return registry;
+}
+
+/**
+ * @brief One thread's counts. Only their thread writes them, with plain (relaxed load and store) increments, so
+ * counting costs no locked instruction; `snapshot` may read them from any thread.
+ */
+struct ThreadCounts {
+    std::array<std::atomic<uint64_t>, NUM_COUNTERS> values{};
+
+    ThreadCounts() {
+        Registry &all = registry();
+        std::lock_guard<std::mutex> lock(all.mutex);
+        all.live.push_back(this);
+    }
+
+    ~ThreadCounts() {
+        Registry &all = registry();
+        std::lock_guard<std::mutex> lock(all.mutex);
+        for (uint32_t i = 0; i < NUM_COUNTERS; i += 1) {
+            all.retired[i] += values[i].load(std::memory_order_relaxed);
+        }
+        std::erase(all.live, this);
+    }
+};
+
+inline ThreadCounts& local() {
+    thread_local ThreadCounts counts;
+    return counts;
+}
+
+}   // end namespace detail
+
+/**
+ * @brief Adds `n` to `counter` for the calling thread. Does nothing unless ENABLED.
+ *
+ * @param counter what to count
+ * @param n amount to add
+ */
+inline void count(Counter counter, uint64_t n = 1) noexcept {
+    if constexpr (ENABLED) {
+        std::atomic<uint64_t> &value = detail::local().values[counter];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Totals of every counter over all threads, past and present. Take one before and after a region and
+ * subtract. All zeros unless ENABLED.
+ *
+ * @return Counts total of each Counter
+ */
+inline Counts snapshot() {
+    Counts totals{};
+    if constexpr (ENABLED) {
+        detail::Registry &all = detail::registry();
+        std::lock_guard<std::mutex> lock(all.mutex);
+        totals = all.retired;
+        for (detail::ThreadCounts const* counts : all.live) {
+            for (uint32_t i = 0; i < NUM_COUNTERS; i += 1) {
+                totals[i] += counts->values[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return totals;
+}
+
+/**
+ * @brief Hardware event counters (perf_event_open) of the calling thread and the threads it starts while counting,
+ * in user space. Events accumulate over every start/stop region until `reset`:
+ *
+ *     PerfCounters perf;
+ *     { PerfCounters::Region region(perf); ...work...; }
+ *     perf.read()[PerfCounters::LLC_MISSES];
+ *
+ * Events the kernel or hardware won't count (e.g. perf_event_paranoid, or a VM without a PMU) are unavailable and read
+ * 0, as do all of them unless ENABLED.
+ */
+class PerfCounters {
+    public:
+        enum Event : uint32_t {
+            CYCLES = 0,
+            LLC_MISSES,         /* last level cache read misses */
+            DTLB_MISSES,        /* data TLB read misses */
+            NUM_EVENTS
+        };
+
+        /**
+         * @brief Names of the events, e.g. for benchmark output.
+         */
+        constexpr static std::array<char const*, NUM_EVENTS> EVENT_NAMES = {"cycles", "llc_misses", "dtlb_misses"};
+
+        using Values = std::array<uint64_t, NUM_EVENTS>;
+
+        /**
+         * @brief Opens the event counters, stopped and at zero.
+         */
+        PerfCounters() {
+            fds_.fill(-1);
+#if defined(INSTRUMENT)
+            constexpr uint64_t readMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            fds_[CYCLES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+            fds_[LLC_MISSES] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | readMiss);
+            fds_[DTLB_MISSES] = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | readMiss);
+#endif
+        }
+
+        PerfCounters(PerfCounters const&) = delete;
+        PerfCounters& operator=(PerfCounters const&) = delete;
+
+        ~PerfCounters() {
+#if defined(INSTRUMENT)
+            for (int fd : fds_) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+#endif
+        }
+
+        /**
+         * @param event an Event
+         * @return true if `event` is being counted
+         */
+        bool available(Event event) const noexcept {
+            return fds_[event] >= 0;
+        }
+
+        /**
+         * @brief Starts (or resumes) counting.
+         */
+        void start() noexcept {
+#if defined(INSTRUMENT)
+            this->control(PERF_EVENT_IOC_ENABLE);
+#endif
+        }
+
+        /**
+         * @brief Pauses counting.
+         */
+        void stop() noexcept {
+#if defined(INSTRUMENT)
+            this->control(PERF_EVENT_IOC_DISABLE);
+#endif
+        }
+
+        /**
+         * @brief Zeros every event.
+         */
+        void reset() noexcept {
+#if defined(INSTRUMENT)
+            this->control(PERF_EVENT_IOC_RESET);
+#endif
+        }
+
+        /**
+         * @brief Events counted since construction or the last `reset`.
+         *
+         * @return Values count of each Event; 0 for unavailable ones
+         */
+        Values read() const noexcept {
+            Values values{};
+#if defined(INSTRUMENT)
+            for (uint32_t event = 0; event < NUM_EVENTS; event += 1) {
+                uint64_t value = 0;
+                if (fds_[event] >= 0 && ::read(fds_[event], &value, sizeof(value)) == sizeof(value)) {
+                    values[event] = value;
+                }
+            }
+#endif
+            return values;
+        }
+
+        /**
+         * @brief Counts for its lifetime.
+         */
+        class Region {
+            public:
+                explicit Region(PerfCounters &counters) noexcept : counters_(counters) {
+                    counters_.start();
+                }
+                ~Region() {
+                    counters_.stop();
+                }
+                Region(Region const&) = delete;
+                Region& operator=(Region const&) = delete;
+
+            private:
+                PerfCounters &counters_;
+        };
+
+    private:
+        std::array<int, NUM_EVENTS> fds_;
+
+#if defined(INSTRUMENT)
+        static int open(uint32_t type, uint64_t config) noexcept {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        }
+
+        void control(unsigned long request) noexcept {
+            for (int fd : fds_) {
+                if (fd >= 0) {
+                    ::ioctl(fd, request, 0);
+                }
+            }
+        }
+#endif
+};
+
+}   // end namespace instrument
@@ -0,0 +1,324 @@
+/*  Implementation of a versioned file format of checksummed, independently loadable sections
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ios>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// local includes
+#include "utilities.h"
+
+namespace serial {
+
+/**
+ * @brief How the bytes of a section are stored.
+ */
+enum class Codec : uint32_t {
+    NONE = 0,       /* as written */
+    PACKED = 1,     /* integers as their difference from the smallest one, bit packed in a PackedVector */
+};
+
+/**
+ * @brief Directory entry of one section.
+ */
+struct SectionEntry {
+    uint32_t id;
+    uint32_t codec;     /* a Codec */
+    uint64_t offset;    /* from the start of the file; a multiple of ALIGNMENT */
+    uint64_t bytes;     /* stored size */
+    uint64_t rawBytes;  /* size once decoded */
+    uint32_t crc;       /* CRC32C of the stored bytes */
+    uint32_t reserved;
+};
+
+static_assert(std::is_trivially_copyable<SectionEntry>::value && sizeof(SectionEntry) == 40);
+
+/**
+ * @brief Sectioned files start with these 4 bytes ("SECT"), and end with them before the format version.
+ */
+constexpr uint32_t SECTION_FILE_MAGIC = 0x54434553;
+
+/**
+ * @brief Version of the container layout itself. What is inside the sections is versioned by their writer.
+ */
+constexpr uint32_t SECTION_FILE_VERSION = 1;
+
+/**
+ * @brief Fixed size end of a sectioned file: where its directory is and how to check it.
+ */
+struct SectionFooter {
+    uint64_t directoryOffset;
+    uint32_t numSections;
+    uint32_t directoryCrc;  /* CRC32C of the directory entries */
+    uint32_t magic;
+    uint32_t version;
+};
+
+static_assert(std::is_trivially_copyable<SectionFooter>::value && sizeof(SectionFooter) == 24);
+
+/**
+ * @brief Writes a sectioned file. Layout:
+ *
+ *     magic, version | section | section | ... | directory (SectionEntry each) | SectionFooter
+ *
+ * Every section starts on a multiple of ALIGNMENT bytes, so a mapped file can use arrays inside it in place, and has
+ * its own CRC32C, so a reader only has to read (and check) the sections it uses. Sections are written one at a time
+ * through a serial::FileWriter between `begin` and `end`.
+ */
+class SectionWriter {
+    public:
+        /**
+         * @brief Creates or truncates `fname` and writes the file header.
+         * @throws std::ios_base::failure If the file cannot be opened.
+         *
+         * @param fname file to write
+         * @param direct write full buffers with O_DIRECT, if the file system supports it
+         */
+        explicit SectionWriter(std::string const& fname, bool direct = false) : out_(fname, direct) {
+            serialize(SECTION_FILE_MAGIC, out_);
+            serialize(SECTION_FILE_VERSION, out_);
+        }
+
+        /**
+         * @brief Starts section `id`. Write its bytes to the returned stream, then call `end`.
+         *
+         * @param id identifies the section to readers. Must be unique in the file.
+         * @param codec how the bytes are encoded
+         * @param rawBytes size once decoded. 0 means the same as the stored size.
+         * @return std::ostream& where the section's bytes go
+         */
+        std::ostream& begin(uint32_t id, Codec codec = Codec::NONE, uint64_t rawBytes = 0) {
+            pad(out_);
+            SectionEntry entry{};
+            entry.id = id;
+            entry.codec = static_cast<uint32_t>(codec);
+            entry.offset = static_cast<uint64_t>(out_.tellp());
+            entry.rawBytes = rawBytes;
+            entries_.push_back(entry);
+            out_.restartChecksum();
+            return out_;
+        }
+
+        /**
+         * @brief Finishes the section started by the last `begin`.
+         */
+        void end() {
+            SectionEntry &entry = entries_.back();
+            entry.bytes = static_cast<uint64_t>(out_.tellp()) - entry.offset;
+            entry.crc = out_.checksum();
+            if (entry.rawBytes == 0) {
+                entry.rawBytes = entry.bytes;
+            }
+        }
+
+        /**
+         * @brief Writes the directory and footer and closes the file.
+         * @throws std::ios_base::failure If any write failed.
+         */
+        void close() {
+            pad(out_);
+            SectionFooter footer{};
+            footer.directoryOffset = static_cast<uint64_t>(out_.tellp());
+            footer.numSections = entries_.size();
+            footer.directoryCrc = utility::crc32c(entries_.data(), entries_.size() * sizeof(SectionEntry));
+            footer.magic = SECTION_FILE_MAGIC;
+            footer.version = SECTION_FILE_VERSION;
+            out_.write(reinterpret_cast<char const*>(entries_.data()), entries_.size() * sizeof(SectionEntry));
+            serialize(footer, out_);
+            out_.close();
+        }
+
+    private:
+        FileWriter out_;
+        std::vector<SectionEntry> entries_;
+};
+
+/**
+ * @brief Stream buffer over bytes in memory, e.g. a section of a mapped file, for the `deserialize` functions.
+ * Positions (tellg, and so skipPadding) are relative to the first byte.
+ */
+class MemoryReadBuffer : public std::streambuf {
+    public:
+        explicit MemoryReadBuffer(std::span<const uint8_t> bytes) {
+            char *first = reinterpret_cast<char*>(const_cast<uint8_t*>(bytes.data()));
+            this->setg(first, first, first + bytes.size());
+        }
+
+    protected:
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+            if (!(which & std::ios_base::in)) {
+                return pos_type(off_type(-1));
+            }
+            const off_type base = (dir == std::ios_base::beg) ? 0 :
+                (dir == std::ios_base::cur) ? this->gptr() - this->eback() : this->egptr() - this->eback();
+            const off_type target = base + off;
+            if (target < 0 || target > this->egptr() - this->eback()) {
+                return pos_type(off_type(-1));
+            }
+            this->setg(this->eback(), this->eback() + target, this->egptr());
+            return pos_type(target);
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+            return this->seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+};
+
+/**
+ * @brief Input stream over bytes in memory. Reads past the end fail like reads past the end of a file.
+ */
+class MemoryReader : public std::istream {
+    public:
+        explicit MemoryReader(std::span<const uint8_t> bytes) : std::istream(nullptr), buffer_(bytes) {
+            this->rdbuf(&buffer_);
+        }
+
+    private:
+        MemoryReadBuffer buffer_;
+};
+
+/**
+ * @brief Reads a file written by SectionWriter. The file is mapped, and only the footer and directory are read up
+ * front; a section's pages are read when it is used, and its checksum is checked only when asked (`verify`).
+ */
+class SectionReader {
+    public:
+        /**
+         * @brief Maps `fname` and reads its directory.
+         * @throws std::ios_base::failure If the file cannot be mapped, is not a sectioned file of this version, or
+         *         its directory is corrupt.
+         *
+         * @param fname file to read
+         */
+        explicit SectionReader(std::string const& fname) : file_(std::make_shared<utility::MappedFile>(fname)),
+            fname_(fname) {
+            constexpr uint64_t headerBytes = 2 * sizeof(uint32_t);
+            if (file_->size() < headerBytes + sizeof(SectionFooter)) {
+                this->fail("is too small to be a sectioned file");
+            }
+
+            uint32_t magic;
+            std::memcpy(&magic, file_->data(), sizeof(magic));
+            SectionFooter footer;
+            std::memcpy(&footer, file_->data() + file_->size() - sizeof(SectionFooter), sizeof(SectionFooter));
+            if (magic != SECTION_FILE_MAGIC || footer.magic != SECTION_FILE_MAGIC) {
+                this->fail("is not a sectioned file");
+            }
+            if (footer.version != SECTION_FILE_VERSION) {
+                this->fail("has unsupported section format version " + std::to_string(footer.version));
+            }
+
+            const uint64_t directoryBytes = static_cast<uint64_t>(footer.numSections) * sizeof(SectionEntry);
+            if (footer.directoryOffset + directoryBytes + sizeof(SectionFooter) != file_->size()) {
+                this->fail("has a truncated or misplaced directory");
+            }
+            entries_.resize(footer.numSections);
+            std::memcpy(entries_.data(), file_->data() + footer.directoryOffset, directoryBytes);
+            if (utility::crc32c(entries_.data(), directoryBytes) != footer.directoryCrc) {
+                this->fail("has a corrupt directory");
+            }
+            for (auto const& entry : entries_) {
+                if (entry.offset > footer.directoryOffset || entry.bytes > footer.directoryOffset - entry.offset) {
+                    this->fail("has a section outside the file");
+                }
+            }
+        }
+
+        /**
+         * @param id section id
+         * @return true if the file has section `id`
+         */
+        bool contains(uint32_t id) const noexcept {
+            return this->find(id) != nullptr;
+        }
+
+        /**
+         * @brief The directory entry of section `id`.
+         * @throws std::ios_base::failure If there is no such section.
+         *
+         * @param id section id
+         * @return SectionEntry const& its entry
+         */
+        SectionEntry const& entry(uint32_t id) const {
+            SectionEntry const* entry = this->find(id);
+            if (!entry) {
+                this->fail("has no section " + std::to_string(id));
+            }
+            return *entry;
+        }
+
+        /**
+         * @brief The stored bytes of section `id`, in place in the mapping.
+         * @throws std::ios_base::failure If there is no such section.
+         *
+         * @param id section id
+         * @return std::span<const uint8_t> stored bytes. Valid while this reader or a `keepAlive` handle lives.
+         */
+        std::span<const uint8_t> bytes(uint32_t id) const {
+            SectionEntry const& entry = this->entry(id);
+            return std::span<const uint8_t>(file_->data() + entry.offset, entry.bytes);
+        }
+
+        /**
+         * @brief A MappedReader over section `id`, e.g. for `map` functions.
+         * @throws std::ios_base::failure If there is no such section.
+         *
+         * @param id section id
+         * @return MappedReader reader positioned at the section's first byte and limited to the section
+         */
+        MappedReader reader(uint32_t id) const {
+            SectionEntry const& entry = this->entry(id);
+            return MappedReader(file_, entry.offset, entry.offset + entry.bytes);
+        }
+
+        /**
+         * @brief Checks section `id` against its checksum. Reads all of its pages.
+         * @throws std::ios_base::failure If there is no such section, or it is corrupt.
+         *
+         * @param id section id
+         */
+        void verify(uint32_t id) const {
+            if (utility::crc32c(this->bytes(id).data(), this->entry(id).bytes) != this->entry(id).crc) {
+                this->fail("has a corrupt section " + std::to_string(id));
+            }
+        }
+
+        /**
+         * @brief Handle that keeps the mapping alive. Give it to every view that outlives the reader.
+         *
+         * @return std::shared_ptr<void const> shared owner of the mapping
+         */
+        std::shared_ptr<void const> keepAlive() const noexcept {
+            return file_;
+        }
+
+    private:
+        std::shared_ptr<utility::MappedFile> file_;
+        std::string fname_;
+        std::vector<SectionEntry> entries_;
+
+        SectionEntry const* find(uint32_t id) const noexcept {
+            const auto it = std::find_if(entries_.begin(), entries_.end(),
+                [id](SectionEntry const& entry) { return entry.id == id; });
+            return (it == entries_.end()) ? nullptr : &(*it);
+        }
+
+        [[noreturn]] void fail(std::string const& reason) const {
+            throw std::ios_base::failure("SectionReader -- \"" + fname_ + "\" " + reason + ".");
+        }
+};
+
+}   // end namespace serial
@@ -0,0 +1,513 @@
+/*  Implementation of a SparseArray range partitioned into independent shards
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// local includes
+#include "sparsearray.h"
+#include "utilities.h"
+
+namespace sparse {
+
+/**
+ * @brief A SparseArray split by index range into `numShards` independent SparseArrays (shards) of `shardSize`
+ * positions each, the last one possibly shorter. Each shard has its own positions and rank index, so shards can be
+ * built, finalized, saved, and loaded separately: in parallel, on different NUMA nodes, or on different machines.
+ * Global ranks come from the number of elements before each shard, so `numElemAt` and `getAtRank` cost one shard
+ * query plus (for getAtRank) a binary search over the shards.
+ *
+ * Shard s belongs to NUMA node `nodeOf(s)`: consecutive shards share a node. `fromSorted`, `create`, `finalize`, and
+ * `load` build each shard on a thread pinned to its node, so the shard's memory is allocated there; route queries for
+ * shard s to threads on its node for local lookups. Appended elements are allocated by the appending thread.
+ *
+ * @tparam T type to store within array
+ * @tparam Positions how each shard stores its set positions. See PositionsBackend.
+ */
+template <typename T, PositionsBackend Positions = BitVectorPositions>
+class ShardedSparseArray {
+    /**
+     * @brief All saved manifests start with these 4 bytes.
+     */
+    constexpr static uint32_t FILE_MAGIC = 0x5a4d0e5d;
+
+    /**
+     * @brief Manifest layout version written after the magic.
+     */
+    constexpr static uint32_t FILE_VERSION = 1;
+
+    public:
+        using Shard = SparseArray<T, Positions>;
+
+        /**
+         * @brief Construct an empty ShardedSparseArray of size 0.
+         * @see create
+         */
+        ShardedSparseArray() = default;
+
+        ShardedSparseArray(ShardedSparseArray&&) noexcept = default;
+        ShardedSparseArray& operator=(ShardedSparseArray&&) noexcept = default;
+
+        /**
+         * @brief Resets to `size` empty positions split into `numShards` shards.
+         * @throws std::invalid_argument if numShards is 0.
+         *
+         * @param size size of the sparse array
+         * @param numShards number of shards
+         */
+        void create(uint64_t size, uint32_t numShards) {
+            this->reset(size, numShards);
+            this->forEachShard([this](uint32_t s) {
+                shards_[s].create(this->shardLength(s));
+            });
+        }
+
+        /**
+         * @brief Builds a ShardedSparseArray from (position, value) pairs sorted by strictly increasing position.
+         * Splits the pairs at shard boundaries with a binary search each, then builds every shard with
+         * SparseArray::fromSorted on a thread pinned to its node.
+         * @throws std::out_of_range if a position is out of bounds.
+         * @throws std::invalid_argument if positions are not strictly increasing, or numShards is 0.
+         *
+         * @tparam It random access iterator over pair-like (position, value) elements
+         * @param size size of the sparse array
+         * @param numShards number of shards
+         * @param first first (position, value) pair
+         * @param last end of the pairs
+         * @return ShardedSparseArray the filled array
+         */
+        template <std::random_access_iterator It>
+        static ShardedSparseArray fromSorted(uint64_t size, uint32_t numShards, It first, It last) {
+            ShardedSparseArray array;
+            array.reset(size, numShards);
+
+            /* shard s gets the pairs in [bounds[s], bounds[s+1]) */
+            std::vector<It> bounds(numShards + 1, last);
+            bounds[0] = first;
+            for (uint32_t s = 1; s < numShards; s += 1) {
+                const uint64_t begin = array.shardBegin(s);
+                bounds[s] = std::partition_point(bounds[s-1], last,
+                    [begin](auto const& pair) { return std::get<0>(pair) < begin; });
+            }
+            /* positions past the end, and out of order ones, are caught below and by each shard's fromSorted */
+
+            array.forEachShard([&array, &bounds](uint32_t s) {
+                const uint64_t begin = array.shardBegin(s);
+                if (bounds[s] != bounds[s+1] && std::get<0>(*bounds[s]) < begin) {
+                    throw std::invalid_argument("ShardedSparseArray::fromSorted -- positions are not sorted.");
+                }
+                auto local = std::ranges::subrange(bounds[s], bounds[s+1]) | std::views::transform(
+                    [begin](auto const& pair) {
+                        return std::pair<uint64_t, T const&>(std::get<0>(pair) - begin, std::get<1>(pair));
+                    });
+                array.shards_[s] = Shard::fromSorted(array.shardLength(s), local.begin(), local.end());
+            });
+            array.countElements();
+            return array;
+        }
+
+        /**
+         * @brief Add element to the end of the array. Positions must increase across every append, as with
+         * SparseArray::append.
+         * @throws std::out_of_range if the position is out of bounds.
+         * @throws std::invalid_argument if the position is at or before the last appended position.
+         *
+         * @param elem element to append
+         * @param pos where to insert it
+         */
+        void append(T const& elem, uint64_t pos) {
+            const uint32_t s = this->routeAppend(pos);
+            shards_[s].append(elem, pos - this->shardBegin(s));
+            numElem_ += 1;
+        }
+
+        /**
+         * @brief Add element to the end of the array, moving `elem` into it.
+         * @throws std::out_of_range if the position is out of bounds.
+         * @throws std::invalid_argument if the position is at or before the last appended position.
+         *
+         * @param elem element to move in
+         * @param pos where to insert it
+         */
+        void append(T&& elem, uint64_t pos) {
+            const uint32_t s = this->routeAppend(pos);
+            shards_[s].append(std::move(elem), pos - this->shardBegin(s));
+            numElem_ += 1;
+        }
+
+        /**
+         * @brief Finalizes every shard, in parallel on their nodes.
+         * @see SparseArray::finalize
+         */
+        void finalize() {
+            this->forEachShard([this](uint32_t s) {
+                shards_[s].finalize();
+            });
+        }
+
+        /**
+         * @brief Looks up the element at `index` without copying it.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index index of sparse array
+         * @return T const* the value at `index`, or nullptr if none is present. Valid until its shard is modified.
+         */
+        T const* find(uint64_t index) const {
+            const uint32_t s = this->shardOf(index);
+            return shards_[s].find(index - this->shardBegin(s));
+        }
+
+        /**
+         * @brief get the element of the sparse array at `index`.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index index of sparse array
+         * @param element receives value at `index`
+         * @return true if value was present
+         * @return false if value was not present
+         */
+        bool getAtIndex(uint64_t index, T &element) const {
+            if (T const* value = this->find(index)) {
+                element = *value;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief return the rank-th element of the sparse array. Finds its shard with a binary search over the
+         * number of elements before each shard.
+         *
+         * @param rank what rank element to retrieve
+         * @param element receives the value
+         * @return true if rank < the number of elements
+         * @return false if rank >= the number of elements
+         */
+        bool getAtRank(uint64_t rank, T &element) const {
+            if (rank >= numElem_) {
+                return false;
+            }
+            /* the last shard starting at or before rank; shards after appendShard_ are empty */
+            const auto after = std::upper_bound(elemsBefore_.begin(), elemsBefore_.begin() + appendShard_ + 1, rank);
+            const uint32_t s = static_cast<uint32_t>(after - elemsBefore_.begin()) - 1;
+            return shards_[s].getAtRank(rank - elemsBefore_[s], element);
+        }
+
+        /**
+         * @brief Counts the number of elements up to index.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
+         * @return uint64_t number of elements up to `index`
+         */
+        uint64_t numElemAt(uint64_t index) const {
+            const uint32_t s = this->shardOf(index);
+            return this->elementsBefore(s) + shards_[s].numElemAt(index - this->shardBegin(s));
+        }
+
+        /**
+         * @brief The size of the ShardedSparseArray. This is the total number of elements it can store.
+         *
+         * @return uint64_t size of sparsearray
+         */
+        uint64_t size() const noexcept {
+            return size_;
+        }
+
+        /**
+         * @brief The total number of elements in all shards.
+         *
+         * @return uint64_t total elements.
+         */
+        uint64_t numElem() const noexcept {
+            return numElem_;
+        }
+
+        /**
+         * @return uint32_t number of shards
+         */
+        uint32_t numShards() const noexcept {
+            return static_cast<uint32_t>(shards_.size());
+        }
+
+        /**
+         * @brief Which shard holds `index`.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index index of sparse array
+         * @return uint32_t shard id
+         */
+        uint32_t shardOf(uint64_t index) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (index >= size_) {
+                    throw std::out_of_range("ShardedSparseArray -- index " + std::to_string(index) +
+                        " is out of bounds.");
+                }
+            }
+            return static_cast<uint32_t>(index / shardSize_);
+        }
+
+        /**
+         * @param shard shard id
+         * @return uint64_t first index of the array that falls into `shard`
+         */
+        uint64_t shardBegin(uint32_t shard) const noexcept {
+            return std::min(size_, shard * shardSize_);
+        }
+
+        /**
+         * @brief The NUMA node a shard is built on: shards are split into one contiguous run per node.
+         *
+         * @param shard shard id
+         * @return uint32_t index into utility::numaNodeCpus()
+         */
+        uint32_t nodeOf(uint32_t shard) const noexcept {
+            return static_cast<uint32_t>(static_cast<uint64_t>(shard) * nodeCpus_.size() / shards_.size());
+        }
+
+        /**
+         * @brief One shard, e.g. to save or query it on its own. Its indices are relative to `shardBegin(shard)`.
+         *
+         * @param shard shard id
+         * @return Shard const& the shard
+         */
+        Shard const& shard(uint32_t shard) const {
+            return shards_.at(shard);
+        }
+
+        /**
+         * @brief number of bits this data structure uses
+         *
+         * @return uint64_t number of bits used by all shards and the shard offsets
+         */
+        uint64_t overhead() const noexcept {
+            uint64_t bits = 8 * sizeof(uint64_t) * elemsBefore_.size();
+            for (auto const& shard : shards_) {
+                bits += shard.overhead();
+            }
+            return bits;
+        }
+
+        /**
+         * @brief The file shard `shard` is saved to by `save`.
+         *
+         * @param prefix prefix passed to `save`
+         * @param shard shard id
+         * @return std::string file name
+         */
+        static std::string shardFileName(std::string const& prefix, uint32_t shard) {
+            return prefix + ".shard" + std::to_string(shard);
+        }
+
+        /**
+         * @brief Saves a manifest to `prefix + ".manifest"` and each shard to `shardFileName(prefix, s)`, as a
+         * regular SparseArray file, so shards can be copied to and loaded on different machines.
+         * @see load
+         * @throws std::ios_base::failure If there is an error opening or writing a file.
+         *
+         * @param prefix path prefix of the files
+         * @param saveRankTables passed to each shard's SparseArray::save
+         */
+        void save(std::string const& prefix, bool saveRankTables=false) {
+            serial::FileWriter manifest(prefix + ".manifest");
+            const uint32_t tmpMagic = FILE_MAGIC, tmpVersion = FILE_VERSION, tmpNumShards = this->numShards();
+            serial::serialize(tmpMagic, manifest);
+            serial::serialize(tmpVersion, manifest);
+            serial::serialize(size_, manifest);
+            serial::serialize(tmpNumShards, manifest);
+            for (auto const& shard : shards_) {
+                serial::serialize(shard.numElem(), manifest);
+            }
+            manifest.writeChecksum();
+            manifest.close();
+
+            for (uint32_t s = 0; s < this->numShards(); s += 1) {
+                shards_[s].save(shardFileName(prefix, s), saveRankTables);
+            }
+        }
+
+        /**
+         * @brief Loads the manifest and every shard written by `save`, each on a thread pinned to its node.
+         * @see save
+         * @throws std::ios_base::failure if a file is not found, invalid, or does not match the manifest.
+         *
+         * @param prefix path prefix of the files
+         */
+        void load(std::string const& prefix) {
+            serial::FileReader manifest(prefix + ".manifest");
+            uint32_t tmpMagic = 0, tmpVersion = 0, tmpNumShards = 0;
+            uint64_t tmpSize = 0;
+            serial::deserialize(tmpMagic, manifest);
+            serial::deserialize(tmpVersion, manifest);
+            serial::deserialize(tmpSize, manifest);
+            serial::deserialize(tmpNumShards, manifest);
+            if (!manifest || tmpMagic != FILE_MAGIC || tmpVersion != FILE_VERSION || tmpNumShards == 0) {
+                throw std::ios_base::failure("ShardedSparseArray::load -- Invalid manifest \"" + prefix +
+                    ".manifest\".");
+            }
+            std::vector<uint64_t> counts(tmpNumShards);
+            for (auto &count : counts) {
+                serial::deserialize(count, manifest);
+            }
+            if (!manifest.verifyChecksum()) {
+                throw std::ios_base::failure("ShardedSparseArray::load -- Corrupt manifest \"" + prefix +
+                    ".manifest\".");
+            }
+
+            this->reset(tmpSize, tmpNumShards);
+            this->forEachShard([this, &prefix](uint32_t s) {
+                shards_[s].load(shardFileName(prefix, s));
+            });
+            for (uint32_t s = 0; s < tmpNumShards; s += 1) {
+                this->checkShard(s, shardFileName(prefix, s));
+                if (shards_[s].numElem() != counts[s]) {
+                    throw std::ios_base::failure("ShardedSparseArray::load -- Shard file \"" +
+                        shardFileName(prefix, s) + "\" does not match the manifest.");
+                }
+            }
+            this->countElements();
+        }
+
+        /**
+         * @brief Replaces one shard with a file saved by `save` (or by SparseArray::save for a shard), e.g. one
+         * received from another machine. Loads on a thread pinned to the shard's node.
+         * @throws std::ios_base::failure if the file is not found, invalid, or its size is not the shard's.
+         *
+         * @param shard shard id
+         * @param fname shard file
+         */
+        void loadShard(uint32_t shard, std::string const& fname) {
+            Shard loaded;
+            this->onNode(this->nodeOf(shard), [&loaded, &fname]() {
+                loaded.load(fname);
+            });
+            if (loaded.size() != this->shardLength(shard)) {
+                throw std::ios_base::failure("ShardedSparseArray::loadShard -- \"" + fname + "\" is not the size of "
+                    "shard " + std::to_string(shard) + ".");
+            }
+            shards_.at(shard) = std::move(loaded);
+            this->countElements();
+        }
+
+    private:
+        std::vector<Shard> shards_;
+        std::vector<uint64_t> elemsBefore_;   /* elements in shards before s, for s <= appendShard_ */
+        std::vector<std::vector<uint32_t>> nodeCpus_;
+        uint64_t size_ = 0;
+        uint64_t shardSize_ = 1;
+        uint64_t numElem_ = 0;
+        uint32_t appendShard_ = 0;             /* last shard appended to; later shards are empty */
+
+        /**
+         * @brief Resizes to `numShards` empty shards over `size` positions, without creating them.
+         */
+        void reset(uint64_t size, uint32_t numShards) {
+            if (numShards == 0) {
+                throw std::invalid_argument("ShardedSparseArray -- number of shards must be positive.");
+            }
+            size_ = size;
+            shardSize_ = std::max<uint64_t>(1, utility::roundDivisionUp(size, numShards));
+            shards_.clear();
+            shards_.resize(numShards);
+            elemsBefore_.assign(numShards + 1, 0);
+            nodeCpus_ = utility::numaNodeCpus();
+            numElem_ = 0;
+            appendShard_ = 0;
+        }
+
+        /**
+         * @return uint64_t number of positions in `shard`
+         */
+        uint64_t shardLength(uint32_t shard) const noexcept {
+            return this->shardBegin(shard + 1) - this->shardBegin(shard);
+        }
+
+        uint64_t elementsBefore(uint32_t shard) const noexcept {
+            return (shard <= appendShard_) ? elemsBefore_[shard] : numElem_;
+        }
+
+        /**
+         * @brief Recounts the elements before every shard after shards were built or replaced. O(numShards).
+         */
+        void countElements() noexcept {
+            for (uint32_t s = 0; s < this->numShards(); s += 1) {
+                elemsBefore_[s + 1] = elemsBefore_[s] + shards_[s].numElem();
+            }
+            numElem_ = elemsBefore_.back();
+            appendShard_ = this->numShards() - 1;
+            while (appendShard_ > 0 && shards_[appendShard_].numElem() == 0) {
+                appendShard_ -= 1;
+            }
+        }
+
+        /**
+         * @brief Shard for appending at `pos`. Moving on to a later shard closes the counts of the ones skipped.
+         */
+        uint32_t routeAppend(uint64_t pos) {
+            const uint32_t s = this->shardOf(pos);
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (s < appendShard_) {
+                    throw std::invalid_argument("ShardedSparseArray::append -- position " + std::to_string(pos) +
+                        " is before the last appended position.");
+                }
+            }
+            for (; appendShard_ < s; appendShard_ += 1) {
+                elemsBefore_[appendShard_ + 1] = elemsBefore_[appendShard_] + shards_[appendShard_].numElem();
+            }
+            return s;
+        }
+
+        void checkShard(uint32_t shard, std::string const& fname) const {
+            if (shards_[shard].size() != this->shardLength(shard)) {
+                throw std::ios_base::failure("ShardedSparseArray::load -- Shard file \"" + fname + "\" is not the "
+                    "size of shard " + std::to_string(shard) + ".");
+            }
+        }
+
+        /**
+         * @brief Runs func() on a thread pinned to `node`'s CPUs.
+         */
+        template <typename Func>
+        void onNode(uint32_t node, Func&& func) const {
+            utility::ScopedAffinity affinity(nodeCpus_.at(node));
+            func();
+        }
+
+        /**
+         * @brief Runs func(s) for every shard, one thread per CPU at most, each pinned to the shard's node while it
+         * runs. Exceptions are rethrown on the calling thread.
+         */
+        template <typename Func>
+        void forEachShard(Func&& func) {
+            std::exception_ptr error;
+            std::mutex errorMutex;
+            utility::parallelFor(this->numShards(), std::thread::hardware_concurrency(), [&](uint64_t s) {
+                try {
+                    this->onNode(this->nodeOf(static_cast<uint32_t>(s)), [&func, s]() {
+                        func(static_cast<uint32_t>(s));
+                    });
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    error = error ? error : std::current_exception();
+                }
+            });
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+};
+
+} // end namespace sparse
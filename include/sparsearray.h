@@ -5,250 +5,1871 @@
 #pragma once
 
 // stl includes
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 // local includes
 #include "bitvector.h"
+#include "compressedbitvector.h"
+#include "eliasfano.h"
+#include "sectionfile.h"
 #include "utilities.h"
 
 namespace sparse {
 
+/**
+ * @brief Shared validation for the sorted builders.
+ * @throws std::out_of_range if pos >= size.
+ * @throws std::invalid_argument if pos < end, i.e. is not after the previous position.
+ */
+inline void checkSorted(uint64_t pos, uint64_t end, uint64_t size) {
+    if constexpr (utility::CHECK_BOUNDS) {
+        if (pos >= size) {
+            throw std::out_of_range("SparseArray::fromSorted -- position " + std::to_string(pos) +
+                " is out of bounds.");
+        }
+        if (pos < end) {
+            throw std::invalid_argument("SparseArray::fromSorted -- position " + std::to_string(pos) +
+                " is not after the previous position " + std::to_string(end - 1) + ".");
+        }
+    }
+}
+
+/**
+ * @brief Iterators the sorted run builders accept: random access ones, or a std::move_iterator over random access ones
+ * to move the values in (C++20 only counts those as input iterators, but they index and subtract the same).
+ */
+template <typename It>
+concept SortedRunIterator = std::random_access_iterator<It> || (requires { typename It::iterator_type; } &&
+    std::same_as<It, std::move_iterator<typename It::iterator_type>> &&
+    std::random_access_iterator<typename It::iterator_type>);
+
+/**
+ * @brief Sets the positions of (position, value) pairs sorted by strictly increasing position in `words`, a word at a
+ * time, in one pass.
+ * @throws std::out_of_range if a position is out of bounds.
+ * @throws std::invalid_argument if positions are not strictly increasing.
+ *
+ * @param words zeroed words of a bitvector of size `size`
+ * @param visit called with each value, in order. Gets an rvalue when `*first` is one (e.g. a std::move_iterator).
+ * @return uint64_t one past the last position, 0 if there are none
+ */
+template <std::input_iterator It, typename Visit>
+uint64_t writeSorted(uint64_t *words, uint64_t size, It first, It last, Visit&& visit) {
+    uint64_t currentWord = 0, currentBits = 0, end = 0;
+    for (; first != last; ++first) {
+        auto&& element = *first;
+        const uint64_t pos = std::get<0>(element);
+        checkSorted(pos, end, size);
+        if ((pos >> 6) != currentWord) {
+            words[currentWord] |= currentBits;
+            currentWord = pos >> 6;
+            currentBits = 0;
+        }
+        currentBits |= 1ull << (pos & 63);
+        visit(std::get<1>(std::forward<decltype(element)>(element)));
+        end = pos + 1;
+    }
+    if (currentBits != 0) {
+        words[currentWord] |= currentBits;
+    }
+    return end;
+}
+
+/**
+ * @brief Parallel writeSorted over runs the caller has already checked are in order with respect to each other.
+ * Words shared by two runs are merged atomically.
+ * @throws std::invalid_argument if a run is unsorted or out of bounds.
+ *
+ * @param words zeroed words of a bitvector of size `size`
+ * @param offsets offsets[r] is the rank of the first element of run r
+ * @param visit called concurrently with (rank, value) for every element. Gets an rvalue when `*it` is one.
+ * @return uint64_t one past the last position, 0 if there are none
+ */
+template <SortedRunIterator It, typename Visit>
+uint64_t writeSortedRuns(uint64_t *words, uint64_t size, std::vector<std::pair<It, It>> const& runs,
+    std::vector<uint64_t> const& offsets, uint32_t numThreads, Visit&& visit) {
+    std::vector<uint8_t> invalidRuns(runs.size(), 0);
+    utility::parallelFor(runs.size(), numThreads, [&](uint64_t r) {
+        auto const& [first, last] = runs[r];
+        if (first == last) {
+            return;
+        }
+
+        /* the whole run is checked before anything is written, since an unsorted run could reach words that
+         * belong to another run, which are written without atomics */
+        if constexpr (utility::CHECK_BOUNDS) {
+            const auto unsorted = std::adjacent_find(first, last, [](auto const& a, auto const& b) {
+                return std::get<0>(a) >= std::get<0>(b);
+            });
+            if (unsorted != last || std::get<0>(*(last - 1)) >= size) {
+                invalidRuns[r] = 1;
+                return;
+            }
+        }
+
+        /* only a run's first and last words can be shared with another run */
+        const uint64_t firstWord = std::get<0>(*first) >> 6, lastWord = std::get<0>(*(last - 1)) >> 6;
+        auto flush = [&](uint64_t word, uint64_t bits) {
+            if (word == firstWord || word == lastWord) {
+                std::atomic_ref<uint64_t>(words[word]).fetch_or(bits, std::memory_order_relaxed);
+            } else {
+                words[word] = bits;
+            }
+        };
+
+        uint64_t currentWord = firstWord, currentBits = 0;
+        uint64_t valueIndex = offsets[r];
+        for (auto it = first; it != last; ++it) {
+            auto&& element = *it;
+            const uint64_t pos = std::get<0>(element);
+            if ((pos >> 6) != currentWord) {
+                flush(currentWord, currentBits);
+                currentWord = pos >> 6;
+                currentBits = 0;
+            }
+            currentBits |= 1ull << (pos & 63);
+            visit(valueIndex++, std::get<1>(std::forward<decltype(element)>(element)));
+        }
+        flush(currentWord, currentBits);
+    });
+    if (std::find(invalidRuns.begin(), invalidRuns.end(), 1) != invalidRuns.end()) {
+        throw std::invalid_argument("SparseArray::fromSortedRuns -- a run is unsorted or out of bounds.");
+    }
+
+    uint64_t end = 0;
+    for (auto const& [first, last] : runs) {
+        if (first != last) {
+            end = std::get<0>(*(last - 1)) + 1;
+        }
+    }
+    return end;
+}
+
+/**
+ * @brief How SparseArray stores which positions are set. Implementations are BitVectorPositions (plain bitvector and
+ * rank tables), EliasFanoPositions, and StaticPositions over RankSupportInterleaved or CompressedBitVector. The
+ * backend is a template parameter, so calls are resolved and inlined at compile time.
+ *
+ * Besides the members checked here, a backend provides `buildSorted(size, first, last, visit)` and
+ * `buildSortedRuns(size, runs, offsets, numThreads, visit)`, which reset it to `size` positions, set the positions of
+ * sorted (position, value) pairs, and hand each value to `visit` (see writeSorted and writeSortedRuns).
+ * `rank(i)` counts the set positions in [0, i] and must be correct between `append` and `finalize`;
+ * `rankIfContains(i)` is the point lookup: rank(i) if position i is set and nullopt otherwise, from one probe of the
+ * structure, so an absent index costs no more than `contains`.
+ * Iterating a backend yields its set positions in increasing order, pending ones included, and ends at
+ * std::default_sentinel.
+ */
+template <typename P>
+concept PositionsBackend = std::default_initializable<P> && std::movable<P> &&
+    requires(P positions, P const& constPositions, uint64_t i, std::string const& name, std::ostream& out,
+        std::istream& in, serial::MappedReader& reader, bool flag) {
+    { P::FILE_TAG } -> std::convertible_to<uint32_t>;
+    positions.create(i);
+    { constPositions.size() } -> std::convertible_to<uint64_t>;
+    { constPositions.contains(i) } -> std::convertible_to<bool>;
+    { constPositions.rank(i) } -> std::convertible_to<uint64_t>;
+    { constPositions.rankIfContains(i) } -> std::same_as<std::optional<uint64_t>>;
+    constPositions.checkAppend(i, name);
+    positions.append(i);
+    positions.finalize();
+    { constPositions.overhead() } -> std::convertible_to<uint64_t>;
+    positions.serialize(out, flag);
+    positions.deserialize(in, flag);
+    positions.map(reader, flag);
+} && std::ranges::forward_range<P const>;
+
+/**
+ * @brief Positions policy for SparseArray that marks set positions in a BitVector with RankSupport over it. Takes
+ * about 1.25 bits per slot whatever the density, and answers rank in O(1) with two table lookups and a popcount.
+ *
+ * @see PositionsBackend
+ */
+class BitVectorPositions {
+    public:
+        /**
+         * @brief Written in SparseArray files so they can't be loaded with a different policy.
+         */
+        constexpr static uint32_t FILE_TAG = 0;
+
+        /**
+         * @brief Empty positions over an empty array.
+         */
+        BitVectorPositions() noexcept : bitvector_(8), rank_(bitvector_) {}
+
+        /**
+         * @brief Move construct. The rank tables are rebound to this object's bitvector.
+         */
+        BitVectorPositions(BitVectorPositions&& other) noexcept : bitvector_(std::move(other.bitvector_)),
+            rank_(std::move(other.rank_)), endPosition_(other.endPosition_), rankFinal_(other.rankFinal_) {
+            rank_.bitvector_ = std::cref(bitvector_);
+        }
+
+        /**
+         * @brief Move assign. The rank tables are rebound to this object's bitvector.
+         */
+        BitVectorPositions& operator=(BitVectorPositions&& other) noexcept {
+            bitvector_ = std::move(other.bitvector_);
+            rank_ = std::move(other.rank_);
+            rank_.bitvector_ = std::cref(bitvector_);
+            endPosition_ = other.endPosition_;
+            rankFinal_ = other.rankFinal_;
+            return *this;
+        }
+
+        /**
+         * @brief Resets to `size` unset positions.
+         *
+         * @param size number of positions
+         */
+        void create(uint64_t size) noexcept {
+            bitvector_ = bitvector::BitVector(size);
+            rank_ = bitvector::RankSupport(bitvector_);
+            endPosition_ = 0;
+            rankFinal_ = true;
+        }
+
+        /**
+         * @return uint64_t number of positions, set or not
+         */
+        uint64_t size() const noexcept {
+            return bitvector_.size();
+        }
+
+        /**
+         * @brief Whether position `index` is set.
+         * @throws std::out_of_range if index is out of bounds.
+         */
+        bool contains(uint64_t index) const {
+            return bitvector_.at(index);
+        }
+
+        /**
+         * @brief Counts the set positions up to and including index. Correct before `finalize`: every position is at
+         * or before the last appended superblock, so indices past it have all of the positions before them.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
+         * @return uint64_t number of set positions in [0, index]
+         */
+        uint64_t rank(uint64_t index) const {
+            if (!rankFinal_ && index / rank_.superblockSize_ > this->currentSuperblock()) {
+                if constexpr (utility::CHECK_BOUNDS) {
+                    if (index >= this->size()) {
+                        throw std::out_of_range("SparseArray::numElemAt -- index " + std::to_string(index) +
+                            " is out of bounds.");
+                    }
+                }
+                return rank_(endPosition_ - 1);
+            }
+            return rank_(index);
+        }
+
+        /**
+         * @brief rank(index) if index is set. The bit is tested first, so an absent index costs one load like
+         * `contains`, and the rank tables are only read for set positions, when the bit's word is already cached.
+         * A set position is at or before the last appended one, so its superblock is ranked even before `finalize`.
+         * Callers that need the rank whether or not the bit is set should use RankSupport::rank1WithBit.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
+         * @return std::optional<uint64_t> number of set positions in [0, index], or nullopt if index is not set
+         */
+        std::optional<uint64_t> rankIfContains(uint64_t index) const {
+            if (!bitvector_.at(index)) {
+                return std::nullopt;
+            }
+            return rank_.rank1(index);
+        }
+
+        /**
+         * @brief Checks that `pos` can be appended.
+         * @throws std::out_of_range if pos is out of bounds.
+         * @throws std::invalid_argument if pos is set or before the last set position.
+         */
+        void checkAppend(uint64_t pos, std::string const& name) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (bitvector_.at(pos)) {
+                    throw std::invalid_argument("SparseArray::" + name + " -- position " + std::to_string(pos) +
+                        " already set.");
+                }
+                if (pos < endPosition_) {
+                    throw std::invalid_argument("SparseArray::" + name + " -- position " + std::to_string(pos) +
+                        " is before the last appended position " + std::to_string(endPosition_ - 1) + ".");
+                }
+            }
+        }
+
+        /**
+         * @brief Sets bit `pos` (after every set bit) and updates the rank tables up to its superblock. Moving to a
+         * new superblock refills the previous current superblock and any skipped ones once; staying in the same
+         * superblock only bumps the block counts after pos, which is O(log n) entries. The superblocks after it are
+         * left for `finalize`.
+         *
+         * @param pos position being appended
+         */
+        void append(uint64_t pos) {
+            bitvector_.set(pos, 1);
+
+            const uint64_t superblock = pos / rank_.superblockSize_;
+            const uint64_t current = this->currentSuperblock();
+            if (endPosition_ == 0 || superblock != current) {
+                rank_.fillTables(current, superblock + 1, rank_.superblocks_[current]);
+            } else {
+                const uint64_t blocksPerSuperblock = rank_.superblockSize_ / rank_.blockSize_;
+                const uint64_t endBlock = std::min((superblock + 1) * blocksPerSuperblock, rank_.blocks_.size());
+                for (uint64_t block = pos / rank_.blockSize_ + 1; block < endBlock; block += 1) {
+                    rank_.blocks_.set(block, rank_.blocks_[block] + 1);
+                }
+            }
+
+            endPosition_ = pos + 1;
+            rankFinal_ = false;
+        }
+
+        /**
+         * @brief Brings the rank tables after the last appended superblock up to date, in one O(n) pass. Does
+         * nothing if no position was appended since the last call.
+         */
+        void finalize() {
+            if (!rankFinal_) {
+                rank_.buildTables(this->currentSuperblock() * rank_.superblockSize_);
+                rankFinal_ = true;
+            }
+        }
+
+        /**
+         * @brief Resets to `size` positions and sets the positions of sorted (position, value) pairs in one pass, a
+         * word at a time, then builds the rank tables once.
+         * @see writeSorted
+         */
+        template <std::input_iterator It, typename Visit>
+        void buildSorted(uint64_t size, It first, It last, Visit&& visit) {
+            bitvector_ = bitvector::BitVector(size);
+            this->finishBuild(writeSorted(bitvector_.words(), size, first, last, visit), 1);
+        }
+
+        /**
+         * @brief Parallel buildSorted over runs the caller has already checked are in order with respect to each
+         * other. The rank tables are built with the same threads.
+         * @see writeSortedRuns
+         */
+        template <SortedRunIterator It, typename Visit>
+        void buildSortedRuns(uint64_t size, std::vector<std::pair<It, It>> const& runs,
+            std::vector<uint64_t> const& offsets, uint32_t numThreads, Visit&& visit) {
+            bitvector_ = bitvector::BitVector(size);
+            this->finishBuild(writeSortedRuns(bitvector_.words(), size, runs, offsets, numThreads, visit), numThreads);
+        }
+
+        /**
+         * @brief The set positions in increasing order, scanned a word at a time.
+         *
+         * @return iterator at the first set position
+         */
+        auto begin() const noexcept {
+            return bitvector_.ones().begin();
+        }
+
+        /**
+         * @return std::default_sentinel_t the end of the positions
+         */
+        std::default_sentinel_t end() const noexcept {
+            return std::default_sentinel;
+        }
+
+        /**
+         * @return uint64_t bits used by the bitvector and rank tables
+         */
+        uint64_t overhead() const noexcept {
+            return rank_.overhead() + bitvector_.size();
+        }
+
+        /**
+         * @brief Writes the bits and, if `saveIndex`, the rank tables (finalizing them first).
+         *
+         * @param out destination of data
+         * @param saveIndex whether to save the rank tables or leave them for `deserialize` to rebuild
+         */
+        void serialize(std::ostream& out, bool saveIndex) {
+            serial::serialize(bitvector_, out);
+            if (saveIndex) {
+                this->finalize();
+                serial::pad(out);
+                rank_.serialize(out);
+            }
+        }
+
+        /**
+         * @brief Reads data written by `serialize`. Will reallocate.
+         *
+         * @param in source of data
+         * @param hasIndex whether the rank tables were saved
+         */
+        void deserialize(std::istream& in, bool hasIndex) {
+            this->create(0);
+            serial::deserialize(bitvector_, in);
+            if (hasIndex) {
+                serial::skipPadding(in);
+                rank_.deserialize(in);
+            } else {
+                rank_ = bitvector::RankSupport(bitvector_);
+            }
+            endPosition_ = this->lastPosition() + 1;
+        }
+
+        /**
+         * @brief Views data written by `serialize` in a mapped file. The bits are copy-on-write, so appending still
+         * works. Rank tables that weren't saved are rebuilt in memory.
+         *
+         * @param reader mapped file positioned where `serialize` started writing
+         * @param hasIndex whether the rank tables were saved
+         */
+        void map(serial::MappedReader& reader, bool hasIndex) {
+            this->create(0);
+            bitvector_.map(reader);
+            if (hasIndex) {
+                reader.skipPadding();
+                rank_.map(reader);
+            } else {
+                rank_ = bitvector::RankSupport(bitvector_);
+            }
+            endPosition_ = this->lastPosition() + 1;
+        }
+
+    private:
+        bitvector::BitVector bitvector_;
+        bitvector::RankSupport rank_;
+        uint64_t endPosition_ = 0;  /* one past the last set position, 0 if empty */
+        bool rankFinal_ = true;     /* false if rank tables after currentSuperblock() are stale */
+
+        /**
+         * @brief The superblock holding the last set position. Its rank table entries, and those of every superblock
+         * before it, are always up to date.
+         *
+         * @return uint64_t superblock index
+         */
+        uint64_t currentSuperblock() const noexcept {
+            return (endPosition_ == 0) ? 0 : (endPosition_ - 1) / rank_.superblockSize_;
+        }
+
+        /**
+         * @brief Position of the last set bit, or -1 (so that + 1 gives 0) if there is none.
+         *
+         * @return uint64_t last set position
+         */
+        uint64_t lastPosition() const noexcept {
+            uint64_t const* words = bitvector_.words();
+            for (uint64_t word = bitvector_.numWords(); word > 0; word -= 1) {
+                if (words[word - 1] != 0) {
+                    return (word - 1) * bitvector::BitVector::WORD_BITS + 63 - std::countl_zero(words[word - 1]);
+                }
+            }
+            return ~0ull;
+        }
+
+        /**
+         * @brief Builds the rank tables once the bits of a sorted build are written.
+         *
+         * @param end one past the last set position
+         * @param numThreads threads to build the tables with
+         */
+        void finishBuild(uint64_t end, uint32_t numThreads) {
+            rank_ = bitvector::RankSupport(bitvector_, numThreads);
+            endPosition_ = end;
+            rankFinal_ = true;
+        }
+};
+
+static_assert(PositionsBackend<BitVectorPositions>);
+
+/**
+ * @brief Positions appended to an immutable positions structure since it was last rebuilt. They are sorted and all
+ * after the structure's positions, so queries binary search them until the owner's `finalize` folds them in.
+ */
+class PendingPositions {
+    public:
+        /**
+         * @brief Drops the pending positions after they were folded in, or to start over.
+         *
+         * @param end one past the last position already in the structure, 0 if none
+         */
+        void reset(uint64_t end) noexcept {
+            positions_ = {};
+            end_ = end;
+        }
+
+        /**
+         * @brief Checks that `pos` can be appended to positions [0, size).
+         * @throws std::out_of_range if pos is out of bounds.
+         * @throws std::invalid_argument if pos is set or before the last set position.
+         */
+        void checkAppend(uint64_t pos, uint64_t size, std::string const& name) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (pos >= size) {
+                    throw std::out_of_range("SparseArray::" + name + " -- position " + std::to_string(pos) +
+                        " is out of bounds.");
+                }
+                if (pos < end_) {
+                    throw std::invalid_argument("SparseArray::" + name + " -- position " + std::to_string(pos) +
+                        " is not after the last appended position " + std::to_string(end_ - 1) + ".");
+                }
+            }
+        }
+
+        /**
+         * @brief Adds `pos`, which must have passed checkAppend.
+         */
+        void append(uint64_t pos) {
+            positions_.push_back(pos);
+            end_ = pos + 1;
+        }
+
+        /**
+         * @return true if `index` is pending
+         */
+        bool contains(uint64_t index) const noexcept {
+            return std::binary_search(positions_.cbegin(), positions_.cend(), index);
+        }
+
+        /**
+         * @return uint64_t number of pending positions <= index
+         */
+        uint64_t rank(uint64_t index) const noexcept {
+            return std::upper_bound(positions_.cbegin(), positions_.cend(), index) - positions_.cbegin();
+        }
+
+        /**
+         * @return std::pair<uint64_t, bool> rank(index) and contains(index) from one binary search
+         */
+        std::pair<uint64_t, bool> rankAndContains(uint64_t index) const noexcept {
+            const uint64_t count = this->rank(index);
+            return {count, count != 0 && positions_[count - 1] == index};
+        }
+
+        /**
+         * @return std::vector<uint64_t> const& the pending positions, in increasing order
+         */
+        std::vector<uint64_t> const& positions() const noexcept {
+            return positions_;
+        }
+
+        /**
+         * @return uint64_t one past the last set position, pending or not
+         */
+        uint64_t end() const noexcept {
+            return end_;
+        }
+
+        /**
+         * @return uint64_t bits used by the pending list
+         */
+        uint64_t overhead() const noexcept {
+            return 8 * sizeof(uint64_t) * positions_.size();
+        }
+
+        /**
+         * @brief Iterator over the positions of a structure followed by the pending positions.
+         *
+         * @tparam It iterator over the structure's positions, ending at std::default_sentinel
+         */
+        template <std::forward_iterator It>
+        class Iterator {
+            public:
+                using value_type = uint64_t;
+                using difference_type = std::ptrdiff_t;
+
+                Iterator() = default;
+
+                Iterator(It structure, uint64_t const* pending, uint64_t const* pendingEnd) : structure_(structure),
+                    pending_(pending), pendingEnd_(pendingEnd) {}
+
+                uint64_t operator*() const noexcept {
+                    return (structure_ != std::default_sentinel) ? *structure_ : *pending_;
+                }
+
+                Iterator& operator++() noexcept {
+                    if (structure_ != std::default_sentinel) {
+                        ++structure_;
+                    } else {
+                        ++pending_;
+                    }
+                    return *this;
+                }
+
+                Iterator operator++(int) noexcept {
+                    Iterator previous = *this;
+                    ++(*this);
+                    return previous;
+                }
+
+                bool operator==(Iterator const& other) const noexcept {
+                    return structure_ == other.structure_ && pending_ == other.pending_;
+                }
+
+                bool operator==(std::default_sentinel_t) const noexcept {
+                    return structure_ == std::default_sentinel && pending_ == pendingEnd_;
+                }
+
+            private:
+                It structure_;
+                uint64_t const* pending_ = nullptr;
+                uint64_t const* pendingEnd_ = nullptr;
+        };
+
+        /**
+         * @brief Chains the pending positions after a structure's.
+         *
+         * @param structure iterator at the structure's first position
+         * @return Iterator<It> iterator over both
+         */
+        template <std::forward_iterator It>
+        Iterator<It> after(It structure) const noexcept {
+            return Iterator<It>(structure, positions_.data(), positions_.data() + positions_.size());
+        }
+
+    private:
+        std::vector<uint64_t> positions_;
+        uint64_t end_ = 0;
+};
+
+/**
+ * @brief Positions policy for SparseArray that Elias-Fano encodes the set positions. Takes about 2 + log_2(n/m) bits
+ * per set position instead of 1.25 bits per slot, so at 1% density it is over 10x smaller than BitVectorPositions.
+ * Rank is two select0s and a short binary search instead of a table lookup.
+ *
+ * The encoding is immutable, so appended positions are kept in a PendingPositions list until `finalize` re-encodes
+ * everything in O(m).
+ * @see PositionsBackend
+ */
+class EliasFanoPositions {
+    public:
+        /**
+         * @brief Written in SparseArray files so they can't be loaded with a different policy.
+         */
+        constexpr static uint32_t FILE_TAG = 1;
+
+        /**
+         * @brief Resets to `size` unset positions.
+         *
+         * @param size number of positions
+         */
+        void create(uint64_t size) {
+            encoded_ = bitvector::EliasFano(size);
+            pending_.reset(0);
+        }
+
+        /**
+         * @return uint64_t number of positions, set or not
+         */
+        uint64_t size() const noexcept {
+            return encoded_.size();
+        }
+
+        /**
+         * @brief Whether position `index` is set.
+         * @throws std::out_of_range if index is out of bounds.
+         */
+        bool contains(uint64_t index) const {
+            return encoded_.contains(index) || pending_.contains(index);
+        }
+
+        /**
+         * @brief Counts the set positions up to and including index.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
+         * @return uint64_t number of set positions in [0, index]
+         */
+        uint64_t rank(uint64_t index) const {
+            return encoded_.rank(index) + pending_.rank(index);
+        }
+
+        /**
+         * @brief rank(index) if index is set, from one bucket search of the encoded positions. Pending positions all
+         * follow the encoded ones, so they only need a look when index isn't encoded.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
+         * @return std::optional<uint64_t> number of set positions in [0, index], or nullopt if index is not set
+         */
+        std::optional<uint64_t> rankIfContains(uint64_t index) const {
+            const auto [encodedRank, encodedSet] = encoded_.rankAndContains(index);
+            if (encodedSet) {
+                return encodedRank;
+            }
+            const auto [pendingRank, pendingSet] = pending_.rankAndContains(index);
+            return pendingSet ? std::optional<uint64_t>(encodedRank + pendingRank) : std::nullopt;
+        }
+
+        /**
+         * @brief Checks that `pos` can be appended.
+         * @throws std::out_of_range if pos is out of bounds.
+         * @throws std::invalid_argument if pos is set or before the last set position.
+         */
+        void checkAppend(uint64_t pos, std::string const& name) const {
+            pending_.checkAppend(pos, this->size(), name);
+        }
+
+        /**
+         * @brief Adds `pos` (after every set position) to the pending list.
+         *
+         * @param pos position being appended
+         */
+        void append(uint64_t pos) {
+            pending_.append(pos);
+        }
+
+        /**
+         * @brief Re-encodes the encoded and pending positions together. Does nothing if no position was appended
+         * since the last call.
+         */
+        void finalize() {
+            auto const& pending = pending_.positions();
+            if (pending.empty()) {
+                return;
+            }
+            std::vector<uint64_t> positions;
+            positions.reserve(encoded_.count() + pending.size());
+            for (uint64_t k = 0; k < encoded_.count(); k += 1) {
+                positions.push_back(encoded_.select(k));
+            }
+            positions.insert(positions.end(), pending.cbegin(), pending.cend());
+
+            encoded_ = bitvector::EliasFano(this->size(), positions.size(), positions.cbegin(), positions.cend());
+            pending_.reset(pending_.end());
+        }
+
+        /**
+         * @brief Resets to `size` positions and encodes the positions of sorted (position, value) pairs.
+         * @throws std::out_of_range if a position is out of bounds.
+         * @throws std::invalid_argument if positions are not strictly increasing.
+         *
+         * @param visit called with each value, in order
+         */
+        template <std::input_iterator It, typename Visit>
+        void buildSorted(uint64_t size, It first, It last, Visit&& visit) {
+            std::vector<uint64_t> positions;
+            if constexpr (std::forward_iterator<It>) {
+                positions.reserve(std::distance(first, last));
+            }
+
+            uint64_t end = 0;
+            for (; first != last; ++first) {
+                auto&& element = *first;
+                const uint64_t pos = std::get<0>(element);
+                checkSorted(pos, end, size);
+                positions.push_back(pos);
+                visit(std::get<1>(std::forward<decltype(element)>(element)));
+                end = pos + 1;
+            }
+
+            encoded_ = bitvector::EliasFano(size, positions.size(), positions.cbegin(), positions.cend());
+            pending_.reset(end);
+        }
+
+        /**
+         * @brief Parallel buildSorted over runs the caller has already checked are in order with respect to each
+         * other. The positions are gathered in parallel and encoded once.
+         * @throws std::invalid_argument if a run is unsorted or out of bounds.
+         *
+         * @param offsets offsets[r] is the rank of the first element of run r
+         * @param visit called concurrently with (rank, value) for every element, an rvalue when `*it` is one
+         */
+        template <SortedRunIterator It, typename Visit>
+        void buildSortedRuns(uint64_t size, std::vector<std::pair<It, It>> const& runs,
+            std::vector<uint64_t> const& offsets, uint32_t numThreads, Visit&& visit) {
+            std::vector<uint64_t> positions(offsets.back());
+            std::vector<uint8_t> invalidRuns(runs.size(), 0);
+            utility::parallelFor(runs.size(), numThreads, [&](uint64_t r) {
+                auto const& [first, last] = runs[r];
+                uint64_t valueIndex = offsets[r];
+                for (auto it = first; it != last; ++it) {
+                    auto&& element = *it;
+                    const uint64_t pos = std::get<0>(element);
+                    if constexpr (utility::CHECK_BOUNDS) {
+                        if ((it != first && pos <= positions[valueIndex - 1]) || pos >= size) {
+                            invalidRuns[r] = 1;
+                            return;
+                        }
+                    }
+                    positions[valueIndex] = pos;
+                    visit(valueIndex++, std::get<1>(std::forward<decltype(element)>(element)));
+                }
+            });
+            if (std::find(invalidRuns.begin(), invalidRuns.end(), 1) != invalidRuns.end()) {
+                throw std::invalid_argument("SparseArray::fromSortedRuns -- a run is unsorted or out of bounds.");
+            }
+
+            encoded_ = bitvector::EliasFano(size, positions.size(), positions.cbegin(), positions.cend());
+            pending_.reset(positions.empty() ? 0 : positions.back() + 1);
+        }
+
+        /**
+         * @brief The set positions in increasing order, pending ones last.
+         *
+         * @return iterator at the first set position
+         */
+        auto begin() const noexcept {
+            return pending_.after(encoded_.begin());
+        }
+
+        /**
+         * @return std::default_sentinel_t the end of the positions
+         */
+        std::default_sentinel_t end() const noexcept {
+            return std::default_sentinel;
+        }
+
+        /**
+         * @return uint64_t bits used by the encoding and the pending list
+         */
+        uint64_t overhead() const noexcept {
+            return encoded_.overhead() + pending_.overhead();
+        }
+
+        /**
+         * @brief Finalizes and writes the encoding. Its select indices are part of it, so `saveIndex` is ignored.
+         *
+         * @param out destination of data
+         */
+        void serialize(std::ostream& out, bool /* saveIndex */) {
+            this->finalize();
+            serial::serialize(encoded_, out);
+        }
+
+        /**
+         * @brief Reads data written by `serialize`. Will reallocate.
+         *
+         * @param in source of data
+         */
+        void deserialize(std::istream& in, bool /* hasIndex */) {
+            serial::deserialize(encoded_, in);
+            this->loaded();
+        }
+
+        /**
+         * @brief Views data written by `serialize` in a mapped file. Appending still works, since appended positions
+         * go to the pending list and `finalize` encodes into new memory.
+         *
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader, bool /* hasIndex */) {
+            encoded_.map(reader);
+            this->loaded();
+        }
+
+    private:
+        bitvector::EliasFano encoded_;
+        PendingPositions pending_;
+
+        /**
+         * @brief Picks up the end position of a freshly read encoding.
+         */
+        void loaded() {
+            const uint64_t count = encoded_.count();
+            pending_.reset((count == 0) ? 0 : encoded_.select(count - 1) + 1);
+        }
+};
+
+static_assert(PositionsBackend<EliasFanoPositions>);
+
+/**
+ * @brief A rank structure StaticPositions can store positions in: built from a BitVector, answers access, rank, and
+ * both at once through `rank1WithBit`, and can list its ones again, either through `ones()` or the BitVector it keeps
+ * reading from.
+ */
+template <typename S>
+concept StaticPositionStructure = bitvector::Rankable<S> && bitvector::BitAccess<S> && std::movable<S> &&
+    std::constructible_from<S, bitvector::BitVector const&> &&
+    requires(S const& structure, uint64_t i) {
+        { structure.rank1WithBit(i) } -> std::same_as<std::pair<uint64_t, bool>>;
+    } &&
+    (bitvector::BitVectorRankable<S> || requires(S const& structure) {
+        { structure.ones() } -> std::ranges::forward_range;
+    });
+
+/**
+ * @brief Positions policy for SparseArray over any immutable rank structure, e.g. RankSupportInterleaved (one cache
+ * miss per rank) or CompressedBitVector (RRR, small for skewed or clustered positions). Like EliasFanoPositions,
+ * appended positions wait in a PendingPositions list until `finalize` rebuilds the structure.
+ *
+ * Structures that keep reading the BitVector they were built from (BitVectorRankable ones) get a heap allocated
+ * BitVector that lives as long as they do and moves with them. Save files store just those bits, and the structure is
+ * rebuilt on load. Self-contained structures are stored and mapped directly.
+ * @see PositionsBackend
+ *
+ * @tparam Structure rank structure
+ */
+template <StaticPositionStructure Structure>
+class StaticPositions {
+    /**
+     * @brief whether structure_ refers to bits_
+     */
+    constexpr static bool KEEPS_BITS = bitvector::BitVectorRankable<Structure>;
+
+    /**
+     * @brief whether reading one bit of structure_ is a plain load, much cheaper than ranking it
+     */
+    constexpr static bool CHEAP_ACCESS = !std::same_as<Structure, bitvector::CompressedBitVector>;
+
+    public:
+        /**
+         * @brief Written in SparseArray files so they can't be loaded with a different policy.
+         */
+        constexpr static uint32_t FILE_TAG = [] {
+            if constexpr (std::same_as<Structure, bitvector::RankSupportInterleaved>) {
+                return 2u;
+            } else if constexpr (std::same_as<Structure, bitvector::CompressedBitVector>) {
+                return 3u;
+            } else {
+                static_assert(sizeof(Structure) == 0, "StaticPositions -- give this Structure a FILE_TAG.");
+            }
+        }();
+
+        /**
+         * @brief Empty positions over an empty array.
+         */
+        StaticPositions() : bits_(std::make_unique<bitvector::BitVector>(0)), structure_(*bits_) {}
+
+        /**
+         * @brief Resets to `size` unset positions.
+         *
+         * @param size number of positions
+         */
+        void create(uint64_t size) {
+            this->rebuild(bitvector::BitVector(size));
+            pending_.reset(0);
+        }
+
+        /**
+         * @return uint64_t number of positions, set or not
+         */
+        uint64_t size() const noexcept {
+            return structure_.size();
+        }
+
+        /**
+         * @brief Whether position `index` is set.
+         * @throws std::out_of_range if index is out of bounds.
+         */
+        bool contains(uint64_t index) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (index >= this->size()) {
+                    throw std::out_of_range("SparseArray::getAtIndex -- index " + std::to_string(index) +
+                        " is out of bounds.");
+                }
+            }
+            return structure_[index] || pending_.contains(index);
+        }
+
+        /**
+         * @brief Counts the set positions up to and including index.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
+         * @return uint64_t number of set positions in [0, index]
+         */
+        uint64_t rank(uint64_t index) const {
+            return structure_.rank1(index) + pending_.rank(index);
+        }
+
+        /**
+         * @brief rank(index) if index is set. Where access is a single load the structure is only ranked for set
+         * positions; where access costs as much as rank (RRR walks samples and decodes a block either way) both
+         * come from one rank1WithBit. Pending positions all follow the structure's, so they only need a look
+         * when index isn't in the structure.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
+         * @return std::optional<uint64_t> number of set positions in [0, index], or nullopt if index is not set
+         */
+        std::optional<uint64_t> rankIfContains(uint64_t index) const {
+            if constexpr (CHEAP_ACCESS) {
+                if (!this->contains(index)) {
+                    return std::nullopt;
+                }
+                return structure_[index] ? structure_.rank1(index) : structure_.totalOnes() + pending_.rank(index);
+            } else {
+                const auto [structureRank, structureSet] = structure_.rank1WithBit(index);
+                if (structureSet) {
+                    return structureRank;
+                }
+                const auto [pendingRank, pendingSet] = pending_.rankAndContains(index);
+                return pendingSet ? std::optional<uint64_t>(structureRank + pendingRank) : std::nullopt;
+            }
+        }
+
+        /**
+         * @brief Checks that `pos` can be appended.
+         * @throws std::out_of_range if pos is out of bounds.
+         * @throws std::invalid_argument if pos is set or before the last set position.
+         */
+        void checkAppend(uint64_t pos, std::string const& name) const {
+            pending_.checkAppend(pos, this->size(), name);
+        }
+
+        /**
+         * @brief Adds `pos` (after every set position) to the pending list.
+         *
+         * @param pos position being appended
+         */
+        void append(uint64_t pos) {
+            pending_.append(pos);
+        }
+
+        /**
+         * @brief Rebuilds the structure with the pending positions. Kept bits are updated in place, and structures
+         * with `buildTables(startingIndex)` only recount from the first pending position; otherwise the ones are
+         * scanned into a fresh BitVector. Does nothing if no position was appended since the last call.
+         */
+        void finalize() {
+            auto const& pending = pending_.positions();
+            if (pending.empty()) {
+                return;
+            }
+
+            if constexpr (KEEPS_BITS) {
+                for (auto const& pos : pending) {
+                    bits_->set(pos, 1);
+                }
+                if constexpr (requires { structure_.buildTables(pending.front()); }) {
+                    structure_.buildTables(pending.front());
+                } else {
+                    structure_ = Structure(*bits_);
+                }
+            } else {
+                this->rebuild(bitvector::BitVector(this->size(), this->begin(), this->end()));
+            }
+            pending_.reset(pending_.end());
+        }
+
+        /**
+         * @brief Resets to `size` positions, sets the positions of sorted (position, value) pairs a word at a time,
+         * and builds the structure once.
+         * @see writeSorted
+         */
+        template <std::input_iterator It, typename Visit>
+        void buildSorted(uint64_t size, It first, It last, Visit&& visit) {
+            bitvector::BitVector bits(size);
+            const uint64_t end = writeSorted(bits.words(), size, first, last, visit);
+            this->rebuild(std::move(bits));
+            pending_.reset(end);
+        }
+
+        /**
+         * @brief Parallel buildSorted over runs the caller has already checked are in order with respect to each
+         * other. The structure itself is built on one thread.
+         * @see writeSortedRuns
+         */
+        template <SortedRunIterator It, typename Visit>
+        void buildSortedRuns(uint64_t size, std::vector<std::pair<It, It>> const& runs,
+            std::vector<uint64_t> const& offsets, uint32_t numThreads, Visit&& visit) {
+            bitvector::BitVector bits(size);
+            const uint64_t end = writeSortedRuns(bits.words(), size, runs, offsets, numThreads, visit);
+            this->rebuild(std::move(bits));
+            pending_.reset(end);
+        }
+
+        /**
+         * @brief The set positions in increasing order, pending ones last.
+         *
+         * @return iterator at the first set position
+         */
+        auto begin() const noexcept {
+            return pending_.after(this->structureOnes().begin());
+        }
+
+        /**
+         * @return std::default_sentinel_t the end of the positions
+         */
+        std::default_sentinel_t end() const noexcept {
+            return std::default_sentinel;
+        }
+
+        /**
+         * @return uint64_t the structure's overhead, plus the kept bits and the pending list
+         */
+        uint64_t overhead() const noexcept {
+            return structure_.overhead() + (KEEPS_BITS ? bits_->size() : 0) + pending_.overhead();
+        }
+
+        /**
+         * @brief Finalizes and writes the kept bits, or the structure if it is self-contained. `saveIndex` is
+         * ignored: kept bits are always re-indexed on load, and self-contained structures are their own index.
+         *
+         * @param out destination of data
+         */
+        void serialize(std::ostream& out, bool /* saveIndex */) {
+            this->finalize();
+            if constexpr (KEEPS_BITS) {
+                serial::serialize(*bits_, out);
+            } else {
+                serial::serialize(structure_, out);
+            }
+        }
+
+        /**
+         * @brief Reads data written by `serialize`. Will reallocate.
+         *
+         * @param in source of data
+         */
+        void deserialize(std::istream& in, bool /* hasIndex */) {
+            if constexpr (KEEPS_BITS) {
+                bitvector::BitVector bits(0);
+                serial::deserialize(bits, in);
+                this->rebuild(std::move(bits));
+            } else {
+                serial::deserialize(structure_, in);
+            }
+            this->loaded();
+        }
+
+        /**
+         * @brief Views data written by `serialize` in a mapped file. Kept bits are copy-on-write, so `finalize` can
+         * still set bits in them.
+         *
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader, bool /* hasIndex */) {
+            if constexpr (KEEPS_BITS) {
+                bitvector::BitVector bits(0);
+                bits.map(reader);
+                this->rebuild(std::move(bits));
+            } else {
+                structure_.map(reader);
+            }
+            this->loaded();
+        }
+
+    private:
+        std::unique_ptr<bitvector::BitVector> bits_;    /* on the heap so structure_'s reference survives moves */
+        Structure structure_;
+        PendingPositions pending_;
+
+        /**
+         * @brief The structure's set positions: the kept bits, or the structure's own `ones()`.
+         */
+        auto structureOnes() const noexcept {
+            if constexpr (KEEPS_BITS) {
+                return bits_->ones();
+            } else {
+                return structure_.ones();
+            }
+        }
+
+        /**
+         * @brief Builds the structure over `bits`, keeping them if it needs them.
+         */
+        void rebuild(bitvector::BitVector bits) {
+            if constexpr (KEEPS_BITS) {
+                auto kept = std::make_unique<bitvector::BitVector>(std::move(bits));
+                structure_ = Structure(*kept);
+                bits_ = std::move(kept);
+            } else {
+                structure_ = Structure(bits);
+            }
+        }
+
+        /**
+         * @brief Picks up the end position of a freshly read structure.
+         */
+        void loaded() {
+            const uint64_t ones = structure_.totalOnes();
+            if constexpr (bitvector::Selectable<Structure>) {
+                pending_.reset((ones == 0) ? 0 : structure_.select1(ones) + 1);
+            } else if (ones == 0) {
+                pending_.reset(0);
+            } else {
+                /* the last set position is the first index whose rank counts all the ones */
+                uint64_t lower = 0, upper = this->size() - 1;
+                while (lower < upper) {
+                    const uint64_t mid = lower + (upper - lower) / 2;
+                    if (structure_.rank1(mid) < ones) {
+                        lower = mid + 1;
+                    } else {
+                        upper = mid;
+                    }
+                }
+                pending_.reset(lower + 1);
+            }
+        }
+};
+
+/**
+ * @brief Positions in a RankSupportInterleaved: rank in one cache miss, at about twice the memory of
+ * BitVectorPositions, since the bits are kept for the structure and copied into its lines.
+ */
+using InterleavedPositions = StaticPositions<bitvector::RankSupportInterleaved>;
+
+/**
+ * @brief Positions in a CompressedBitVector: RRR compressed, for skewed or clustered positions.
+ */
+using CompressedPositions = StaticPositions<bitvector::CompressedBitVector>;
+
+static_assert(PositionsBackend<InterleavedPositions> && PositionsBackend<CompressedPositions>);
+
 /**
  * @brief SparseArray
- * 
- * @tparam T type to store within array. Can be any valid type. Compiling ::load and ::save will give errors if T is 
+ *
+ * @tparam T type to store within array. Can be any valid type. Compiling ::load and ::save will give errors if T is
  *         not a trivial type or container of trivial types (or container of container of etc...).
  *         See std::is_trivial<> and utilities.h for definition of concepts.
+ * @tparam Positions how the set positions are stored: BitVectorPositions (bitvector + rank, the default),
+ *         InterleavedPositions (fewer cache misses), EliasFanoPositions (much smaller when sparse), or
+ *         CompressedPositions (RRR, smaller when skewed). See PositionsBackend.
+ * @tparam Allocator allocates the values, e.g. a std::pmr::polymorphic_allocator over an arena or huge pages. Mapped
+ *         values (see `map`) live in the mapping instead until they are appended to.
  */
-template<typename T>
+template<typename T, PositionsBackend Positions = BitVectorPositions, typename Allocator = std::allocator<T>>
 class SparseArray {
     /**
      * @brief All saved SparseArray files should start with these 4 bytes.
      */
     constexpr static uint32_t FILE_MAGIC = 0xdeadbeef;
 
+    /**
+     * @brief Layout version written after the magic. Bump when the file layout changes.
+     */
+    constexpr static uint32_t FILE_VERSION = 5;
+
+    /**
+     * @brief Section ids of a saved SparseArray. See serial::SectionWriter.
+     */
+    enum Section : uint32_t {
+        META = 1,       /* magic, version, value size, positions tag, whether rank tables are saved, # of values */
+        POSITIONS = 2,  /* positions_.serialize */
+        VALUES = 3,     /* the values, as is or (for integers) serial::Codec::PACKED */
+    };
+
+    /**
+     * @brief What the META section says about the rest of the file.
+     */
+    struct FileHeader {
+        bool hasRankTables;
+        uint64_t numValues;
+        serial::Codec valuesCodec;
+    };
+
     public:
 
         /**
          * @brief Construct a new SparseArray object. Empty initially.
          * @see create
-         * 
+         *
+         */
+        SparseArray() = default;
+
+        /**
+         * @brief Construct a new, empty SparseArray whose values are allocated with `allocator`.
+         * @see create
+         *
+         * @param allocator allocator for the values
+         */
+        explicit SparseArray(Allocator const& allocator) : values_(allocator) {}
+
+        SparseArray(SparseArray&&) noexcept = default;
+        SparseArray& operator=(SparseArray&&) noexcept = default;
+
+        /**
+         * @brief Builds a SparseArray of size `size` from (position, value) pairs sorted by strictly increasing
+         * position, in one pass. Values are reserved up front when the range size is known, and the positions are
+         * built once at the end (for BitVectorPositions, bits are written a word at a time and the rank tables are
+         * built once). Values are moved in if the iterator yields rvalues, e.g. a std::move_iterator.
+         * @throws std::out_of_range if a position is out of bounds.
+         * @throws std::invalid_argument if positions are not strictly increasing.
+         *
+         * @tparam It input iterator over pair-like (position, value) elements
+         * @param size size of the sparse array
+         * @param first first (position, value) pair
+         * @param last end of the pairs
+         * @param allocator allocator for the values
+         * @return SparseArray the filled array
+         */
+        template <std::input_iterator It>
+        static SparseArray fromSorted(uint64_t size, It first, It last, Allocator const& allocator = Allocator()) {
+            SparseArray array(allocator);
+            if constexpr (std::forward_iterator<It>) {
+                array.values_.reserve(std::distance(first, last));
+            }
+            array.positions_.buildSorted(size, first, last, [&array](auto&& value) {
+                array.values_.push_back(std::forward<decltype(value)>(value));
+            });
+            return array;
+        }
+
+        /**
+         * @brief Builds a SparseArray from pre-partitioned sorted runs in parallel. Each run is a (first, last) range
+         * of (position, value) pairs sorted by strictly increasing position, and every position in a run is less than
+         * every position in the next run. Runs are written by up to `numThreads` threads, which then build the
+         * positions' index. Values are moved in if the runs' iterators yield rvalues, e.g. std::move_iterators.
+         * @see fromSorted
+         * @throws std::out_of_range if a position is out of bounds.
+         * @throws std::invalid_argument if positions are not strictly increasing within and across runs.
+         *
+         * @tparam It random access iterator (or std::move_iterator over one) over pair-like (position, value)
+         *         elements
+         * @param size size of the sparse array
+         * @param runs sorted, non-overlapping runs in increasing order
+         * @param numThreads number of threads. 0 uses std::thread::hardware_concurrency().
+         * @param allocator allocator for the values
+         * @return SparseArray the filled array
          */
-        SparseArray() noexcept : bitvector_(8), rank_(bitvector_) {}
+        template <SortedRunIterator It>
+        static SparseArray fromSortedRuns(uint64_t size, std::vector<std::pair<It, It>> const& runs,
+            uint32_t numThreads = 0, Allocator const& allocator = Allocator()) requires std::default_initializable<T> {
+            if (numThreads == 0) {
+                numThreads = std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            /* where each run's values go, and the runs' order with respect to each other */
+            std::vector<uint64_t> offsets(runs.size() + 1, 0);
+            uint64_t end = 0;
+            for (uint64_t r = 0; r < runs.size(); r += 1) {
+                auto const& [first, last] = runs[r];
+                offsets[r + 1] = offsets[r] + (last - first);
+                if (first != last) {
+                    checkSorted(std::get<0>(*first), end, size);
+                    end = std::get<0>(*(last - 1)) + 1;
+                }
+            }
+
+            SparseArray array(allocator);
+            array.values_.resize(offsets.back());
+            array.positions_.buildSortedRuns(size, runs, offsets, numThreads,
+                [&array](uint64_t index, auto&& value) {
+                    array.values_[index] = std::forward<decltype(value)>(value);
+                });
+            return array;
+        }
 
         /**
          * @brief initialize the array with size `size`
-         * 
+         *
          * @param size size of the sparse array
          */
-        void create(uint64_t size) noexcept {
-            bitvector_ = bitvector::BitVector(size);
-            rank_ = bitvector::RankSupport(bitvector_);
+        void create(uint64_t size) {
+            positions_.create(size);
             values_.clear();
+            mappedValues_ = {};
+            mapping_.reset();
+        }
+
+        /**
+         * @brief Reserves room for `expectedElems` values, so appending up to that many never reallocates. Copies
+         * mapped values out of the mapping first, as `append` would.
+         *
+         * @param expectedElems total number of elements expected
+         */
+        void reserve(uint64_t expectedElems) {
+            this->ownValues();
+            values_.reserve(expectedElems);
         }
 
         /**
-         * @brief Add element to end of sparse array. Copy of `elem` is moved into array.
-         * @throws std::invalid_argument if the position is already set.
+         * @brief Add element to end of sparse array. Copy of `elem` is stored in the array. Positions must be appended
+         * in increasing order. With the pending list backends (EliasFanoPositions, StaticPositions) this is amortized
+         * O(1) and indexing is deferred to `finalize` (queries don't need it, see `numElemAt`). BitVectorPositions
+         * keeps its rank tables current up to the appended superblock instead: an append in the same superblock as
+         * the last one bumps the O(log n) block counts after it, and one in a later superblock refills the tables of
+         * the superblocks in between (see BitVectorPositions::append).
+         * @throws std::invalid_argument if the position is already set or is before the last appended position.
          * @throws std::out_of_range if the position is out of bounds.
-         * 
+         *
          * @param elem element to append
          * @param pos where to insert it
          */
         void append(T const& elem, uint64_t pos) {
-            if constexpr (utility::CHECK_BOUNDS) {
-                if (bitvector_.at(pos)) {
-                    throw std::invalid_argument("SparseArray::append -- position " + std::to_string(pos) + 
-                        " already set.");
-                }
-            }
+            this->emplaceBack("append", pos, elem);
+        }
 
-            values_.push_back(elem);
-            bitvector_.set(pos, 1);
-            rank_.buildTables(pos);
+        /**
+         * @brief Add element to end of sparse array, moving `elem` into it. Otherwise the same as the copying append.
+         * @throws std::invalid_argument if the position is already set or is before the last appended position.
+         * @throws std::out_of_range if the position is out of bounds.
+         *
+         * @param elem element to move in
+         * @param pos where to insert it
+         */
+        void append(T&& elem, uint64_t pos) {
+            this->emplaceBack("append", pos, std::move(elem));
         }
 
         /**
-         * @brief Construct T(Args ...args) at the index in the sparse array. Only handles appending.
-         * 
-         * @tparam Args Constructor arguments for data type T. Forwarded to constructor.
+         * @brief Construct T(std::forward<Args>(args)...) at the index in the sparse array. Only handles appending.
+         * @throws std::invalid_argument if the position is already set or is before the last appended position.
+         * @throws std::out_of_range if the position is out of bounds.
+         *
+         * @tparam Args Constructor arguments for data type T. Perfectly forwarded to constructor.
          * @param pos Index to insert at.
          * @param args Constructor arguments.
-         * @return T& Returns a reference to the constructed value.
+         * @return T& Returns a reference to the constructed value. Valid until the next append.
          */
         template<class... Args>
-        T& emplace(uint64_t pos, Args ...args) {
-            if constexpr (utility::CHECK_BOUNDS) {
-                if (bitvector_.at(pos)) {
-                    throw std::invalid_argument("SparseArray::emplace -- position " + std::to_string(pos) + 
-                        " already set.");
-                }
-            }
+        T& emplace(uint64_t pos, Args&& ...args) {
+            return this->emplaceBack("emplace", pos, std::forward<Args>(args)...);
+        }
 
-            auto &ref = values_.emplace_back(std::forward<Args>(args)...);
-            bitvector_.set(pos, 1);
-            rank_.buildTables(pos);
-            return ref;
+        /**
+         * @brief Finishes the indexing deferred by `append`: for BitVectorPositions, the rank tables after the last
+         * appended superblock are filled in one O(n) pass; for EliasFanoPositions, the appended positions are
+         * encoded in O(m). Queries are correct without it, but faster after it with EliasFanoPositions. Does nothing
+         * if no element was appended since the last call.
+         */
+        void finalize() {
+            positions_.finalize();
         }
 
         /**
          * @brief return the rank-th element of the sparse array.
-         * 
+         *
          * @param rank what rank element to retrieve
-         * @param element receives reference to value in sparse array
-         * @return true if rank >= the number of elements
-         * @return false if rank < the number of elements
+         * @param element receives a copy of the value in sparse array
+         * @return true if rank < the number of elements
+         * @return false if rank >= the number of elements
          */
-        bool getAtRank(uint64_t rank, T &element) {
-            if (rank < this->numElem()) {
-                element = values_.at(rank);
+        bool getAtRank(uint64_t rank, T &element) const {
+            if (T const* value = this->findRank(rank)) {
+                element = *value;
                 return true;
             }
             return false;
         }
 
+        /**
+         * @brief Looks up the rank-th element without copying it.
+         *
+         * @param rank what rank element to retrieve
+         * @return T const* the rank-th value, or nullptr if rank >= the number of elements. Valid until the array is
+         *         modified.
+         */
+        T const* findRank(uint64_t rank) const noexcept {
+            const auto values = this->values();
+            return (rank < values.size()) ? values.data() + rank : nullptr;
+        }
+
         /**
          * @brief get the element of the sparse array at `index`.
          * @throws std::out_of_range if index is out of bounds.
-         * 
+         *
          * @param index index of sparse array
          * @param element receives value at `index`
          * @return true if value was present
          * @return false if value was not present
          */
-        bool getAtIndex(uint64_t index, T &element) {
-            if (bitvector_.at(index)) {
-                const auto arrayIndex = rank_(index);
-                element = values_.at(arrayIndex-1); /* arrayIndex shouldn't be 0, since bv[index]=1 => rank(index)>=1*/
+        bool getAtIndex(uint64_t index, T &element) const {
+            if (T const* value = this->find(index)) {
+                element = *value;
                 return true;
             }
             return false;
         }
 
         /**
-         * @brief Counts the number of elements up to index.
-         * 
-         * @param index 
+         * @brief Looks up the element at `index` without copying it. Whether index is set and its rank come from
+         * one `rankIfContains` probe of the positions, and the value is read without a second bounds check.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index index of sparse array
+         * @return T const* the value at `index`, or nullptr if none is present. Valid until the array is modified.
+         */
+        T const* find(uint64_t index) const {
+            const auto rank = positions_.rankIfContains(index);
+            /* rank >= 1 whenever index is set, since it counts index itself */
+            return rank ? this->values().data() + (*rank - 1) : nullptr;
+        }
+
+        /**
+         * @brief Counts the number of elements up to index. Correct before `finalize`.
+         * @throws std::out_of_range if index is out of bounds.
+         *
+         * @param index
          * @return uint64_t number of elements up to `index`
          */
         uint64_t numElemAt(uint64_t index) const {
-            return rank_(index);
+            return positions_.rank(index);
         }
 
         /**
          * @brief The size of the SparseArray. This is the total number of elements it can store.
-         * 
+         *
          * @return uint64_t size of sparsearray
          */
         uint64_t size() const noexcept {
-            return bitvector_.size();
+            return positions_.size();
         }
 
         /**
-         * @brief The total number of elements currently in the SparseArray. 
-         * 
+         * @brief The total number of elements currently in the SparseArray.
+         *
          * @return uint64_t total elements.
          */
         uint64_t numElem() const noexcept {
-            return values_.size();
+            return this->values().size();
+        }
+
+        /**
+         * @brief Forward iterator over the (position, value) pairs in increasing position order. Walks the positions
+         * and the values together, so a full scan needs no rank or select; with BitVectorPositions it scans the
+         * bitvector a word at a time.
+         */
+        class const_iterator {
+            using PositionIterator = decltype(std::declval<Positions const&>().begin());
+
+            public:
+                using value_type = std::pair<uint64_t, T>;
+                using reference = std::pair<uint64_t, T const&>;
+                using difference_type = std::ptrdiff_t;
+
+                const_iterator() = default;
+
+                const_iterator(PositionIterator position, T const* value) : position_(position), value_(value) {}
+
+                /**
+                 * @return reference the current position and a reference to its value
+                 */
+                reference operator*() const noexcept {
+                    return {*position_, *value_};
+                }
+
+                const_iterator& operator++() noexcept {
+                    ++position_;
+                    ++value_;
+                    return *this;
+                }
+
+                const_iterator operator++(int) noexcept {
+                    const_iterator previous = *this;
+                    ++(*this);
+                    return previous;
+                }
+
+                bool operator==(const_iterator const& other) const noexcept {
+                    return value_ == other.value_;
+                }
+
+                bool operator==(std::default_sentinel_t) const noexcept {
+                    return position_ == std::default_sentinel;
+                }
+
+            private:
+                PositionIterator position_;
+                T const* value_ = nullptr;
+        };
+
+        /**
+         * @return const_iterator the first (position, value) pair
+         */
+        const_iterator begin() const noexcept {
+            return const_iterator(positions_.begin(), this->values().data());
+        }
+
+        /**
+         * @return std::default_sentinel_t the end of the pairs
+         */
+        std::default_sentinel_t end() const noexcept {
+            return std::default_sentinel;
         }
 
         /**
-         * @brief Save SparseArray to file. 
+         * @brief Save SparseArray to file, as a serial::SectionWriter file with META, POSITIONS, and VALUES sections.
+         * Each section has its own CRC32C, and `map` can use POSITIONS and (unpacked) VALUES in place.
          * @see load
-         * @throws std::ios_base::failure If there is an error opening the file.
-         * 
+         * @throws std::ios_base::failure If there is an error opening or writing the file.
+         *
          * @param fname Filename of file to write to.
-         * @param saveRankTables If true, then the ranktable data will be saved in the file. If false, then it is left
-         *        out and `load` will regenerate it.
+         * @param saveRankTables If true, then the ranktable data will be saved in the file (finalizing them first). If
+         *        false, then it is left out and `load` will regenerate it. EliasFanoPositions always saves its index.
+         * @param directIO If true, write with O_DIRECT where supported, so saving a large array does not fill the
+         *        page cache.
+         * @param packValues If true and T is an integer type, store the values as their difference from the smallest
+         *        one in as few bits as the largest difference needs. Smaller files for values with a small range, but
+         *        `map` has to decode them instead of using them in place.
          */
-        void save(std::string const& fname, bool saveRankTables=false) {
-            std::ofstream outputStream(fname, std::ios::out | std::ios::binary);
-            if (!outputStream) {
-                throw std::ios_base::failure("SparseArray::save -- Could not open file \"" + fname + "\" to write.");
-            }
+        void save(std::string const& fname, bool saveRankTables=false, bool directIO=false, bool packValues=false) {
+            serial::SectionWriter file(fname, directIO);
+            const auto values = this->values();
 
             /* meta data */
-            const uint32_t tmpMagic = SparseArray::FILE_MAGIC;
-            const uint32_t tmpDataSize = sizeof(T);
-            const uint32_t tmpSize = this->size();
-            serial::serialize(tmpMagic, outputStream);
-            serial::serialize(tmpDataSize, outputStream);
-            serial::serialize(tmpSize, outputStream);
+            std::ostream &meta = file.begin(META);
+            const uint32_t tmpMagic = SparseArray::FILE_MAGIC, tmpVersion = SparseArray::FILE_VERSION;
+            const uint32_t tmpDataSize = sizeof(T), tmpPositionsTag = Positions::FILE_TAG;
+            const uint8_t tmpHasRankTables = saveRankTables;
+            const uint64_t tmpNumValues = values.size();
+            serial::serialize(tmpMagic, meta);
+            serial::serialize(tmpVersion, meta);
+            serial::serialize(tmpDataSize, meta);
+            serial::serialize(tmpPositionsTag, meta);
+            serial::serialize(tmpHasRankTables, meta);
+            serial::serialize(tmpNumValues, meta);
+            file.end();
 
-            /* write bits in bitvector */
-            serial::serialize(bitvector_, outputStream);
+            /* positions and, if requested, their rank tables */
+            positions_.serialize(file.begin(POSITIONS), saveRankTables);
+            file.end();
 
-            /* write values */
-            serial::serialize(values_, outputStream);
-
-            /* save rank information */
-            if (saveRankTables) {
-                serial::serialize(rank_.superblocks_, outputStream);
-                serial::serialize(rank_.blocks_, outputStream);
+            /* values. Unpacked trivially copyable values are one aligned block so `map` can use them in place. */
+            if constexpr (std::is_integral<T>::value) {
+                if (packValues) {
+                    this->writePacked(file.begin(VALUES, serial::Codec::PACKED, values.size_bytes()));
+                    file.end();
+                    file.close();
+                    return;
+                }
             }
-
-            outputStream.close();
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                file.begin(VALUES).write(reinterpret_cast<char const*>(values.data()), values.size_bytes());
+            } else {
+                serial::serialize(values_, file.begin(VALUES));
+            }
+            file.end();
+            file.close();
         }
 
         /**
-         * @brief Loads a SparseVector from a file. Expects the format used in SparseVector::save.
+         * @brief Loads a SparseVector from a file. Expects the format used in SparseVector::save. Checks every
+         * section's checksum.
          * @see save
-         * @throws std::ios_base::failure if file not found, invalid, or some other file error.
-         * 
+         * @throws std::ios_base::failure if file not found, invalid, truncated, fails a checksum, or some other file
+         *         error.
+         *
          * @param fname Name of file to load.
          */
         void load(std::string const& fname) {
-            std::ifstream inputStream(fname, std::ios::in | std::ios::binary);
-            if (!inputStream) {
-                throw std::ios_base::failure("SparseArray::load -- Could not open file \"" + fname + "\" to read.");
+            const serial::SectionReader file(fname);
+            for (const uint32_t section : {META, POSITIONS, VALUES}) {
+                file.verify(section);
             }
+            const FileHeader header = readHeader(file, fname);
 
-            /* metadata */
-            uint32_t tmpMagic, tmpDataSize, tmpSize;
-            serial::deserialize(tmpMagic, inputStream);
-            if (tmpMagic != SparseArray::FILE_MAGIC) {
-                inputStream.close();
-                throw std::ios_base::failure("SparseArray::load -- Invalid file format reading \"" + fname + "\".");
+            /* read in positions, and read in or rebuild rank tables */
+            this->create(0);
+            serial::MemoryReader positions(file.bytes(POSITIONS));
+            positions_.deserialize(positions, header.hasRankTables);
+
+            /* read in array */
+            serial::MemoryReader values(file.bytes(VALUES));
+            if (header.valuesCodec == serial::Codec::PACKED) {
+                this->readPacked(values, fname);
+            } else if constexpr (std::is_trivially_copyable<T>::value) {
+                values_.resize(header.numValues);
+                values.read(reinterpret_cast<char*>(values_.data()), header.numValues * sizeof(T));
+            } else {
+                serial::deserialize(values_, values);
             }
-            serial::deserialize(tmpDataSize, inputStream);
-            if (tmpDataSize != sizeof(T)) {
-                inputStream.close();
-                throw std::ios_base::failure("SparseArray::load -- File \"" + fname + "\" saves different data type.");
+
+            if (!positions || !values || values_.size() != header.numValues) {
+                this->create(0);
+                throw std::ios_base::failure("SparseArray::load -- \"" + fname + "\" is truncated or corrupt.");
             }
-            serial::deserialize(tmpSize, inputStream);
+        }
 
-            /* allocate data and read in bitvector */
-            this->create(tmpSize);
-            serial::deserialize(bitvector_, inputStream);
+        /**
+         * @brief Loads a file written by `save` without copying it. Only the file's directory and META section are
+         * read up front: the positions, the values, and (if they were saved) the rank tables become views into a
+         * private mapping of the file, whose pages are read as queries touch them, and every process mapping the
+         * same file shares one copy of it in the page cache. Without saved rank tables they are rebuilt in memory,
+         * and packed values are decoded into memory. `append` and `emplace` still work: the values are copied out
+         * of the mapping first and the bits are copy-on-write.
+         * @see save
+         * @throws std::ios_base::failure if file not found, invalid, fails a checked checksum, or some other file
+         *         error.
+         *
+         * @param fname Name of file to map.
+         * @param verify If true, check the positions' and values' checksums too, which reads every page up front.
+         */
+        void map(std::string const& fname, bool verify=false) requires std::is_trivially_copyable<T>::value {
+            const serial::SectionReader file(fname);
+            file.verify(META);
+            if (verify) {
+                file.verify(POSITIONS);
+                file.verify(VALUES);
+            }
+            const FileHeader header = readHeader(file, fname);
 
-            /* read in array */
-            serial::deserialize(values_, inputStream);
+            /* positions and values in place */
+            this->create(0);
+            serial::MappedReader positions = file.reader(POSITIONS);
+            positions_.map(positions, header.hasRankTables);
 
-            /* read in or rebuild rank tables */
-            if (inputStream.peek() == EOF) {
-                rank_.buildTables();
+            if (header.valuesCodec == serial::Codec::PACKED) {
+                serial::MemoryReader values(file.bytes(VALUES));
+                this->readPacked(values, fname);
             } else {
-                serial::deserialize(rank_.superblocks_, inputStream);
-                serial::deserialize(rank_.blocks_, inputStream);
+                serial::MappedReader values = file.reader(VALUES);
+                mappedValues_ = std::span<const T>(values.view<T>(header.numValues), header.numValues);
+                mapping_ = file.keepAlive();
             }
-
-            inputStream.close();
         }
 
         /**
          * @brief number of bits this data structure uses
-         * 
+         *
          * @return uint64_t number of bits used to store meta data
          */
         uint64_t overhead() const noexcept {
-            return 8*sizeof(T)*values_.size() + rank_.overhead() + bitvector_.size();
+            return 8*sizeof(T)*this->numElem() + positions_.overhead();
+        }
+
+        /**
+         * @brief Whether the values are a view into a file opened with `map`.
+         *
+         * @return true if the values are mapped
+         */
+        bool isMapped() const noexcept {
+            return static_cast<bool>(mapping_);
+        }
+
+        /**
+         * @brief The stored values, wherever they live, in rank order: the rank-th element is `values()[rank]`. Reads
+         * them all without a copy or a rank query.
+         *
+         * @return std::span<const T> values in rank order. Valid until the array is modified.
+         */
+        std::span<const T> values() const noexcept {
+            return mapping_ ? mappedValues_ : std::span<const T>(values_);
+        }
+
+        /**
+         * @return Allocator the allocator of the values
+         */
+        Allocator get_allocator() const noexcept {
+            return values_.get_allocator();
         }
 
     private:
-        bitvector::BitVector bitvector_;
-        bitvector::RankSupport rank_;
-        std::vector<T> values_;
+        Positions positions_;
+        std::vector<T, Allocator> values_;
+        std::span<const T> mappedValues_;       /* values when mapped; values_ is empty then */
+        std::shared_ptr<void const> mapping_;   /* keeps mappedValues_ valid */
+
+        /**
+         * @brief Checks `pos` can be appended, then constructs its value from `args` at the end of values_.
+         */
+        template<class... Args>
+        T& emplaceBack(char const* function, uint64_t pos, Args&& ...args) {
+            positions_.checkAppend(pos, function);
+            this->ownValues();
+            auto &ref = values_.emplace_back(std::forward<Args>(args)...);
+            positions_.append(pos);
+            return ref;
+        }
+
+        /**
+         * @brief Copies mapped values into values_ so they can be appended to. Only trivially copyable values are
+         * ever mapped, so other types (move-only ones included) never copy here.
+         */
+        void ownValues() {
+            if constexpr (std::is_trivially_copyable<T>::value) {
+                if (mapping_) {
+                    values_.assign(mappedValues_.begin(), mappedValues_.end());
+                    mappedValues_ = {};
+                    mapping_.reset();
+                }
+            }
+        }
+
+        /**
+         * @brief Writes the values as serial::Codec::PACKED: the smallest value, then a PackedVector of each value's
+         * difference from it.
+         */
+        void writePacked(std::ostream &out) const requires std::is_integral<T>::value {
+            constexpr uint64_t CHUNK = 1024;
+            const auto values = this->values();
+            const auto [low, high] = std::minmax_element(values.begin(), values.end());
+            const uint64_t base = values.empty() ? 0 : static_cast<uint64_t>(*low);
+            const uint64_t range = values.empty() ? 0 : static_cast<uint64_t>(*high) - base;
+
+            bitvector::PackedVector packed(values.size(), std::max(1u, static_cast<uint32_t>(std::bit_width(range))));
+            uint64_t differences[CHUNK];
+            for (uint64_t begin = 0; begin < values.size(); begin += CHUNK) {
+                const uint64_t count = std::min<uint64_t>(CHUNK, values.size() - begin);
+                for (uint64_t i = 0; i < count; i += 1) {
+                    differences[i] = static_cast<uint64_t>(values[begin + i]) - base;
+                }
+                packed.pack(begin, count, differences);
+            }
+
+            serial::serialize(base, out);
+            packed.serialize(out);
+        }
+
+        /**
+         * @brief Reads values written by `writePacked` into values_.
+         * @throws std::ios_base::failure If T is not an integer type, so the values cannot have been packed.
+         */
+        void readPacked(std::istream &in, std::string const& fname) {
+            if constexpr (std::is_integral<T>::value) {
+                constexpr uint64_t CHUNK = 1024;
+                uint64_t base = 0;
+                bitvector::PackedVector packed(0, 1);
+                serial::deserialize(base, in);
+                packed.deserialize(in);
+
+                values_.resize(packed.size());
+                uint64_t differences[CHUNK];
+                for (uint64_t begin = 0; begin < packed.size(); begin += CHUNK) {
+                    const uint64_t count = std::min<uint64_t>(CHUNK, packed.size() - begin);
+                    packed.unpack(begin, count, differences);
+                    for (uint64_t i = 0; i < count; i += 1) {
+                        values_[begin + i] = static_cast<T>(base + differences[i]);
+                    }
+                }
+            } else {
+                throw std::ios_base::failure("SparseArray::load -- File \"" + fname + "\" packs values that are not "
+                    "integers.");
+            }
+        }
+
+        /**
+         * @brief Reads and checks the META section of a saved file.
+         * @throws std::ios_base::failure if it does not match this SparseArray type and layout version.
+         */
+        static FileHeader readHeader(serial::SectionReader const& file, std::string const& fname) {
+            serial::MappedReader meta = file.reader(META);
+            const uint32_t tmpMagic = meta.read<uint32_t>();
+            const uint32_t tmpVersion = meta.read<uint32_t>();
+            const uint32_t tmpDataSize = meta.read<uint32_t>();
+            const uint32_t tmpPositionsTag = meta.read<uint32_t>();
+            checkHeader(tmpMagic, tmpVersion, tmpDataSize, tmpPositionsTag, fname);
+
+            FileHeader header;
+            header.hasRankTables = meta.read<uint8_t>();
+            header.numValues = meta.read<uint64_t>();
+            header.valuesCodec = static_cast<serial::Codec>(file.entry(VALUES).codec);
+            return header;
+        }
+
+        /**
+         * @brief Throws unless a file header matches this SparseArray type and layout version.
+         * @throws std::ios_base::failure on a mismatch
+         */
+        static void checkHeader(uint32_t magic, uint32_t version, uint32_t dataSize, uint32_t positionsTag,
+            std::string const& fname) {
+            if (magic != SparseArray::FILE_MAGIC) {
+                throw std::ios_base::failure("SparseArray::load -- Invalid file format reading \"" + fname + "\".");
+            }
+            if (version != SparseArray::FILE_VERSION) {
+                throw std::ios_base::failure("SparseArray::load -- Unsupported file version " +
+                    std::to_string(version) + " in \"" + fname + "\".");
+            }
+            if (dataSize != sizeof(T)) {
+                throw std::ios_base::failure("SparseArray::load -- File \"" + fname + "\" saves different data type.");
+            }
+            if (positionsTag != Positions::FILE_TAG) {
+                throw std::ios_base::failure("SparseArray::load -- File \"" + fname + "\" stores positions with a " +
+                    "different policy.");
+            }
+        }
 };
 
-} // end namespace sparse
\ No newline at end of file
+} // end namespace sparse
@@ -3,8 +3,39 @@
     date: February 2022
 */
 #pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ios>
+#include <istream>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <thread>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__BMI2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
 
 namespace utility {
 
@@ -20,9 +51,9 @@ constexpr bool CHECK_BOUNDS = true;
  * 
  * @param num division numerator
  * @param den division denominator
- * @return constexpr uint32_t ceil(num/den)
+ * @return constexpr uint64_t ceil(num/den)
  */
-constexpr uint32_t roundDivisionUp(uint32_t num, uint32_t den) noexcept {
+constexpr uint64_t roundDivisionUp(uint64_t num, uint64_t den) noexcept {
     return num/den + (num%den == 0 ? 0 : 1);
 }
 
@@ -31,15 +62,16 @@ constexpr uint32_t roundDivisionUp(uint32_t num, uint32_t den) noexcept {
  * modified from Stanford graphics bithacks page: http://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
  * 
  * @param num input integer
- * @return constexpr uint32_t pow(ceil(log_2(num)), 2)
+ * @return constexpr uint64_t pow(ceil(log_2(num)), 2)
  */
-constexpr uint32_t roundUpToPowerOf2(uint32_t num) noexcept {
+constexpr uint64_t roundUpToPowerOf2(uint64_t num) noexcept {
     num -= 1;
     num |= num >> 1;
     num |= num >> 2;
     num |= num >> 4;
     num |= num >> 8;
     num |= num >> 16;
+    num |= num >> 32;
     return num+1;
 }
 
@@ -72,12 +104,1330 @@ T setBitRange(T oldValue, uint32_t start, uint32_t len, T newBits) {
 template <typename T>
 T getBitRange(T value, uint32_t start, uint32_t len) {
     return (((1ull << len) - 1) & (value >> start));
-} 
+}
+
+/**
+ * @brief The bits [start, start+len) of a little-endian word array, as the low bits of a word. Only reads the
+ * second word if the range crosses a word boundary.
+ *
+ * @param words word array
+ * @param start first bit to read
+ * @param len number of bits to read. Must be <= 64.
+ * @return uint64_t the bits in the range
+ */
+inline uint64_t readBits(uint64_t const* words, uint64_t start, uint32_t len) noexcept {
+    const uint64_t wordIndex = start >> 6;
+    const uint32_t offset = start & 63;
+
+    uint64_t val = words[wordIndex] >> offset;
+    if (offset + len > 64) {
+        /* offset > 0 here, since len <= 64 */
+        val |= words[wordIndex+1] << (64 - offset);
+    }
+    const uint64_t mask = (len >= 64) ? ~0ull : ((1ull << len) - 1);
+
+    return val & mask;
+}
+
+/**
+ * @brief Popcount of the bits [start, start+len) of a little-endian word array.
+ * @see readBits
+ *
+ * @param words word array
+ * @param start first bit to count
+ * @param len number of bits to count. Must be <= 64.
+ * @return uint32_t the number of ones in the range
+ */
+inline uint32_t popcountBits(uint64_t const* words, uint64_t start, uint32_t len) noexcept {
+    return std::popcount(readBits(words, start, len));
+}
+
+/**
+ * @brief ORs the low `len` bits of `value` into bits [start, start+len) of a little-endian word array. The range
+ * must be zero beforehand.
+ *
+ * @param words word array
+ * @param start first bit to write
+ * @param len number of bits to write. Must be <= 64.
+ * @param value bits to write. Bits above `len` must be zero.
+ */
+inline void orBits(uint64_t *words, uint64_t start, uint32_t len, uint64_t value) noexcept {
+    if (len == 0) {
+        return;
+    }
+    const uint64_t wordIndex = start >> 6;
+    const uint32_t offset = start & 63;
+
+    words[wordIndex] |= value << offset;
+    if (offset + len > 64) {
+        words[wordIndex+1] |= value >> (64 - offset);
+    }
+}
+
+/**
+ * @brief Overwrites bits [start, start+len) of a little-endian word array with the low `len` bits of `value`.
+ *
+ * @param words word array
+ * @param start first bit to write
+ * @param len number of bits to write. Must be in [1, 64].
+ * @param value bits to write. Bits above `len` are ignored.
+ */
+inline void writeBits(uint64_t *words, uint64_t start, uint32_t len, uint64_t value) noexcept {
+    const uint64_t wordIndex = start >> 6;
+    const uint32_t offset = start & 63;
+    const uint64_t mask = (len >= 64) ? ~0ull : ((1ull << len) - 1);
+    value &= mask;
+
+    words[wordIndex] = (words[wordIndex] & ~(mask << offset)) | (value << offset);
+    if (offset + len > 64) {
+        /* offset > 0 here, since len <= 64 */
+        const uint64_t highMask = mask >> (64 - offset);
+        words[wordIndex+1] = (words[wordIndex+1] & ~highMask) | (value >> (64 - offset));
+    }
+}
+
+/**
+ * @brief Position of the k-th (0-indexed) set bit of `word`. Uses BMI2 `pdep` + `tzcnt` when compiled for it,
+ * otherwise narrows down to a byte with popcounts and finishes with at most 7 `blsr`s.
+ * 
+ * @param word word to search. Must have more than k bits set.
+ * @param k which set bit to find, starting at 0
+ * @return uint32_t bit index in [0, 64) of the k-th set bit
+ */
+inline uint32_t selectInWord(uint64_t word, uint32_t k) noexcept {
+#if defined(__BMI2__)
+    return _tzcnt_u64(_pdep_u64(1ull << k, word));
+#else
+    uint32_t position = 0;
+    for (uint32_t width : {32u, 16u, 8u}) {
+        const uint32_t lowerOnes = std::popcount(word & ((1ull << width) - 1));
+        if (k >= lowerOnes) {
+            k -= lowerOnes;
+            word >>= width;
+            position += width;
+        }
+    }
+    for (; k > 0; k -= 1) {
+        word &= word - 1;
+    }
+    return position + std::countr_zero(word);
+#endif
+}
+
+/**
+ * @brief Counts the ones in `count` consecutive blocks of `blockSize` bits. Block k covers the bits
+ * [firstBit + k*blockSize, firstBit + (k+1)*blockSize) and its popcount is written to out[k]. 
+ * 
+ * Blocks are counted 8 at a time with AVX-512 VPOPCNTQ or 4 at a time with AVX2 (nibble lookup popcount) when the
+ * code is compiled for those targets (see `make NATIVE=1`). Otherwise each block is 1 or 2 word loads and 1 popcnt.
+ * 
+ * @param words word array
+ * @param numWords number of readable words in `words`. Used to keep vector loads in bounds.
+ * @param firstBit first bit of block 0
+ * @param blockSize bits in each block. Must be in [1, 64].
+ * @param count number of blocks to count
+ * @param out receives the `count` block popcounts
+ */
+inline void blockPopcounts(uint64_t const* words, uint64_t numWords, uint64_t firstBit, uint32_t blockSize, 
+    uint64_t count, uint32_t *out) noexcept {
+    
+    uint64_t k = 0;
+    [[maybe_unused]] const uint64_t mask = (blockSize >= 64) ? ~0ull : ((1ull << blockSize) - 1);
+
+    /* vector lanes read words[start/64] and words[start/64 + 1] unconditionally. `lanesInBounds` checks that the
+       last lane of a batch starting at block k satisfies this. */
+    [[maybe_unused]] auto lanesInBounds = [&](uint64_t lanes) {
+        return ((firstBit + (k + lanes - 1) * blockSize) >> 6) + 1 < numWords;
+    };
+
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+#if defined(__GNUC__) && !defined(__clang__)
+/* gcc < 13 warns on the `__Y = __Y` placeholders inside its own AVX-512 intrinsics (gcc bug 105593) */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    const long long bs = blockSize;
+    const __m512i laneOffsets = _mm512_setr_epi64(0, bs, 2*bs, 3*bs, 4*bs, 5*bs, 6*bs, 7*bs);
+    const __m512i maskVec = _mm512_set1_epi64(static_cast<long long>(mask));
+    const __m512i lowBits = _mm512_set1_epi64(63), sixtyFour = _mm512_set1_epi64(64), one = _mm512_set1_epi64(1);
+    for (; k + 8 <= count && lanesInBounds(8); k += 8) {
+        const __m512i starts = _mm512_add_epi64(_mm512_set1_epi64(firstBit + k*blockSize), laneOffsets);
+        const __m512i wordIdx = _mm512_srli_epi64(starts, 6);
+        const __m512i offsets = _mm512_and_si512(starts, lowBits);
+
+        const __m512i lo = _mm512_i64gather_epi64(wordIdx, words, 8);
+        const __m512i hi = _mm512_i64gather_epi64(_mm512_add_epi64(wordIdx, one), words, 8);
+
+        /* shift counts of 64 produce 0, so blocks that don't cross a word boundary take nothing from `hi` */
+        __m512i val = _mm512_or_si512(_mm512_srlv_epi64(lo, offsets), 
+                                      _mm512_sllv_epi64(hi, _mm512_sub_epi64(sixtyFour, offsets)));
+        val = _mm512_and_si512(val, maskVec);
+
+        const __m256i counts = _mm512_cvtepi64_epi32(_mm512_popcnt_epi64(val));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), counts);
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#elif defined(__AVX2__)
+    const __m256i laneOffsets = _mm256_setr_epi64x(0, blockSize, 2ll*blockSize, 3ll*blockSize);
+    const __m256i maskVec = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const __m256i lowBits = _mm256_set1_epi64x(63), sixtyFour = _mm256_set1_epi64x(64), one = _mm256_set1_epi64x(1);
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0f);
+    const __m256i nibbleCounts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i evenLanes = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    for (; k + 4 <= count && lanesInBounds(4); k += 4) {
+        const __m256i starts = _mm256_add_epi64(_mm256_set1_epi64x(firstBit + k*blockSize), laneOffsets);
+        const __m256i wordIdx = _mm256_srli_epi64(starts, 6);
+        const __m256i offsets = _mm256_and_si256(starts, lowBits);
+
+        auto const* base = reinterpret_cast<long long const*>(words);
+        const __m256i lo = _mm256_i64gather_epi64(base, wordIdx, 8);
+        const __m256i hi = _mm256_i64gather_epi64(base, _mm256_add_epi64(wordIdx, one), 8);
+
+        /* shift counts of 64 produce 0, so blocks that don't cross a word boundary take nothing from `hi` */
+        __m256i val = _mm256_or_si256(_mm256_srlv_epi64(lo, offsets), 
+                                      _mm256_sllv_epi64(hi, _mm256_sub_epi64(sixtyFour, offsets)));
+        val = _mm256_and_si256(val, maskVec);
+
+        /* popcount each byte with a nibble lookup, then sum the bytes of each 64 bit lane */
+        const __m256i byteCounts = _mm256_add_epi8(
+            _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(val, nibbleMask)),
+            _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(_mm256_srli_epi64(val, 4), nibbleMask)));
+        const __m256i counts = _mm256_sad_epu8(byteCounts, _mm256_setzero_si256());
+
+        const __m256i packed = _mm256_permutevar8x32_epi32(counts, evenLanes);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm256_castsi256_si128(packed));
+    }
+#endif
+
+    for (; k < count; k += 1) {
+        out[k] = popcountBits(words, firstBit + k*blockSize, blockSize);
+    }
+}
+
+/**
+ * @brief Reads `count` consecutive `width` bit integers starting at bit `firstBit`: out[k] = the bits
+ * [firstBit + k*width, firstBit + (k+1)*width). The same lane math as blockPopcounts unpacks 4 integers at a time
+ * with AVX2 gathers and variable shifts when compiled for it (see `make NATIVE=1`); otherwise each integer is 1 or 2
+ * word loads.
+ *
+ * @param words word array
+ * @param numWords number of readable words in `words`. Used to keep vector loads in bounds.
+ * @param firstBit first bit of integer 0
+ * @param width bits in each integer. Must be in [1, 64].
+ * @param count number of integers to read
+ * @param out receives the `count` integers
+ */
+inline void unpackBits(uint64_t const* words, uint64_t numWords, uint64_t firstBit, uint32_t width, uint64_t count,
+    uint64_t *out) noexcept {
+
+    uint64_t k = 0;
+#if defined(__AVX2__)
+    const uint64_t mask = (width >= 64) ? ~0ull : ((1ull << width) - 1);
+    const __m256i laneOffsets = _mm256_setr_epi64x(0, width, 2ll*width, 3ll*width);
+    const __m256i maskVec = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const __m256i lowBits = _mm256_set1_epi64x(63), sixtyFour = _mm256_set1_epi64x(64), one = _mm256_set1_epi64x(1);
+    auto const* base = reinterpret_cast<long long const*>(words);
+    /* lanes read words[start/64 + 1] unconditionally, so stop once the last lane's would be out of bounds */
+    for (; k + 4 <= count && ((firstBit + (k + 3) * width) >> 6) + 1 < numWords; k += 4) {
+        const __m256i starts = _mm256_add_epi64(_mm256_set1_epi64x(firstBit + k*width), laneOffsets);
+        const __m256i wordIdx = _mm256_srli_epi64(starts, 6);
+        const __m256i offsets = _mm256_and_si256(starts, lowBits);
+
+        const __m256i lo = _mm256_i64gather_epi64(base, wordIdx, 8);
+        const __m256i hi = _mm256_i64gather_epi64(base, _mm256_add_epi64(wordIdx, one), 8);
+
+        /* shift counts of 64 produce 0, so integers that don't cross a word boundary take nothing from `hi` */
+        __m256i val = _mm256_or_si256(_mm256_srlv_epi64(lo, offsets),
+                                      _mm256_sllv_epi64(hi, _mm256_sub_epi64(sixtyFour, offsets)));
+        val = _mm256_and_si256(val, maskVec);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + k), val);
+    }
+#else
+    static_cast<void>(numWords);
+#endif
+
+    for (; k < count; k += 1) {
+        out[k] = readBits(words, firstBit + k*width, width);
+    }
+}
+
+/**
+ * @brief Writes `count` consecutive `width` bit integers starting at bit `firstBit`, the inverse of unpackBits. The
+ * integers are streamed through a one word accumulator, so every word in the range is written once instead of read
+ * and written for every integer touching it. Bits outside the range are kept.
+ *
+ * @param words word array
+ * @param firstBit first bit of integer 0
+ * @param width bits in each integer. Must be in [1, 64].
+ * @param count number of integers to write
+ * @param in the `count` integers. Bits above `width` are ignored.
+ */
+inline void packBits(uint64_t *words, uint64_t firstBit, uint32_t width, uint64_t count, uint64_t const* in) noexcept {
+    if (count == 0) {
+        return;
+    }
+    const uint64_t mask = (width >= 64) ? ~0ull : ((1ull << width) - 1);
+    uint64_t wordIndex = firstBit >> 6;
+    uint32_t fill = firstBit & 63;
+    uint64_t acc = (fill == 0) ? 0 : (words[wordIndex] & ((1ull << fill) - 1));
+
+    for (uint64_t k = 0; k < count; k += 1) {
+        const uint64_t value = in[k] & mask;
+        acc |= value << fill;
+        fill += width;
+        if (fill >= 64) {
+            words[wordIndex++] = acc;
+            fill -= 64;
+            /* the bits of value that didn't fit start the next word */
+            acc = (fill == 0) ? 0 : (value >> (width - fill));
+        }
+    }
+    if (fill != 0) {
+        const uint64_t keep = ~((1ull << fill) - 1);
+        words[wordIndex] = (words[wordIndex] & keep) | acc;
+    }
+}
+
+/**
+ * @brief Runs func(task) for every task in [0, numTasks) on up to `numThreads` threads. Tasks are handed out 
+ * round-robin, so thread t runs tasks t, t+numThreads, ... Runs inline when only 1 thread is needed.
+ * 
+ * @tparam Func callable with signature void(uint64_t)
+ * @param numTasks number of tasks
+ * @param numThreads maximum number of threads to use
+ * @param func task body
+ */
+template <typename Func>
+void parallelFor(uint64_t numTasks, uint32_t numThreads, Func&& func) {
+    const uint64_t threadsToUse = std::min<uint64_t>(std::max(numThreads, 1u), numTasks);
+    if (threadsToUse <= 1) {
+        for (uint64_t task = 0; task < numTasks; task += 1) {
+            func(task);
+        }
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadsToUse);
+    for (uint64_t t = 0; t < threadsToUse; t += 1) {
+        threads.emplace_back([&func, t, threadsToUse, numTasks]() {
+            for (uint64_t task = t; task < numTasks; task += threadsToUse) {
+                func(task);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Parses a sysfs CPU or node list such as "0-3,8,10-11".
+ *
+ * @param list comma separated ids and inclusive ranges
+ * @return std::vector<uint32_t> the ids, in order
+ */
+inline std::vector<uint32_t> parseIdList(std::string const& list) {
+    std::vector<uint32_t> ids;
+    uint64_t start = 0;
+    while (start < list.size()) {
+        uint64_t end = list.find(',', start);
+        end = (end == std::string::npos) ? list.size() : end;
+        const std::string range = list.substr(start, end - start);
+        const uint64_t dash = range.find('-');
+        if (!range.empty() && range.find_first_not_of("0123456789-\n") == std::string::npos) {
+            const uint32_t first = std::stoul(range.substr(0, dash));
+            const uint32_t last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+            for (uint32_t id = first; id <= last; id += 1) {
+                ids.push_back(id);
+            }
+        }
+        start = end + 1;
+    }
+    return ids;
+}
+
+/**
+ * @brief Ids of the online NUMA nodes, read from /sys/devices/system/node/online. Without NUMA information there is
+ * just node 0.
+ *
+ * @return std::vector<uint32_t> node ids in increasing order
+ */
+inline std::vector<uint32_t> onlineNumaNodes() {
+    std::string line;
+    std::ifstream online("/sys/devices/system/node/online");
+    if (online && std::getline(online, line) && !parseIdList(line).empty()) {
+        return parseIdList(line);
+    }
+    return {0};
+}
+
+/**
+ * @brief The CPUs of each NUMA node that has any, read from /sys/devices/system/node. Without NUMA information there
+ * is one node holding every CPU.
+ *
+ * @return std::vector<std::vector<uint32_t>> CPU ids of each node, in node order
+ */
+inline std::vector<std::vector<uint32_t>> numaNodeCpus() {
+    std::vector<std::vector<uint32_t>> nodes;
+    for (const uint32_t node : onlineNumaNodes()) {
+        std::ifstream cpus("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string cpuList;
+        if (cpus && std::getline(cpus, cpuList) && !parseIdList(cpuList).empty()) {
+            nodes.push_back(parseIdList(cpuList));
+        }
+    }
+    if (nodes.empty()) {
+        std::vector<uint32_t> all(std::max(1u, std::thread::hardware_concurrency()));
+        for (uint32_t cpu = 0; cpu < all.size(); cpu += 1) {
+            all[cpu] = cpu;
+        }
+        nodes.push_back(std::move(all));
+    }
+    return nodes;
+}
+
+/**
+ * @brief Restricts the calling thread to a set of CPUs (e.g. one NUMA node's) for its lifetime, then restores the
+ * thread's previous affinity. Memory the thread touches first in the meantime is allocated on that node by Linux's
+ * default first-touch policy. Does nothing if the affinity cannot be read or set.
+ */
+class ScopedAffinity {
+    public:
+        explicit ScopedAffinity(std::vector<uint32_t> const& cpus) noexcept {
+            cpu_set_t wanted;
+            CPU_ZERO(&wanted);
+            for (const uint32_t cpu : cpus) {
+                if (cpu < CPU_SETSIZE) {
+                    CPU_SET(cpu, &wanted);
+                }
+            }
+            pinned_ = ::pthread_getaffinity_np(::pthread_self(), sizeof(previous_), &previous_) == 0 &&
+                ::pthread_setaffinity_np(::pthread_self(), sizeof(wanted), &wanted) == 0;
+        }
+
+        ScopedAffinity(ScopedAffinity const&) = delete;
+        ScopedAffinity& operator=(ScopedAffinity const&) = delete;
+
+        ~ScopedAffinity() {
+            if (pinned_) {
+                ::pthread_setaffinity_np(::pthread_self(), sizeof(previous_), &previous_);
+            }
+        }
+
+        /**
+         * @return true if the thread was pinned
+         */
+        bool pinned() const noexcept {
+            return pinned_;
+        }
+
+    private:
+        cpu_set_t previous_;
+        bool pinned_ = false;
+};
+
+/**
+ * @brief Hints that the cache line holding `ptr` will be read soon. No-op on compilers without
+ * __builtin_prefetch.
+ *
+ * @param ptr address to prefetch
+ */
+inline void prefetch(void const* ptr) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(ptr, 0, 3);
+#else
+    (void) ptr;
+#endif
+}
+
+/**
+ * @brief How many queries ahead batched lookups issue their prefetches.
+ */
+constexpr uint32_t PREFETCH_DISTANCE = 16;
+
+/**
+ * @brief Answers out[i] = query(in[i]) for every i while keeping memory requests for later queries in flight.
+ * `prefetchFar(q)` is issued 2*PREFETCH_DISTANCE queries ahead and `prefetchNear(q)` PREFETCH_DISTANCE ahead, so
+ * structures with a dependent second lookup can use the far stage to pull in the first level and the near stage
+ * to read it and prefetch the second. If `sortQueries` is true the queries are answered in increasing order, which
+ * turns random access into a forward sweep; answers are still written in input order.
+ *
+ * @tparam Far callable with signature void(uint64_t)
+ * @tparam Near callable with signature void(uint64_t)
+ * @tparam Query callable with signature uint64_t(uint64_t)
+ * @param in queries
+ * @param out answers. Must be at least as long as `in`.
+ * @param sortQueries answer the queries in sorted order
+ * @param prefetchFar first prefetch stage
+ * @param prefetchNear second prefetch stage
+ * @param query answers a single query
+ * @throws std::invalid_argument if CHECK_BOUNDS and out is shorter than in
+ */
+template <typename Far, typename Near, typename Query>
+void batchQuery(std::span<const uint64_t> in, std::span<uint64_t> out, bool sortQueries,
+    Far&& prefetchFar, Near&& prefetchNear, Query&& query) {
+    if constexpr (CHECK_BOUNDS) {
+        if (out.size() < in.size()) {
+            throw std::invalid_argument("Output span is shorter than the input span.");
+        }
+    }
+
+    const uint64_t n = in.size();
+    const uint64_t far = 2 * PREFETCH_DISTANCE, near = PREFETCH_DISTANCE;
+
+    /* (query, input position) pairs sort without chasing pointers back into `in` */
+    std::vector<std::pair<uint64_t, uint64_t>> order;
+    if (sortQueries) {
+        order.reserve(n);
+        for (uint64_t j = 0; j < n; j += 1) {
+            order.emplace_back(in[j], j);
+        }
+        std::sort(order.begin(), order.end());
+    }
+    auto queryAt = [&](uint64_t j) { return sortQueries ? order[j].first : in[j]; };
+
+    for (uint64_t j = 0; j < std::min(far, n); j += 1) {
+        prefetchFar(queryAt(j));
+    }
+    for (uint64_t j = 0; j < std::min(near, n); j += 1) {
+        prefetchNear(queryAt(j));
+    }
+    for (uint64_t j = 0; j < n; j += 1) {
+        if (j + far < n) {
+            prefetchFar(queryAt(j + far));
+        }
+        if (j + near < n) {
+            prefetchNear(queryAt(j + near));
+        }
+        out[sortQueries ? order[j].second : j] = query(queryAt(j));
+    }
+}
+
+/**
+ * @brief How `allocateAligned` gets the memory of an array. The default is the aligned operator new, zero filled. Any
+ * other page size or NUMA placement maps fresh anonymous pages for the array instead, which are zero anyway.
+ *
+ * Page sizes and placement are hints: without reserved huge pages (see /proc/sys/vm/nr_hugepages) an explicit huge
+ * page size falls back to transparent huge pages, and a NUMA policy the kernel rejects (e.g. nodes that do not exist)
+ * leaves the pages to first touch.
+ */
+struct AllocationPolicy {
+    /**
+     * @brief Pages to back the array with.
+     */
+    enum class Pages : uint8_t {
+        DEFAULT = 0,        /* whatever operator new returns */
+        SMALL,              /* base pages only (MADV_NOHUGEPAGE), even when transparent huge pages are "always" */
+        TRANSPARENT_HUGE,   /* a 2 MB aligned mapping marked MADV_HUGEPAGE, promoted by the kernel when it can */
+        HUGE_2MB,           /* MAP_HUGETLB 2 MB pages from the reserved pool */
+        HUGE_1GB,           /* MAP_HUGETLB 1 GB pages from the reserved pool */
+    };
+
+    /**
+     * @brief NUMA nodes to place the pages on.
+     */
+    enum class Numa : uint8_t {
+        DEFAULT = 0,        /* the node of the thread that first touches each page */
+        BIND,               /* only on `nodes` */
+        INTERLEAVE,         /* round robin over `nodes`, page by page */
+    };
+
+    Pages pages = Pages::DEFAULT;
+    Numa numa = Numa::DEFAULT;
+    uint64_t nodes = 0;     /* bit mask of node ids for BIND and INTERLEAVE. 0 means every online node. */
+    bool zeroFill = true;   /* false skips zeroing operator new memory, for callers that write every element */
+
+    /**
+     * @return true if arrays are mapped instead of allocated with operator new
+     */
+    bool mapped() const noexcept {
+        return pages != Pages::DEFAULT || numa != Numa::DEFAULT;
+    }
+};
+
+/**
+ * @brief bytes of the pages `allocateAligned` maps for a transparent or explicit 2 MB huge page array
+ */
+constexpr std::size_t HUGE_PAGE_BYTES = std::size_t{1} << 21;
+
+/**
+ * @brief bytes of the pages `allocateAligned` maps for an explicit 1 GB huge page array
+ */
+constexpr std::size_t GIGANTIC_PAGE_BYTES = std::size_t{1} << 30;
+
+/**
+ * @brief Maps anonymous memory of at least `bytes` bytes as `policy` asks. Used by `allocateAligned`.
+ * @throws std::bad_alloc If nothing can be mapped.
+ *
+ * @param bytes minimum size
+ * @param policy pages and placement; `policy.mapped()` should be true
+ * @return std::pair<void*, std::size_t> start (page aligned) and length of the mapping, for munmap
+ */
+inline std::pair<void*, std::size_t> mapPages(std::size_t bytes, AllocationPolicy const& policy) {
+    using Pages = AllocationPolicy::Pages;
+    bytes = std::max<std::size_t>(bytes, 1);
+
+    void *ptr = MAP_FAILED;
+    std::size_t length = 0;
+    if (policy.pages == Pages::HUGE_2MB || policy.pages == Pages::HUGE_1GB) {
+        const bool gigantic = policy.pages == Pages::HUGE_1GB;
+        const std::size_t pageBytes = gigantic ? GIGANTIC_PAGE_BYTES : HUGE_PAGE_BYTES;
+        length = roundDivisionUp(bytes, pageBytes) * pageBytes;
+        ptr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | ((gigantic ? 30 : 21) << MAP_HUGE_SHIFT), -1, 0);
+    }
+
+    if (ptr == MAP_FAILED) {
+        /* over map by one huge page and trim both ends, so huge page arrays start on a huge page boundary */
+        const bool huge = policy.pages != Pages::DEFAULT && policy.pages != Pages::SMALL;
+        const std::size_t align = huge ? HUGE_PAGE_BYTES : static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        length = roundDivisionUp(bytes, align) * align;
+        const std::size_t extra = huge ? align : 0;
+        void *raw = ::mmap(nullptr, length + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        uint8_t *first = static_cast<uint8_t*>(raw);
+        uint8_t *start = first + (roundDivisionUp(reinterpret_cast<uintptr_t>(first), align) * align -
+            reinterpret_cast<uintptr_t>(first));
+        if (start != first) {
+            ::munmap(first, start - first);
+        }
+        if (first + length + extra != start + length) {
+            ::munmap(start + length, (first + length + extra) - (start + length));
+        }
+        ptr = start;
+        if (huge) {
+            ::madvise(ptr, length, MADV_HUGEPAGE);
+        } else if (policy.pages == Pages::SMALL) {
+            ::madvise(ptr, length, MADV_NOHUGEPAGE);
+        }
+    }
+
+    /* before the first touch, so every page is placed by the policy */
+    if (policy.numa != AllocationPolicy::Numa::DEFAULT) {
+        uint64_t mask = policy.nodes;
+        if (mask == 0) {
+            for (const uint32_t node : onlineNumaNodes()) {
+                mask |= (node < 64) ? (1ull << node) : 0;
+            }
+        }
+        const int mode = (policy.numa == AllocationPolicy::Numa::BIND) ? MPOL_BIND : MPOL_INTERLEAVE;
+        ::syscall(SYS_mbind, ptr, length, mode, &mask, sizeof(mask) * 8 + 1, 0);
+    }
+    return {ptr, length};
+}
+
+/**
+ * @brief Deleter for arrays allocated with `allocateAligned`. Arrays made with `viewAligned` point into memory owned
+ * by `owner` instead; they are not freed, and just keep `owner` alive. Arrays mapped by an AllocationPolicy are
+ * unmapped (`mappedBytes` is their mapping's length).
+ *
+ * @tparam Alignment alignment in bytes the array was allocated with
+ */
+template <std::size_t Alignment>
+struct AlignedDeleter {
+    std::shared_ptr<void const> owner;
+    std::size_t mappedBytes = 0;
+
+    template <typename T>
+    void operator()(T *ptr) const noexcept {
+        if (owner) {
+            return;
+        }
+        if (mappedBytes != 0) {
+            ::munmap(const_cast<std::remove_const_t<T>*>(ptr), mappedBytes);
+        } else {
+            ::operator delete[](ptr, std::align_val_t{Alignment});
+        }
+    }
+};
+
+/**
+ * @brief Pointer to an array with `Alignment` byte alignment. Either owns the array or is a view kept alive by its
+ * deleter (see `viewAligned`).
+ */
+template <typename T, std::size_t Alignment>
+using AlignedArray = std::unique_ptr<T[], AlignedDeleter<Alignment>>;
+
+/**
+ * @brief Allocates an array of `count` elements aligned to `Alignment` bytes. It is zero initialized unless
+ * `policy.zeroFill` is false.
+ * @throws std::bad_alloc If the memory cannot be allocated or mapped.
+ *
+ * @tparam T trivial element type
+ * @tparam Alignment alignment in bytes. Must be a power of 2, and at most 4096 (a page).
+ * @param count number of elements
+ * @param policy page size and NUMA placement of the array
+ * @return AlignedArray<T, Alignment> owning pointer to the new array
+ */
+template <typename T, std::size_t Alignment>
+AlignedArray<T, Alignment> allocateAligned(std::size_t count, AllocationPolicy const& policy = AllocationPolicy()) {
+    static_assert(std::is_trivial<T>::value, "allocateAligned only supports trivial types.");
+    static_assert((Alignment & (Alignment-1)) == 0, "Alignment must be a power of 2.");
+    static_assert(Alignment <= 4096, "Alignment must be at most a page.");
+
+    if (policy.mapped()) {
+        const auto [ptr, length] = mapPages(count * sizeof(T), policy);
+        return AlignedArray<T, Alignment>(static_cast<T*>(ptr), AlignedDeleter<Alignment>{nullptr, length});
+    }
+    T *ptr = static_cast<T*>(::operator new[](count * sizeof(T), std::align_val_t{Alignment}));
+    if (policy.zeroFill) {
+        std::memset(ptr, 0, count * sizeof(T));
+    }
+    return AlignedArray<T, Alignment>(ptr);
+}
+
+/**
+ * @brief Wraps memory owned by something else (e.g. a MappedFile) as an AlignedArray. The memory is not copied or
+ * freed; the returned array keeps `owner` alive until it is destroyed.
+ *
+ * @tparam T trivial element type
+ * @tparam Alignment alignment in bytes. `ptr` must be aligned to it.
+ * @param ptr first element
+ * @param owner keeps the memory at ptr valid
+ * @return AlignedArray<T, Alignment> non-owning array
+ */
+template <typename T, std::size_t Alignment>
+AlignedArray<T, Alignment> viewAligned(T *ptr, std::shared_ptr<void const> owner) noexcept {
+    return AlignedArray<T, Alignment>(ptr, AlignedDeleter<Alignment>{std::move(owner)});
+}
+
+/**
+ * @brief A whole file mapped into memory with mmap. The mapping is private and copy-on-write: pages are shared with
+ * the page cache (and every other process mapping the file) until they are written, and writes never reach the file.
+ */
+class MappedFile {
+    public:
+        /**
+         * @brief Maps the file `fname`.
+         * @throws std::ios_base::failure If the file cannot be opened or mapped.
+         *
+         * @param fname file to map
+         */
+        explicit MappedFile(std::string const& fname) {
+            const int fd = ::open(fname.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::ios_base::failure("Could not open file \"" + fname + "\" to map.");
+            }
+
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                ::close(fd);
+                throw std::ios_base::failure("Could not stat file \"" + fname + "\".");
+            }
+            size_ = info.st_size;
+
+            if (size_ > 0) {
+                void *ptr = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                if (ptr == MAP_FAILED) {
+                    ::close(fd);
+                    throw std::ios_base::failure("Could not map file \"" + fname + "\".");
+                }
+                data_ = static_cast<uint8_t*>(ptr);
+            }
+            ::close(fd);
+        }
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+
+        ~MappedFile() {
+            if (data_) {
+                ::munmap(data_, size_);
+            }
+        }
+
+        /**
+         * @brief First byte of the mapping. Page aligned.
+         *
+         * @return uint8_t* start of the file's contents, or nullptr for an empty file
+         */
+        uint8_t *data() const noexcept {
+            return data_;
+        }
+
+        /**
+         * @brief Size of the mapped file in bytes.
+         *
+         * @return uint64_t number of bytes
+         */
+        uint64_t size() const noexcept {
+            return size_;
+        }
+
+    private:
+        uint8_t *data_ = nullptr;
+        uint64_t size_ = 0;
+};
+
+/**
+ * @brief Lookup tables for slicing-by-8 CRC32C (Castagnoli, reflected polynomial 0x82F63B78): table t maps a byte to
+ * its CRC after t more zero bytes.
+ */
+constexpr std::array<std::array<uint32_t, 256>, 8> makeCrc32cTables() {
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t byte = 0; byte < 256; byte += 1) {
+        uint32_t crc = byte;
+        for (uint32_t bit = 0; bit < 8; bit += 1) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78u : 0u);
+        }
+        tables[0][byte] = crc;
+    }
+    for (uint32_t byte = 0; byte < 256; byte += 1) {
+        for (uint32_t t = 1; t < 8; t += 1) {
+            tables[t][byte] = (tables[t-1][byte] >> 8) ^ tables[0][tables[t-1][byte] & 0xff];
+        }
+    }
+    return tables;
+}
+
+constexpr auto CRC32C_TABLES = makeCrc32cTables();
+
+/**
+ * @brief CRC32C checksum of `bytes` bytes, continuing from the checksum `crc` of the bytes before them, so a stream can
+ * be checksummed in pieces: crc32c(b, m, crc32c(a, n)) is the checksum of a followed by b. Uses the SSE4.2 crc32
+ * instruction 8 bytes at a time when compiled for it (NATIVE=1), and slicing-by-8 tables otherwise.
+ *
+ * @param data first byte
+ * @param bytes number of bytes
+ * @param crc checksum of the preceding bytes, 0 to start
+ * @return uint32_t checksum of the preceding bytes followed by these
+ */
+inline uint32_t crc32c(void const* data, uint64_t bytes, uint32_t crc = 0) noexcept {
+    auto const* ptr = static_cast<uint8_t const*>(data);
+    uint64_t state = ~crc & 0xffffffffull;
+
+    for (; bytes >= 8; bytes -= 8, ptr += 8) {
+        uint64_t word;
+        std::memcpy(&word, ptr, sizeof(word));
+#if defined(__SSE4_2__)
+        state = _mm_crc32_u64(state, word);
+#else
+        word ^= state;
+        state = CRC32C_TABLES[7][word & 0xff] ^ CRC32C_TABLES[6][(word >> 8) & 0xff] ^
+            CRC32C_TABLES[5][(word >> 16) & 0xff] ^ CRC32C_TABLES[4][(word >> 24) & 0xff] ^
+            CRC32C_TABLES[3][(word >> 32) & 0xff] ^ CRC32C_TABLES[2][(word >> 40) & 0xff] ^
+            CRC32C_TABLES[1][(word >> 48) & 0xff] ^ CRC32C_TABLES[0][word >> 56];
+#endif
+    }
+    for (; bytes > 0; bytes -= 1, ptr += 1) {
+        state = (state >> 8) ^ CRC32C_TABLES[0][(state ^ *ptr) & 0xff];
+    }
+    return ~static_cast<uint32_t>(state);
+}
 
 }   // end namespace utility
 
 namespace serial {
 
+/**
+ * @brief Arrays in versioned files start on multiples of this many bytes, so a mapped file can be used in place.
+ */
+constexpr uint64_t ALIGNMENT = 64;
+
+/**
+ * @brief Writes zeros until the stream position is a multiple of ALIGNMENT.
+ *
+ * @param outputStream stream to pad
+ */
+inline void pad(std::ostream &outputStream) {
+    static constexpr char zeros[ALIGNMENT] = {};
+    const uint64_t position = outputStream.tellp();
+    outputStream.write(zeros, (ALIGNMENT - position % ALIGNMENT) % ALIGNMENT);
+}
+
+/**
+ * @brief Skips the padding written by `pad`.
+ *
+ * @param inputStream stream to advance
+ */
+inline void skipPadding(std::istream &inputStream) {
+    const uint64_t position = inputStream.tellg();
+    inputStream.seekg((ALIGNMENT - position % ALIGNMENT) % ALIGNMENT, std::ios::cur);
+}
+
+/**
+ * @brief Reads a file written with serialize/pad in place from a utility::MappedFile. Scalars are copied out; arrays
+ * are returned as pointers into the mapping.
+ */
+class MappedReader {
+    public:
+        /**
+         * @brief Maps `fname` and starts reading at its first byte.
+         * @throws std::ios_base::failure If the file cannot be opened or mapped.
+         *
+         * @param fname file to read
+         */
+        explicit MappedReader(std::string const& fname) : file_(std::make_shared<utility::MappedFile>(fname)),
+            end_(file_->size()) {}
+
+        /**
+         * @brief Reads bytes [begin, end) of an already mapped file, e.g. one section of it.
+         * @throws std::ios_base::failure If the range is not inside the file.
+         *
+         * @param file mapped file
+         * @param begin first byte to read. Padding is skipped relative to the start of the file.
+         * @param end one past the last byte to read
+         */
+        MappedReader(std::shared_ptr<utility::MappedFile> file, uint64_t begin, uint64_t end)
+            : file_(std::move(file)), offset_(begin), end_(end) {
+            if (begin > end || end > file_->size()) {
+                throw std::ios_base::failure("MappedReader -- range is outside the mapped file.");
+            }
+        }
+
+        /**
+         * @brief Reads a value the way `serialize` wrote it for trivial types.
+         * @throws std::ios_base::failure If the file ends first.
+         *
+         * @tparam T trivially copyable type
+         * @return T the value
+         */
+        template <typename T>
+        T read() {
+            static_assert(std::is_trivially_copyable<T>::value, "MappedReader::read only supports trivial types.");
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        /**
+         * @brief Returns `count` elements in place and advances past them.
+         * @throws std::ios_base::failure If the file ends first.
+         *
+         * @tparam T element type
+         * @param count number of elements
+         * @return T* first element, inside the mapping
+         */
+        template <typename T>
+        T *view(uint64_t count) {
+            return reinterpret_cast<T*>(take(count * sizeof(T)));
+        }
+
+        /**
+         * @brief Skips the padding written by `pad`.
+         */
+        void skipPadding() noexcept {
+            offset_ = utility::roundDivisionUp(offset_, ALIGNMENT) * ALIGNMENT;
+        }
+
+        /**
+         * @brief Handle that keeps the mapping alive. Give it to every view that outlives the reader.
+         *
+         * @return std::shared_ptr<void const> shared owner of the mapping
+         */
+        std::shared_ptr<void const> keepAlive() const noexcept {
+            return file_;
+        }
+
+    private:
+        std::shared_ptr<utility::MappedFile> file_;
+        uint64_t offset_ = 0;
+        uint64_t end_ = 0;
+
+        uint8_t *take(uint64_t bytes) {
+            if (bytes > end_ - offset_) {
+                throw std::ios_base::failure("MappedReader -- unexpected end of mapped file.");
+            }
+            uint8_t *ptr = file_->data() + offset_;
+            offset_ += bytes;
+            return ptr;
+        }
+};
+
+/**
+ * @brief Size of the buffer FileWriter and FileReader move data through: one write or read system call per this many
+ * bytes.
+ */
+constexpr uint64_t IO_BUFFER_BYTES = 1ull << 22;
+
+/**
+ * @brief O_DIRECT writes need the buffer, file offset, and length aligned to the device's logical block size. 4096
+ * covers the common ones.
+ */
+constexpr uint64_t DIRECT_IO_ALIGNMENT = 4096;
+
+/**
+ * @brief Stream buffer that writes to a file descriptor IO_BUFFER_BYTES at a time and keeps a CRC32C of everything
+ * written. With direct I/O, full buffers are written with O_DIRECT, bypassing the page cache, and the unaligned tail
+ * is written without it on close.
+ */
+class FileWriteBuffer : public std::streambuf {
+    public:
+        /**
+         * @brief Creates or truncates `fname`.
+         * @throws std::ios_base::failure If the file cannot be opened.
+         *
+         * @param fname file to write
+         * @param direct try O_DIRECT. Falls back to buffered writes where the file system does not support it.
+         */
+        FileWriteBuffer(std::string const& fname, [[maybe_unused]] bool direct)
+            : buffer_(utility::allocateAligned<char, DIRECT_IO_ALIGNMENT>(IO_BUFFER_BYTES)) {
+            constexpr int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#if defined(O_DIRECT)
+            if (direct) {
+                fd_ = ::open(fname.c_str(), flags | O_DIRECT, 0644);
+                direct_ = (fd_ >= 0);
+            }
+#endif
+            if (fd_ < 0) {
+                fd_ = ::open(fname.c_str(), flags, 0644);
+            }
+            if (fd_ < 0) {
+                throw std::ios_base::failure("Could not open file \"" + fname + "\" to write.");
+            }
+            this->setp(buffer_.get(), buffer_.get() + IO_BUFFER_BYTES);
+            checked_ = buffer_.get();
+        }
+
+        FileWriteBuffer(FileWriteBuffer const&) = delete;
+        FileWriteBuffer& operator=(FileWriteBuffer const&) = delete;
+
+        ~FileWriteBuffer() override {
+            this->close();
+        }
+
+        /**
+         * @brief Writes out what is buffered and closes the file. Does nothing if it is already closed.
+         *
+         * @return true if every write and the close succeeded
+         */
+        bool close() noexcept {
+            if (fd_ < 0) {
+                return ok_;
+            }
+            ok_ = this->drain(true) && ok_;
+            ok_ = (::close(fd_) == 0) && ok_;
+            fd_ = -1;
+            return ok_;
+        }
+
+        /**
+         * @return uint32_t CRC32C of every byte written since the file was opened or `restartChecksum`, including
+         *         buffered ones
+         */
+        uint32_t checksum() const noexcept {
+            return utility::crc32c(checked_, this->pptr() - checked_, crc_);
+        }
+
+        /**
+         * @brief Starts a new checksum at the next byte written, e.g. for the next section of a file.
+         */
+        void restartChecksum() noexcept {
+            crc_ = 0;
+            checked_ = this->pptr();
+        }
+
+        /**
+         * @return true if full buffers are written with O_DIRECT
+         */
+        bool isDirect() const noexcept {
+            return direct_;
+        }
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!this->drain(false)) {
+                return traits_type::eof();
+            }
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *this->pptr() = traits_type::to_char_type(ch);
+                this->pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        int sync() override {
+            return this->drain(false) ? 0 : -1;
+        }
+
+        /* only reports the position (tellp); the file is written strictly in order */
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+            if (off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::out)) {
+                return pos_type(off_type(-1));
+            }
+            return pos_type(written_ + (this->pptr() - this->pbase()));
+        }
+
+    private:
+        utility::AlignedArray<char, DIRECT_IO_ALIGNMENT> buffer_;
+        int fd_ = -1;
+        bool direct_ = false;
+        bool ok_ = true;
+        uint64_t written_ = 0;          /* bytes handed to the file */
+        uint32_t crc_ = 0;              /* checksum of the bytes before checked_ */
+        char const* checked_ = nullptr; /* first buffered byte not in crc_ */
+
+        /**
+         * @brief Writes the buffered bytes and moves any left over to the front. Direct writes that are not `last`
+         * leave the unaligned tail behind; the last one turns O_DIRECT off to write it.
+         */
+        bool drain(bool last) noexcept {
+            uint64_t bytes = this->pptr() - this->pbase();
+#if defined(O_DIRECT)
+            if (direct_ && !last) {
+                bytes -= bytes % DIRECT_IO_ALIGNMENT;
+            } else if (direct_ && bytes % DIRECT_IO_ALIGNMENT != 0) {
+                ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) & ~O_DIRECT);
+                direct_ = false;
+            }
+#endif
+            for (uint64_t done = 0; done < bytes;) {
+                const ssize_t count = ::write(fd_, this->pbase() + done, bytes - done);
+                if (count < 0 && errno != EINTR) {
+                    return false;
+                }
+                done += std::max<ssize_t>(count, 0);
+            }
+            char const* drained = this->pbase() + bytes;
+            if (checked_ < drained) {
+                crc_ = utility::crc32c(checked_, drained - checked_, crc_);
+                checked_ = drained;
+            }
+            written_ += bytes;
+
+            const uint64_t rest = (this->pptr() - this->pbase()) - bytes;
+            std::memmove(buffer_.get(), drained, rest);
+            checked_ = buffer_.get() + (checked_ - drained);
+            this->setp(buffer_.get(), buffer_.get() + IO_BUFFER_BYTES);
+            this->pbump(static_cast<int>(rest));
+            return true;
+        }
+};
+
+/**
+ * @brief Stream buffer that reads a file descriptor IO_BUFFER_BYTES at a time, reads large requests straight into the
+ * destination, and keeps a CRC32C of every byte consumed.
+ */
+class FileReadBuffer : public std::streambuf {
+    public:
+        /**
+         * @brief Opens `fname` for sequential reading.
+         * @throws std::ios_base::failure If the file cannot be opened.
+         *
+         * @param fname file to read
+         */
+        explicit FileReadBuffer(std::string const& fname)
+            : buffer_(utility::allocateAligned<char, DIRECT_IO_ALIGNMENT>(IO_BUFFER_BYTES)) {
+            fd_ = ::open(fname.c_str(), O_RDONLY);
+            if (fd_ < 0) {
+                throw std::ios_base::failure("Could not open file \"" + fname + "\" to read.");
+            }
+            ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+            this->setg(buffer_.get(), buffer_.get(), buffer_.get());
+            checked_ = buffer_.get();
+        }
+
+        FileReadBuffer(FileReadBuffer const&) = delete;
+        FileReadBuffer& operator=(FileReadBuffer const&) = delete;
+
+        ~FileReadBuffer() override {
+            this->close();
+        }
+
+        /**
+         * @brief Closes the file. Does nothing if it is already closed.
+         */
+        void close() noexcept {
+            if (fd_ >= 0) {
+                ::close(fd_);
+                fd_ = -1;
+            }
+        }
+
+        /**
+         * @return uint32_t CRC32C of every byte consumed so far
+         */
+        uint32_t checksum() noexcept {
+            this->consume();
+            return crc_;
+        }
+
+    protected:
+        int_type underflow() override {
+            this->consume();
+            const ssize_t count = this->readSome(buffer_.get(), IO_BUFFER_BYTES);
+            if (count <= 0) {
+                return traits_type::eof();
+            }
+            this->setg(buffer_.get(), buffer_.get(), buffer_.get() + count);
+            checked_ = buffer_.get();
+            return traits_type::to_int_type(*this->gptr());
+        }
+
+        std::streamsize xsgetn(char *destination, std::streamsize count) override {
+            std::streamsize copied = 0;
+            while (copied < count) {
+                const std::streamsize available = this->egptr() - this->gptr();
+                if (available > 0) {
+                    const std::streamsize step = std::min(available, count - copied);
+                    std::memcpy(destination + copied, this->gptr(), step);
+                    this->gbump(static_cast<int>(step));
+                    copied += step;
+                } else if (static_cast<uint64_t>(count - copied) >= IO_BUFFER_BYTES) {
+                    /* large reads skip the buffer */
+                    this->consume();
+                    const ssize_t step = this->readSome(destination + copied, count - copied);
+                    if (step <= 0) {
+                        break;
+                    }
+                    crc_ = utility::crc32c(destination + copied, step, crc_);
+                    copied += step;
+                } else if (traits_type::eq_int_type(this->underflow(), traits_type::eof())) {
+                    break;
+                }
+            }
+            return copied;
+        }
+
+        /* reports the position (tellg) and skips forward (seekg with a non-negative offset from cur) */
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+            if (off < 0 || dir != std::ios_base::cur || !(which & std::ios_base::in)) {
+                return pos_type(off_type(-1));
+            }
+            while (off > 0) {
+                if (this->gptr() == this->egptr() && traits_type::eq_int_type(this->underflow(), traits_type::eof())) {
+                    return pos_type(off_type(-1));
+                }
+                const off_type step = std::min<off_type>(off, this->egptr() - this->gptr());
+                this->gbump(static_cast<int>(step));
+                off -= step;
+            }
+            return pos_type(read_ - (this->egptr() - this->gptr()));
+        }
+
+    private:
+        utility::AlignedArray<char, DIRECT_IO_ALIGNMENT> buffer_;
+        int fd_ = -1;
+        uint64_t read_ = 0;             /* bytes read from the file */
+        uint32_t crc_ = 0;              /* checksum of the bytes before checked_ */
+        char const* checked_ = nullptr; /* first buffered byte not in crc_ */
+
+        /**
+         * @brief Adds the bytes consumed from the buffer since the last call to the checksum.
+         */
+        void consume() noexcept {
+            crc_ = utility::crc32c(checked_, this->gptr() - checked_, crc_);
+            checked_ = this->gptr();
+        }
+
+        ssize_t readSome(char *destination, uint64_t bytes) noexcept {
+            ssize_t count;
+            do {
+                count = ::read(fd_, destination, bytes);
+            } while (count < 0 && errno == EINTR);
+            read_ += std::max<ssize_t>(count, 0);
+            return count;
+        }
+};
+
+/**
+ * @brief Output file stream for `serialize` that writes large buffers straight to the file descriptor, optionally
+ * with O_DIRECT, and can append a CRC32C of everything written so far for FileReader::verifyChecksum.
+ */
+class FileWriter : public std::ostream {
+    public:
+        /**
+         * @brief Creates or truncates `fname`.
+         * @throws std::ios_base::failure If the file cannot be opened.
+         *
+         * @param fname file to write
+         * @param direct write full buffers with O_DIRECT, if the file system supports it
+         */
+        explicit FileWriter(std::string const& fname, bool direct = false)
+            : std::ostream(nullptr), buffer_(fname, direct), fname_(fname) {
+            this->rdbuf(&buffer_);
+        }
+
+        /**
+         * @brief Appends the CRC32C of every byte written so far.
+         */
+        void writeChecksum() {
+            const uint32_t crc = buffer_.checksum();
+            this->write(reinterpret_cast<char const*>(&crc), sizeof(crc));
+        }
+
+        /**
+         * @return uint32_t CRC32C of every byte written since the file was opened or `restartChecksum`
+         */
+        uint32_t checksum() const noexcept {
+            return buffer_.checksum();
+        }
+
+        /**
+         * @brief Starts a new checksum at the next byte written.
+         */
+        void restartChecksum() noexcept {
+            buffer_.restartChecksum();
+        }
+
+        /**
+         * @brief Writes out what is buffered and closes the file.
+         * @throws std::ios_base::failure If any write failed.
+         */
+        void close() {
+            if (!buffer_.close() || !*this) {
+                throw std::ios_base::failure("Error writing file \"" + fname_ + "\".");
+            }
+        }
+
+        /**
+         * @return true if full buffers are written with O_DIRECT
+         */
+        bool isDirect() const noexcept {
+            return buffer_.isDirect();
+        }
+
+    private:
+        FileWriteBuffer buffer_;
+        std::string fname_;
+};
+
+/**
+ * @brief Input file stream for `deserialize` that reads large buffers straight from the file descriptor and checks
+ * the checksums FileWriter::writeChecksum appends.
+ */
+class FileReader : public std::istream {
+    public:
+        /**
+         * @brief Opens `fname`.
+         * @throws std::ios_base::failure If the file cannot be opened.
+         *
+         * @param fname file to read
+         */
+        explicit FileReader(std::string const& fname) : std::istream(nullptr), buffer_(fname) {
+            this->rdbuf(&buffer_);
+        }
+
+        /**
+         * @brief Reads a checksum written by FileWriter::writeChecksum and compares it with the CRC32C of every byte
+         * read before it.
+         *
+         * @return true if it matches
+         */
+        bool verifyChecksum() {
+            const uint32_t expected = buffer_.checksum();
+            uint32_t crc = 0;
+            this->read(reinterpret_cast<char*>(&crc), sizeof(crc));
+            return static_cast<bool>(*this) && crc == expected;
+        }
+
+        /**
+         * @brief Closes the file.
+         */
+        void close() noexcept {
+            buffer_.close();
+        }
+
+    private:
+        FileReadBuffer buffer_;
+};
+
 /* forward declarations */
 class ofstream;
 class ifstream;
@@ -121,11 +1471,19 @@ concept Resizable = requires(T a, size_t size) {
  * @brief Concept resolves if T implements a serialize and deserialize function.
  */
 template<typename T>
-concept SerializeOverloads = requires(const T a, T b, std::ofstream& out, std::ifstream& in) {
+concept SerializeOverloads = requires(const T a, T b, std::ostream& out, std::istream& in) {
     { a.serialize(out) } -> std::same_as<void>; 
     { b.deserialize(in) } -> std::same_as<void>;
 };
 
+/**
+ * @brief Concept resolves if T stores trivially copyable values contiguously, so serialize can write them in one call.
+ * The bytes are the same as writing each value in turn.
+ */
+template <typename T>
+concept BulkContainer = Container<T> && std::ranges::contiguous_range<T> &&
+    std::is_trivially_copyable<typename T::value_type>::value && !SerializeOverloads<typename T::value_type>;
+
 /**
  * @brief Concept resolves if T is trivial data type, container, or provides serialization functions.
  * @note "Serializable" is a bit of a misnomer. If T is a container, then it is not necessarily serializable. It's
@@ -138,9 +1496,10 @@ template <typename T>
 concept Serializable = std::is_trivial<T>::value || Container<T> || SerializeOverloads<T>;
 
 /**
- * @brief Serialize an objects bytes into an ofstream. If trivial (POD, bare struct with simple extant, etc...), 
+ * @brief Serialize an objects bytes into an ostream. If trivial (POD, bare struct with simple extant, etc...), 
  *        then this will just write out the data. If DataType is a container, then serialize will be recursively called
- *        on each value. If DataType::serialize exists, then this will be used.
+ *        on each value, except that contiguous containers of trivially copyable values are written in one call. If
+ *        DataType::serialize exists, then this will be used.
  * @see deserialize
  * 
  * @tparam DataType serializable
@@ -148,15 +1507,20 @@ concept Serializable = std::is_trivial<T>::value || Container<T> || SerializeOve
  * @param outputStream location of resulting data
  */
 template <Serializable DataType>
-void serialize(DataType const& data, std::ofstream &outputStream) {
+void serialize(DataType const& data, std::ostream &outputStream) {
 
     if constexpr (SerializeOverloads<DataType>) {
         data.serialize(outputStream);
     } else if constexpr (Container<DataType>) {
         const auto size = data.size();
         outputStream.write(reinterpret_cast<char const*>(&size), sizeof(size));
-        for (auto const& value : data) {    
-            serialize(value, outputStream);
+        if constexpr (BulkContainer<DataType>) {
+            outputStream.write(reinterpret_cast<char const*>(std::ranges::data(data)),
+                size * sizeof(typename DataType::value_type));
+        } else {
+            for (auto const& value : data) {    
+                serialize(value, outputStream);
+            }
         }
     } else {
         outputStream.write(reinterpret_cast<char const*>(&data), sizeof(data));
@@ -165,10 +1529,10 @@ void serialize(DataType const& data, std::ofstream &outputStream) {
 
 
 /**
- * @brief Deserialize bytes from an ifstream into data object. If trivial (POD, bare struct with simple extant, etc...), 
+ * @brief Deserialize bytes from an istream into data object. If trivial (POD, bare struct with simple extant, etc...), 
  *        then this will just read in the data. If DataType is a container, then deserialize will be recursively called
- *        on each value. If DataType::deserialize exists, then it will be used. Expects the format/ordering used 
- *        by `serialize` for containers.
+ *        on each value (one read for contiguous containers of trivially copyable values). If DataType::deserialize
+ *        exists, then it will be used. Expects the format/ordering used by `serialize` for containers.
  * @see serialize
  * 
  * @throws std::runtime_error Thrown when deserializing a container, there's a size mismatch between current container
@@ -179,7 +1543,7 @@ void serialize(DataType const& data, std::ofstream &outputStream) {
  * @param inputStream location of incoming data
  */
 template <Serializable DataType>
-void deserialize(DataType &data, std::ifstream &inputStream) {
+void deserialize(DataType &data, std::istream &inputStream) {
 
     if constexpr (SerializeOverloads<DataType>) {
         data.deserialize(inputStream);
@@ -196,8 +1560,13 @@ void deserialize(DataType &data, std::ifstream &inputStream) {
             }
         }
 
-        for (auto &value : data) {
-            deserialize(value, inputStream);
+        if constexpr (BulkContainer<DataType>) {
+            inputStream.read(reinterpret_cast<char*>(std::ranges::data(data)),
+                size * sizeof(typename DataType::value_type));
+        } else {
+            for (auto &value : data) {
+                deserialize(value, inputStream);
+            }
         }
     } else {
         inputStream.read(reinterpret_cast<char *>(&data), sizeof(data));
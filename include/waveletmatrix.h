@@ -0,0 +1,634 @@
+/*  Implementation of a wavelet matrix: access, rank, select, and range queries over a sequence of integer symbols.
+    author: Daniel Nichols
+    date: February 2022
+*/
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <ios>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// local includes
+#include "bitvector.h"
+#include "utilities.h"
+
+namespace bitvector {
+
+/**
+ * @brief WaveletMatrix. Stores n symbols from an alphabet [0, sigma) in n*ceil(log_2(sigma)) bits plus the rank and
+ * select indices over them, and answers access, rank, select, quantile, and range count queries with O(log sigma)
+ * rank or select calls. One BitVector and RankSupport per symbol would take sigma*n bits.
+ *
+ * Level l holds bit l of every symbol, most significant first, in the order left by stably partitioning the level
+ * above it by its bits: zeros first, then ones. So position p of level l moves to rank0(p) on level l+1 if its bit is
+ * 0, and to zeros(l) + rank1(p) if it is 1 (Claude, Navarro, and Ordonez). All the levels are one BitVector, each
+ * starting on a word boundary, under one RankSupport and one SelectIndex each for its ones and zeros; a rank or select
+ * within a level is the global one offset by the counts before the level.
+ */
+class WaveletMatrix {
+    /**
+     * @brief All WaveletMatrix files should start with these 4 bytes.
+     */
+    constexpr static uint32_t FILE_MAGIC = 0xbeeffade;
+
+    /**
+     * @brief Layout version written after the magic. Bump when the file layout changes.
+     */
+    constexpr static uint32_t FILE_VERSION = 1;
+
+    public:
+        /**
+         * @brief Construct an empty sequence, e.g. to deserialize into.
+         */
+        WaveletMatrix() : WaveletMatrix(std::span<const uint64_t>()) {}
+
+        /**
+         * @brief Builds the levels over `symbols`. Each level is packed and partitioned in parallel over chunks of
+         * the sequence, and the rank tables are built in parallel (see RankSupport::buildTables).
+         * @throws std::invalid_argument If CHECK_BOUNDS and a symbol is >= alphabetSize.
+         *
+         * @param symbols sequence to index
+         * @param alphabetSize one past the largest symbol. 0 uses the largest symbol in `symbols` plus 1, so symbols
+         *        must then be < 2^64 - 1.
+         * @param numThreads number of threads to build with. 0 uses std::thread::hardware_concurrency().
+         */
+        explicit WaveletMatrix(std::span<const uint64_t> symbols, uint64_t alphabetSize = 0, uint32_t numThreads = 1) :
+            size_(symbols.size()), alphabetSize_(alphabetSizeFor(symbols, alphabetSize)),
+            levels_(levelsFor(alphabetSize_)), stride_(strideFor(size_)),
+            bits_(buildLevels(symbols, levels_, stride_, numThreads)), rank_(bits_, numThreads),
+            ones_(bits_, rank_.totalOnes(), true), zeros_(bits_, rank_.totalZeros(), false) {
+            this->countLevels();
+        }
+
+        /**
+         * @brief Move construct. The rank tables are rebound to this object's bitvector.
+         */
+        WaveletMatrix(WaveletMatrix&& other) noexcept : size_(other.size_), alphabetSize_(other.alphabetSize_),
+            levels_(other.levels_), stride_(other.stride_), bits_(std::move(other.bits_)),
+            rank_(std::move(other.rank_)), ones_(std::move(other.ones_)), zeros_(std::move(other.zeros_)),
+            levelOnes_(std::move(other.levelOnes_)), levelZeros_(std::move(other.levelZeros_)) {
+            rank_.bitvector_ = std::cref(bits_);
+        }
+
+        /**
+         * @brief Move assign. The rank tables are rebound to this object's bitvector.
+         */
+        WaveletMatrix& operator=(WaveletMatrix&& other) noexcept {
+            size_ = other.size_;
+            alphabetSize_ = other.alphabetSize_;
+            levels_ = other.levels_;
+            stride_ = other.stride_;
+            bits_ = std::move(other.bits_);
+            rank_ = std::move(other.rank_);
+            rank_.bitvector_ = std::cref(bits_);
+            ones_ = std::move(other.ones_);
+            zeros_ = std::move(other.zeros_);
+            levelOnes_ = std::move(other.levelOnes_);
+            levelZeros_ = std::move(other.levelZeros_);
+            return *this;
+        }
+
+        /**
+         * @brief The i-th symbol.
+         * @see access
+         * @throws std::out_of_range If i >= size().
+         *
+         * @param i index
+         * @return uint64_t symbol at i
+         */
+        uint64_t operator[](uint64_t i) const {
+            return access(i);
+        }
+
+        /**
+         * @brief The i-th symbol. One rank per level.
+         * @throws std::out_of_range If i >= size().
+         *
+         * @param i index
+         * @return uint64_t symbol at i
+         */
+        uint64_t access(uint64_t i) const {
+            this->checkBounds(i, "access");
+
+            uint64_t symbol = 0;
+            for (uint32_t level = 0; level < levels_; level += 1) {
+                const auto [rank, bit] = rank_.rank1WithBit(level * stride_ + i);
+                const uint64_t ones = rank - bit - levelOnes_[level];
+                symbol = (symbol << 1) | bit;
+                i = bit ? levelZeros_[level] + ones : i - ones;
+            }
+            return symbol;
+        }
+
+        /**
+         * @brief The number of occurrences of symbol `c` in range 0...i. Two ranks per level.
+         * @throws std::out_of_range If i >= size().
+         *
+         * @param c symbol. Symbols outside the alphabet occur 0 times.
+         * @param i index
+         * @return uint64_t number of c in [0, i]
+         */
+        uint64_t rank(uint64_t c, uint64_t i) const {
+            this->checkBounds(i, "rank");
+            if (c >= alphabetSize_) {
+                return 0;
+            }
+
+            uint64_t begin = 0, end = i + 1;
+            for (uint32_t level = 0; level < levels_; level += 1) {
+                const bool bit = this->symbolBit(c, level);
+                begin = this->descend(level, begin, bit);
+                end = this->descend(level, end, bit);
+            }
+            return end - begin;
+        }
+
+        /**
+         * @brief The location of the k-th occurrence of symbol `c`, so select(c, rank(c, i)) == i if the i-th symbol
+         * is c. Two ranks per level to find where the c's end up, then one select per level back up.
+         * @throws std::invalid_argument If c is outside the alphabet, or k is zero or greater than the number of c.
+         *
+         * @param c symbol
+         * @param k number of c (1-indexed, as in SelectSupport)
+         * @return uint64_t index of the k-th c
+         */
+        uint64_t select(uint64_t c, uint64_t k) const {
+            uint64_t begin = 0, end = size_;
+            for (uint32_t level = 0; level < levels_; level += 1) {
+                const bool bit = this->symbolBit(c, level);
+                begin = this->descend(level, begin, bit);
+                end = this->descend(level, end, bit);
+            }
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (c >= alphabetSize_ || k == 0 || k > end - begin) {
+                    throw std::invalid_argument("WaveletMatrix::select -- Cannot select " + std::to_string(k) +
+                        "-th " + std::to_string(c) + " in sequence with " +
+                        std::to_string((c >= alphabetSize_) ? 0 : end - begin) + " of them. Use 1-indexing.");
+                }
+            }
+
+            uint64_t const* words = bits_.words();
+            uint64_t position = begin + k - 1;
+            for (uint32_t level = levels_; level-- > 0;) {
+                if (this->symbolBit(c, level)) {
+                    position = ones_.select(words, levelOnes_[level] + position - levelZeros_[level]);
+                } else {
+                    position = zeros_.select(words, level * stride_ - levelOnes_[level] + position);
+                }
+                position -= level * stride_;
+            }
+            return position;
+        }
+
+        /**
+         * @brief The k-th smallest (0-indexed) symbol in range begin...end-1, e.g. its median for k = (end-begin)/2.
+         * Two ranks per level.
+         * @throws std::out_of_range If end > size(), or k >= end - begin.
+         *
+         * @param begin first index of the range
+         * @param end one past the last index of the range
+         * @param k number of symbols in the range smaller than the one to return (ties in index order)
+         * @return uint64_t k-th smallest symbol in [begin, end)
+         */
+        uint64_t quantile(uint64_t begin, uint64_t end, uint64_t k) const {
+            this->checkRange(begin, end, "quantile");
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (k >= end - begin) {
+                    throw std::out_of_range("WaveletMatrix::quantile -- " + std::to_string(k) + "-th smallest " +
+                        "symbol requested from a range of " + std::to_string(end - begin) + ".");
+                }
+            }
+
+            uint64_t symbol = 0;
+            for (uint32_t level = 0; level < levels_; level += 1) {
+                const uint64_t onesBegin = this->onesBefore(level, begin), onesEnd = this->onesBefore(level, end);
+                const uint64_t zeros = (end - begin) - (onesEnd - onesBegin);
+                if (k < zeros) {
+                    begin -= onesBegin;
+                    end -= onesEnd;
+                    symbol <<= 1;
+                } else {
+                    k -= zeros;
+                    begin = levelZeros_[level] + onesBegin;
+                    end = levelZeros_[level] + onesEnd;
+                    symbol = (symbol << 1) | 1;
+                }
+            }
+            return symbol;
+        }
+
+        /**
+         * @brief The number of symbols less than `c` in range begin...end-1. Two ranks per level.
+         * @throws std::out_of_range If begin > end or end > size().
+         *
+         * @param begin first index of the range
+         * @param end one past the last index of the range
+         * @param c symbol
+         * @return uint64_t number of symbols < c in [begin, end)
+         */
+        uint64_t countLess(uint64_t begin, uint64_t end, uint64_t c) const {
+            this->checkRange(begin, end, "countLess");
+            if (c >= alphabetSize_) {
+                return end - begin;
+            }
+
+            uint64_t count = 0;
+            for (uint32_t level = 0; level < levels_; level += 1) {
+                const uint64_t onesBegin = this->onesBefore(level, begin), onesEnd = this->onesBefore(level, end);
+                if (this->symbolBit(c, level)) {
+                    count += (end - begin) - (onesEnd - onesBegin);
+                    begin = levelZeros_[level] + onesBegin;
+                    end = levelZeros_[level] + onesEnd;
+                } else {
+                    begin -= onesBegin;
+                    end -= onesEnd;
+                }
+            }
+            return count;
+        }
+
+        /**
+         * @brief The number of symbols in [low, high) in range begin...end-1. Four ranks per level.
+         * @throws std::out_of_range If begin > end or end > size().
+         *
+         * @param begin first index of the range
+         * @param end one past the last index of the range
+         * @param low smallest symbol counted
+         * @param high one past the largest symbol counted
+         * @return uint64_t number of symbols s in [begin, end) with low <= s < high
+         */
+        uint64_t rangeCount(uint64_t begin, uint64_t end, uint64_t low, uint64_t high) const {
+            if (high <= low) {
+                this->checkRange(begin, end, "rangeCount");
+                return 0;
+            }
+            return this->countLess(begin, end, high) - this->countLess(begin, end, low);
+        }
+
+        /**
+         * @brief The length of the sequence.
+         *
+         * @return uint64_t number of symbols
+         */
+        uint64_t size() const noexcept {
+            return size_;
+        }
+
+        /**
+         * @brief The number of distinct symbols the sequence may hold.
+         *
+         * @return uint64_t one past the largest symbol
+         */
+        uint64_t alphabetSize() const noexcept {
+            return alphabetSize_;
+        }
+
+        /**
+         * @brief The number of levels, i.e. bits per symbol.
+         *
+         * @return uint32_t ceil(log_2(alphabetSize())), at least 1
+         */
+        uint32_t levels() const noexcept {
+            return levels_;
+        }
+
+        /**
+         * @brief Return the overhead in bits: the levels, including their word padding, and the rank and select
+         * indices over them.
+         *
+         * @return uint64_t bits used
+         */
+        uint64_t overhead() const noexcept {
+            return bits_.size() + rank_.overhead() + ones_.overhead() + zeros_.overhead();
+        }
+
+        /**
+         * @brief Serialize into output stream using serial::serialize
+         *
+         * @param out destination of data
+         */
+        void serialize(std::ostream& out) const {
+            serial::serialize(size_, out);
+            serial::serialize(alphabetSize_, out);
+            serial::serialize(levels_, out);
+            serial::serialize(bits_, out);
+            rank_.serialize(out);
+            serial::serialize(ones_, out);
+            serial::serialize(zeros_, out);
+        }
+
+        /**
+         * @brief Deserialize from inputstream using serial::deserialize. Will reallocate.
+         * @throws std::ios_base::failure If the levels do not match the sequence length.
+         *
+         * @param in source of data
+         */
+        void deserialize(std::istream& in) {
+            serial::deserialize(size_, in);
+            serial::deserialize(alphabetSize_, in);
+            serial::deserialize(levels_, in);
+            stride_ = strideFor(size_);
+            serial::deserialize(bits_, in);
+            rank_.deserialize(in);
+            serial::deserialize(ones_, in);
+            serial::deserialize(zeros_, in);
+            this->checkLayout();
+            this->countLevels();
+        }
+
+        /**
+         * @brief Views data written by `serialize` in a mapped file instead of copying it.
+         * @see BitVector::map
+         * @throws std::ios_base::failure If the levels do not match the sequence length.
+         *
+         * @param reader mapped file positioned where `serialize` started writing
+         */
+        void map(serial::MappedReader& reader) {
+            size_ = reader.read<uint64_t>();
+            alphabetSize_ = reader.read<uint64_t>();
+            levels_ = reader.read<uint32_t>();
+            stride_ = strideFor(size_);
+            bits_.map(reader);
+            rank_.map(reader);
+            ones_.map(reader);
+            zeros_.map(reader);
+            this->checkLayout();
+            this->countLevels();
+        }
+
+        /**
+         * @brief Loads a WaveletMatrix from `fname`. Must be in format from `save`.
+         * @see save
+         * @throws std::ios_base::failure If the file cannot be opened or is malformed.
+         * @throws std::domain_error If the file is not a WaveletMatrix file of the current version.
+         *
+         * @param fname input filename
+         */
+        void load(std::string const& fname) {
+            serial::FileReader inputStream(fname);
+
+            /* meta data */
+            uint32_t magicTmp, versionTmp;
+            serial::deserialize(magicTmp, inputStream);
+            serial::deserialize(versionTmp, inputStream);
+            checkHeader(magicTmp, versionTmp, fname);
+
+            /* levels and indices */
+            this->deserialize(inputStream);
+
+            /* cleanup */
+            inputStream.close();
+        }
+
+        /**
+         * @brief Loads a file written by `save` without copying it. The levels and indices become views into a
+         * private mapping of the file.
+         * @see save
+         * @throws std::ios_base::failure If the file cannot be mapped or is malformed.
+         * @throws std::domain_error If the file is not a WaveletMatrix file of the current version.
+         *
+         * @param fname input filename
+         */
+        void map(std::string const& fname) {
+            serial::MappedReader reader(fname);
+
+            const uint32_t magicTmp = reader.read<uint32_t>();
+            const uint32_t versionTmp = reader.read<uint32_t>();
+            checkHeader(magicTmp, versionTmp, fname);
+
+            this->map(reader);
+        }
+
+        /**
+         * @brief Saves the WaveletMatrix to `fname`.
+         * @see load
+         * @throws std::ios_base::failure If the file cannot be opened.
+         *
+         * @param fname output filename
+         */
+        void save(std::string const& fname) const {
+            serial::FileWriter outputStream(fname);
+
+            /* write meta data */
+            const uint32_t magicTmp = FILE_MAGIC, versionTmp = FILE_VERSION;
+            serial::serialize(magicTmp, outputStream);
+            serial::serialize(versionTmp, outputStream);
+
+            /* write levels and indices */
+            this->serialize(outputStream);
+
+            /* cleanup */
+            outputStream.close();
+        }
+
+    private:
+        uint64_t size_, alphabetSize_;
+        uint32_t levels_;
+        uint64_t stride_;           /* bits from the start of a level to the next; a multiple of the word size */
+        BitVector bits_;
+        RankSupport rank_;
+        SelectIndex ones_, zeros_;
+        std::vector<uint64_t> levelOnes_;   /* ones before each level, and in total */
+        std::vector<uint64_t> levelZeros_;  /* zeros in each level, not counting its padding */
+
+        /**
+         * @brief alphabetSize, or the largest symbol plus 1 if it is 0.
+         * @throws std::invalid_argument If CHECK_BOUNDS and a symbol is >= a non-zero alphabetSize.
+         */
+        static uint64_t alphabetSizeFor(std::span<const uint64_t> symbols, uint64_t alphabetSize) {
+            if (alphabetSize == 0) {
+                return symbols.empty() ? 1 : *std::max_element(symbols.begin(), symbols.end()) + 1;
+            }
+            if constexpr (utility::CHECK_BOUNDS) {
+                const auto outside = std::find_if(symbols.begin(), symbols.end(),
+                    [alphabetSize](uint64_t symbol) { return symbol >= alphabetSize; });
+                if (outside != symbols.end()) {
+                    throw std::invalid_argument("WaveletMatrix -- symbol " + std::to_string(*outside) + " at index " +
+                        std::to_string(outside - symbols.begin()) + " is outside the alphabet [0, " +
+                        std::to_string(alphabetSize) + ").");
+                }
+            }
+            return alphabetSize;
+        }
+
+        /**
+         * @brief ceil(log_2(alphabetSize)), but at least 1 level.
+         */
+        constexpr static uint32_t levelsFor(uint64_t alphabetSize) noexcept {
+            return std::max<uint32_t>(1, std::bit_width(alphabetSize - 1));
+        }
+
+        /**
+         * @brief Level length rounded up to whole words, so threads writing different words never share one and each
+         * level starts at a word. At least one word, so every level has a last bit to rank.
+         */
+        constexpr static uint64_t strideFor(uint64_t size) noexcept {
+            return utility::roundDivisionUp(std::max<uint64_t>(size, 1), BitVector::WORD_BITS) * BitVector::WORD_BITS;
+        }
+
+        /**
+         * @brief Packs every level of `symbols` into one bitvector. Per level, the sequence is split into one chunk
+         * per thread (a multiple of a word long): (1) each chunk packs its bits a word at a time and counts its ones,
+         * (2) the counts are exclusive scanned into where each chunk's zeros and ones go, and (3) each chunk stably
+         * partitions its symbols into the next level's order.
+         *
+         * @param symbols sequence to index
+         * @param levels number of levels
+         * @param stride bits per level
+         * @param numThreads number of threads. 0 uses std::thread::hardware_concurrency().
+         * @return BitVector levels * stride bits; level l is bits [l*stride, l*stride + symbols.size())
+         */
+        static BitVector buildLevels(std::span<const uint64_t> symbols, uint32_t levels, uint64_t stride,
+            uint32_t numThreads) {
+            if (numThreads == 0) {
+                numThreads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            BitVector bits(levels * stride);
+            const uint64_t n = symbols.size();
+            const uint64_t chunkSize = strideFor(utility::roundDivisionUp(n, numThreads));
+            const uint64_t numChunks = utility::roundDivisionUp(n, chunkSize);
+
+            std::vector<uint64_t> current(symbols.begin(), symbols.end()), next(n);
+            std::vector<uint64_t> chunkZeros(numChunks + 1, 0), chunkOnes(numChunks + 1, 0);
+            for (uint32_t level = 0; level < levels; level += 1) {
+                const uint32_t shift = levels - 1 - level;
+                uint64_t *levelWords = bits.words() + level * (stride / BitVector::WORD_BITS);
+
+                /* (1) pack each chunk's bits */
+                utility::parallelFor(numChunks, numThreads, [&](uint64_t chunk) {
+                    const uint64_t begin = chunk * chunkSize, end = std::min(begin + chunkSize, n);
+                    uint64_t ones = 0;
+                    for (uint64_t first = begin; first < end; first += BitVector::WORD_BITS) {
+                        const uint64_t last = std::min(first + BitVector::WORD_BITS, end);
+                        uint64_t word = 0;
+                        for (uint64_t i = first; i < last; i += 1) {
+                            word |= ((current[i] >> shift) & 1) << (i - first);
+                        }
+                        levelWords[first / BitVector::WORD_BITS] = word;
+                        ones += std::popcount(word);
+                    }
+                    chunkOnes[chunk + 1] = ones;
+                    chunkZeros[chunk + 1] = (end - begin) - ones;
+                });
+                if (level + 1 == levels) {
+                    break;
+                }
+
+                /* (2) exclusive scan of chunk counts */
+                chunkZeros[0] = chunkOnes[0] = 0;
+                std::inclusive_scan(std::begin(chunkZeros), std::end(chunkZeros), std::begin(chunkZeros));
+                std::inclusive_scan(std::begin(chunkOnes), std::end(chunkOnes), std::begin(chunkOnes));
+                const uint64_t zeros = chunkZeros[numChunks];
+
+                /* (3) stable partition into the next level's order */
+                utility::parallelFor(numChunks, numThreads, [&](uint64_t chunk) {
+                    const uint64_t begin = chunk * chunkSize, end = std::min(begin + chunkSize, n);
+                    uint64_t const* from = current.data();
+                    uint64_t *to = next.data();
+                    uint64_t zero = chunkZeros[chunk], one = zeros + chunkOnes[chunk];
+                    for (uint64_t i = begin; i < end; i += 1) {
+                        /* branch free: the bits are as good as random */
+                        const uint64_t bit = (from[i] >> shift) & 1;
+                        to[bit ? one : zero] = from[i];
+                        one += bit;
+                        zero += bit ^ 1;
+                    }
+                });
+                std::swap(current, next);
+            }
+            return bits;
+        }
+
+        /**
+         * @brief Fills levelOnes_ and levelZeros_ from the rank tables.
+         */
+        void countLevels() {
+            levelOnes_.assign(levels_ + 1, 0);
+            levelZeros_.assign(levels_, 0);
+            for (uint32_t level = 0; level < levels_; level += 1) {
+                levelOnes_[level + 1] = rank_.rank1((level + 1) * stride_ - 1);
+                levelZeros_[level] = size_ - (levelOnes_[level + 1] - levelOnes_[level]);
+            }
+        }
+
+        /**
+         * @brief Throws unless the deserialized levels fit the sequence length and alphabet.
+         * @throws std::ios_base::failure on a mismatch
+         */
+        void checkLayout() const {
+            if (levels_ != levelsFor(alphabetSize_) || bits_.size() != levels_ * stride_ ||
+                rank_.size() != bits_.size()) {
+                throw std::ios_base::failure("WaveletMatrix -- levels do not match a sequence of length " +
+                    std::to_string(size_) + " over an alphabet of size " + std::to_string(alphabetSize_) + ".");
+            }
+        }
+
+        /**
+         * @brief Throws unless a file header matches FILE_MAGIC and FILE_VERSION.
+         * @throws std::domain_error on a mismatch
+         */
+        static void checkHeader(uint32_t magic, uint32_t version, std::string const& fname) {
+            if (magic != FILE_MAGIC) {
+                throw std::domain_error("Invalid file magic for file \"" + fname + "\".");
+            }
+            if (version != FILE_VERSION) {
+                throw std::domain_error("Unsupported WaveletMatrix file version " + std::to_string(version) +
+                    " in file \"" + fname + "\".");
+            }
+        }
+
+        /**
+         * @brief Bit of symbol `c` stored on `level`.
+         */
+        bool symbolBit(uint64_t c, uint32_t level) const noexcept {
+            return (c >> (levels_ - 1 - level)) & 1;
+        }
+
+        /**
+         * @brief The number of ones in positions [0, i) of `level`.
+         */
+        uint64_t onesBefore(uint32_t level, uint64_t i) const noexcept {
+            const uint64_t position = level * stride_ + i;
+            return ((position == 0) ? 0 : rank_.rank1(position - 1)) - levelOnes_[level];
+        }
+
+        /**
+         * @brief Where position i of `level` moves on the next level, if its bit is `bit`. i may be the level length,
+         * to map the end of a range.
+         */
+        uint64_t descend(uint32_t level, uint64_t i, bool bit) const noexcept {
+            const uint64_t ones = this->onesBefore(level, i);
+            return bit ? levelZeros_[level] + ones : i - ones;
+        }
+
+        inline void checkBounds(uint64_t index, std::string const& name) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (index >= size_) {
+                    throw std::out_of_range("WaveletMatrix::" + name + " -- index " + std::to_string(index) +
+                        " is out of bounds for sequence of length " + std::to_string(size_) + ".");
+                }
+            }
+        }
+
+        inline void checkRange(uint64_t begin, uint64_t end, std::string const& name) const {
+            if constexpr (utility::CHECK_BOUNDS) {
+                if (begin > end || end > size_) {
+                    throw std::out_of_range("WaveletMatrix::" + name + " -- range [" + std::to_string(begin) + ", " +
+                        std::to_string(end) + ") is out of bounds for sequence of length " + std::to_string(size_) +
+                        ".");
+                }
+            }
+        }
+};
+
+}   // end namespace bitvector
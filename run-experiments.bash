@@ -5,6 +5,7 @@
 
 # config
 EXEC="./bin/experiment"
+BENCH="./bin/bench"
 TESTS="./bin/tests"
 DATA_DIR="./data"
 RANK_HEADER="problem,bitvector_size,num_rank_calls,num_iter,overhead,avg_duration"
@@ -57,8 +58,19 @@ for N in 100 1000 10000 100000; do
 done
 
 
+# -- Benchmark suite --
+echo "Running benchmark suite..."
+make ${BOUNDS_CHECKING_FLAG} bench
+if [ $? -ne 0 ]; then
+    echo "Build error. Stopping."
+    exit 1
+fi
+${BENCH} --benchmark_out=${DATA_DIR}/bench-results.json --benchmark_out_format=json
+
+
 # ======================
 # === GENERATE PLOTS ===
 # ======================
 echo "Generating plots..."
-python3 generate-plots.py ${DATA_DIR}/rank-results.csv ${DATA_DIR}/select-results.csv ${DATA_DIR}/sparsearray-results.csv
\ No newline at end of file
+python3 generate-plots.py ${DATA_DIR}/rank-results.csv ${DATA_DIR}/select-results.csv ${DATA_DIR}/sparsearray-results.csv
+python3 generate-plots.py --bench ${DATA_DIR}/bench-results.json
\ No newline at end of file
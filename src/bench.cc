@@ -0,0 +1,863 @@
+/*  Benchmark suite for rank, select, SparseArray, WaveletMatrix and serialization. Built on Google Benchmark.
+    usage: bin/bench [--benchmark_filter=<regex>] [--benchmark_out=<file.json> --benchmark_out_format=json]
+    author: Daniel Nichols
+    date: February 2022
+*/
+// stl includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// tpl includes
+#include <benchmark/benchmark.h>
+
+// local includes
+#include "bitvector.h"
+#include "instrument.h"
+#include "sparsearray.h"
+#include "utilities.h"
+#include "waveletmatrix.h"
+
+/* every benchmark is repeated this many times; min, median and max are over the repetitions' means */
+constexpr int REPETITIONS = 10;
+
+/* query benchmarks time every batch of this many queries, and report the p99 of the batches' ns per query */
+constexpr uint64_t LATENCY_BATCH = 256;
+
+/* minimum seconds per repetition */
+constexpr double MIN_TIME = 0.05;
+
+/* queries are drawn ahead of time into a buffer of this many (a power of 2), which is cycled through */
+constexpr uint64_t NUM_QUERIES = 1 << 16;
+
+/* exponent of the skewed query pattern. 0.99 is the YCSB default. */
+constexpr double ZIPF_EXPONENT = 0.99;
+
+/* fixed, so every run of the suite queries the same structures */
+constexpr uint64_t SEED = 858;
+
+/* structure sizes (bits for rank/select, positions for SparseArray) and densities (percent of positions set) */
+const std::vector<int64_t> SIZES = {1 << 10, 1 << 16, 1 << 20, 1 << 24};
+const std::vector<int64_t> DENSITIES = {1, 10, 50};
+
+/* alphabet sizes of the WaveletMatrix benchmarks */
+const std::vector<int64_t> ALPHABETS = {4, 256, 1 << 16};
+
+/* bitvector sizes of the page size comparison: one that fits the TLB reach of base pages, and one far past it */
+const std::vector<int64_t> PAGED_SIZES = {1 << 24, int64_t{1} << 32};
+
+/**
+ * @brief Order queries are issued in.
+ */
+enum Pattern : int64_t {
+    SEQUENTIAL = 0,     /* increasing, evenly spread over the structure */
+    RANDOM = 1,         /* uniform */
+    ZIPF = 2,           /* Zipf distributed ranks, with the hot items scattered over the structure */
+};
+
+const char *patternName(int64_t pattern) {
+    switch (pattern) {
+        case SEQUENTIAL: return "sequential";
+        case RANDOM: return "random";
+        default: return "zipf";
+    }
+}
+
+/**
+ * @brief Samples integers in [1, n] with P(k) proportional to 1/k^s in O(1) expected time, by rejection-inversion
+ * (Hörmann and Derflinger, 1996). Needs no table, so n can be the size of any structure.
+ */
+class ZipfDistribution {
+    public:
+        ZipfDistribution(uint64_t n, double exponent) : n_(n), s_(exponent) {
+            hIntegralX1_ = this->hIntegral(1.5) - 1.0;
+            hIntegralN_ = this->hIntegral(static_cast<double>(n) + 0.5);
+            squeeze_ = 2.0 - this->hIntegralInverse(this->hIntegral(2.5) - this->h(2.0));
+        }
+
+        template <typename Generator>
+        uint64_t operator()(Generator &rng) {
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            while (true) {
+                const double u = hIntegralN_ + uniform(rng) * (hIntegralX1_ - hIntegralN_);
+                const double x = this->hIntegralInverse(u);
+                const uint64_t k = std::clamp<uint64_t>(static_cast<uint64_t>(x + 0.5), 1, n_);
+                const double kd = static_cast<double>(k);
+                if (kd - x <= squeeze_ || u >= this->hIntegral(kd + 0.5) - this->h(kd)) {
+                    return k;
+                }
+            }
+        }
+
+    private:
+        uint64_t n_;
+        double s_;
+        double hIntegralX1_, hIntegralN_, squeeze_;
+
+        double h(double x) const {
+            return std::exp(-s_ * std::log(x));
+        }
+
+        double hIntegral(double x) const {
+            const double logX = std::log(x);
+            return helper2((1.0 - s_) * logX) * logX;
+        }
+
+        double hIntegralInverse(double x) const {
+            double t = x * (1.0 - s_);
+            if (t < -1.0) {
+                t = -1.0;   /* rounding near the left end */
+            }
+            return std::exp(helper1(t) * x);
+        }
+
+        /* log1p(x)/x and expm1(x)/x, with the limit at 0 */
+        static double helper1(double x) {
+            return (std::abs(x) > 1e-8) ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+        }
+
+        static double helper2(double x) {
+            return (std::abs(x) > 1e-8) ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+        }
+};
+
+/**
+ * @brief splitmix64 finalizer. Scatters the hot Zipf ranks over the structure.
+ */
+uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Draws NUM_QUERIES queries in [0, universe) in `pattern` order.
+ *
+ * @param universe number of distinct queries
+ * @param pattern a Pattern
+ * @return std::vector<uint64_t> the queries
+ */
+std::vector<uint64_t> makeQueries(uint64_t universe, int64_t pattern) {
+    std::vector<uint64_t> queries(NUM_QUERIES);
+    std::mt19937_64 rng(SEED + static_cast<uint64_t>(pattern));
+    if (pattern == SEQUENTIAL) {
+        for (uint64_t i = 0; i < NUM_QUERIES; i += 1) {
+            queries[i] = (universe >= NUM_QUERIES) ? i * (universe / NUM_QUERIES) : i % universe;
+        }
+    } else if (pattern == RANDOM) {
+        std::uniform_int_distribution<uint64_t> dist(0, universe - 1);
+        std::generate(queries.begin(), queries.end(), [&]() { return dist(rng); });
+    } else {
+        ZipfDistribution dist(universe, ZIPF_EXPONENT);
+        std::generate(queries.begin(), queries.end(), [&]() { return mix(dist(rng)) % universe; });
+    }
+    return queries;
+}
+
+/**
+ * @brief Sorted random positions in [0, size), each present with probability densityPct/100, drawn as geometric gaps
+ * so it takes time proportional to their number.
+ */
+std::vector<uint64_t> randomPositions(uint64_t size, int64_t densityPct) {
+    std::mt19937_64 rng(SEED);
+    std::geometric_distribution<uint64_t> gap(static_cast<double>(densityPct) / 100.0);
+    std::vector<uint64_t> positions;
+    positions.reserve(static_cast<uint64_t>(size * densityPct / 100.0 * 1.1) + 16);
+    for (uint64_t pos = gap(rng); pos < size; pos += 1 + gap(rng)) {
+        positions.push_back(pos);
+    }
+    return positions;
+}
+
+/**
+ * @brief Returns the Fixture built from `args`, building it only if the last call had different arguments. The
+ * repetitions (and iteration count estimates) of one benchmark then share one structure, and only the one structure
+ * of each fixture type is alive at a time.
+ */
+template <typename Fixture, typename ...Args>
+Fixture const& cached(Args ...args) {
+    static std::tuple<Args...> key;
+    static std::unique_ptr<Fixture> fixture;
+    if (!fixture || key != std::make_tuple(args...)) {
+        fixture.reset();
+        fixture = std::make_unique<Fixture>(args...);
+        key = std::make_tuple(args...);
+    }
+    return *fixture;
+}
+
+/**
+ * @param pages a utility::AllocationPolicy::Pages
+ * @return char const* name of `pages`, for labels
+ */
+const char *pagesName(int64_t pages) {
+    using Pages = utility::AllocationPolicy::Pages;
+    switch (static_cast<Pages>(pages)) {
+        case Pages::DEFAULT: return "default";
+        case Pages::SMALL: return "4k";
+        case Pages::TRANSPARENT_HUGE: return "thp";
+        case Pages::HUGE_2MB: return "hugetlb_2m";
+        case Pages::HUGE_1GB: return "hugetlb_1g";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief A random bitvector with its rank and select indices.
+ */
+struct BitVectorFixture {
+    BitVectorFixture(uint64_t size, int64_t densityPct) : bits(makeBits(size, densityPct)), rank(bits), select(rank) {}
+
+    bitvector::BitVector bits;
+    bitvector::RankSupport rank;
+    bitvector::SelectSupport<> select;
+
+    private:
+        static bitvector::BitVector makeBits(uint64_t size, int64_t densityPct) {
+            const auto positions = randomPositions(size, densityPct);
+            return bitvector::BitVector(size, positions.begin(), positions.end());
+        }
+};
+
+/**
+ * @brief A random bitvector (half the bits set) and its rank index, both allocated on `pages`.
+ */
+struct PagedRankFixture {
+    PagedRankFixture(uint64_t size, int64_t pages) :
+        policy{.pages = static_cast<utility::AllocationPolicy::Pages>(pages)}, bits(makeBits(size, policy)),
+        rank(bits, 0, policy) {}
+
+    utility::AllocationPolicy policy;
+    bitvector::BitVector bits;
+    bitvector::RankSupport rank;
+
+    private:
+        static bitvector::BitVector makeBits(uint64_t size, utility::AllocationPolicy policy) {
+            policy.zeroFill = false;
+            bitvector::BitVector bits(size, policy);
+            std::mt19937_64 rng(SEED);
+            std::generate(bits.words(), bits.words() + size / bitvector::BitVector::WORD_BITS, std::ref(rng));
+            return bits;
+        }
+};
+
+/**
+ * @brief A sequence of uniformly random symbols and its WaveletMatrix.
+ */
+struct WaveletFixture {
+    WaveletFixture(uint64_t size, int64_t alphabet) : symbols(makeSymbols(size, alphabet)), matrix(symbols, alphabet) {}
+
+    std::vector<uint64_t> symbols;
+    bitvector::WaveletMatrix matrix;
+
+    private:
+        static std::vector<uint64_t> makeSymbols(uint64_t size, int64_t alphabet) {
+            std::mt19937_64 rng(SEED);
+            std::uniform_int_distribution<uint64_t> symbol(0, static_cast<uint64_t>(alphabet) - 1);
+            std::vector<uint64_t> symbols(size);
+            std::generate(symbols.begin(), symbols.end(), [&]() { return symbol(rng); });
+            return symbols;
+        }
+};
+
+/**
+ * @brief Random (position, value) pairs and the SparseArray built from them.
+ */
+template <typename Positions>
+struct SparseArrayFixture {
+    SparseArrayFixture(uint64_t size, int64_t densityPct) : elements(randomElements(size, densityPct)),
+        array(sparse::SparseArray<uint64_t, Positions>::fromSorted(size, elements.begin(), elements.end())) {}
+
+    std::vector<std::pair<uint64_t, uint64_t>> elements;
+    sparse::SparseArray<uint64_t, Positions> array;
+
+    private:
+        static std::vector<std::pair<uint64_t, uint64_t>> randomElements(uint64_t size, int64_t densityPct) {
+            std::mt19937_64 rng(SEED + 1);
+            std::vector<std::pair<uint64_t, uint64_t>> elements;
+            for (uint64_t pos : randomPositions(size, densityPct)) {
+                elements.emplace_back(pos, rng());
+            }
+            return elements;
+        }
+};
+
+/**
+ * @brief Measures the instrument counters and hardware events of a benchmark's timed loop, from construction to
+ * `report`, and exports them per iteration next to the timings. Does nothing unless built with INSTRUMENT=1.
+ */
+class Instrumented {
+    public:
+        Instrumented() : before_(instrument::snapshot()) {
+            perf_.start();
+        }
+
+        void report(benchmark::State &state) {
+            perf_.stop();
+            if constexpr (instrument::ENABLED) {
+                const instrument::Counts after = instrument::snapshot();
+                for (uint32_t i = 0; i < instrument::NUM_COUNTERS; i += 1) {
+                    state.counters[instrument::COUNTER_NAMES[i]] = benchmark::Counter(
+                        static_cast<double>(after[i] - before_[i]), benchmark::Counter::kAvgIterations);
+                }
+                const auto events = perf_.read();
+                for (uint32_t e = 0; e < instrument::PerfCounters::NUM_EVENTS; e += 1) {
+                    const auto event = static_cast<instrument::PerfCounters::Event>(e);
+                    if (perf_.available(event)) {
+                        state.counters[instrument::PerfCounters::EVENT_NAMES[e]] = benchmark::Counter(
+                            static_cast<double>(events[e]), benchmark::Counter::kAvgIterations);
+                    }
+                }
+            }
+        }
+
+    private:
+        instrument::Counts before_;
+        instrument::PerfCounters perf_;
+};
+
+/**
+ * @brief Linearly interpolated `q`-quantile of `values`, which must not be empty.
+ */
+double percentile(std::vector<double> values, double q) {
+    std::sort(values.begin(), values.end());
+    const double rank = q * static_cast<double>(values.size() - 1);
+    const uint64_t below = static_cast<uint64_t>(rank);
+    const uint64_t above = std::min<uint64_t>(below + 1, values.size() - 1);
+    return values[below] + (rank - static_cast<double>(below)) * (values[above] - values[below]);
+}
+
+/**
+ * @brief Latency samples of a query benchmark's timed loop. Every LATENCY_BATCH queries are timed together, and
+ * `report` exports the 99th percentile of the batches' ns per query as `p99_ns_per_op`. The repetitions only see
+ * each run's mean, so this is what shows slow stretches within a run. One clock read per batch adds well under a
+ * nanosecond per query.
+ */
+class BatchLatency {
+    public:
+        explicit BatchLatency(benchmark::State const& state) {
+            samples_.reserve(state.max_iterations / LATENCY_BATCH + 1);
+        }
+
+        /**
+         * @brief Call once per query in the timed loop. The first call starts the clock.
+         */
+        void tick() {
+            if (count_++ % LATENCY_BATCH == 0) {
+                const auto now = std::chrono::steady_clock::now();
+                if (count_ > 1) {
+                    samples_.push_back(std::chrono::duration<double, std::nano>(now - start_).count() /
+                        static_cast<double>(LATENCY_BATCH));
+                }
+                start_ = now;
+            }
+        }
+
+        void report(benchmark::State &state) const {
+            if (!samples_.empty()) {
+                state.counters["p99_ns_per_op"] = percentile(samples_, 0.99);
+            }
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+        uint64_t count_ = 0;
+        std::vector<double> samples_;
+};
+
+/**
+ * @brief Records the parameters and per operation cost of a query benchmark, whose iterations are one query each.
+ *
+ * @param bytesPerElem bytes of the structure per bit (rank, select) or per stored element (SparseArray)
+ */
+void reportQueries(benchmark::State &state, double bytesPerElem) {
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(patternName(state.range(2)));
+    state.counters["size"] = static_cast<double>(state.range(0));
+    state.counters["density"] = static_cast<double>(state.range(1)) / 100.0;
+    state.counters["pattern"] = static_cast<double>(state.range(2));
+    state.counters["bytes_per_elem"] = bytesPerElem;
+    state.counters["ns_per_op"] = benchmark::Counter(static_cast<double>(state.iterations()) * 1e-9,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+/**
+ * @brief Records the parameters and throughput of a build or serialization benchmark, whose iterations each process
+ * `elements` elements (bits for rank/select) and `bytes` bytes.
+ */
+void reportBuild(benchmark::State &state, uint64_t elements, uint64_t bytes, double bytesPerElem) {
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(elements));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+    state.counters["size"] = static_cast<double>(state.range(0));
+    state.counters["density"] = static_cast<double>(state.range(1)) / 100.0;
+    state.counters["bytes_per_elem"] = bytesPerElem;
+    state.counters["ns_per_op"] = benchmark::Counter(static_cast<double>(state.iterations()) * 1e-9,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+/**
+ * @brief Reports a WaveletMatrix query benchmark, like reportQueries but with the alphabet size as the second argument.
+ */
+void reportWaveletQueries(benchmark::State &state, double bytesPerElem) {
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(patternName(state.range(2)));
+    state.counters["size"] = static_cast<double>(state.range(0));
+    state.counters["alphabet"] = static_cast<double>(state.range(1));
+    state.counters["pattern"] = static_cast<double>(state.range(2));
+    state.counters["bytes_per_elem"] = bytesPerElem;
+    state.counters["ns_per_op"] = benchmark::Counter(static_cast<double>(state.iterations()) * 1e-9,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+std::filesystem::path scratchFile() {
+    return std::filesystem::temp_directory_path() / "cmsc858d-bench.bin";
+}
+
+/* === rank and select === */
+
+void benchRank(benchmark::State &state) {
+    BitVectorFixture const& fixture = cached<BitVectorFixture>(state.range(0), state.range(1));
+    const auto queries = makeQueries(fixture.bits.size(), state.range(2));
+    uint64_t i = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        uint64_t result = fixture.rank.rank1(queries[i++ & (NUM_QUERIES - 1)]);
+        benchmark::DoNotOptimize(result);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    reportQueries(state, static_cast<double>(fixture.rank.overhead()) / 8.0 / static_cast<double>(state.range(0)));
+}
+
+void benchSelect(benchmark::State &state) {
+    BitVectorFixture const& fixture = cached<BitVectorFixture>(state.range(0), state.range(1));
+    const uint64_t ones = fixture.rank.totalOnes();
+    if (ones == 0) {
+        state.SkipWithError("no ones to select");
+        return;
+    }
+    const auto queries = makeQueries(ones, state.range(2));
+    uint64_t i = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        uint64_t result = fixture.select.select1(queries[i++ & (NUM_QUERIES - 1)] + 1);
+        benchmark::DoNotOptimize(result);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    reportQueries(state, static_cast<double>(fixture.select.overhead()) / 8.0 / static_cast<double>(state.range(0)));
+}
+
+void benchRankBuild(benchmark::State &state) {
+    BitVectorFixture const& fixture = cached<BitVectorFixture>(state.range(0), state.range(1));
+    Instrumented instrumented;
+    for (auto _ : state) {
+        bitvector::RankSupport rank(fixture.bits);
+        benchmark::DoNotOptimize(rank);
+    }
+    instrumented.report(state);
+    reportBuild(state, fixture.bits.size(), fixture.bits.size() / 8,
+        static_cast<double>(fixture.rank.overhead()) / 8.0 / static_cast<double>(state.range(0)));
+}
+
+void benchSelectBuild(benchmark::State &state) {
+    BitVectorFixture const& fixture = cached<BitVectorFixture>(state.range(0), state.range(1));
+    Instrumented instrumented;
+    for (auto _ : state) {
+        bitvector::SelectSupport<> select(fixture.rank);
+        benchmark::DoNotOptimize(select);
+    }
+    instrumented.report(state);
+    reportBuild(state, fixture.bits.size(), fixture.bits.size() / 8,
+        static_cast<double>(fixture.select.overhead()) / 8.0 / static_cast<double>(state.range(0)));
+}
+
+/**
+ * @brief Bytes of the mapping holding `ptr` that are backed by huge pages, transparent or hugetlb, from
+ * /proc/self/smaps. 0 if it cannot be read.
+ */
+uint64_t hugePageBytes(void const* ptr) {
+    const uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inMapping = false;
+    uint64_t kilobytes = 0;
+    while (std::getline(smaps, line)) {
+        uintptr_t first, last;
+        if (std::sscanf(line.c_str(), "%lx-%lx ", &first, &last) == 2) {
+            inMapping = (first <= address && address < last);
+        } else if (inMapping) {
+            uint64_t value;
+            if (std::sscanf(line.c_str(), "AnonHugePages: %lu kB", &value) == 1 ||
+                std::sscanf(line.c_str(), "Private_Hugetlb: %lu kB", &value) == 1) {
+                kilobytes += value;
+            }
+        }
+    }
+    return kilobytes * 1024;
+}
+
+/* random rank queries on a bitvector and rank index allocated on base, transparent huge, or hugetlb pages */
+void benchRankPages(benchmark::State &state) {
+    PagedRankFixture const& fixture = cached<PagedRankFixture>(state.range(0), state.range(1));
+    const auto queries = makeQueries(fixture.bits.size(), RANDOM);
+    uint64_t i = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        uint64_t result = fixture.rank.rank1(queries[i++ & (NUM_QUERIES - 1)]);
+        benchmark::DoNotOptimize(result);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(pagesName(state.range(1)));
+    state.counters["size"] = static_cast<double>(state.range(0));
+    state.counters["pages"] = static_cast<double>(state.range(1));
+    state.counters["huge_page_fraction"] = static_cast<double>(hugePageBytes(fixture.bits.words())) /
+        static_cast<double>(fixture.bits.numWords() * sizeof(uint64_t));
+    state.counters["ns_per_op"] = benchmark::Counter(static_cast<double>(state.iterations()) * 1e-9,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+double bytesPerSymbol(bitvector::WaveletMatrix const& matrix) {
+    return static_cast<double>(matrix.overhead()) / 8.0 / static_cast<double>(std::max<uint64_t>(1, matrix.size()));
+}
+
+void benchWaveletAccess(benchmark::State &state) {
+    WaveletFixture const& fixture = cached<WaveletFixture>(state.range(0), state.range(1));
+    const auto queries = makeQueries(fixture.matrix.size(), state.range(2));
+    uint64_t i = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        uint64_t result = fixture.matrix.access(queries[i++ & (NUM_QUERIES - 1)]);
+        benchmark::DoNotOptimize(result);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    reportWaveletQueries(state, bytesPerSymbol(fixture.matrix));
+}
+
+/* rank of the symbol at each query index, so every rank counts a symbol that occurs */
+void benchWaveletRank(benchmark::State &state) {
+    WaveletFixture const& fixture = cached<WaveletFixture>(state.range(0), state.range(1));
+    const auto queries = makeQueries(fixture.matrix.size(), state.range(2));
+    uint64_t i = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        const uint64_t index = queries[i++ & (NUM_QUERIES - 1)];
+        uint64_t result = fixture.matrix.rank(fixture.symbols[index], index);
+        benchmark::DoNotOptimize(result);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    reportWaveletQueries(state, bytesPerSymbol(fixture.matrix));
+}
+
+/* select of the occurrence of a symbol at each query index */
+void benchWaveletSelect(benchmark::State &state) {
+    WaveletFixture const& fixture = cached<WaveletFixture>(state.range(0), state.range(1));
+    const auto indices = makeQueries(fixture.matrix.size(), state.range(2));
+    std::vector<std::pair<uint64_t, uint64_t>> queries(NUM_QUERIES);
+    std::transform(indices.begin(), indices.end(), queries.begin(), [&](uint64_t index) {
+        const uint64_t c = fixture.symbols[index];
+        return std::pair(c, fixture.matrix.rank(c, index));
+    });
+    uint64_t i = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        auto const& [c, k] = queries[i++ & (NUM_QUERIES - 1)];
+        uint64_t result = fixture.matrix.select(c, k);
+        benchmark::DoNotOptimize(result);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    reportWaveletQueries(state, bytesPerSymbol(fixture.matrix));
+}
+
+void benchWaveletBuild(benchmark::State &state) {
+    WaveletFixture const& fixture = cached<WaveletFixture>(state.range(0), state.range(1));
+    Instrumented instrumented;
+    for (auto _ : state) {
+        bitvector::WaveletMatrix matrix(fixture.symbols, state.range(1));
+        benchmark::DoNotOptimize(matrix);
+    }
+    instrumented.report(state);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(sizeof(uint64_t)));
+    state.counters["size"] = static_cast<double>(state.range(0));
+    state.counters["alphabet"] = static_cast<double>(state.range(1));
+    state.counters["bytes_per_elem"] = bytesPerSymbol(fixture.matrix);
+    state.counters["ns_per_op"] = benchmark::Counter(static_cast<double>(state.iterations()) * 1e-9,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+/* === SparseArray === */
+
+template <typename Positions>
+double bytesPerElement(sparse::SparseArray<uint64_t, Positions> const& array) {
+    return static_cast<double>(array.overhead()) / 8.0 / static_cast<double>(std::max<uint64_t>(array.numElem(), 1));
+}
+
+template <typename Positions>
+void benchGetAtIndex(benchmark::State &state) {
+    auto const& fixture = cached<SparseArrayFixture<Positions>>(state.range(0), state.range(1));
+    const auto queries = makeQueries(fixture.array.size(), state.range(2));
+    uint64_t i = 0, element = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        bool found = fixture.array.getAtIndex(queries[i++ & (NUM_QUERIES - 1)], element);
+        benchmark::DoNotOptimize(found);
+        benchmark::DoNotOptimize(element);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    reportQueries(state, bytesPerElement(fixture.array));
+}
+
+template <typename Positions>
+void benchGetAtRank(benchmark::State &state) {
+    auto const& fixture = cached<SparseArrayFixture<Positions>>(state.range(0), state.range(1));
+    if (fixture.array.numElem() == 0) {
+        state.SkipWithError("no elements to select");
+        return;
+    }
+    const auto queries = makeQueries(fixture.array.numElem(), state.range(2));
+    uint64_t i = 0, element = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        bool found = fixture.array.getAtRank(queries[i++ & (NUM_QUERIES - 1)], element);
+        benchmark::DoNotOptimize(found);
+        benchmark::DoNotOptimize(element);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    reportQueries(state, bytesPerElement(fixture.array));
+}
+
+template <typename Positions>
+void benchNumElemAt(benchmark::State &state) {
+    auto const& fixture = cached<SparseArrayFixture<Positions>>(state.range(0), state.range(1));
+    const auto queries = makeQueries(fixture.array.size(), state.range(2));
+    uint64_t i = 0;
+    Instrumented instrumented;
+    BatchLatency latency(state);
+    for (auto _ : state) {
+        uint64_t result = fixture.array.numElemAt(queries[i++ & (NUM_QUERIES - 1)]);
+        benchmark::DoNotOptimize(result);
+        latency.tick();
+    }
+    instrumented.report(state);
+    latency.report(state);
+    reportQueries(state, bytesPerElement(fixture.array));
+}
+
+template <typename Positions>
+void benchAppend(benchmark::State &state) {
+    auto const& fixture = cached<SparseArrayFixture<Positions>>(state.range(0), state.range(1));
+    Instrumented instrumented;
+    for (auto _ : state) {
+        sparse::SparseArray<uint64_t, Positions> array;
+        array.create(fixture.array.size());
+        array.reserve(fixture.elements.size());
+        for (auto const& [pos, value] : fixture.elements) {
+            array.append(value, pos);
+        }
+        array.finalize();
+        benchmark::DoNotOptimize(array);
+    }
+    instrumented.report(state);
+    reportBuild(state, fixture.elements.size(), fixture.elements.size() * sizeof(uint64_t),
+        bytesPerElement(fixture.array));
+}
+
+template <typename Positions>
+void benchFromSorted(benchmark::State &state) {
+    auto const& fixture = cached<SparseArrayFixture<Positions>>(state.range(0), state.range(1));
+    Instrumented instrumented;
+    for (auto _ : state) {
+        auto array = sparse::SparseArray<uint64_t, Positions>::fromSorted(fixture.array.size(),
+            fixture.elements.begin(), fixture.elements.end());
+        benchmark::DoNotOptimize(array);
+    }
+    instrumented.report(state);
+    reportBuild(state, fixture.elements.size(), fixture.elements.size() * sizeof(uint64_t),
+        bytesPerElement(fixture.array));
+}
+
+/* === serialization === */
+
+template <typename Positions>
+void benchSave(benchmark::State &state) {
+    auto const& fixture = cached<SparseArrayFixture<Positions>>(state.range(0), state.range(1));
+    auto array = sparse::SparseArray<uint64_t, Positions>::fromSorted(fixture.array.size(),
+        fixture.elements.begin(), fixture.elements.end());
+    const std::string fname = scratchFile();
+    Instrumented instrumented;
+    for (auto _ : state) {
+        array.save(fname);
+    }
+    instrumented.report(state);
+    const uint64_t bytes = std::filesystem::file_size(fname);
+    std::filesystem::remove(fname);
+    reportBuild(state, fixture.elements.size(), bytes, bytesPerElement(fixture.array));
+}
+
+template <typename Positions>
+void benchLoad(benchmark::State &state) {
+    auto const& fixture = cached<SparseArrayFixture<Positions>>(state.range(0), state.range(1));
+    auto saved = sparse::SparseArray<uint64_t, Positions>::fromSorted(fixture.array.size(),
+        fixture.elements.begin(), fixture.elements.end());
+    const std::string fname = scratchFile();
+    saved.save(fname);
+    Instrumented instrumented;
+    for (auto _ : state) {
+        sparse::SparseArray<uint64_t, Positions> array;
+        array.load(fname);
+        benchmark::DoNotOptimize(array);
+    }
+    instrumented.report(state);
+    const uint64_t bytes = std::filesystem::file_size(fname);
+    std::filesystem::remove(fname);
+    reportBuild(state, fixture.elements.size(), bytes, bytesPerElement(fixture.array));
+}
+
+template <typename Positions>
+void benchMap(benchmark::State &state) {
+    auto const& fixture = cached<SparseArrayFixture<Positions>>(state.range(0), state.range(1));
+    auto saved = sparse::SparseArray<uint64_t, Positions>::fromSorted(fixture.array.size(),
+        fixture.elements.begin(), fixture.elements.end());
+    const std::string fname = scratchFile();
+    saved.save(fname);
+    Instrumented instrumented;
+    for (auto _ : state) {
+        sparse::SparseArray<uint64_t, Positions> array;
+        array.map(fname);
+        benchmark::DoNotOptimize(array);
+    }
+    instrumented.report(state);
+    const uint64_t bytes = std::filesystem::file_size(fname);
+    std::filesystem::remove(fname);
+    reportBuild(state, fixture.elements.size(), bytes, bytesPerElement(fixture.array));
+}
+
+/* === registration === */
+
+double minimum(std::vector<double> const& values) {
+    return *std::min_element(values.begin(), values.end());
+}
+
+double maximum(std::vector<double> const& values) {
+    return *std::max_element(values.begin(), values.end());
+}
+
+/**
+ * @brief Settings shared by every benchmark. Only the aggregates over the repetitions are reported: mean, median,
+ * stddev, cv (built in) and min, max. These are over the repetitions' means; per query tails are `p99_ns_per_op`
+ * (see BatchLatency).
+ */
+void repeated(benchmark::internal::Benchmark *b) {
+    b->Repetitions(REPETITIONS)->MinTime(MIN_TIME)->ReportAggregatesOnly(true)
+        ->ComputeStatistics("min", minimum)->ComputeStatistics("max", maximum);
+}
+
+void queryArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"size", "density", "pattern"});
+    for (int64_t size : SIZES) {
+        for (int64_t density : DENSITIES) {
+            for (int64_t pattern : {SEQUENTIAL, RANDOM, ZIPF}) {
+                b->Args({size, density, pattern});
+            }
+        }
+    }
+    repeated(b);
+}
+
+void buildArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"size", "density"})->ArgsProduct({SIZES, DENSITIES})->Unit(benchmark::kMicrosecond);
+    repeated(b);
+}
+
+void pagedArgs(benchmark::internal::Benchmark *b) {
+    using Pages = utility::AllocationPolicy::Pages;
+    b->ArgNames({"size", "pages"})->ArgsProduct({PAGED_SIZES, {static_cast<int64_t>(Pages::SMALL),
+        static_cast<int64_t>(Pages::DEFAULT), static_cast<int64_t>(Pages::TRANSPARENT_HUGE),
+        static_cast<int64_t>(Pages::HUGE_2MB)}});
+    repeated(b);
+}
+
+void waveletArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"size", "alphabet", "pattern"})->ArgsProduct({SIZES, ALPHABETS, {SEQUENTIAL, RANDOM, ZIPF}});
+    repeated(b);
+}
+
+void waveletBuildArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({"size", "alphabet"})->ArgsProduct({SIZES, ALPHABETS})->Unit(benchmark::kMicrosecond);
+    repeated(b);
+}
+
+BENCHMARK(benchRank)->Apply(queryArgs);
+BENCHMARK(benchSelect)->Apply(queryArgs);
+BENCHMARK(benchRankBuild)->Apply(buildArgs);
+BENCHMARK(benchSelectBuild)->Apply(buildArgs);
+BENCHMARK(benchRankPages)->Apply(pagedArgs);
+
+BENCHMARK(benchWaveletAccess)->Apply(waveletArgs);
+BENCHMARK(benchWaveletRank)->Apply(waveletArgs);
+BENCHMARK(benchWaveletSelect)->Apply(waveletArgs);
+BENCHMARK(benchWaveletBuild)->Apply(waveletBuildArgs);
+
+BENCHMARK_TEMPLATE(benchGetAtIndex, sparse::BitVectorPositions)->Apply(queryArgs);
+BENCHMARK_TEMPLATE(benchGetAtIndex, sparse::EliasFanoPositions)->Apply(queryArgs);
+BENCHMARK_TEMPLATE(benchGetAtRank, sparse::BitVectorPositions)->Apply(queryArgs);
+BENCHMARK_TEMPLATE(benchGetAtRank, sparse::EliasFanoPositions)->Apply(queryArgs);
+BENCHMARK_TEMPLATE(benchNumElemAt, sparse::BitVectorPositions)->Apply(queryArgs);
+BENCHMARK_TEMPLATE(benchNumElemAt, sparse::EliasFanoPositions)->Apply(queryArgs);
+BENCHMARK_TEMPLATE(benchAppend, sparse::BitVectorPositions)->Apply(buildArgs);
+BENCHMARK_TEMPLATE(benchAppend, sparse::EliasFanoPositions)->Apply(buildArgs);
+BENCHMARK_TEMPLATE(benchFromSorted, sparse::BitVectorPositions)->Apply(buildArgs);
+BENCHMARK_TEMPLATE(benchFromSorted, sparse::EliasFanoPositions)->Apply(buildArgs);
+
+BENCHMARK_TEMPLATE(benchSave, sparse::BitVectorPositions)->Apply(buildArgs);
+BENCHMARK_TEMPLATE(benchSave, sparse::EliasFanoPositions)->Apply(buildArgs);
+BENCHMARK_TEMPLATE(benchLoad, sparse::BitVectorPositions)->Apply(buildArgs);
+BENCHMARK_TEMPLATE(benchLoad, sparse::EliasFanoPositions)->Apply(buildArgs);
+BENCHMARK_TEMPLATE(benchMap, sparse::BitVectorPositions)->Apply(buildArgs);
+BENCHMARK_TEMPLATE(benchMap, sparse::EliasFanoPositions)->Apply(buildArgs);
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::AddCustomContext("bounds_checking", utility::CHECK_BOUNDS ? "on" : "off");
+    benchmark::AddCustomContext("zipf_exponent", std::to_string(ZIPF_EXPONENT));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
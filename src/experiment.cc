@@ -7,39 +7,74 @@
 #include <chrono>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <numeric>
 #include <string>
+#include <thread>
 
 // local includes
 #include "bitvector.h"
+#include "compressedbitvector.h"
+#include "concurrentsparsearray.h"
+#include "dynamicbitvector.h"
+#include "shardedsparsearray.h"
 #include "sparsearray.h"
 
 /* average results over this number of tests. */
 constexpr uint32_t NUM_TEST_ITER = 50;
 
 /* declarations */
-void testRank(uint64_t bvSize, uint64_t numRankCalls);
+template <typename Rank> void testRank(std::string const& name, uint64_t bvSize, uint64_t numRankCalls);
+void testRankBatch(std::string const& name, uint64_t bvSize, uint64_t numRankCalls, bool sortQueries);
+void testBuild(uint64_t bvSize, uint32_t numThreads);
 void testSelect(uint64_t bvSize, uint64_t numSelectCalls);
-void testSparseArray(uint64_t size, float sparsity, uint64_t funcCalls);
+template <typename Positions> void testSparseArray(std::string const& name, uint64_t size, float sparsity, 
+    uint64_t funcCalls);
+void testBulk(uint64_t size, float sparsity, uint32_t numThreads);
+void testScan(uint64_t size, float sparsity);
+void testConcurrent(uint64_t size, float sparsity, uint32_t numReaders, uint64_t numQueries);
+void testDynamic(uint64_t bvSize, uint64_t numCalls);
+void testSharded(uint64_t size, float sparsity, uint32_t numShards, uint64_t numQueries);
+int testLarge(uint64_t bvSize, uint64_t numCalls);
 
 int main(int argc, char** argv) {
 
     if (argc < 2) {
-        std::cerr << "usage: " << argv[0] << "<rank|select|sparsearray> <options...>\n";
+        std::cerr << "usage: " << argv[0] << "<rank|rank-interleaved|rank-rrr|rank-batch|rank-batch-sorted|build|select|sparsearray|sparsearray-ef|sparsearray-interleaved|sparsearray-rrr|bulk|scan|concurrent|dynamic|sharded|large> <options...>\n";
         return 1;
     }
 
     std::string action(argv[1]);
     std::transform(std::begin(action), std::end(action), std::begin(action), ::tolower);
-    if (action == "rank") {
+    if (action == "rank" || action == "rank-interleaved" || action == "rank-rrr" || action == "rank-batch" || 
+        action == "rank-batch-sorted") {
         if (argc != 4) {
-            std::cerr << "usage: " << argv[0] << "rank bitvectorSize numRankCalls\n";
+            std::cerr << "usage: " << argv[0] << action << " bitvectorSize numRankCalls\n";
             return 1;
         }
 
         const uint64_t bvSize = std::stoull(std::string(argv[2]));
         const uint64_t numRankCalls = std::stoull(std::string(argv[3]));
 
-        testRank(bvSize, numRankCalls);
+        if (action == "rank") {
+            testRank<bitvector::RankSupport>(action, bvSize, numRankCalls);
+        } else if (action == "rank-rrr") {
+            testRank<bitvector::CompressedBitVector>(action, bvSize, numRankCalls);
+        } else if (action == "rank-batch" || action == "rank-batch-sorted") {
+            testRankBatch(action, bvSize, numRankCalls, action == "rank-batch-sorted");
+        } else {
+            testRank<bitvector::RankSupportInterleaved>(action, bvSize, numRankCalls);
+        }
+    } else if (action == "build") {
+        if (argc != 3 && argc != 4) {
+            std::cerr << "usage: " << argv[0] << "build bitvectorSize [numThreads]\n";
+            return 1;
+        }
+
+        const uint64_t bvSize = std::stoull(std::string(argv[2]));
+        const uint32_t numThreads = (argc == 4) ? std::stoul(std::string(argv[3])) : 1;
+
+        testBuild(bvSize, numThreads);
     } else if (action == "select") {
         if (argc != 4) {
             std::cerr << "usage: " << argv[0] << "select bitvectorSize numSelectCalls\n";
@@ -50,9 +85,10 @@ int main(int argc, char** argv) {
         const uint64_t numSelectCalls = std::stoull(std::string(argv[3]));
 
         testSelect(bvSize, numSelectCalls);
-    } else if (action == "sparsearray" || action == "sparse-array") {
+    } else if (action == "sparsearray" || action == "sparse-array" || action == "sparsearray-ef" ||
+               action == "sparsearray-interleaved" || action == "sparsearray-rrr") {
         if (argc != 5) {
-            std::cerr << "usage: " << argv[0] << "sparsearray bitvectorSize sparsity numFuncCalls\n";
+            std::cerr << "usage: " << argv[0] << action << " bitvectorSize sparsity numFuncCalls\n";
             return 1;
         }
 
@@ -65,15 +101,110 @@ int main(int argc, char** argv) {
             return 1;
         }
 
-        testSparseArray(bvSize, sparsity, numFuncCalls);
+        if (action == "sparsearray-ef") {
+            testSparseArray<sparse::EliasFanoPositions>(action, bvSize, sparsity, numFuncCalls);
+        } else if (action == "sparsearray-interleaved") {
+            testSparseArray<sparse::InterleavedPositions>(action, bvSize, sparsity, numFuncCalls);
+        } else if (action == "sparsearray-rrr") {
+            testSparseArray<sparse::CompressedPositions>(action, bvSize, sparsity, numFuncCalls);
+        } else {
+            testSparseArray<sparse::BitVectorPositions>("sparsearray", bvSize, sparsity, numFuncCalls);
+        }
+    } else if (action == "bulk") {
+        if (argc != 4 && argc != 5) {
+            std::cerr << "usage: " << argv[0] << "bulk arraySize sparsity [numThreads]\n";
+            return 1;
+        }
+
+        const uint64_t size = std::stoull(std::string(argv[2]));
+        const float sparsity = std::stof(std::string(argv[3]));
+        const uint32_t numThreads = (argc == 5) ? std::stoul(std::string(argv[4])) : 1;
+
+        if (sparsity <= 0.0 || sparsity > 1.0) {
+            std::cerr << "sparsity must be in (0,1]." << "\n";
+            return 1;
+        }
+
+        testBulk(size, sparsity, numThreads);
+    } else if (action == "scan") {
+        if (argc != 4) {
+            std::cerr << "usage: " << argv[0] << "scan arraySize sparsity\n";
+            return 1;
+        }
+
+        const uint64_t size = std::stoull(std::string(argv[2]));
+        const float sparsity = std::stof(std::string(argv[3]));
+
+        if (sparsity <= 0.0 || sparsity > 1.0) {
+            std::cerr << "sparsity must be in (0,1]." << "\n";
+            return 1;
+        }
+
+        testScan(size, sparsity);
+    } else if (action == "concurrent") {
+        if (argc != 6) {
+            std::cerr << "usage: " << argv[0] << "concurrent arraySize sparsity numReaders numQueries\n";
+            return 1;
+        }
+
+        const uint64_t size = std::stoull(std::string(argv[2]));
+        const float sparsity = std::stof(std::string(argv[3]));
+        const uint32_t numReaders = std::stoul(std::string(argv[4]));
+        const uint64_t numQueries = std::stoull(std::string(argv[5]));
+
+        if (sparsity <= 0.0 || sparsity > 1.0) {
+            std::cerr << "sparsity must be in (0,1]." << "\n";
+            return 1;
+        }
+
+        testConcurrent(size, sparsity, numReaders, numQueries);
+    } else if (action == "dynamic") {
+        if (argc != 4) {
+            std::cerr << "usage: " << argv[0] << "dynamic bitvectorSize numCalls\n";
+            return 1;
+        }
+
+        const uint64_t bvSize = std::stoull(std::string(argv[2]));
+        const uint64_t numCalls = std::stoull(std::string(argv[3]));
+
+        testDynamic(bvSize, numCalls);
+    } else if (action == "sharded") {
+        if (argc != 6) {
+            std::cerr << "usage: " << argv[0] << "sharded arraySize sparsity numShards numQueries\n";
+            return 1;
+        }
+
+        const uint64_t size = std::stoull(std::string(argv[2]));
+        const float sparsity = std::stof(std::string(argv[3]));
+        const uint32_t numShards = std::stoul(std::string(argv[4]));
+        const uint64_t numQueries = std::stoull(std::string(argv[5]));
+
+        if (sparsity <= 0.0 || sparsity > 1.0) {
+            std::cerr << "sparsity must be in (0,1]." << "\n";
+            return 1;
+        }
+
+        testSharded(size, sparsity, numShards, numQueries);
+    } else if (action == "large") {
+        if (argc > 4) {
+            std::cerr << "usage: " << argv[0] << "large [bitvectorSize] [numCalls]\n";
+            return 1;
+        }
+
+        /* default to just over 2^33 bits so every index, count, and file size needs more than 32 bits */
+        const uint64_t bvSize = (argc >= 3) ? std::stoull(std::string(argv[2])) : (1ull << 33) + 12345;
+        const uint64_t numCalls = (argc == 4) ? std::stoull(std::string(argv[3])) : 1000000;
+
+        return testLarge(bvSize, numCalls);
     } else {
-        std::cerr << "usage: " << argv[0] << "<rank|select|sparsearray> <options...>\n";
+        std::cerr << "usage: " << argv[0] << "<rank|rank-interleaved|rank-rrr|rank-batch|rank-batch-sorted|build|select|sparsearray|sparsearray-ef|sparsearray-interleaved|sparsearray-rrr|bulk|scan|concurrent|dynamic|sharded|large> <options...>\n";
         return 1;
     }
 }
 
 
-void testRank(uint64_t bvSize, uint64_t numRankCalls) {
+template <typename Rank>
+void testRank(std::string const& name, uint64_t bvSize, uint64_t numRankCalls) {
     std::random_device device;
     std::mt19937 rng(device());
     std::uniform_int_distribution<uint64_t> dist{0, bvSize-1};
@@ -84,7 +215,7 @@ void testRank(uint64_t bvSize, uint64_t numRankCalls) {
     for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
 
         const bitvector::BitVector bv = bitvector::getRandomBitVector(bvSize);
-        const bitvector::RankSupport rank(bv);
+        const Rank rank(bv);
 
         /* record overhead */
         if (i == 0) {
@@ -92,41 +223,105 @@ void testRank(uint64_t bvSize, uint64_t numRankCalls) {
         }
 
         /* generate random indices ahead of time */
-        std::vector<uint64_t> indices(numRankCalls);
+        std::vector<uint64_t> indices(numRankCalls), results(numRankCalls);
         std::generate(std::begin(indices), std::end(indices), [&rng, &dist](){ return dist(rng); });
 
         const auto begin = std::chrono::high_resolution_clock::now();
         for (uint64_t j = 0; j < numRankCalls; j += 1) {
-            /*  I've experimentally confirmed on clang and gcc with -S flag that this does not get optimized away.
-                Probably since RankSupport accesses bitvector's data, which may be aliased...?
-                If it does appear to be getting optimized, then we can replace indices[j] with a volatile temporary 
-                variable `const auto volatile idx = indices[j];`. */
-            rank(indices[j]);
+            /*  Store the results like rank-batch does. With NO_BOUNDS_CHECKING=1 gcc removes calls whose results
+                are never used, since rank has no other side effects. */
+            results[j] = rank(indices[j]);
         } 
         const auto end = std::chrono::high_resolution_clock::now();
         const auto duration = std::chrono::duration<double>(end-begin).count();
         avgDuration += duration;
+
+        /* keep the results observable so the loop can't be optimized away */
+        if (numRankCalls > 0 && results.back() > bvSize) {
+            std::cerr << "invalid rank.\n";
+        }
     }
 
     avgDuration /= static_cast<double>(NUM_TEST_ITER);
 
-    std::cout << "rank," << bvSize << "," << numRankCalls << "," << NUM_TEST_ITER << "," << overhead << "," 
+    std::cout << name << "," << bvSize << "," << numRankCalls << "," << NUM_TEST_ITER << "," << overhead << "," 
             << avgDuration << "\n";
 }
 
-void testSelect(uint64_t bvSize, uint64_t numSelectCalls) {
+void testRankBatch(std::string const& name, uint64_t bvSize, uint64_t numRankCalls, bool sortQueries) {
     std::random_device device;
     std::mt19937 rng(device());
+    std::uniform_int_distribution<uint64_t> dist{0, bvSize-1};
 
     uint64_t overhead = 0;
     double avgDuration = 0.0;
 
     for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
 
-        auto bitString = bitvector::getRandomBinaryString(bvSize);
-        std::shuffle(std::begin(bitString), std::end(bitString), rng);
+        const bitvector::BitVector bv = bitvector::getRandomBitVector(bvSize);
+        const bitvector::RankSupport rank(bv);
+
+        /* record overhead */
+        if (i == 0) {
+            overhead = rank.overhead();
+        }
+
+        /* generate random indices ahead of time */
+        std::vector<uint64_t> indices(numRankCalls), results(numRankCalls);
+        std::generate(std::begin(indices), std::end(indices), [&rng, &dist](){ return dist(rng); });
 
-        const bitvector::BitVector bv(bitString);
+        const auto begin = std::chrono::high_resolution_clock::now();
+        rank.rank1Batch(indices, results, sortQueries);
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto duration = std::chrono::duration<double>(end-begin).count();
+        avgDuration += duration;
+
+        /* keep the results observable so the batch can't be optimized away */
+        if (numRankCalls > 0 && results.back() > bvSize) {
+            std::cerr << "invalid rank.\n";
+        }
+    }
+
+    avgDuration /= static_cast<double>(NUM_TEST_ITER);
+
+    std::cout << name << "," << bvSize << "," << numRankCalls << "," << NUM_TEST_ITER << "," << overhead << "," 
+            << avgDuration << "\n";
+}
+
+void testBuild(uint64_t bvSize, uint32_t numThreads) {
+    double avgDuration = 0.0;
+
+    const bitvector::BitVector bv = bitvector::getRandomBitVector(bvSize);
+    for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
+
+        const auto begin = std::chrono::high_resolution_clock::now();
+        const bitvector::RankSupport rank(bv, numThreads);
+        const auto end = std::chrono::high_resolution_clock::now();
+        const auto duration = std::chrono::duration<double>(end-begin).count();
+        avgDuration += duration;
+
+        /* keep the tables observable so construction can't be optimized away */
+        if (rank.totalOnes() > bvSize) {
+            std::cerr << "invalid number of ones.\n";
+        }
+    }
+
+    avgDuration /= static_cast<double>(NUM_TEST_ITER);
+    const double bitsPerSecond = static_cast<double>(bvSize) / avgDuration;
+
+    std::cout << "build," << bvSize << "," << numThreads << "," << NUM_TEST_ITER << "," << avgDuration << "," << bitsPerSecond << "\n";
+}
+
+void testSelect(uint64_t bvSize, uint64_t numSelectCalls) {
+    std::random_device device;
+    std::mt19937 rng(device());
+
+    uint64_t overhead = 0;
+    double avgDuration = 0.0;
+
+    for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
+
+        const bitvector::BitVector bv = bitvector::getRandomBitVector(bvSize, rng());
         const bitvector::RankSupport rank(bv);
         const bitvector::SelectSupport select(rank);
         std::uniform_int_distribution<uint64_t> dist{1, rank.totalOnes()};
@@ -137,18 +332,22 @@ void testSelect(uint64_t bvSize, uint64_t numSelectCalls) {
         }
 
         /* generate random indices ahead of time */
-        std::vector<uint64_t> indices(numSelectCalls);
+        std::vector<uint64_t> indices(numSelectCalls), results(numSelectCalls);
         std::generate(std::begin(indices), std::end(indices), [&rng, &dist](){ return dist(rng); });
 
         const auto begin = std::chrono::high_resolution_clock::now();
         for (uint64_t k = 0; k < numSelectCalls; k += 1) {
-            /*  I've experimentally confirmed on clang and gcc with -S flag that this does not get optimized away.
-                Probably since SelectSupport accesses bitvector's data, which may be aliased...? */
-            select(indices[k]);
+            /* stored like in testRank, so calls without bounds checks can't be removed as unused */
+            results[k] = select(indices[k]);
         } 
         const auto end = std::chrono::high_resolution_clock::now();
         const auto duration = std::chrono::duration<double>(end-begin).count();
         avgDuration += duration;
+
+        /* keep the results observable so the loop can't be optimized away */
+        if (numSelectCalls > 0 && results.back() >= bvSize) {
+            std::cerr << "invalid select.\n";
+        }
     }
 
     avgDuration /= static_cast<double>(NUM_TEST_ITER);
@@ -157,7 +356,8 @@ void testSelect(uint64_t bvSize, uint64_t numSelectCalls) {
             << avgDuration << "\n";
 }
 
-void testSparseArray(uint64_t size, float sparsity, uint64_t funcCalls) {
+template <typename Positions>
+void testSparseArray(std::string const& name, uint64_t size, float sparsity, uint64_t funcCalls) {
 
     const uint64_t numToInsert = static_cast<uint64_t>(size*sparsity);
     std::random_device device;
@@ -168,12 +368,12 @@ void testSparseArray(uint64_t size, float sparsity, uint64_t funcCalls) {
     auto getRandKeyValuePair = [&rng, &dist, &indexDist](){ return std::make_pair(indexDist(rng), dist(rng)); };
 
     double avgAppendDuration = 0.0, avgGetAtIndexDuration = 0.0, avgGetAtRankDuration = 0.0;
-    uint64_t sparseOverhead;
+    uint64_t sparseOverhead = 0;
     const uint64_t denseOverhead = 8*sizeof(uint64_t)*size;
 
     for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
 
-        sparse::SparseArray<uint64_t> array;
+        sparse::SparseArray<uint64_t, Positions> array;
         array.create(size);
 
         /* append */
@@ -188,6 +388,8 @@ void testSparseArray(uint64_t size, float sparsity, uint64_t funcCalls) {
         auto duration = std::chrono::duration<double>(end-begin).count();
         avgAppendDuration += duration / static_cast<double>(numToInsert);
 
+        /* untimed, so both position policies time their queries on a finished index */
+        array.finalize();
         if (i == 0) {
             sparseOverhead = array.overhead();
         }
@@ -222,7 +424,382 @@ void testSparseArray(uint64_t size, float sparsity, uint64_t funcCalls) {
     avgGetAtIndexDuration /= static_cast<double>(NUM_TEST_ITER);
     avgGetAtRankDuration /= static_cast<double>(NUM_TEST_ITER);
 
-    std::cout << "sparsearray," << size << "," << sparsity << "," << funcCalls << "," << denseOverhead << "," << 
+    std::cout << name << "," << size << "," << sparsity << "," << funcCalls << "," << denseOverhead << "," << 
             sparseOverhead << "," << avgAppendDuration << "," << avgGetAtIndexDuration << "," << 
             avgGetAtRankDuration << "\n";
 }
+
+void testBulk(uint64_t size, float sparsity, uint32_t numThreads) {
+    std::random_device device;
+    std::mt19937_64 rng(device());
+    std::bernoulli_distribution keep(sparsity);
+
+    /* sorted (position, value) input, as produced by a sorted ETL run */
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (uint64_t pos = 0; pos < size; pos += 1) {
+        if (keep(rng)) {
+            pairs.emplace_back(pos, rng());
+        }
+    }
+    using Iter = decltype(pairs)::const_iterator;
+    std::vector<std::pair<Iter, Iter>> runs;
+    const uint64_t runLength = std::max<uint64_t>(1, pairs.size() / std::max(numThreads, 1u));
+    for (uint64_t start = 0; start < pairs.size(); start += runLength) {
+        runs.emplace_back(pairs.cbegin() + start, pairs.cbegin() + std::min(start + runLength, pairs.size()));
+    }
+
+    double avgAppendDuration = 0.0, avgSortedDuration = 0.0, avgRunsDuration = 0.0;
+    for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
+        auto begin = std::chrono::high_resolution_clock::now();
+        sparse::SparseArray<uint64_t> appended;
+        appended.create(size);
+        for (auto const& [pos, value] : pairs) {
+            appended.append(value, pos);
+        }
+        appended.finalize();
+        auto end = std::chrono::high_resolution_clock::now();
+        avgAppendDuration += std::chrono::duration<double>(end-begin).count();
+
+        begin = std::chrono::high_resolution_clock::now();
+        const auto sorted = sparse::SparseArray<uint64_t>::fromSorted(size, pairs.cbegin(), pairs.cend());
+        end = std::chrono::high_resolution_clock::now();
+        avgSortedDuration += std::chrono::duration<double>(end-begin).count();
+
+        begin = std::chrono::high_resolution_clock::now();
+        const auto parallel = sparse::SparseArray<uint64_t>::fromSortedRuns(size, runs, numThreads);
+        end = std::chrono::high_resolution_clock::now();
+        avgRunsDuration += std::chrono::duration<double>(end-begin).count();
+
+        if (sorted.numElem() != appended.numElem() || parallel.numElem() != appended.numElem()) {
+            std::cerr << "invalid number of elements.\n";
+        }
+    }
+
+    avgAppendDuration /= static_cast<double>(NUM_TEST_ITER);
+    avgSortedDuration /= static_cast<double>(NUM_TEST_ITER);
+    avgRunsDuration /= static_cast<double>(NUM_TEST_ITER);
+
+    std::cout << "bulk," << size << "," << sparsity << "," << numThreads << "," << NUM_TEST_ITER << "," 
+            << avgAppendDuration << "," << avgSortedDuration << "," << avgRunsDuration << "\n";
+}
+
+void testScan(uint64_t size, float sparsity) {
+    std::random_device device;
+    std::mt19937_64 rng(device());
+    std::bernoulli_distribution keep(sparsity);
+
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (uint64_t pos = 0; pos < size; pos += 1) {
+        if (keep(rng)) {
+            pairs.emplace_back(pos, rng());
+        }
+    }
+    auto array = sparse::SparseArray<uint64_t>::fromSorted(size, pairs.cbegin(), pairs.cend());
+
+    /* every pass sums positions and values, so none of them can be optimized away */
+    double avgIterDuration = 0.0, avgRankDuration = 0.0, avgIndexDuration = 0.0;
+    uint64_t iterSum = 0, rankSum = 0, indexSum = 0;
+    for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
+        auto begin = std::chrono::high_resolution_clock::now();
+        for (auto const& [pos, value] : array) {
+            iterSum += pos ^ value;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        avgIterDuration += std::chrono::duration<double>(end-begin).count();
+
+        begin = std::chrono::high_resolution_clock::now();
+        uint64_t value = 0;
+        for (uint64_t rank = 0; rank < array.numElem(); rank += 1) {
+            array.getAtRank(rank, value);
+            rankSum += value;
+        }
+        end = std::chrono::high_resolution_clock::now();
+        avgRankDuration += std::chrono::duration<double>(end-begin).count();
+
+        begin = std::chrono::high_resolution_clock::now();
+        for (uint64_t index = 0; index < size; index += 1) {
+            if (array.getAtIndex(index, value)) {
+                indexSum += index ^ value;
+            }
+        }
+        end = std::chrono::high_resolution_clock::now();
+        avgIndexDuration += std::chrono::duration<double>(end-begin).count();
+    }
+    if (iterSum != indexSum) {
+        std::cerr << "scan: iteration and getAtIndex disagree.\n";
+    }
+
+    avgIterDuration /= static_cast<double>(NUM_TEST_ITER);
+    avgRankDuration /= static_cast<double>(NUM_TEST_ITER);
+    avgIndexDuration /= static_cast<double>(NUM_TEST_ITER);
+
+    std::cout << "scan," << size << "," << sparsity << "," << NUM_TEST_ITER << "," << avgIterDuration << ","
+            << avgRankDuration << "," << avgIndexDuration << "," << (rankSum & 1) << "\n";
+}
+
+void testConcurrent(uint64_t size, float sparsity, uint32_t numReaders, uint64_t numQueries) {
+    std::random_device device;
+    std::mt19937_64 rng(device());
+    std::bernoulli_distribution keep(sparsity);
+
+    /* the first half of the positions is loaded up front; a writer appends the rest while readers query */
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (uint64_t pos = 0; pos < size; pos += 1) {
+        if (keep(rng)) {
+            pairs.emplace_back(pos, rng());
+        }
+    }
+    const auto middle = pairs.cbegin() + pairs.size() / 2;
+    constexpr uint64_t PUBLISH_EVERY = 10000;
+
+    /* average lookup time per reader thread, with `write` running alongside until every reader is done. Each reader
+       thread makes its own lookup function. */
+    auto timeReaders = [&](auto&& makeLookup, auto&& write) {
+        std::atomic<bool> readersDone = false;
+        std::thread writer([&] { write(readersDone); });
+
+        std::vector<double> durations(numReaders);
+        std::vector<std::thread> readers;
+        for (uint32_t t = 0; t < numReaders; t += 1) {
+            readers.emplace_back([&, t] {
+                std::mt19937_64 queries(t);
+                auto lookup = makeLookup();
+                uint64_t found = 0;
+                const auto begin = std::chrono::high_resolution_clock::now();
+                for (uint64_t q = 0; q < numQueries; q += 1) {
+                    found += lookup(queries() % size) ? 1 : 0;
+                }
+                const auto end = std::chrono::high_resolution_clock::now();
+                durations.at(t) = std::chrono::duration<double>(end-begin).count() / std::max<uint64_t>(numQueries, 1);
+                if (found > numQueries) {
+                    std::cerr << "concurrent: impossible lookup count.\n";
+                }
+            });
+        }
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        readersDone = true;
+        writer.join();
+        return std::accumulate(durations.cbegin(), durations.cend(), 0.0) / std::max(numReaders, 1u);
+    };
+
+    /* baseline: readers of a plain SparseArray that nothing writes to */
+    const auto fixed = sparse::SparseArray<uint64_t>::fromSorted(size, pairs.cbegin(), middle);
+    const double baselineDuration = timeReaders(
+        [&fixed] {
+            return [&fixed](uint64_t index) { return fixed.find(index) != nullptr; };
+        },
+        [](std::atomic<bool> const&) {});
+
+    /* snapshots: readers never block, the writer publishes every PUBLISH_EVERY appends */
+    uint64_t publishes = 0;
+    sparse::ConcurrentSparseArray<uint64_t> concurrent(
+        sparse::SparseArray<uint64_t>::fromSorted(size, pairs.cbegin(), middle));
+    const double snapshotDuration = timeReaders(
+        [&concurrent] {
+            return [reader = concurrent.reader()](uint64_t index) mutable { return reader.find(index) != nullptr; };
+        },
+        [&](std::atomic<bool> const& readersDone) {
+            for (auto it = middle; it != pairs.cend() && !readersDone; ++it) {
+                concurrent.append(it->second, it->first);
+                if ((it - middle + 1) % PUBLISH_EVERY == 0) {
+                    concurrent.publish();
+                    publishes += 1;
+                }
+            }
+        });
+
+    /* one mutex around a SparseArray: every lookup and append takes it */
+    std::mutex mutex;
+    auto locked = sparse::SparseArray<uint64_t>::fromSorted(size, pairs.cbegin(), middle);
+    const double mutexDuration = timeReaders(
+        [&] {
+            return [&](uint64_t index) {
+                std::lock_guard<std::mutex> lock(mutex);
+                return locked.find(index) != nullptr;
+            };
+        },
+        [&](std::atomic<bool> const& readersDone) {
+            for (auto it = middle; it != pairs.cend() && !readersDone; ++it) {
+                std::lock_guard<std::mutex> lock(mutex);
+                locked.append(it->second, it->first);
+            }
+        });
+
+    std::cout << "concurrent," << size << "," << sparsity << "," << numReaders << "," << numQueries << "," 
+            << baselineDuration << "," << snapshotDuration << "," << mutexDuration << "," << publishes << "\n";
+}
+
+void testDynamic(uint64_t bvSize, uint64_t numCalls) {
+    std::random_device device;
+    std::mt19937_64 rng(device());
+
+    /* each timed loop is numCalls random operations on a DynamicBitVector of about bvSize bits */
+    double avgInsertDuration = 0.0, avgEraseDuration = 0.0, avgSetDuration = 0.0, avgRankDuration = 0.0, 
+        avgSelectDuration = 0.0;
+    uint64_t checksum = 0, overhead = 0;
+    for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
+        bitvector::DynamicBitVector bits(bitvector::getRandomBitVector(bvSize, rng()));
+
+        auto begin = std::chrono::high_resolution_clock::now();
+        for (uint64_t call = 0; call < numCalls; call += 1) {
+            bits.insert(rng() % (bits.size() + 1), rng() & 1);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        avgInsertDuration += std::chrono::duration<double>(end-begin).count() / numCalls;
+
+        begin = std::chrono::high_resolution_clock::now();
+        for (uint64_t call = 0; call < numCalls; call += 1) {
+            bits.set(rng() % bits.size(), rng() & 1);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        avgSetDuration += std::chrono::duration<double>(end-begin).count() / numCalls;
+
+        begin = std::chrono::high_resolution_clock::now();
+        for (uint64_t call = 0; call < numCalls; call += 1) {
+            checksum += bits.rank1(rng() % bits.size());
+        }
+        end = std::chrono::high_resolution_clock::now();
+        avgRankDuration += std::chrono::duration<double>(end-begin).count() / numCalls;
+
+        begin = std::chrono::high_resolution_clock::now();
+        for (uint64_t call = 0; bits.totalOnes() > 0 && call < numCalls; call += 1) {
+            checksum += bits.select1(1 + rng() % bits.totalOnes());
+        }
+        end = std::chrono::high_resolution_clock::now();
+        avgSelectDuration += std::chrono::duration<double>(end-begin).count() / numCalls;
+
+        overhead = bits.overhead();
+        begin = std::chrono::high_resolution_clock::now();
+        for (uint64_t call = 0; bits.size() > 0 && call < numCalls; call += 1) {
+            checksum += bits.erase(rng() % bits.size());
+        }
+        end = std::chrono::high_resolution_clock::now();
+        avgEraseDuration += std::chrono::duration<double>(end-begin).count() / numCalls;
+    }
+    avgInsertDuration /= static_cast<double>(NUM_TEST_ITER);
+    avgSetDuration /= static_cast<double>(NUM_TEST_ITER);
+    avgRankDuration /= static_cast<double>(NUM_TEST_ITER);
+    avgSelectDuration /= static_cast<double>(NUM_TEST_ITER);
+    avgEraseDuration /= static_cast<double>(NUM_TEST_ITER);
+
+    std::cout << "dynamic," << bvSize << "," << numCalls << "," << NUM_TEST_ITER << "," << overhead << "," 
+            << avgInsertDuration << "," << avgSetDuration << "," << avgRankDuration << "," << avgSelectDuration << "," 
+            << avgEraseDuration << "," << (checksum & 1) << "\n";
+}
+
+int testLarge(uint64_t bvSize, uint64_t numCalls) {
+    std::mt19937_64 rng(858);
+    std::uniform_int_distribution<uint64_t> indexDist{0, bvSize-1};
+
+    /* fill a word at a time; a bit string this size would need 8 bytes per bit */
+    bitvector::BitVector bv(bvSize);
+    const uint64_t numDataWords = (bvSize + bitvector::BitVector::WORD_BITS - 1) / bitvector::BitVector::WORD_BITS;
+    std::generate(bv.words(), bv.words() + numDataWords, [&rng]() { return rng(); });
+    if (bvSize % bitvector::BitVector::WORD_BITS != 0) {
+        bv.words()[numDataWords - 1] &= (1ull << (bvSize % bitvector::BitVector::WORD_BITS)) - 1;
+    }
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    const bitvector::RankSupport rank(bv);
+    const bitvector::SelectSupport select(rank);
+    auto end = std::chrono::high_resolution_clock::now();
+    const double buildDuration = std::chrono::duration<double>(end-begin).count();
+
+    /* sanity checks against the bits themselves; a 32-bit truncation anywhere breaks these */
+    if (rank.totalOnes() != bv.popcount() || rank(bvSize - 1) != rank.totalOnes()) {
+        std::cerr << "large: incorrect total ones.\n";
+        return 1;
+    }
+    std::vector<uint64_t> indices(numCalls), ranks(numCalls), positions(numCalls);
+    std::generate(std::begin(indices), std::end(indices), [&rng, &indexDist]() { return indexDist(rng); });
+    for (uint64_t const& i : indices) {
+        if (i > 0 && rank(i) != rank(i - 1) + bv[i]) {
+            std::cerr << "large: inconsistent rank at " << i << ".\n";
+            return 1;
+        }
+        if (bv[i] && select(rank(i)) != i) {
+            std::cerr << "large: incorrect select at " << i << ".\n";
+            return 1;
+        }
+    }
+
+    begin = std::chrono::high_resolution_clock::now();
+    for (uint64_t j = 0; j < numCalls; j += 1) {
+        ranks[j] = rank(indices[j]);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double rankDuration = std::chrono::duration<double>(end-begin).count();
+
+    begin = std::chrono::high_resolution_clock::now();
+    for (uint64_t j = 0; j < numCalls; j += 1) {
+        positions[j] = select(std::min(ranks[j] + 1, rank.totalOnes()));
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double selectDuration = std::chrono::duration<double>(end-begin).count();
+
+    if (numCalls > 0 && positions.back() >= bvSize) {
+        std::cerr << "large: invalid select.\n";
+        return 1;
+    }
+
+    std::cout << "large," << bvSize << "," << numCalls << "," << rank.overhead() + select.overhead() << "," 
+            << buildDuration << "," << rankDuration << "," << selectDuration << "\n";
+    return 0;
+}
+
+void testSharded(uint64_t size, float sparsity, uint32_t numShards, uint64_t numQueries) {
+    std::random_device device;
+    std::mt19937_64 rng(device());
+    std::bernoulli_distribution keep(sparsity);
+
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (uint64_t pos = 0; pos < size; pos += 1) {
+        if (keep(rng)) {
+            pairs.emplace_back(pos, rng());
+        }
+    }
+    std::vector<uint64_t> indices(numQueries), ranks(numQueries);
+    std::generate(indices.begin(), indices.end(), [&rng, size]() { return rng() % size; });
+    std::generate(ranks.begin(), ranks.end(), [&rng, &pairs]() { return pairs.empty() ? 0 : rng() % pairs.size(); });
+
+    /* build times are per array; query times are per call. Times per query are summed over the three kinds. */
+    double plainBuild = 0.0, shardedBuild = 0.0, plainQuery = 0.0, shardedQuery = 0.0;
+    uint64_t checksum = 0, overhead = 0;
+    auto timeQueries = [&](auto const& array) {
+        const auto begin = std::chrono::high_resolution_clock::now();
+        uint64_t value = 0;
+        for (uint64_t j = 0; j < numQueries; j += 1) {
+            checksum += array.numElemAt(indices[j]);
+            checksum += array.getAtIndex(indices[j], value) ? value : 0;
+            checksum += array.getAtRank(ranks[j], value) ? value : 0;
+        }
+        const auto end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(end-begin).count() / (3 * numQueries);
+    };
+    for (uint32_t i = 0; i < NUM_TEST_ITER; i += 1) {
+        auto begin = std::chrono::high_resolution_clock::now();
+        auto plain = sparse::SparseArray<uint64_t>::fromSorted(size, pairs.cbegin(), pairs.cend());
+        auto end = std::chrono::high_resolution_clock::now();
+        plainBuild += std::chrono::duration<double>(end-begin).count();
+
+        begin = std::chrono::high_resolution_clock::now();
+        auto sharded = sparse::ShardedSparseArray<uint64_t>::fromSorted(size, numShards, pairs.cbegin(),
+            pairs.cend());
+        end = std::chrono::high_resolution_clock::now();
+        shardedBuild += std::chrono::duration<double>(end-begin).count();
+        overhead = sharded.overhead();
+
+        plainQuery += timeQueries(plain);
+        shardedQuery += timeQueries(sharded);
+    }
+    plainBuild /= static_cast<double>(NUM_TEST_ITER);
+    shardedBuild /= static_cast<double>(NUM_TEST_ITER);
+    plainQuery /= static_cast<double>(NUM_TEST_ITER);
+    shardedQuery /= static_cast<double>(NUM_TEST_ITER);
+
+    std::cout << "sharded," << size << "," << sparsity << "," << numShards << "," << numQueries << "," 
+            << NUM_TEST_ITER << "," << overhead << "," << plainBuild << "," << shardedBuild << "," << plainQuery 
+            << "," << shardedQuery << "," << (checksum & 1) << "\n";
+}
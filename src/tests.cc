@@ -4,14 +4,29 @@
     date: February 2022
 */
 // stl includes
+#include <array>
 #include <cstdint>
+#include <filesystem>
 #include <iostream>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <thread>
 #include <vector>
 
 // local includes
 #include "bitvector.h"
+#include "compressedbitvector.h"
+#include "concurrentsparsearray.h"
+#include "dynamicbitvector.h"
+#include "dynamicsparsearray.h"
+#include "eliasfano.h"
+#include "instrument.h"
+#include "sectionfile.h"
+#include "shardedsparsearray.h"
 #include "sparsearray.h"
+#include "waveletmatrix.h"
 
 constexpr void ASSERT_EQUAL(auto a, auto b, std::string const& msg) {
     if (a != b) {
@@ -24,14 +39,30 @@ constexpr void ASSERT_EQUAL(auto a, auto b, std::string const& msg) {
 void testBitVector();
 void testRank();
 void testSelect();
+void testCompressedBitVector();
+void testEliasFano();
 void testSparseArray();
+void testConcurrentSparseArray();
+void testDynamicBitVector();
+void testDynamicSparseArray();
+void testShardedSparseArray();
+void testInstrument();
+void testWaveletMatrix();
 
 int main() {
 
     testBitVector();
     testRank();
     testSelect();
+    testCompressedBitVector();
+    testEliasFano();
     testSparseArray();
+    testConcurrentSparseArray();
+    testDynamicBitVector();
+    testDynamicSparseArray();
+    testShardedSparseArray();
+    testInstrument();
+    testWaveletMatrix();
 
 }
 
@@ -91,14 +122,176 @@ void testBitVector() {
     sum = bvSmall.popcount(0, 6);
     ASSERT_EQUAL(sum, 2u, "Popcount invalid.");
 
+    /* ranged popcount over 64 bit windows, including ones that straddle words */
+    for (uint64_t start = 0; start + 64 <= bv2.size(); start += 7) {
+        for (uint32_t len = 0; len <= 64; len += 1) {
+            uint32_t expected = 0;
+            for (uint64_t i = start; i < start + len; i += 1) {
+                expected += bv2[i];
+            }
+            ASSERT_EQUAL(bv2.popcount(start, len), expected, "Ranged popcount invalid (start=" +
+                std::to_string(start) + ", len=" + std::to_string(len) + ").");
+        }
+    }
+
+    /* word-at-a-time scan of the ones matches probing every bit */
+    for (std::string const& bits : {std::string(""), std::string(130, '0'), std::string(130, '1'),
+            getRandomBinaryString(1000), getRandomBinaryString(10057)}) {
+        const BitVector scanned(bits);
+        std::vector<uint64_t> expected;
+        for (uint64_t i = 0; i < bits.size(); i += 1) {
+            if (bits[i] == '1') {
+                expected.push_back(i);
+            }
+        }
+        std::vector<uint64_t> ones;
+        std::ranges::copy(scanned.ones(), std::back_inserter(ones));
+        ASSERT_EQUAL(ones == expected, true, "Set bits scanned incorrectly (length=" + std::to_string(bits.size()) +
+            ").");
+    }
+
+    /* construction from words, adopted words, and positions */
+    {
+        const BitVector source(getRandomBinaryString(1000));
+        const BitVector copied(1000, source.words());
+        auto adoptedWords = utility::allocateAligned<uint64_t, BitVector::ALIGNMENT>(BitVector::numWordsFor(1000));
+        std::copy(source.words(), source.words() + source.numWords(), adoptedWords.get());
+        adoptedWords[15] |= ~0ull << (1000 % 64);    /* bits past the end are cleared */
+        const BitVector adopted(1000, std::move(adoptedWords));
+
+        std::vector<uint64_t> positions;
+        for (uint64_t i = 0; i < source.size(); i += 1) {
+            if (source[i]) {
+                positions.push_back(i);
+            }
+        }
+        std::shuffle(positions.begin(), positions.end(), std::mt19937(858));
+        const BitVector fromPositions(1000, positions.begin(), positions.end());
+
+        const BitVector shorter(700, source.words());
+        for (uint64_t i = 0; i < source.size(); i += 1) {
+            ASSERT_EQUAL(copied[i], source[i], "Copied word buffer does not match.");
+            ASSERT_EQUAL(adopted[i], source[i], "Adopted word buffer does not match.");
+            ASSERT_EQUAL(fromPositions[i], source[i], "Bitvector from positions does not match.");
+        }
+        ASSERT_EQUAL(adopted.popcount(), source.popcount(), "Adopted words kept bits past the end.");
+        ASSERT_EQUAL(shorter.popcount(), RankSupport(source).rank1(699), "Copied word buffer kept bits past the end.");
+
+        bool threw = false;
+        try {
+            const std::vector<uint64_t> outOfRange {3, 1000};
+            BitVector tooFar(1000, outOfRange.begin(), outOfRange.end());
+        } catch (std::out_of_range const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "Position past the end should fail.");
+
+        threw = false;
+        try {
+            BitVector notBinary(std::string("0101201"));
+        } catch (std::invalid_argument const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "Non-binary string should fail.");
+
+        /* random words: reproducible by seed, about half ones, and zero padding */
+        const BitVector random = getRandomBitVector(100003, 858), sameSeed = getRandomBitVector(100003, 858);
+        ASSERT_EQUAL(random.popcount() > 49000 && random.popcount() < 51000, true, "Random bitvector is skewed.");
+        for (uint64_t w = 0; w < random.numWords(); w += 1) {
+            ASSERT_EQUAL(random.words()[w], sameSeed.words()[w], "Random bitvector not reproducible by seed.");
+        }
+        ASSERT_EQUAL(random.words()[random.numWords() - 1], 0u, "Random bitvector padding not zero.");
+    }
+
+    /* word-wise bulk operations match bit-by-bit string operations */
+    for (uint64_t len : {1u, 63u, 64u, 1000u, 10057u}) {
+        const std::string aStr = getRandomBinaryString(len), bStr = getRandomBinaryString(len);
+        auto checkBits = [&](BitVector const& bv, std::string const& expected, std::string const& op) {
+            for (uint64_t i = 0; i < len; i += 1) {
+                ASSERT_EQUAL(bv[i], expected.at(i) == '1', "Incorrect " + op + " (length=" + std::to_string(len) +
+                    ", index=" + std::to_string(i) + ").");
+            }
+            ASSERT_EQUAL(bv.popcount(), static_cast<uint64_t>(std::count(expected.begin(), expected.end(), '1')),
+                "Bits past the end changed by " + op + ".");
+        };
+        auto combined = [&](auto op) {
+            std::string out(len, '0');
+            for (uint64_t i = 0; i < len; i += 1) {
+                out[i] = op(aStr[i] == '1', bStr[i] == '1') ? '1' : '0';
+            }
+            return out;
+        };
+
+        BitVector andBits(aStr), orBits(aStr), xorBits(aStr), flipped(aStr);
+        const BitVector b(bStr);
+        andBits &= b;
+        orBits |= b;
+        xorBits ^= b;
+        flipped.flip();
+        checkBits(andBits, combined([](bool x, bool y) { return x && y; }), "&=");
+        checkBits(orBits, combined([](bool x, bool y) { return x || y; }), "|=");
+        checkBits(xorBits, combined([](bool x, bool y) { return x != y; }), "^=");
+        checkBits(flipped, combined([](bool x, bool) { return !x; }), "flip");
+
+        /* ranges that start and end mid-word, within one word, and empty */
+        const std::vector<std::pair<uint64_t, uint64_t>> ranges {{0, len}, {0, 0}, {len / 3, len / 2},
+            {len / 2, len - len / 2}, {len - 1, 1}, {len / 7, std::min<uint64_t>(len - len / 7, 5)}};
+        for (auto const& [start, count] : ranges) {
+            for (bool bit : {false, true}) {
+                BitVector ranged(aStr);
+                std::string expected = aStr;
+                ranged.setRange(start, count, bit);
+                std::fill(expected.begin() + start, expected.begin() + start + count, bit ? '1' : '0');
+                checkBits(ranged, expected, "setRange");
+            }
+
+            /* from another bitvector, then within the same one shifted either way */
+            BitVector copied(aStr);
+            std::string expected = aStr;
+            const uint64_t sourceStart = len - count - (len - count) / 5;
+            copied.copyRange(b, sourceStart, start, count);
+            std::copy(bStr.begin() + sourceStart, bStr.begin() + sourceStart + count, expected.begin() + start);
+            checkBits(copied, expected, "copyRange");
+
+            for (uint64_t target : {(len - count) / 2, len - count}) {
+                BitVector shifted(aStr);
+                std::string shiftedExpected = aStr;
+                shifted.copyRange(shifted, start, target, count);
+                const std::string moved = aStr.substr(start, count);
+                std::copy(moved.begin(), moved.end(), shiftedExpected.begin() + target);
+                checkBits(shifted, shiftedExpected, "overlapping copyRange");
+            }
+        }
+
+        bool threw = false;
+        try {
+            andBits.setRange(len / 2 + 1, len, true);
+        } catch (std::out_of_range const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "setRange past the end should fail.");
+
+        threw = false;
+        try {
+            BitVector longer(len + 1);
+            longer &= b;
+        } catch (std::invalid_argument const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "&= with a different size should fail.");
+    }
+
+    /* word storage is cache line aligned */
+    ASSERT_EQUAL(reinterpret_cast<uintptr_t>(bv2.words()) % BitVector::ALIGNMENT, 0u, "Words not aligned.");
+
     /* use as packed int array */
-    const std::vector<uint32_t> bitsPerElement {8u, 3u, 12u, 20u, 32u, 54u};
+    const std::vector<uint32_t> bitsPerElement {8u, 3u, 12u, 20u, 32u, 54u, 57u, 63u, 64u};
     const uint32_t numElements = 150;
     std::vector<uint64_t> elements(numElements);
     for (auto const& bpe : bitsPerElement) {
         std::random_device device;
         std::mt19937 rng(device());
-        std::uniform_int_distribution<uint64_t> dist{0, (1u << bpe) - 1};
+        std::uniform_int_distribution<uint64_t> dist{0, (bpe >= 64) ? ~0ull : (1ull << bpe) - 1};
         
         std::generate(std::begin(elements), std::end(elements), [&dist,&rng](){ return dist(rng); });
 
@@ -115,8 +308,87 @@ void testBitVector() {
             ASSERT_EQUAL(pv.at(i), elements.at(i), "Packed integer invalid on " + std::to_string(bpe) + 
                                                 " bits per element.");
         }
+
+        /* bulk unpack, including ranges that start and end mid-word */
+        std::vector<uint64_t> unpacked(numElements);
+        for (uint64_t begin : {0u, 1u, 13u, 77u}) {
+            const uint64_t count = numElements - begin - (begin % 5);
+            pv.unpack(begin, count, unpacked.data());
+            for (uint64_t i = 0; i < count; i += 1) {
+                ASSERT_EQUAL(unpacked.at(i), elements.at(begin + i), "Unpacked integer invalid on " + 
+                    std::to_string(bpe) + " bits per element.");
+            }
+        }
+
+        /* bulk pack into the middle leaves the neighbours alone */
+        std::vector<uint64_t> repacked(numElements);
+        std::generate(std::begin(repacked), std::end(repacked), [&dist,&rng](){ return dist(rng); });
+        const uint64_t packBegin = 7, packCount = numElements - 20;
+        pv.pack(packBegin, packCount, repacked.data());
+        for (uint64_t i = 0; i < numElements; i += 1) {
+            const bool packed = (i >= packBegin && i < packBegin + packCount);
+            ASSERT_EQUAL(pv[i], packed ? repacked.at(i - packBegin) : elements.at(i), "Packed range invalid on " + 
+                std::to_string(bpe) + " bits per element.");
+        }
+
+        bool threw = false;
+        try {
+            pv.unpack(numElements - 1, 2, unpacked.data());
+        } catch (std::out_of_range const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "Unpacking past the end should fail.");
     }
 
+    /* fixed width packed vectors match, and share the PackedVector file format */
+    auto checkFixed = [&](auto bits) {
+        constexpr uint32_t BITS = decltype(bits)::value;
+        std::mt19937 rng(BITS);
+        std::uniform_int_distribution<uint64_t> dist{0, (BITS >= 64) ? ~0ull : (1ull << BITS) - 1};
+        std::generate(std::begin(elements), std::end(elements), [&dist,&rng](){ return dist(rng); });
+
+        FixedPackedVector<BITS> fixed(numElements);
+        PackedVector pv(numElements, BITS);
+        for (uint32_t i = 0; i < elements.size(); i += 1) {
+            fixed.set(i, elements.at(i));
+            pv.set(i, elements.at(i));
+        }
+        for (uint32_t i = 0; i < elements.size(); i += 1) {
+            ASSERT_EQUAL(fixed.at(i), elements.at(i), "Fixed packed integer invalid on " + std::to_string(BITS) +
+                " bits per element.");
+            ASSERT_EQUAL(FixedPackedVector<BITS>::get(pv.words(), i), elements.at(i), "Fixed read of PackedVector "
+                "invalid on " + std::to_string(BITS) + " bits per element.");
+        }
+
+        std::ofstream out("junk.packedvector", std::ios::binary);
+        pv.serialize(out);
+        out.close();
+        std::ifstream in("junk.packedvector", std::ios::binary);
+        FixedPackedVector<BITS> loaded;
+        loaded.deserialize(in);
+        for (uint32_t i = 0; i < elements.size(); i += 1) {
+            ASSERT_EQUAL(loaded[i], elements.at(i), "Fixed packed integer invalid after loading a PackedVector.");
+        }
+
+        bool threw = false;
+        try {
+            std::ifstream wrongIn("junk.packedvector", std::ios::binary);
+            FixedPackedVector<BITS % 64 + 1> wrongWidth;
+            wrongWidth.deserialize(wrongIn);
+        } catch (std::ios_base::failure const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "Loading a PackedVector of another width should fail.");
+        std::remove("junk.packedvector");
+    };
+    checkFixed(std::integral_constant<uint32_t, 3>{});
+    checkFixed(std::integral_constant<uint32_t, 8>{});
+    checkFixed(std::integral_constant<uint32_t, 11>{});
+    checkFixed(std::integral_constant<uint32_t, 16>{});
+    checkFixed(std::integral_constant<uint32_t, 32>{});
+    checkFixed(std::integral_constant<uint32_t, 48>{});
+    checkFixed(std::integral_constant<uint32_t, 64>{});
+
     std::cout << "Success\n";
 }
 
@@ -135,8 +407,35 @@ void testRank() {
         const uint32_t expected = std::count_if(std::begin(prefix), std::end(prefix), [](auto c) { return c == '1'; });
 
         ASSERT_EQUAL(val, expected, "Incorrect rank calculated.");
+        ASSERT_EQUAL(rank.rank0(i), (i+1) - expected, "Incorrect rank0 calculated.");
     }
-    ASSERT_EQUAL(rank.overhead(), 160u, "Incorrect overhead.");
+    ASSERT_EQUAL(rank.overhead(), 32u, "Incorrect overhead.");
+    ASSERT_EQUAL(rank.isStale(), false, "Fresh tables reported stale.");
+
+    /* interleaved overhead counts whole lines, the copy of the bits included */
+    {
+        const RankSupportInterleaved interleaved(bv);
+        ASSERT_EQUAL(interleaved.overhead(), uint64_t(512), "Incorrect interleaved overhead.");
+        ASSERT_EQUAL(interleaved.copyOverhead(), RankSupportInterleaved::PAYLOAD_BITS, "Incorrect copy overhead.");
+    }
+
+    /* writes to the bitvector mark tables stale until they are rebuilt */
+    {
+        BitVector changing(EXAMPLE_STR);
+        RankSupport changingRank(changing);
+        RankSupportInterleaved changingInterleaved(changing);
+        changing.setRange(0, 8, true);
+        ASSERT_EQUAL(changingRank.isStale(), true, "Tables not stale after setRange.");
+        ASSERT_EQUAL(changingInterleaved.isStale(), true, "Lines not stale after setRange.");
+        changingRank.buildTables();
+        changingInterleaved.buildTables();
+        ASSERT_EQUAL(changingRank.isStale() || changingInterleaved.isStale(), false, "Rebuilt tables stale.");
+        ASSERT_EQUAL(changingRank.rank1(7), 8u, "Incorrect rank after setRange and rebuild.");
+        ASSERT_EQUAL(changingInterleaved.rank1(7), 8u, "Incorrect interleaved rank after setRange and rebuild.");
+        changing.flip();
+        ASSERT_EQUAL(changingRank.isStale(), true, "Tables not stale after flip.");
+    }
+    ASSERT_EQUAL(rank.totalZeros(), 8u, "Incorrect total zeros.");
 
     /* even smaller example */
     const std::string SMALL_STR = "0100010001";
@@ -150,6 +449,22 @@ void testRank() {
         ASSERT_EQUAL(val, expected, "Invalid rank calculated.");
     }
 
+    /* tiny bitvectors use blocks and superblocks of at least 1 bit */
+    for (auto const& TINY_STR : {"1", "0", "10", "011", "1101", "10101"}) {
+        const std::string tinyStr(TINY_STR);
+        const BitVector bvTiny(tinyStr);
+        const RankSupport rankTiny(bvTiny);
+        const SelectSupport selectTiny(rankTiny);
+        for (size_t i = 0; i < bvTiny.size(); i += 1) {
+            const auto prefix = tinyStr.substr(0, i+1);
+            const uint64_t expected = std::count(std::begin(prefix), std::end(prefix), '1');
+            ASSERT_EQUAL(rankTiny(i), expected, "Incorrect rank calculated (tiny bitvector " + tinyStr + ").");
+            if (bvTiny[i]) {
+                ASSERT_EQUAL(selectTiny(expected), i, "Incorrect select calculated (tiny bitvector " + tinyStr + ").");
+            }
+        }
+    }
+
     /* longer examples */
     const std::vector<uint32_t> LENGTHS {10, 1024, 4096, 1000, 1001, 10057};
     for (auto const& len : LENGTHS) {
@@ -167,6 +482,8 @@ void testRank() {
 
             ASSERT_EQUAL(val, expected, "Incorrect rank calculated (length=" + std::to_string(len) + 
                                         ", index=" + std::to_string(i) + ").");
+            ASSERT_EQUAL(rankLong.rank1WithBit(i) == std::pair<uint64_t, bool>(expected, bvLong[i]), true,
+                "Incorrect rank1WithBit (length=" + std::to_string(len) + ", index=" + std::to_string(i) + ").");
         }
 
         /* read from file and do again */
@@ -180,10 +497,160 @@ void testRank() {
                                         ", index=" + std::to_string(i) + ") after file load.");
         }
 
+        /* map the file in place and do again */
+        RankSupport rankMapped(bvLong);
+        rankMapped.map("junk.ranksupport");
+        ASSERT_EQUAL(rankMapped.totalOnes(), rankLong.totalOnes(), "Incorrect total ones after file map.");
+        for (size_t i = 0; i < bvLong.size(); i += 1) {
+            ASSERT_EQUAL(rankMapped(i), rankLong(i), "Incorrect rank calculated (length=" + std::to_string(len) + 
+                                        ", index=" + std::to_string(i) + ") after file map.");
+        }
     }
 
     std::remove("junk.ranksupport");
 
+    /* interleaved layout agrees with RankSupport, including across line boundaries and after reload */
+    for (auto const& len : {10u, 448u, 449u, 1000u, 100000u}) {
+        BitVector bvInterleaved = getRandomBitVector(len);
+        const RankSupport rankPlain(bvInterleaved);
+        RankSupportInterleaved rankInterleaved(bvInterleaved);
+
+        ASSERT_EQUAL(rankInterleaved.totalOnes(), rankPlain.totalOnes(), "Incorrect interleaved total ones.");
+        for (size_t i = 0; i < bvInterleaved.size(); i += 1) {
+            ASSERT_EQUAL(rankInterleaved(i), rankPlain(i), "Incorrect interleaved rank calculated (length=" +
+                std::to_string(len) + ", index=" + std::to_string(i) + ").");
+            ASSERT_EQUAL(rankInterleaved.rank0(i), rankPlain.rank0(i), "Incorrect interleaved rank0 calculated.");
+            ASSERT_EQUAL(rankInterleaved[i], bvInterleaved[i], "Incorrect interleaved bit.");
+            ASSERT_EQUAL(rankInterleaved.rank1WithBit(i) == rankPlain.rank1WithBit(i), true,
+                "Incorrect interleaved rank1WithBit.");
+        }
+
+        rankInterleaved.save("junk.ranksupport");
+        const bool flipped = !bvInterleaved[len - 1];
+        const uint64_t expectedRank = flipped ? rankPlain(len - 1) + 1 : rankPlain(len - 1) - 1;
+        bvInterleaved.set(len - 1, flipped);
+        rankInterleaved.buildTables(len - 1);
+        ASSERT_EQUAL(rankInterleaved(len - 1), expectedRank, "Incorrect interleaved rank after rebuild.");
+
+        bvInterleaved.set(len - 1, !flipped);
+        rankInterleaved.load("junk.ranksupport");
+        for (size_t i = 0; i < bvInterleaved.size(); i += 1) {
+            ASSERT_EQUAL(rankInterleaved(i), rankPlain(i), "Incorrect interleaved rank after file load.");
+        }
+
+        /* files saved over another bitvector size, or cut short, are rejected */
+        const BitVector bvShorter(len - 1);
+        RankSupportInterleaved rankShorter(bvShorter);
+        bool threw = false;
+        try {
+            rankShorter.load("junk.ranksupport");
+        } catch (std::invalid_argument const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw || !utility::CHECK_BOUNDS, true, "loading over a bitvector of another size should fail.");
+
+        std::filesystem::resize_file("junk.ranksupport", std::filesystem::file_size("junk.ranksupport") - 8);
+        threw = false;
+        try {
+            rankInterleaved.load("junk.ranksupport");
+        } catch (std::ios_base::failure const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "loading a truncated interleaved file should fail.");
+    }
+    std::remove("junk.ranksupport");
+
+    /* parallel construction builds the same tables */
+    for (auto const& len : {100000u, 1000003u}) {
+        const BitVector bvParallel = getRandomBitVector(len);
+        const RankSupport rankSerial(bvParallel);
+        const RankSupport rankParallel(bvParallel, 4);
+
+        ASSERT_EQUAL(rankParallel.totalOnes(), rankSerial.totalOnes(), "Incorrect parallel total ones.");
+        for (size_t i = 0; i < bvParallel.size(); i += 1) {
+            ASSERT_EQUAL(rankParallel(i), rankSerial(i), "Incorrect parallel rank calculated (length=" +
+                std::to_string(len) + ", index=" + std::to_string(i) + ").");
+        }
+    }
+
+    /* a parallel rebuild from an unaligned startingIndex matches a serial build */
+    {
+        BitVector bvRebuild = getRandomBitVector(4000037);
+        RankSupport rankRebuild(bvRebuild);
+        for (auto const& startingIndex : {uint64_t(1000001), uint64_t(2345678), uint64_t(3999999)}) {
+            for (uint64_t i = startingIndex; i < bvRebuild.size(); i += 7) {
+                bvRebuild.set(i, !bvRebuild.at(i));
+            }
+            rankRebuild.buildTables(startingIndex, 4);
+            const RankSupport rankSerial(bvRebuild);
+
+            ASSERT_EQUAL(rankRebuild.totalOnes(), rankSerial.totalOnes(), "Incorrect rebuilt total ones.");
+            for (size_t i = 0; i < bvRebuild.size(); i += 1) {
+                ASSERT_EQUAL(rankRebuild(i), rankSerial(i), "Incorrect rank after parallel rebuild (startingIndex=" +
+                    std::to_string(startingIndex) + ", index=" + std::to_string(i) + ").");
+            }
+        }
+    }
+
+    /* batched queries match the scalar calls, sorted or not */
+    {
+        const BitVector bvBatch = getRandomBitVector(100003);
+        const RankSupport rankBatch(bvBatch);
+        const RankSupportInterleaved rankBatchInterleaved(bvBatch);
+
+        std::mt19937 rng(1234);
+        std::uniform_int_distribution<uint64_t> index{0, bvBatch.size() - 1};
+        std::vector<uint64_t> queries(5000);
+        std::generate(queries.begin(), queries.end(), [&]() { return index(rng); });
+
+        std::vector<uint64_t> answers(queries.size()), sortedAnswers(queries.size()), interleaved(queries.size());
+        rankBatch.rank1Batch(queries, answers);
+        rankBatch.rank1Batch(queries, sortedAnswers, true);
+        rankBatchInterleaved.rank1Batch(queries, interleaved, true);
+        for (size_t j = 0; j < queries.size(); j += 1) {
+            ASSERT_EQUAL(answers.at(j), rankBatch(queries.at(j)), "Incorrect batched rank calculated.");
+            ASSERT_EQUAL(sortedAnswers.at(j), answers.at(j), "Incorrect sorted batched rank calculated.");
+            ASSERT_EQUAL(interleaved.at(j), answers.at(j), "Incorrect interleaved batched rank calculated.");
+        }
+    }
+
+    /* bitvectors and tables allocated by a policy: mapped pages start zeroed, and skipping the zero fill leaves
+       nothing unwritten that rank reads */
+    {
+        using utility::AllocationPolicy;
+        const BitVector reference = getRandomBitVector(1u << 22, 858);
+        const RankSupport referenceRank(reference);
+        for (auto const& policy : {AllocationPolicy{.zeroFill = false},
+                AllocationPolicy{.pages = AllocationPolicy::Pages::SMALL},
+                AllocationPolicy{.pages = AllocationPolicy::Pages::TRANSPARENT_HUGE},
+                AllocationPolicy{.pages = AllocationPolicy::Pages::HUGE_2MB, .zeroFill = false},
+                AllocationPolicy{.numa = AllocationPolicy::Numa::INTERLEAVE},
+                AllocationPolicy{.numa = AllocationPolicy::Numa::BIND, .nodes = 1}}) {
+            BitVector bvPolicy(reference.size(), policy);
+            if (policy.zeroFill) {
+                ASSERT_EQUAL(bvPolicy.popcount(), uint64_t(0), "Policy allocated BitVector not zeroed.");
+            }
+            if (policy.pages == AllocationPolicy::Pages::TRANSPARENT_HUGE) {
+                ASSERT_EQUAL(reinterpret_cast<uintptr_t>(bvPolicy.words()) % utility::HUGE_PAGE_BYTES, uintptr_t(0),
+                    "Huge page BitVector not aligned to a huge page.");
+            }
+            std::copy(reference.words(), reference.words() + reference.numWords(), bvPolicy.words());
+
+            const RankSupport rankPolicy(bvPolicy, 2, policy);
+            ASSERT_EQUAL(rankPolicy.totalOnes(), referenceRank.totalOnes(), "Incorrect policy total ones.");
+            for (size_t i = 0; i < bvPolicy.size(); i += 997) {
+                ASSERT_EQUAL(rankPolicy(i), referenceRank(i), "Incorrect rank of policy allocated tables (index=" +
+                    std::to_string(i) + ").");
+            }
+        }
+
+        /* without the zero fill, the last word holding bits (here word 1) and the padding are still zero */
+        const BitVector bvPartial(100, AllocationPolicy{.zeroFill = false});
+        for (uint64_t w = 1; w < bvPartial.numWords(); w += 1) {
+            ASSERT_EQUAL(bvPartial.words()[w], uint64_t(0), "Padding of unfilled BitVector not zeroed.");
+        }
+    }
+
     std::cout << "Success\n";
 }
 
@@ -235,6 +702,28 @@ void testSelect() {
 
         ASSERT_EQUAL(val, expected, "Incorrect select calculated.");
     }
+    ASSERT_EQUAL(select.isStale(), false, "Fresh select index reported stale.");
+
+    /* writes to the bitvector mark the indices stale until they are rebuilt */
+    {
+        BitVector changing(EXAMPLE_STR);
+        RankSupport changingRank(changing);
+        SelectSupport changingSelect(changingRank, true);
+        changing.setRange(0, 8, true);
+        ASSERT_EQUAL(changingSelect.isStale(), true, "Select index not stale after setRange.");
+        changingRank.buildTables();
+        changingSelect.rebuild();
+        ASSERT_EQUAL(changingSelect.isStale(), false, "Rebuilt select index stale.");
+
+        const std::string changedStr = "11111111" + EXAMPLE_STR.substr(8);
+        for (size_t i = 1; i <= changingRank.totalOnes(); i += 1) {
+            ASSERT_EQUAL(changingSelect(i), naiveSelect(changedStr, '1', i), "Incorrect select after rebuild.");
+        }
+        for (size_t i = 1; i <= changingRank.totalZeros(); i += 1) {
+            ASSERT_EQUAL(changingSelect.select0(i), naiveSelect(changedStr, '0', i),
+                "Incorrect select0 after rebuild.");
+        }
+    }
 
     /* longer examples */
     const std::vector<uint32_t> LENGTHS {10, 65, 1024, 4096, 1000, 1001, 10057};
@@ -252,6 +741,195 @@ void testSelect() {
             ASSERT_EQUAL(val, expected, "Incorrect select calculated (length=" + std::to_string(len) + 
                                         ", index=" + std::to_string(i) + ").");
         }
+
+        /* select0 with and without the sampled zero index */
+        const SelectSupport selectZeros(rankLong, true);
+        for (size_t i = 1; i <= len - NUM_ONES; i += 1) {
+            const auto expected = naiveSelect(BIT_STR, '0', i);
+            ASSERT_EQUAL(selectLong.select0(i), expected, "Incorrect select0 calculated (length=" + 
+                                        std::to_string(len) + ", index=" + std::to_string(i) + ").");
+            ASSERT_EQUAL(selectZeros.select0(i), expected, "Incorrect indexed select0 calculated (length=" + 
+                                        std::to_string(len) + ", index=" + std::to_string(i) + ").");
+        }
+
+        /* SelectSupport over interleaved rank, which select0 binary searches */
+        const RankSupportInterleaved rankInterleaved(bvLong);
+        const SelectSupport<RankSupportInterleaved> selectInterleaved(rankInterleaved);
+        for (size_t i = 1; i <= NUM_ONES; i += 1) {
+            ASSERT_EQUAL(selectInterleaved(i), selectLong(i), "Incorrect select over interleaved rank.");
+        }
+        for (size_t i = 1; i <= len - NUM_ONES; i += 1) {
+            ASSERT_EQUAL(selectInterleaved.select0(i), selectLong.select0(i),
+                "Incorrect select0 over interleaved rank.");
+        }
+    }
+
+    /* mixed density -- a dense prefix followed by a sparse tail exercises dense and sparse index blocks */
+    {
+        const uint64_t len = 2000000;
+        std::random_device device;
+        std::mt19937 rng(device());
+        std::uniform_int_distribution<uint64_t> sparseGap{1, 400};
+
+        BitVector bvMixed(len);
+        std::vector<uint64_t> positions;
+        for (uint64_t i = 0; i < len; i += (i < len/4) ? 2 : sparseGap(rng)) {
+            bvMixed.set(i, true);
+            positions.push_back(i);
+        }
+        const RankSupport rankMixed(bvMixed);
+        SelectSupport selectMixed(rankMixed, true);
+
+        for (size_t i = 1; i <= positions.size(); i += 1) {
+            ASSERT_EQUAL(selectMixed(i), positions.at(i-1), "Incorrect select calculated (mixed density, index=" +
+                std::to_string(i) + ").");
+        }
+
+        /* the sparse tail makes long runs of zeros, so the zero index has sparse blocks too */
+        const SelectSupport selectMixedByRank(rankMixed);
+        uint64_t zeroCount = 0;
+        for (uint64_t i = 0; i < len; i += 1) {
+            if (!bvMixed[i]) {
+                zeroCount += 1;
+                ASSERT_EQUAL(selectMixed.select0(zeroCount), i, "Incorrect indexed select0 (mixed density).");
+                ASSERT_EQUAL(selectMixedByRank.select0(zeroCount), i, "Incorrect select0 (mixed density).");
+            }
+        }
+        ASSERT_EQUAL(selectMixed.overhead() > 0, true, "Select overhead not reported.");
+
+        /* batched select matches the scalar calls */
+        std::vector<uint64_t> queries(positions.size()), answers(positions.size());
+        std::iota(queries.begin(), queries.end(), 1);
+        std::shuffle(queries.begin(), queries.end(), rng);
+        for (bool sorted : {false, true}) {
+            selectMixed.select1Batch(queries, answers, sorted);
+            for (size_t j = 0; j < queries.size(); j += 1) {
+                ASSERT_EQUAL(answers.at(j), positions.at(queries.at(j) - 1), "Incorrect batched select calculated.");
+            }
+        }
+
+        /* save, reload, and check again */
+        selectMixed.save("junk.selectsupport");
+        const uint64_t overhead = selectMixed.overhead();
+        selectMixed.load("junk.selectsupport");
+        ASSERT_EQUAL(selectMixed.overhead(), overhead, "Incorrect select overhead after file load.");
+        ASSERT_EQUAL(selectMixed.hasZeroIndex(), true, "Zero index not loaded.");
+        for (size_t i = 1; i <= positions.size(); i += 1) {
+            ASSERT_EQUAL(selectMixed(i), positions.at(i-1), "Incorrect select calculated after file load.");
+        }
+        ASSERT_EQUAL(selectMixed.select0(zeroCount), selectMixedByRank.select0(zeroCount), 
+            "Incorrect select0 calculated after file load.");
+        std::remove("junk.selectsupport");
+    }
+
+    std::cout << "Success\n";
+}
+
+void testCompressedBitVector() {
+    using namespace bitvector;
+    std::cout << "Testing CompressedBitVector...\t";
+
+    std::mt19937 rng(63);
+
+    /* skewed, balanced, and run-heavy bitvectors, with sizes around the block and sample sizes */
+    const std::vector<std::pair<uint64_t, double>> CASES {{1, 1.0}, {63, 0.0}, {64, 1.0}, {2016, 0.5}, {2017, 0.01},
+        {100000, 0.001}, {100000, 0.5}, {100003, 0.97}};
+    for (auto const& [len, density] : CASES) {
+        std::bernoulli_distribution bit(density);
+        BitVector bv(len);
+        for (uint64_t i = 0; i < len; i += 1) {
+            /* runs of 500 bits copied from the block before, so whole blocks are all zeros or all ones */
+            bv.set(i, (i % 1000 >= 500 && i >= 1000) ? bv[i - 1000] : bit(rng));
+        }
+        const RankSupport rank(bv);
+        const SelectSupport select(rank, true);
+        const CompressedBitVector rrr(bv);
+
+        ASSERT_EQUAL(rrr.size(), len, "invalid CompressedBitVector size.");
+        ASSERT_EQUAL(rrr.totalOnes(), rank.totalOnes(), "invalid CompressedBitVector totalOnes.");
+        for (uint64_t i = 0; i < len; i += 1) {
+            ASSERT_EQUAL(rrr[i], bv[i], "invalid CompressedBitVector access.");
+            ASSERT_EQUAL(rrr.rank1(i), rank.rank1(i), "invalid CompressedBitVector rank1.");
+            ASSERT_EQUAL(rrr.rank0(i), rank.rank0(i), "invalid CompressedBitVector rank0.");
+            ASSERT_EQUAL(rrr.rank1WithBit(i) == rank.rank1WithBit(i), true,
+                "invalid CompressedBitVector rank1WithBit.");
+        }
+        for (uint64_t i = 1; i <= rank.totalOnes(); i += 1) {
+            ASSERT_EQUAL(rrr.select1(i), select.select1(i), "invalid CompressedBitVector select1.");
+        }
+        for (uint64_t i = 1; i <= rank.totalZeros(); i += 1) {
+            ASSERT_EQUAL(rrr.select0(i), select.select0(i), "invalid CompressedBitVector select0.");
+        }
+
+        /* scanning the ones decodes blocks in order */
+        uint64_t ones = 0;
+        for (uint64_t pos : rrr.ones()) {
+            ones += 1;
+            ASSERT_EQUAL(pos, select.select1(ones), "invalid CompressedBitVector ones.");
+        }
+        ASSERT_EQUAL(ones, rank.totalOnes(), "invalid number of CompressedBitVector ones.");
+
+        /* round trip through serialize, and a view of the same file */
+        {
+            std::ofstream out("junk.rrr", std::ios::out | std::ios::binary);
+            serial::serialize(rrr, out);
+        }
+        CompressedBitVector loaded, mapped;
+        {
+            std::ifstream in("junk.rrr", std::ios::in | std::ios::binary);
+            serial::deserialize(loaded, in);
+        }
+        serial::MappedReader reader("junk.rrr");
+        mapped.map(reader);
+        for (uint64_t i = 0; i < len; i += 1) {
+            ASSERT_EQUAL(loaded.rank1(i), rank.rank1(i), "invalid CompressedBitVector rank1 after deserialize.");
+            ASSERT_EQUAL(mapped.rank1(i), rank.rank1(i), "invalid CompressedBitVector rank1 after map.");
+        }
+        std::remove("junk.rrr");
+
+        /* skewed bits compress; at 1 in 1000 the entropy is ~0.011 bits/bit plus 6/63 for the classes */
+        if (density == 0.001) {
+            ASSERT_EQUAL(rrr.overhead() < len / 5, true, "skewed CompressedBitVector should be compressed.");
+        }
+    }
+
+    std::cout << "Success\n";
+}
+
+void testEliasFano() {
+    using namespace bitvector;
+    std::cout << "Testing EliasFano...\t\t";
+
+    std::mt19937 rng(858);
+
+    /* empty, full, and random sets, with universes that aren't multiples of the bucket size */
+    const std::vector<std::pair<uint64_t, double>> CASES {{1, 0.0}, {1, 1.0}, {100, 1.0}, {1000, 0.0}, {1000, 0.5},
+        {4099, 0.01}, {70001, 0.001}, {100003, 0.2}};
+    for (auto const& [universe, density] : CASES) {
+        std::bernoulli_distribution keep(density);
+        std::vector<uint64_t> positions;
+        for (uint64_t i = 0; i < universe; i += 1) {
+            if (keep(rng)) {
+                positions.push_back(i);
+            }
+        }
+
+        const EliasFano ef(universe, positions.size(), positions.cbegin(), positions.cend());
+        ASSERT_EQUAL(ef.size(), universe, "invalid EliasFano size.");
+        ASSERT_EQUAL(ef.count(), positions.size(), "invalid EliasFano count.");
+        for (uint64_t k = 0; k < positions.size(); k += 1) {
+            ASSERT_EQUAL(ef.select(k), positions.at(k), "invalid EliasFano select.");
+        }
+        ASSERT_EQUAL(std::equal(ef.begin(), std::ranges::next(ef.begin(), ef.end()), positions.cbegin(),
+            positions.cend()), true, "invalid EliasFano iteration.");
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < universe; i += 1) {
+            const bool isSet = count < positions.size() && positions.at(count) == i;
+            count += isSet ? 1 : 0;
+            ASSERT_EQUAL(ef.rank(i), count, "invalid EliasFano rank.");
+            ASSERT_EQUAL(ef.contains(i), isSet, "invalid EliasFano contains.");
+            ASSERT_EQUAL(ef.rankAndContains(i) == std::pair(count, isSet), true, "invalid EliasFano rankAndContains.");
+        }
     }
 
     std::cout << "Success\n";
@@ -323,6 +1001,14 @@ void testSparseArray() {
         }
         ASSERT_EQUAL(array.numElem(), insertedCounter, "invalid number of elements.");
 
+        /* lookups before the rank tables are finalized */
+        for (uint64_t index = 0; index < len; index += 1) {
+            uint64_t const* found = array.find(index);
+            const auto expected = key.find(index);
+            ASSERT_EQUAL(found != nullptr, expected != key.end(), "invalid find before finalize.");
+            ASSERT_EQUAL(found == nullptr || *found == expected->second, true, "invalid value from find.");
+        }
+
         /* write out the array */
         array.save("junk.sparsearray", true);
 
@@ -360,9 +1046,889 @@ void testSparseArray() {
 
             rankCounter += 1;
         }
+
+        /* map the file, with and without saved rank tables, and check again */
+        for (bool saveRankTables : {true, false}) {
+            array.save("junk.sparsearray", saveRankTables);
+            sparse::SparseArray<uint64_t> mapped;
+            mapped.map("junk.sparsearray");
+            ASSERT_EQUAL(mapped.isMapped(), true, "array not mapped.");
+            ASSERT_EQUAL(mapped.size(), array.size(), "invalid size (after map).");
+            ASSERT_EQUAL(mapped.numElem(), array.numElem(), "invalid number of elements (after map).");
+
+            rankCounter = 0;
+            for (auto const& [index, value] : key) {
+                uint64_t tmp;
+                ASSERT_EQUAL(mapped.getAtIndex(index, tmp), true, "invalid element at index (after map).");
+                ASSERT_EQUAL(tmp, value, "invalid element at index (after map).");
+                ASSERT_EQUAL(mapped.getAtRank(rankCounter, tmp), true, "invalid element at rank (after map).");
+                ASSERT_EQUAL(tmp, value, "invalid element at rank (after map).");
+                rankCounter += 1;
+            }
+
+            /* appending copies the values out of the mapping and leaves the file alone */
+            const uint64_t lastIndex = len - 1;
+            if (!key.contains(lastIndex)) {
+                mapped.append(42, lastIndex);
+                uint64_t tmp;
+                ASSERT_EQUAL(mapped.isMapped(), false, "values still mapped after append.");
+                ASSERT_EQUAL(mapped.getAtIndex(lastIndex, tmp), true, "invalid append after map.");
+                ASSERT_EQUAL(tmp, 42u, "invalid appended value after map.");
+                ASSERT_EQUAL(mapped.numElem(), array.numElem() + 1, "invalid number of elements after append.");
+
+                sparse::SparseArray<uint64_t> remapped;
+                remapped.map("junk.sparsearray");
+                ASSERT_EQUAL(remapped.getAtIndex(lastIndex, tmp), false, "append after map changed the file.");
+            }
+        }
     }
 
     std::remove("junk.sparsearray");
 
+    /* deferred rank tables -- queries between appends, then finalize matches a fresh build */
+    {
+        const uint64_t len = 200000;
+        sparse::SparseArray<uint64_t> array;
+        array.create(len);
+
+        std::vector<uint64_t> positions;
+        for (uint64_t pos = distKey(rng); pos < len; pos += distKey(rng) * (pos < len/2 ? 1 : 300)) {
+            array.append(pos, pos);
+            positions.push_back(pos);
+
+            const uint64_t probe = std::min(len - 1, pos + distKey(rng) * 1000);
+            ASSERT_EQUAL(array.numElemAt(pos), positions.size(), "invalid numElemAt while appending.");
+            ASSERT_EQUAL(array.numElemAt(probe), positions.size(), "invalid numElemAt past last append.");
+        }
+
+        array.finalize();
+        array.save("junk.sparsearray", true);
+        sparse::SparseArray<uint64_t> reloaded;
+        reloaded.load("junk.sparsearray");
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < len; i += 1) {
+            count += (count < positions.size() && positions.at(count) == i) ? 1 : 0;
+            ASSERT_EQUAL(array.numElemAt(i), count, "invalid numElemAt after finalize.");
+            ASSERT_EQUAL(reloaded.numElemAt(i), count, "invalid numElemAt after reloading finalized tables.");
+        }
+        std::remove("junk.sparsearray");
+
+        /* sorted bulk builds match the appended array */
+        std::vector<std::pair<uint64_t, uint64_t>> pairs;
+        for (auto const& pos : positions) {
+            pairs.emplace_back(pos, pos);
+        }
+        const auto bulk = sparse::SparseArray<uint64_t>::fromSorted(len, pairs.begin(), pairs.end());
+
+        /* runs split mid-word, so neighbouring runs share words */
+        std::vector<std::pair<decltype(pairs)::const_iterator, decltype(pairs)::const_iterator>> runs;
+        for (uint64_t start = 0; start < pairs.size(); start += 777) {
+            runs.emplace_back(pairs.cbegin() + start, pairs.cbegin() + std::min<uint64_t>(start + 777, pairs.size()));
+        }
+        auto parallel = sparse::SparseArray<uint64_t>::fromSortedRuns(len, runs, 4);
+
+        ASSERT_EQUAL(bulk.numElem(), positions.size(), "invalid number of elements (fromSorted).");
+        ASSERT_EQUAL(parallel.numElem(), positions.size(), "invalid number of elements (fromSortedRuns).");
+        for (uint64_t i = 0; i < len; i += 1) {
+            ASSERT_EQUAL(bulk.numElemAt(i), array.numElemAt(i), "invalid numElemAt (fromSorted).");
+            ASSERT_EQUAL(parallel.numElemAt(i), array.numElemAt(i), "invalid numElemAt (fromSortedRuns).");
+        }
+
+        /* an unsorted run reaching into the words of the next run is rejected before anything is written */
+        if constexpr (utility::CHECK_BOUNDS) {
+            const std::vector<std::pair<uint64_t, uint64_t>> unsortedPairs {{0, 0}, {5000, 1}, {10, 2},
+                {3000, 3}, {4000, 4}, {4990, 5}, {6000, 6}};
+            using PairIt = decltype(unsortedPairs)::const_iterator;
+            const std::vector<std::pair<PairIt, PairIt>> unsortedRuns {
+                {unsortedPairs.cbegin(), unsortedPairs.cbegin() + 3},
+                {unsortedPairs.cbegin() + 3, unsortedPairs.cend()}};
+            bool threw = false;
+            try {
+                sparse::SparseArray<uint64_t>::fromSortedRuns(10000, unsortedRuns, 2);
+            } catch (std::invalid_argument const&) {
+                threw = true;
+            }
+            ASSERT_EQUAL(threw, true, "an unsorted run should fail.");
+        }
+        uint64_t tmp;
+        auto moved = std::move(parallel);
+        ASSERT_EQUAL(moved.getAtIndex(positions.back(), tmp), true, "invalid element after move.");
+        ASSERT_EQUAL(tmp, positions.back(), "invalid value after move.");
+
+        /* iterating walks the positions and values together */
+        uint64_t pairIndex = 0;
+        for (auto const& [pos, value] : moved) {
+            ASSERT_EQUAL(pos, positions.at(pairIndex), "invalid iterated position.");
+            ASSERT_EQUAL(value, positions.at(pairIndex), "invalid iterated value.");
+            pairIndex += 1;
+        }
+        ASSERT_EQUAL(pairIndex, positions.size(), "invalid number of iterated pairs.");
+
+        /* other positions backends match, while appending, after finalize, from sorted builds, and from files */
+        auto checkBackend = [&](auto backend, std::string const& name) {
+            using Array = sparse::SparseArray<uint64_t, typename decltype(backend)::type>;
+            Array other;
+            other.create(len);
+            for (uint64_t k = 0; k < positions.size(); k += 1) {
+                other.append(positions.at(k), positions.at(k));
+                if (k == positions.size() / 2) {
+                    other.finalize();
+                }
+            }
+            ASSERT_EQUAL(other.numElemAt(len - 1), positions.size(), "invalid numElemAt with pending positions (" +
+                name + ").");
+            auto checkPairs = [&](Array const& scanned, std::string const& how) {
+                uint64_t k = 0;
+                for (auto const& [pos, value] : scanned) {
+                    ASSERT_EQUAL(pos, positions.at(k), "invalid iterated position (" + name + ", " + how + ").");
+                    ASSERT_EQUAL(value, positions.at(k), "invalid iterated value (" + name + ", " + how + ").");
+                    k += 1;
+                }
+                ASSERT_EQUAL(k, positions.size(), "invalid number of iterated pairs (" + name + ", " + how + ").");
+            };
+            auto checkFind = [&](Array const& searched, std::string const& how) {
+                uint64_t k = 0;
+                for (uint64_t i = 0; i < len; i += 1) {
+                    const bool isSet = k < positions.size() && positions.at(k) == i;
+                    uint64_t const* found = searched.find(i);
+                    ASSERT_EQUAL(found != nullptr, isSet, "invalid find (" + name + ", " + how + ").");
+                    ASSERT_EQUAL(!isSet || *found == i, true, "invalid value from find (" + name + ", " + how + ").");
+                    k += isSet ? 1 : 0;
+                }
+            };
+            checkPairs(other, "pending");
+            checkFind(other, "pending");
+            other.save("junk.sparsearray");
+
+            Array loaded, mapped;
+            loaded.load("junk.sparsearray");
+            mapped.map("junk.sparsearray");
+            const auto otherBulk = Array::fromSorted(len, pairs.begin(), pairs.end());
+            const auto otherParallel = Array::fromSortedRuns(len, runs, 4);
+            checkPairs(other, "finalized");
+            checkPairs(mapped, "mapped");
+            checkFind(other, "finalized");
+            checkFind(mapped, "mapped");
+            uint64_t otherValue = 0, value = 0;
+            for (uint64_t i = 0; i < len; i += 1) {
+                const uint64_t expected = array.numElemAt(i);
+                ASSERT_EQUAL(other.numElemAt(i), expected, "invalid numElemAt (" + name + ").");
+                ASSERT_EQUAL(loaded.numElemAt(i), expected, "invalid numElemAt (" + name + ", loaded).");
+                ASSERT_EQUAL(mapped.numElemAt(i), expected, "invalid numElemAt (" + name + ", mapped).");
+                ASSERT_EQUAL(otherBulk.numElemAt(i), expected, "invalid numElemAt (" + name + ", fromSorted).");
+                ASSERT_EQUAL(otherParallel.numElemAt(i), expected, "invalid numElemAt (" + name + ", fromSortedRuns).");
+
+                const bool found = array.getAtIndex(i, value);
+                ASSERT_EQUAL(mapped.getAtIndex(i, otherValue), found, "invalid getAtIndex (" + name + ").");
+                ASSERT_EQUAL(!found || otherValue == value, true, "invalid value from getAtIndex (" + name + ").");
+            }
+            ASSERT_EQUAL(mapped.getAtRank(positions.size() - 1, otherValue), true, "invalid getAtRank (" + name +
+                ").");
+            ASSERT_EQUAL(otherValue, positions.back(), "invalid value from getAtRank (" + name + ").");
+
+            /* appending after a load picks up after the last saved position */
+            if (positions.back() + 1 < len) {
+                loaded.append(7, len - 1);
+                loaded.finalize();
+                ASSERT_EQUAL(loaded.numElemAt(len - 1), positions.size() + 1, "invalid append after load (" + name +
+                    ").");
+            }
+        };
+        checkBackend(std::type_identity<sparse::InterleavedPositions>{}, "interleaved");
+        checkBackend(std::type_identity<sparse::CompressedPositions>{}, "RRR");
+        checkBackend(std::type_identity<sparse::EliasFanoPositions>{}, "EliasFano");
+
+        sparse::SparseArray<uint64_t> wrongPolicy;
+        bool threw = false;
+        try {
+            wrongPolicy.load("junk.sparsearray");
+        } catch (std::ios_base::failure const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "loading Elias-Fano positions as a bitvector should fail.");
+        std::remove("junk.sparsearray");
+    }
+
+    /* files are written and read through large buffers, and every section of a saved array has a checksum */
+    {
+        const char digits[] = "123456789";
+        ASSERT_EQUAL(utility::crc32c(digits, 9), 0xE3069283u, "invalid CRC32C check value.");
+        ASSERT_EQUAL(utility::crc32c(digits + 4, 5, utility::crc32c(digits, 4)), 0xE3069283u,
+            "CRC32C should continue from a previous checksum.");
+
+        /* more than one buffer of values, written and read in one call each, between unaligned scalars */
+        std::vector<uint64_t> words(serial::IO_BUFFER_BYTES / 8 + 1000);
+        for (auto &word : words) {
+            word = rng();
+        }
+        {
+            serial::FileWriter out("junk.serial");
+            serial::serialize(uint8_t(7), out);
+            serial::pad(out);
+            serial::serialize(words, out);
+            out.writeChecksum();
+            out.close();
+        }
+        {
+            serial::FileReader in("junk.serial");
+            uint8_t header = 0;
+            std::vector<uint64_t> loaded;
+            serial::deserialize(header, in);
+            serial::skipPadding(in);
+            ASSERT_EQUAL(static_cast<uint64_t>(in.tellg()), serial::ALIGNMENT, "invalid position after padding.");
+            serial::deserialize(loaded, in);
+            ASSERT_EQUAL(header, uint8_t(7), "invalid scalar read back.");
+            ASSERT_EQUAL(loaded == words, true, "invalid vector read back.");
+            ASSERT_EQUAL(in.verifyChecksum(), true, "checksum should match.");
+        }
+        std::remove("junk.serial");
+
+        sparse::SparseArray<uint64_t> array;
+        array.create(100000);
+        for (uint64_t pos = 0; pos < 100000; pos += 3) {
+            array.append(pos * 7, pos);
+        }
+        for (const bool directIO : {false, true}) {
+            array.save("junk.sparsearray", false, directIO);
+            sparse::SparseArray<uint64_t> loaded;
+            loaded.load("junk.sparsearray");
+            ASSERT_EQUAL(loaded.numElem(), array.numElem(), "invalid numElem after load.");
+            ASSERT_EQUAL(*loaded.find(99999), uint64_t(99999 * 7), "invalid value after load.");
+        }
+
+        /* flip one byte of the values: load and a verifying map notice, a lazy map reads past it */
+        const uint64_t valuesOffset = serial::SectionReader("junk.sparsearray").entry(3).offset;
+        {
+            std::fstream file("junk.sparsearray", std::ios::in | std::ios::out | std::ios::binary);
+            file.seekg(valuesOffset + 8);
+            const char byte = static_cast<char>(file.peek());
+            file.seekp(valuesOffset + 8);
+            file.put(static_cast<char>(byte ^ 1));
+        }
+        auto fails = [](auto&& open) {
+            try {
+                open();
+            } catch (std::ios_base::failure const&) {
+                return true;
+            }
+            return false;
+        };
+        sparse::SparseArray<uint64_t> corrupt;
+        ASSERT_EQUAL(fails([&] { corrupt.load("junk.sparsearray"); }), true, "loading a corrupt file should fail.");
+        ASSERT_EQUAL(fails([&] { corrupt.map("junk.sparsearray", true); }), true,
+            "verified mapping of a corrupt file should fail.");
+        ASSERT_EQUAL(fails([&] { corrupt.map("junk.sparsearray"); }), false, "lazy mapping should not read values.");
+        ASSERT_EQUAL(corrupt.numElemAt(99999), array.numElemAt(99999), "invalid numElemAt after lazy map.");
+
+        /* cut off the directory */
+        std::filesystem::resize_file("junk.sparsearray", valuesOffset + 8);
+        ASSERT_EQUAL(fails([&] { corrupt.load("junk.sparsearray"); }), true, "loading a truncated file should fail.");
+        ASSERT_EQUAL(fails([&] { corrupt.map("junk.sparsearray"); }), true, "mapping a truncated file should fail.");
+        std::remove("junk.sparsearray");
+
+        /* packed integers take the bits of their range, and round trip through load and map */
+        sparse::SparseArray<int64_t, sparse::EliasFanoPositions> small;
+        small.create(100000);
+        for (uint64_t pos = 0; pos < 100000; pos += 3) {
+            small.append(static_cast<int64_t>(pos % 200) - 100, pos);
+        }
+        small.save("junk.sparsearray");
+        const uint64_t plainBytes = std::filesystem::file_size("junk.sparsearray");
+        small.save("junk.sparsearray", false, false, true);
+        ASSERT_EQUAL(std::filesystem::file_size("junk.sparsearray") * 4 < plainBytes, true,
+            "8 bit values should pack into under a quarter of the space.");
+        sparse::SparseArray<int64_t, sparse::EliasFanoPositions> packedLoaded, packedMapped;
+        packedLoaded.load("junk.sparsearray");
+        packedMapped.map("junk.sparsearray", true);
+        for (uint64_t pos = 0; pos < 100000; pos += 3) {
+            const int64_t expected = static_cast<int64_t>(pos % 200) - 100;
+            ASSERT_EQUAL(*packedLoaded.find(pos), expected, "invalid packed value after load.");
+            ASSERT_EQUAL(*packedMapped.find(pos), expected, "invalid packed value after map.");
+        }
+        std::remove("junk.sparsearray");
+
+        /* sections are found by id wherever they are, and missing ones are reported */
+        {
+            serial::SectionWriter writer("junk.sections");
+            serial::serialize(std::vector<uint32_t>{1, 2, 3}, writer.begin(7));
+            writer.end();
+            writer.begin(9) << "hello";
+            writer.end();
+            writer.close();
+        }
+        const serial::SectionReader sections("junk.sections");
+        ASSERT_EQUAL(sections.contains(9) && !sections.contains(8), true, "invalid section directory.");
+        ASSERT_EQUAL(sections.entry(7).offset % serial::ALIGNMENT, uint64_t(0), "sections should be aligned.");
+        sections.verify(7);
+        serial::MemoryReader in(sections.bytes(7));
+        std::vector<uint32_t> read;
+        serial::deserialize(read, in);
+        ASSERT_EQUAL(read == std::vector<uint32_t>{1, 2, 3}, true, "invalid section contents.");
+        ASSERT_EQUAL(std::string(sections.bytes(9).begin(), sections.bytes(9).end()), std::string("hello"),
+            "invalid section contents.");
+        ASSERT_EQUAL(fails([&] { sections.entry(8); }), true, "a missing section should be reported.");
+        std::remove("junk.sections");
+    }
+
+    /* at 1% density the positions take over 10x less space with Elias-Fano */
+    {
+        const uint64_t len = 1000000;
+        std::vector<std::pair<uint64_t, uint64_t>> pairs;
+        for (uint64_t pos = distKey(rng) % 100; pos < len; pos += 100) {
+            pairs.emplace_back(pos, pos);
+        }
+        const auto plain = sparse::SparseArray<uint64_t>::fromSorted(len, pairs.cbegin(), pairs.cend());
+        const auto ef = sparse::SparseArray<uint64_t, sparse::EliasFanoPositions>::fromSorted(len, pairs.cbegin(), 
+            pairs.cend());
+        const uint64_t valueBits = 8 * sizeof(uint64_t) * pairs.size();
+        ASSERT_EQUAL((plain.overhead() - valueBits) > 10 * (ef.overhead() - valueBits), true, 
+            "Elias-Fano positions should be over 10x smaller at 1% density.");
+
+        /* an empty set is O(1) bits, whatever the universe */
+        sparse::SparseArray<uint64_t, sparse::EliasFanoPositions> large;
+        large.create(uint64_t(1) << 40);
+        ASSERT_EQUAL(large.overhead() < 4096, true, "a freshly created Elias-Fano array should be O(1) bits.");
+        ASSERT_EQUAL(large.numElemAt((uint64_t(1) << 40) - 1), uint64_t(0), "invalid numElemAt of an empty array.");
+        large.append(7, uint64_t(1) << 39);
+        large.finalize();
+        ASSERT_EQUAL(large.numElemAt((uint64_t(1) << 40) - 1), uint64_t(1), "invalid numElemAt after an append.");
+    }
+
+    /* move-only values are moved in by append, emplace, and fromSorted over move iterators */
+    {
+        sparse::SparseArray<std::unique_ptr<uint64_t>> array;
+        array.create(100);
+        array.reserve(3);
+        auto first = std::make_unique<uint64_t>(10);
+        uint64_t const* firstAddress = first.get();
+        array.append(std::move(first), 10);
+        array.emplace(20, std::make_unique<uint64_t>(20));
+        array.emplace(30, new uint64_t(30));
+        ASSERT_EQUAL(first == nullptr, true, "append should move its argument.");
+        ASSERT_EQUAL(array.find(10)->get(), firstAddress, "append should not copy the moved value.");
+        ASSERT_EQUAL(**array.find(30), uint64_t(30), "invalid value from emplace.");
+        ASSERT_EQUAL(array.find(31), static_cast<std::unique_ptr<uint64_t> const*>(nullptr), "invalid find.");
+        ASSERT_EQUAL(**array.findRank(1), uint64_t(20), "invalid findRank.");
+        ASSERT_EQUAL(array.findRank(3), static_cast<std::unique_ptr<uint64_t> const*>(nullptr),
+            "findRank past the end should be nullptr.");
+        ASSERT_EQUAL(array.values().size(), uint64_t(3), "invalid values.");
+
+        std::vector<std::pair<uint64_t, std::unique_ptr<uint64_t>>> pairs;
+        for (uint64_t pos = 0; pos < 100; pos += 7) {
+            pairs.emplace_back(pos, std::make_unique<uint64_t>(pos));
+        }
+        const auto built = sparse::SparseArray<std::unique_ptr<uint64_t>, sparse::EliasFanoPositions>::fromSorted(100,
+            std::make_move_iterator(pairs.begin()), std::make_move_iterator(pairs.end()));
+        ASSERT_EQUAL(pairs.front().second == nullptr, true, "fromSorted should move from move iterators.");
+        for (auto const& [pos, value] : built) {
+            ASSERT_EQUAL(*value, pos, "invalid value moved in by fromSorted.");
+        }
+
+        /* and so does fromSortedRuns, for both kinds of run writer */
+        auto checkRuns = [](auto backend, std::string const& name) {
+            using Array = sparse::SparseArray<std::unique_ptr<uint64_t>, typename decltype(backend)::type>;
+            std::vector<std::pair<uint64_t, std::unique_ptr<uint64_t>>> runPairs;
+            for (uint64_t pos = 0; pos < 1000; pos += 7) {
+                runPairs.emplace_back(pos, std::make_unique<uint64_t>(pos));
+            }
+            using MoveIt = std::move_iterator<decltype(runPairs)::iterator>;
+            const std::vector<std::pair<MoveIt, MoveIt>> runs {
+                {MoveIt(runPairs.begin()), MoveIt(runPairs.begin() + 50)},
+                {MoveIt(runPairs.begin() + 50), MoveIt(runPairs.end())}};
+            const auto fromRuns = Array::fromSortedRuns(1000, runs, 2);
+            ASSERT_EQUAL(std::all_of(runPairs.begin(), runPairs.end(), [](auto const& p) { return !p.second; }), true,
+                "fromSortedRuns should move from move iterators (" + name + ").");
+            for (auto const& [pos, value] : fromRuns) {
+                ASSERT_EQUAL(*value, pos, "invalid value moved in by fromSortedRuns (" + name + ").");
+            }
+        };
+        checkRuns(std::type_identity<sparse::BitVectorPositions>{}, "bitvector");
+        checkRuns(std::type_identity<sparse::EliasFanoPositions>{}, "elias-fano");
+    }
+
+    /* values come from the array's allocator: the arena has no upstream, so any other allocation would throw */
+    {
+        std::array<std::byte, 1 << 14> buffer;
+        std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+        using ArenaArray = sparse::SparseArray<uint64_t, sparse::BitVectorPositions,
+            std::pmr::polymorphic_allocator<uint64_t>>;
+
+        ArenaArray array(&arena);
+        array.create(1000);
+        array.reserve(100);
+        for (uint64_t pos = 0; pos < 1000; pos += 10) {
+            array.append(pos, pos);
+        }
+        auto const* values = reinterpret_cast<std::byte const*>(array.values().data());
+        ASSERT_EQUAL(values >= buffer.data() && values < buffer.data() + buffer.size(), true,
+            "values should be allocated in the arena.");
+        ASSERT_EQUAL(array.get_allocator().resource() == &arena, true, "invalid allocator.");
+
+        std::vector<std::pair<uint64_t, uint64_t>> pairs = {{3, 30}, {500, 5000}};
+        const auto built = ArenaArray::fromSorted(1000, pairs.cbegin(), pairs.cend(), &arena);
+        ASSERT_EQUAL(*built.find(500), uint64_t(5000), "invalid arena fromSorted.");
+        ASSERT_EQUAL(built.get_allocator().resource() == &arena, true, "fromSorted should use the given allocator.");
+    }
+
+    std::cout << "Success\n";
+}
+
+void testConcurrentSparseArray() {
+    std::cout << "Testing ConcurrentSparseArray...\t";
+
+    /* staged appends are invisible until publish, and old snapshots stay intact */
+    {
+        sparse::ConcurrentSparseArray<std::string> array;
+        array.create(100);
+        auto reader = array.reader();
+        array.append("foo", 3);
+        array.append("bar", 40);
+        ASSERT_EQUAL(array.numStaged(), 2u, "invalid number of staged appends.");
+        ASSERT_EQUAL(reader.find(3) == nullptr, true, "staged append visible before publish.");
+
+        const auto before = array.snapshot();
+        const uint64_t version = array.publish();
+        ASSERT_EQUAL(array.version(), version, "invalid version after publish.");
+        ASSERT_EQUAL(array.publish(), version, "publishing nothing made a new version.");
+        ASSERT_EQUAL(before->numElem(), 0u, "published into a held snapshot.");
+
+        std::string tmp;
+        ASSERT_EQUAL(reader.getAtIndex(40, tmp), true, "reader missed a published append.");
+        ASSERT_EQUAL(tmp, "bar", "invalid value after publish.");
+        ASSERT_EQUAL(reader.version(), version, "reader didn't move to the published version.");
+        ASSERT_EQUAL(array.getAtIndex(3, tmp), true, "invalid getAtIndex after publish.");
+        ASSERT_EQUAL(tmp, "foo", "invalid value after publish.");
+        ASSERT_EQUAL(array.numElemAt(99), 2u, "invalid numElemAt after publish.");
+
+        bool threw = false;
+        try {
+            array.append("baz", 40);
+        } catch (std::invalid_argument const&) {
+            threw = true;
+        }
+        ASSERT_EQUAL(threw, true, "append before the last published position should fail.");
+
+        array.append("baz", 41);
+        sparse::SparseArray<std::string> empty;
+        empty.create(100);
+        array.replace(std::move(empty));
+        ASSERT_EQUAL(array.numStaged(), 0u, "replace kept staged appends.");
+        ASSERT_EQUAL(reader.find(40) == nullptr, true, "reader kept a replaced snapshot.");
+    }
+
+    /* readers check every snapshot they see while a writer publishes batches */
+    {
+        const uint64_t len = 200000, batch = 1000;
+        sparse::ConcurrentSparseArray<uint64_t, sparse::EliasFanoPositions> array;
+        array.create(len);
+        std::atomic<bool> done = false;
+        std::atomic<uint64_t> failures = 0;
+
+        std::vector<std::thread> readers;
+        for (uint32_t t = 0; t < 4; t += 1) {
+            readers.emplace_back([&array, &done, &failures, t] {
+                auto reader = array.reader();
+                std::mt19937_64 queries(t);
+                while (!done.load()) {
+                    /* every third position is set, up to some prefix of the array */
+                    const uint64_t index = queries() % len;
+                    auto const& snapshot = reader.current();
+                    uint64_t const* value = snapshot.find(index);
+                    const uint64_t published = snapshot.numElem();
+                    const bool expected = (index % 3 == 0) && (index / 3 < published);
+                    if ((value != nullptr) != expected || (value != nullptr && *value != index)) {
+                        failures += 1;
+                    }
+                }
+            });
+        }
+
+        uint64_t published = 0;
+        for (uint64_t pos = 0; pos < len; pos += 3) {
+            array.append(pos, pos);
+            if (++published % batch == 0) {
+                array.publish();
+            }
+        }
+        array.publish();
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        ASSERT_EQUAL(failures.load(), 0u, "reader saw an inconsistent snapshot.");
+        ASSERT_EQUAL(array.numElem(), published, "invalid number of elements after concurrent publishes.");
+    }
+
+    std::cout << "Success\n";
+}
+
+void testDynamicBitVector() {
+    using namespace bitvector;
+    std::cout << "Testing DynamicBitVector...\t";
+
+    std::mt19937_64 rng(858);
+    auto checkAll = [](DynamicBitVector const& dynamic, std::vector<uint8_t> const& expected, std::string const& when) {
+        /* messages are built once, not per bit */
+        const std::string accessMsg = "invalid DynamicBitVector access " + when + ".",
+            rankMsg = "invalid DynamicBitVector rank1 " + when + ".",
+            selectMsg = "invalid DynamicBitVector select " + when + ".",
+            copyMsg = "invalid DynamicBitVector::toBitVector " + when + ".";
+        ASSERT_EQUAL(dynamic.size(), expected.size(), "invalid DynamicBitVector size " + when + ".");
+        const BitVector copied = dynamic.toBitVector();
+        uint64_t ones = 0;
+        for (uint64_t i = 0; i < expected.size(); i += 1) {
+            ASSERT_EQUAL(dynamic[i], expected[i], accessMsg);
+            ASSERT_EQUAL(copied[i], expected[i], copyMsg);
+            ones += expected[i] ? 1 : 0;
+            ASSERT_EQUAL(dynamic.rank1(i), ones, rankMsg);
+            ASSERT_EQUAL(expected[i] ? dynamic.select1(ones) : dynamic.select0(i + 1 - ones), i, selectMsg);
+        }
+        ASSERT_EQUAL(dynamic.totalOnes(), ones, "invalid DynamicBitVector totalOnes " + when + ".");
+    };
+
+    /* built from a BitVector, then random inserts, erases, and sets that split and merge leaves and nodes. The
+       expected bits are bytes, so inserting and erasing them is a memmove. */
+    for (uint64_t len : {0u, 1u, 1000u, 50000u}) {
+        const BitVector initial = getRandomBitVector(len, rng());
+        std::vector<uint8_t> expected(len);
+        for (uint64_t i = 0; i < len; i += 1) {
+            expected[i] = initial[i];
+        }
+        DynamicBitVector dynamic(initial);
+        checkAll(dynamic, expected, "after construction");
+
+        for (uint32_t round = 0; round < 4; round += 1) {
+            /* grow in the first rounds, shrink in the later ones */
+            const double insertShare = (round < 2) ? 0.7 : 0.2;
+            std::bernoulli_distribution doInsert(insertShare), bit(0.5);
+            for (uint32_t op = 0; op < 10000; op += 1) {
+                if (expected.empty() || doInsert(rng)) {
+                    const uint64_t i = rng() % (expected.size() + 1);
+                    const bool value = bit(rng);
+                    dynamic.insert(i, value);
+                    expected.insert(expected.begin() + i, value);
+                } else if (op % 5 == 0) {
+                    const uint64_t i = rng() % expected.size();
+                    const bool value = bit(rng);
+                    dynamic.set(i, value);
+                    expected[i] = value;
+                } else {
+                    const uint64_t i = rng() % expected.size();
+                    ASSERT_EQUAL(dynamic.erase(i), static_cast<bool>(expected[i]), "invalid erased bit.");
+                    expected.erase(expected.begin() + i);
+                }
+            }
+            checkAll(dynamic, expected, "after round " + std::to_string(round));
+        }
+    }
+
+    /* appending builds the tree up, and erasing takes it back down */
+    {
+        DynamicBitVector dynamic;
+        std::vector<uint8_t> expected;
+        for (uint64_t i = 0; i < 300000; i += 1) {
+            dynamic.push_back(i % 3 == 0);
+            expected.push_back(i % 3 == 0);
+        }
+        ASSERT_EQUAL(dynamic.height() > 1, true, "DynamicBitVector didn't grow a level.");
+        checkAll(dynamic, expected, "after appends");
+        while (dynamic.size() > 10) {
+            ASSERT_EQUAL(dynamic.erase(dynamic.size() - 1), static_cast<bool>(expected.back()), "invalid erased bit.");
+            expected.pop_back();
+        }
+        ASSERT_EQUAL(dynamic.height(), 1u, "DynamicBitVector didn't shrink back to one level.");
+        checkAll(dynamic, expected, "after erasing");
+    }
+
+    bool threw = false;
+    try {
+        DynamicBitVector().erase(0);
+    } catch (std::out_of_range const&) {
+        threw = true;
+    }
+    ASSERT_EQUAL(threw, true, "erasing from an empty DynamicBitVector should fail.");
+
+    std::cout << "Success\n";
+}
+
+void testDynamicSparseArray() {
+    std::cout << "Testing DynamicSparseArray...\t";
+
+    std::mt19937_64 rng(858);
+    const uint64_t len = 50000;
+    sparse::DynamicSparseArray<uint64_t> array;
+    array.create(len);
+    std::map<uint64_t, uint64_t> expected;
+
+    /* positions arrive out of order, and some are overwritten or erased again */
+    for (uint32_t op = 0; op < 30000; op += 1) {
+        const uint64_t pos = rng() % len;
+        if (op % 4 == 3) {
+            ASSERT_EQUAL(array.erase(pos), expected.erase(pos) == 1, "invalid DynamicSparseArray erase.");
+        } else {
+            const uint64_t value = rng();
+            ASSERT_EQUAL(array.insert(value, pos), !expected.contains(pos), "invalid DynamicSparseArray insert.");
+            expected[pos] = value;
+        }
+    }
+    ASSERT_EQUAL(array.numElem(), expected.size(), "invalid DynamicSparseArray numElem.");
+
+    const auto packed = array.toSparseArray();
+    uint64_t rank = 0, value = 0;
+    for (uint64_t i = 0; i < len; i += 1) {
+        const auto it = expected.find(i);
+        uint64_t const* found = array.find(i);
+        ASSERT_EQUAL(found != nullptr, it != expected.end(), "invalid DynamicSparseArray find.");
+        if (found != nullptr) {
+            ASSERT_EQUAL(*found, it->second, "invalid DynamicSparseArray value.");
+            ASSERT_EQUAL(array.getAtRank(rank, value), true, "invalid DynamicSparseArray getAtRank.");
+            ASSERT_EQUAL(value, it->second, "invalid DynamicSparseArray value at rank.");
+            rank += 1;
+        }
+        ASSERT_EQUAL(array.numElemAt(i), rank, "invalid DynamicSparseArray numElemAt.");
+        ASSERT_EQUAL(packed.numElemAt(i), rank, "invalid numElemAt after toSparseArray.");
+    }
+    ASSERT_EQUAL(array.getAtRank(rank, value), false, "getAtRank past the last element should fail.");
+    ASSERT_EQUAL(std::equal(array.begin(), array.end(), expected.cbegin(), expected.cend()), true,
+        "invalid DynamicSparseArray iteration.");
+
+    std::cout << "Success\n";
+}
+
+void testShardedSparseArray() {
+    std::cout << "Testing ShardedSparseArray...\t";
+
+    std::mt19937_64 rng(858);
+    const uint64_t len = 100000;
+    std::vector<std::pair<uint64_t, uint64_t>> pairs;
+    for (uint64_t pos = 0; pos < len; pos += 1) {
+        /* leave a gap of empty shards in the middle */
+        if ((pos < len / 3 || pos > len / 2) && rng() % 10 == 0) {
+            pairs.emplace_back(pos, rng());
+        }
+    }
+    const auto reference = sparse::SparseArray<uint64_t>::fromSorted(len, pairs.cbegin(), pairs.cend());
+
+    auto check = [&reference](auto const& array, std::string const& name) {
+        ASSERT_EQUAL(array.size(), reference.size(), "invalid size (" + name + ").");
+        ASSERT_EQUAL(array.numElem(), reference.numElem(), "invalid numElem (" + name + ").");
+        uint64_t value = 0;
+        for (uint64_t i = 0; i < reference.size(); i += 1) {
+            ASSERT_EQUAL(array.numElemAt(i), reference.numElemAt(i), "invalid numElemAt (" + name + ").");
+            uint64_t const* expected = reference.find(i);
+            uint64_t const* found = array.find(i);
+            ASSERT_EQUAL(found == nullptr, expected == nullptr, "invalid find (" + name + ").");
+            ASSERT_EQUAL(!found || *found == *expected, true, "invalid value from find (" + name + ").");
+        }
+        for (uint64_t rank = 0; rank <= reference.numElem(); rank += 1) {
+            const bool present = array.getAtRank(rank, value);
+            ASSERT_EQUAL(present, rank < reference.numElem(), "invalid getAtRank (" + name + ").");
+            ASSERT_EQUAL(!present || value == reference.values()[rank], true, "invalid value from getAtRank (" +
+                name + ").");
+        }
+    };
+
+    for (const uint32_t numShards : {1u, 7u, 64u}) {
+        const std::string name = std::to_string(numShards) + " shards";
+        const auto built = sparse::ShardedSparseArray<uint64_t>::fromSorted(len, numShards, pairs.cbegin(),
+            pairs.cend());
+        ASSERT_EQUAL(built.numShards(), numShards, "invalid numShards.");
+        check(built, name + ", fromSorted");
+
+        sparse::ShardedSparseArray<uint64_t, sparse::EliasFanoPositions> appended;
+        appended.create(len, numShards);
+        for (auto const& [pos, value] : pairs) {
+            appended.append(value, pos);
+        }
+        check(appended, name + ", appended");
+        appended.finalize();
+        check(appended, name + ", finalized");
+
+        /* shards are saved separately and can be replaced one at a time */
+        appended.save("junk.sharded");
+        sparse::ShardedSparseArray<uint64_t, sparse::EliasFanoPositions> loaded;
+        loaded.load("junk.sharded");
+        check(loaded, name + ", loaded");
+        loaded.loadShard(numShards - 1, sparse::ShardedSparseArray<uint64_t>::shardFileName("junk.sharded",
+            numShards - 1));
+        check(loaded, name + ", shard reloaded");
+        for (uint32_t s = 0; s < numShards; s += 1) {
+            ASSERT_EQUAL(loaded.nodeOf(s) < utility::numaNodeCpus().size(), true, "invalid nodeOf.");
+            std::remove(sparse::ShardedSparseArray<uint64_t>::shardFileName("junk.sharded", s).c_str());
+        }
+        std::remove("junk.sharded.manifest");
+    }
+
+    /* appends stay in increasing order across shards */
+    sparse::ShardedSparseArray<uint64_t> array;
+    array.create(100, 4);
+    array.append(1, 60);
+    bool threw = false;
+    try {
+        array.append(2, 10);
+    } catch (std::invalid_argument const&) {
+        threw = true;
+    }
+    ASSERT_EQUAL(threw || !utility::CHECK_BOUNDS, true, "appending into an earlier shard should fail.");
+
+    std::cout << "Success\n";
+}
+
+void testInstrument() {
+    using namespace bitvector;
+    std::cout << "Testing instrument...\t\t";
+
+    const uint64_t size = 1 << 16;
+    const uint64_t enabled = instrument::ENABLED ? 1 : 0;   /* counts are all 0 when disabled */
+    auto counted = [](instrument::Counts const& before, instrument::Counter counter) {
+        return instrument::snapshot()[counter] - before[counter];
+    };
+
+    instrument::PerfCounters perf;
+    perf.start();
+    instrument::Counts before = instrument::snapshot();
+    const BitVector bv = getRandomBitVector(size, 858);
+    const RankSupport rank(bv);
+    ASSERT_EQUAL(counted(before, instrument::BUILD_BITS_SCANNED), size * enabled,
+        "buildTables should count every bit it scans.");
+
+    /* select1 scans at least the word its answer is in; select0 binary searches the rank tables */
+    const SelectSupport select(rank);
+    before = instrument::snapshot();
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < 100; i += 1) {
+        sum += rank.rank1(i * 7) + select.select1(i + 1) + select.select0(i + 1);
+    }
+    perf.stop();
+    ASSERT_EQUAL(sum > 0, true, "invalid rank/select.");
+    ASSERT_EQUAL(counted(before, instrument::RANK_CALLS), 100 * enabled, "invalid number of ranks.");
+    ASSERT_EQUAL(counted(before, instrument::SELECT_CALLS), 200 * enabled,
+        "invalid number of selects.");
+    ASSERT_EQUAL(counted(before, instrument::SELECT_SCAN_WORDS) >= 100 * enabled, true,
+        "select1 should count the words it scans.");
+    ASSERT_EQUAL(counted(before, instrument::SELECT_SEARCH_STEPS) >= 100 * enabled, true,
+        "select0 should count its binary search steps.");
+
+    /* counts of threads that have exited are kept */
+    before = instrument::snapshot();
+    std::thread([&rank]() { ASSERT_EQUAL(rank.rank1(0) <= 1, true, "invalid rank."); }).join();
+    ASSERT_EQUAL(counted(before, instrument::RANK_CALLS), 1 * enabled, "lost another thread's count.");
+
+    /* hardware events are optional (the kernel may not allow them), but can't be counted when disabled */
+    for (uint32_t e = 0; e < instrument::PerfCounters::NUM_EVENTS; e += 1) {
+        const auto event = static_cast<instrument::PerfCounters::Event>(e);
+        ASSERT_EQUAL(!perf.available(event) || instrument::ENABLED, true, "events should be off when disabled.");
+        ASSERT_EQUAL(perf.available(event) || perf.read()[e] == 0, true, "unavailable events should read 0.");
+    }
+    if (perf.available(instrument::PerfCounters::CYCLES)) {
+        ASSERT_EQUAL(perf.read()[instrument::PerfCounters::CYCLES] > 0, true, "no cycles counted.");
+    }
+
+    std::cout << "Success\n";
+}
+
+void testWaveletMatrix() {
+    using namespace bitvector;
+    std::cout << "Testing WaveletMatrix...\t";
+
+    std::mt19937_64 rng(858);
+
+    /* (length, alphabet size, threads): empty and unary sequences, alphabets that aren't powers of 2, and lengths that
+       aren't multiples of a word */
+    const std::vector<std::tuple<uint64_t, uint64_t, uint32_t>> CASES {{0, 1, 1}, {1, 1, 1}, {100, 2, 1},
+        {1000, 5, 2}, {4099, 256, 4}, {70001, 1000, 3}, {100003, 3, 4}};
+    for (auto const& [length, sigma, threads] : CASES) {
+        std::uniform_int_distribution<uint64_t> symbol(0, sigma - 1);
+        std::vector<uint64_t> symbols(length);
+        std::generate(symbols.begin(), symbols.end(), [&]() { return symbol(rng); });
+
+        WaveletMatrix wm(symbols, sigma, threads);
+        ASSERT_EQUAL(wm.size(), length, "invalid WaveletMatrix size.");
+        ASSERT_EQUAL(wm.alphabetSize(), sigma, "invalid WaveletMatrix alphabet size.");
+        ASSERT_EQUAL(WaveletMatrix(symbols).alphabetSize() <= sigma, true, "invalid inferred alphabet size.");
+
+        /* access, rank, and select against running counts */
+        std::vector<uint64_t> counts(sigma, 0);
+        for (uint64_t i = 0; i < length; i += 1) {
+            const uint64_t c = symbols.at(i), other = symbol(rng);
+            counts.at(c) += 1;
+            ASSERT_EQUAL(wm[i], c, "invalid WaveletMatrix access (index=" + std::to_string(i) + ").");
+            ASSERT_EQUAL(wm.rank(c, i), counts.at(c), "invalid WaveletMatrix rank (index=" + std::to_string(i) + ").");
+            ASSERT_EQUAL(wm.rank(other, i), counts.at(other), "invalid WaveletMatrix rank of another symbol.");
+            ASSERT_EQUAL(wm.rank(sigma, i), uint64_t(0), "invalid WaveletMatrix rank outside the alphabet.");
+            ASSERT_EQUAL(wm.select(c, counts.at(c)), i, "invalid WaveletMatrix select (index=" + std::to_string(i) +
+                ").");
+        }
+
+        /* quantile and range counts of random ranges against a sorted copy */
+        for (uint64_t trial = 0; length > 0 && trial < 200; trial += 1) {
+            std::uniform_int_distribution<uint64_t> index(0, length - 1);
+            uint64_t begin = index(rng), end = index(rng) + 1;
+            if (begin >= end) {
+                std::swap(begin, end);
+                begin -= 1;
+                end += 1;
+            }
+            std::vector<uint64_t> sorted(symbols.begin() + begin, symbols.begin() + end);
+            std::sort(sorted.begin(), sorted.end());
+            const uint64_t k = std::uniform_int_distribution<uint64_t>(0, sorted.size() - 1)(rng);
+            ASSERT_EQUAL(wm.quantile(begin, end, k), sorted.at(k), "invalid WaveletMatrix quantile.");
+
+            uint64_t low = symbol(rng), high = symbol(rng) + 1;
+            const uint64_t expected = std::count_if(sorted.begin(), sorted.end(),
+                [low, high](uint64_t s) { return low <= s && s < high; });
+            ASSERT_EQUAL(wm.rangeCount(begin, end, low, high), expected, "invalid WaveletMatrix range count.");
+            ASSERT_EQUAL(wm.countLess(begin, end, sigma), end - begin, "invalid WaveletMatrix countLess.");
+        }
+
+        /* saved, loaded, mapped, and moved copies give the same answers */
+        wm.save("junk.waveletmatrix");
+        WaveletMatrix loaded, mapped;
+        loaded.load("junk.waveletmatrix");
+        mapped.map("junk.waveletmatrix");
+        const WaveletMatrix moved(std::move(wm));
+        ASSERT_EQUAL(loaded.size(), length, "invalid loaded WaveletMatrix size.");
+        ASSERT_EQUAL(mapped.size(), length, "invalid mapped WaveletMatrix size.");
+        for (uint64_t i = 0; i < length; i += 7) {
+            const uint64_t c = symbols.at(i);
+            ASSERT_EQUAL(loaded[i], c, "invalid loaded WaveletMatrix access.");
+            ASSERT_EQUAL(mapped[i], c, "invalid mapped WaveletMatrix access.");
+            ASSERT_EQUAL(moved[i], c, "invalid moved WaveletMatrix access.");
+            ASSERT_EQUAL(mapped.rank(c, i), moved.rank(c, i), "invalid mapped WaveletMatrix rank.");
+            ASSERT_EQUAL(loaded.select(c, loaded.rank(c, i)), i, "invalid loaded WaveletMatrix select.");
+        }
+    }
+    std::remove("junk.waveletmatrix");
+
+    /* 64 bit symbols use every level */
+    {
+        const std::vector<uint64_t> wide {~0ull - 1, 0, 1ull << 63, 42, ~0ull - 1};
+        const WaveletMatrix wm(wide);
+        ASSERT_EQUAL(wm.levels(), uint32_t(64), "invalid WaveletMatrix levels for 64 bit symbols.");
+        for (uint64_t i = 0; i < wide.size(); i += 1) {
+            ASSERT_EQUAL(wm[i], wide.at(i), "invalid WaveletMatrix access of 64 bit symbols.");
+        }
+        ASSERT_EQUAL(wm.select(~0ull - 1, 2), uint64_t(4), "invalid WaveletMatrix select of 64 bit symbols.");
+        ASSERT_EQUAL(wm.quantile(0, wide.size(), 2), uint64_t(1ull << 63), "invalid quantile of 64 bit symbols.");
+    }
+
+    bool threw = false;
+    try {
+        const std::vector<uint64_t> outside {0, 1, 5};
+        WaveletMatrix tooLarge(outside, 5);
+    } catch (std::invalid_argument const&) {
+        threw = true;
+    }
+    ASSERT_EQUAL(threw || !utility::CHECK_BOUNDS, true, "symbol outside the alphabet should fail.");
+
+    threw = false;
+    try {
+        const std::vector<uint64_t> some {0, 1, 1};
+        WaveletMatrix(some).select(1, 3);
+    } catch (std::invalid_argument const&) {
+        threw = true;
+    }
+    ASSERT_EQUAL(threw || !utility::CHECK_BOUNDS, true, "select past the last occurrence should fail.");
+
     std::cout << "Success\n";
 }